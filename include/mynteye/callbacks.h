@@ -5,6 +5,7 @@
 #include <algorithm>
 #include "mynteye/types.h"
 #include "mynteye/image.h"
+#include "mynteye/depth_stats.h"
 
 MYNTEYE_BEGIN_NAMESPACE
 
@@ -38,6 +39,9 @@ struct MYNTEYE_API StreamData {
 
   /** Image data */
   std::shared_ptr<Image> img;
+
+  /** Depth stats, of DEPTH_RAW if enabled */
+  std::shared_ptr<DepthStats> depth_stats;
 };
 
 } // namespace device
@@ -16,13 +16,22 @@
 #pragma once
 
 #include <cstdint>
+#include <functional>
 #include <memory>
 #include <vector>
 #include <string>
 
+#include "mynteye/depth_filter.h"
+#include "mynteye/depth_stats.h"
 #include "mynteye/device_info.h"
 #include "mynteye/image.h"
+#include "mynteye/imu_sync.h"
 #include "mynteye/init_params.h"
+#include "mynteye/laser_scan.h"
+#include "mynteye/record.h"
+#include "mynteye/record_reader.h"
+#include "mynteye/rectifier.h"
+#include "mynteye/stereo_calibration.h"
 #include "mynteye/stream_info.h"
 #include "mynteye/types.h"
 #include "mynteye/callbacks.h"
@@ -58,6 +67,12 @@ struct MYNTEYE_API StreamData {
   /** Image data */
   std::shared_ptr<Image> img;
 
+  /**
+   * Depth stats and invalid mask, of IMAGE_DEPTH in DEPTH_RAW when
+   * EnableDepthStats(), else nullptr.
+   */
+  std::shared_ptr<DepthStats> depth_stats;
+
   bool operator==(const StreamData& other) const {
     if (img_info && other.img_info) {
       return img_info->frame_id == other.img_info->frame_id &&
@@ -73,7 +88,21 @@ class CameraPrivate;
 
 class MYNTEYE_API Camera {
  public:
+  using stream_callback_t = std::function<void(const StreamData&)>;
+  using motion_callback_t = std::function<void(const MotionData&)>;
+  using imu_callback_t = std::function<void(const std::vector<ImuSample>&)>;
+
   Camera();
+  /**
+   * Play a record file of Recorder as the camera, through the same capture
+   * and process as the device. Open with any params, the recorded are used.
+   */
+  explicit Camera(const ReplayParams& params);
+  /**
+   * Generate a test pattern as the camera, through the same capture and
+   * process as the device, at the size and rates of params.
+   */
+  explicit Camera(const SyntheticParams& params);
   ~Camera();
 
   /** Get Deveces info */
@@ -94,9 +123,43 @@ class MYNTEYE_API Camera {
 
   /** Get the work status of the camera true(working)/false(stopped) */
   bool IsOpened() const;
+  /** Whether a replay played to its end, never of a device. */
+  bool IsEnded() const;
 
-  /** Enable image of type */
+  /**
+   * Enable image of type. IMAGE_DEPTH_REGISTERED also enables left color and
+   * depth, and registers the raw depth of the same frame id to each left
+   * color frame, of its size and with its info; a color whose depth is
+   * dropped is skipped. IMAGE_DEPTH_MIN_* and IMAGE_DEPTH_MEDIAN_*
+   * also enable depth, and pool each raw depth frame with DepthPyramid.
+   */
   void EnableImageType(const ImageType& type);
+  /**
+   * Disable image of type. Before open it is not streamed. After open its
+   * frames are dropped, and the device stops being read if no type of color
+   * or of depth is left; EnableImageType() resumes it. Disabling depth also
+   * stops the types made of it. ALL disables every type.
+   */
+  void DisableImageType(const ImageType& type);
+  /**
+   * Set the callback of image type, or unset if nullptr. Frames of the type
+   * are then passed to it instead of queued for RetrieveImages(). It is
+   * called on the thread of the SDK that synthesizes frames, so should
+   * return soon.
+   */
+  void SetStreamCallback(const ImageType& type, stream_callback_t callback);
+  /**
+   * Set the callback of motion datas, or unset if nullptr. Datas are then
+   * passed to it as read instead of queued for RetrieveMotions(), on the
+   * thread of the SDK reading them.
+   */
+  void SetMotionCallback(motion_callback_t callback);
+  /**
+   * Set the callback of imu samples, or unset if nullptr, in place of the
+   * motion callback. Accelerometer is interpolated to the time of each
+   * gyroscope by ImuSynchronizer, and batch samples are passed per call.
+   */
+  void SetImuCallback(imu_callback_t callback, std::size_t batch = 1);
   /** Get datas of stream */
   std::vector<mynteye::StreamData> RetrieveImages(const ImageType& type);
   /** Get datas of stream and status */
@@ -131,9 +194,58 @@ class MYNTEYE_API Camera {
     return struct CameraCtrlRectLogData.*/
   struct CameraCtrlRectLogData GetVGACameraCtrlData();
 
+  /** Get the stereo calibration of the opened stream mode. */
+  StereoCalibration GetStereoCalibration() const;
+
   /** Set Image mode ( raw image and rectified image )*/
   void SetImageMode(const ImageMode& mode);
 
+  /**
+   * Rectify left and right color images on the host, for the raw image mode.
+   * The outputs are COLOR_RGB. Skipped in the rectified image mode, of the
+   * images rectified by the device.
+   */
+  void EnableHostRectification(bool enabled = true);
+  /** Get the host rectifier, nullptr if not enabled or not opened. */
+  std::shared_ptr<Rectifier> GetRectifier() const;
+  /**
+   * Set the directory of the host rectification cache, maps are loaded from
+   * it instead of built when the serial, mode and calibration match.
+   * Default is $MYNTEYE_CACHE_DIR or ~/.mynteye/cache, empty to disable.
+   */
+  void SetCacheDirectory(const std::string& dir);
+
+  /**
+   * Filter DEPTH_RAW images before they are retrieved, nullptr to disable.
+   * The timings of the chain are updated by the capture thread.
+   */
+  void SetDepthFilter(const std::shared_ptr<DepthFilterChain>& filter);
+  /** Get the depth filter chain, nullptr if not set. */
+  std::shared_ptr<DepthFilterChain> GetDepthFilter() const;
+
+  /**
+   * Project each DEPTH_RAW image to a LaserScan, nullptr to disable.
+   * The projector must be of the depth size, see GetStereoCalibration().
+   */
+  void SetLaserScan(const std::shared_ptr<LaserScanProjector>& projector);
+  /** Get the scans projected since the last call. */
+  std::vector<LaserScan> RetrieveLaserScans();
+
+  /**
+   * Compute DepthStats of each DEPTH_RAW image as it arrives, attached to its
+   * StreamData of IMAGE_DEPTH. Disabled by default.
+   */
+  void EnableDepthStats(bool enabled = true);
+
+  /**
+   * Record the raw color, depth, image infos and imu into the opened recorder,
+   * nullptr to stop. Set after open, the stream parameters are recorded first.
+   * Streams are captured while recording, even if all image types disabled.
+   */
+  void SetRecorder(const std::shared_ptr<Recorder>& recorder);
+  /** Whether a recorder is set. */
+  bool IsRecording() const;
+
   /** Get device information of Info*/
   std::string GetInfo(const Info &info) const;
 
@@ -0,0 +1,200 @@
+// Copyright 2018 Slightech Co., Ltd. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#ifndef MYNTEYE_DEPTH_FILTER_H_
+#define MYNTEYE_DEPTH_FILTER_H_
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "mynteye/stubs/global.h"
+#include "mynteye/image.h"
+#include "mynteye/util/aligned_allocator.h"
+
+MYNTEYE_BEGIN_NAMESPACE
+
+/**
+ * Filter of raw depth, in place. Invalid pixels are 0 or 4096 on input and
+ * 0 on output. Rows are split into bands and filtered on all cores.
+ */
+class MYNTEYE_API DepthFilter {
+ public:
+  template <typename T>
+  using buffer_t = std::vector<T, AlignedAllocator<T>>;
+
+  virtual ~DepthFilter();
+
+  /** Name of the filter in timings. */
+  virtual std::string name() const = 0;
+
+  /**
+   * Filter raw depth in place.
+   * @param step bytes per depth row.
+   */
+  virtual void Process(std::uint16_t* depth, int width, int height,
+      std::size_t step) = 0;
+
+  /** Drop the state kept across frames, if any. */
+  virtual void Reset() {}
+};
+
+/**
+ * Exponential moving average of each pixel over frames. A pixel that differs
+ * from its average by delta or more starts again, so edges do not smear.
+ */
+class MYNTEYE_API TemporalFilter : public DepthFilter {
+ public:
+  /**
+   * @param alpha weight of the new frame, (0, 1].
+   * @param delta raw depth difference that restarts the average.
+   * @param persistence frames to keep the average of a pixel gone invalid.
+   */
+  explicit TemporalFilter(float alpha = 0.4f, std::uint16_t delta = 20,
+      int persistence = 0);
+
+  std::string name() const override { return "temporal"; }
+  void Process(std::uint16_t* depth, int width, int height,
+      std::size_t step) override;
+  void Reset() override;
+
+ private:
+  int alpha_;  // 8 bits fixed point
+  std::uint16_t delta_;
+  std::uint8_t persistence_;
+  int width_;
+  int height_;
+  buffer_t<std::uint16_t> average_;
+  buffer_t<std::uint8_t> age_;
+};
+
+/**
+ * Invalidate small blobs, like cv::filterSpeckles: 4-connected regions whose
+ * neighbors differ by at most max_diff and have at most max_size pixels.
+ * Regions cross row bands, so it runs on the calling thread.
+ */
+class MYNTEYE_API SpeckleFilter : public DepthFilter {
+ public:
+  explicit SpeckleFilter(int max_size = 100, std::uint16_t max_diff = 16);
+
+  std::string name() const override { return "speckle"; }
+  void Process(std::uint16_t* depth, int width, int height,
+      std::size_t step) override;
+
+ private:
+  int max_size_;
+  std::uint16_t max_diff_;
+  buffer_t<std::int32_t> labels_;
+  buffer_t<std::uint8_t> removed_;
+  std::vector<std::int32_t> stack_;
+};
+
+/**
+ * Fill horizontal runs of invalid pixels up to max_hole long, that have
+ * valid pixels on both sides, with the farther of the two.
+ */
+class MYNTEYE_API HoleFillFilter : public DepthFilter {
+ public:
+  explicit HoleFillFilter(int max_hole = 4);
+
+  std::string name() const override { return "hole_fill"; }
+  void Process(std::uint16_t* depth, int width, int height,
+      std::size_t step) override;
+
+ private:
+  int max_hole_;
+};
+
+/**
+ * Edge preserving smoothing, a recursive filter run both ways along rows
+ * and then columns, which stops where neighbors differ by delta or more.
+ */
+class MYNTEYE_API SpatialFilter : public DepthFilter {
+ public:
+  /**
+   * @param alpha weight of the pixel itself, (0, 1], less is smoother.
+   * @param delta raw depth difference of an edge.
+   * @param iterations passes of the rows and columns.
+   */
+  explicit SpatialFilter(float alpha = 0.5f, std::uint16_t delta = 20,
+      int iterations = 1);
+
+  std::string name() const override { return "spatial"; }
+  void Process(std::uint16_t* depth, int width, int height,
+      std::size_t step) override;
+
+ private:
+  int alpha_;  // 8 bits fixed point
+  std::uint16_t delta_;
+  int iterations_;
+};
+
+/**
+ * @ingroup datatypes
+ * Time spent by a filter of DepthFilterChain.
+ */
+struct MYNTEYE_API DepthFilterTiming {
+  std::string name;
+  /** Milliseconds of the last frame */
+  double last_ms;
+  /** Average milliseconds of all frames */
+  double average_ms;
+  std::uint64_t frames;
+};
+
+/**
+ * Filters run one after another on each depth frame, timed per filter.
+ * It can be set to Camera, then depth images are filtered before they are
+ * retrieved.
+ */
+class MYNTEYE_API DepthFilterChain {
+ public:
+  DepthFilterChain();
+  ~DepthFilterChain();
+
+  /** Speckle, spatial, temporal and hole fill with default parameters. */
+  static std::shared_ptr<DepthFilterChain> CreateDefault();
+
+  void Add(const std::shared_ptr<DepthFilter>& filter);
+  void Clear();
+  std::size_t size() const;
+
+  /** Filter a DEPTH_RAW image in place, false for other formats. */
+  bool Process(const Image::pointer& depth);
+  void Process(std::uint16_t* depth, int width, int height,
+      std::size_t step);
+
+  /** Reset the state of all filters, e.g. after a jump of the view. */
+  void Reset();
+
+  std::vector<DepthFilterTiming> GetTimings() const;
+
+ private:
+  struct Stage {
+    std::shared_ptr<DepthFilter> filter;
+    DepthFilterTiming timing;
+  };
+
+  mutable std::mutex mtx_;
+  std::vector<Stage> stages_;
+
+  MYNTEYE_DISABLE_COPY(DepthFilterChain)
+  MYNTEYE_DISABLE_MOVE(DepthFilterChain)
+};
+
+MYNTEYE_END_NAMESPACE
+
+#endif  // MYNTEYE_DEPTH_FILTER_H_
@@ -0,0 +1,97 @@
+// Copyright 2018 Slightech Co., Ltd. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#ifndef MYNTEYE_DEPTH_PYRAMID_H_
+#define MYNTEYE_DEPTH_PYRAMID_H_
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "mynteye/stubs/global.h"
+#include "mynteye/image.h"
+
+MYNTEYE_BEGIN_NAMESPACE
+
+/**
+ * @ingroup enumerations
+ * @brief How a 2x2 cell of depth is pooled to one pixel.
+ */
+enum class DepthPooling : std::int32_t {
+  /** The nearest valid depth, e.g. for obstacle checks */
+  MIN,
+  /** The lower median of the valid depths, robust to outliers */
+  MEDIAN,
+};
+
+/**
+ * Downsampled levels of raw depth, each half the size of the one before,
+ * rounded up. Invalid pixels (0 or 4096) are skipped when pooling, and a
+ * cell of no valid depth is 0. Levels are pooled from the level before, so
+ * the third level of 1280x720 is 160x90 and costs 1/64 of the data to read.
+ *
+ * Pooling a row pair is branch free over plain arrays, and rows are split
+ * into bands on all cores.
+ */
+class MYNTEYE_API DepthPyramid {
+ public:
+  /** Most levels above the depth itself. */
+  static constexpr int kMaxLevels = 8;
+
+  /**
+   * @param pooling pooling of every level.
+   * @param levels levels above the depth, 1 to kMaxLevels.
+   */
+  explicit DepthPyramid(DepthPooling pooling = DepthPooling::MIN,
+      int levels = 3);
+  ~DepthPyramid();
+
+  DepthPooling pooling() const {
+    return pooling_;
+  }
+
+  int levels() const {
+    return static_cast<int>(levels_.size());
+  }
+
+  /**
+   * Build all levels from a DEPTH_RAW image. A level of the last build is
+   * reused if of the same size and no one else holds it, else a new image,
+   * so those held stay valid.
+   * @return false if depth is not DEPTH_RAW.
+   */
+  bool Build(const Image::pointer& depth);
+
+  /**
+   * Level of the last build, 1 is half the size of the depth. Levels 1 to 3
+   * are of the pooled types, e.g. IMAGE_DEPTH_MIN_2, the others IMAGE_DEPTH.
+   * @return nullptr if out of range or not built.
+   */
+  Image::pointer GetLevel(int level) const;
+
+  /**
+   * Pool raw depth of width x height to (width + 1) / 2 x (height + 1) / 2.
+   * @param step, dst_step bytes per row.
+   */
+  static void Pool(DepthPooling pooling, const std::uint16_t* src,
+      int width, int height, std::size_t step, std::uint16_t* dst,
+      std::size_t dst_step);
+
+ private:
+  DepthPooling pooling_;
+  std::vector<Image::pointer> levels_;
+};
+
+MYNTEYE_END_NAMESPACE
+
+#endif  // MYNTEYE_DEPTH_PYRAMID_H_
@@ -0,0 +1,149 @@
+// Copyright 2018 Slightech Co., Ltd. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#ifndef MYNTEYE_DEPTH_QUERY_H_
+#define MYNTEYE_DEPTH_QUERY_H_
+#pragma once
+
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+#include "mynteye/stubs/global.h"
+#include "mynteye/image.h"
+#include "mynteye/util/aligned_allocator.h"
+
+MYNTEYE_BEGIN_NAMESPACE
+
+/**
+ * @ingroup datatypes
+ * Box of pixels, clamped to the depth when queried.
+ */
+struct MYNTEYE_API DepthBox {
+  int x;
+  int y;
+  int width;
+  int height;
+
+  /** Box of (2 * radius + 1) ^ 2 pixels centered at (x, y). */
+  static DepthBox Around(int x, int y, int radius) {
+    return {x - radius, y - radius, 2 * radius + 1, 2 * radius + 1};
+  }
+};
+
+/**
+ * @ingroup datatypes
+ * Depth of valid pixels in a box, all 0 if none.
+ */
+struct MYNTEYE_API DepthBoxResult {
+  std::uint32_t count;
+  std::uint16_t min;
+  std::uint16_t max;
+  double mean;
+  /** Lower median, only if asked for */
+  std::uint16_t median;
+};
+
+/**
+ * Queries of valid depth (not 0 or 4096) in boxes of one raw depth frame.
+ *
+ * Structures are built at the first query that needs them, once:
+ * - summed-area tables of valid depth and valid count, so count and mean
+ *   take four reads a box whatever its size.
+ * - min and max of each 16x16 tile, so min and max read whole tiles once
+ *   and only scan the pixels of partial tiles at the box border.
+ * The median gathers the valid depths of the box, it has no table.
+ *
+ * Queries are const and safe from many threads. Batch queries split boxes
+ * on all cores.
+ */
+class MYNTEYE_API DepthQuery {
+ public:
+  /** Side of a min/max tile, pixels. */
+  static constexpr int kTileSize = 16;
+
+  /** @param depth a DEPTH_RAW image, kept by the query. */
+  explicit DepthQuery(const Image::pointer& depth);
+  ~DepthQuery();
+
+  /** Whether depth is DEPTH_RAW, else every query is empty. */
+  bool IsValid() const {
+    return data_ != nullptr;
+  }
+
+  int width() const {
+    return width_;
+  }
+
+  int height() const {
+    return height_;
+  }
+
+  std::uint32_t Count(const DepthBox& box) const;
+  double Mean(const DepthBox& box) const;
+  std::uint16_t Min(const DepthBox& box) const;
+  std::uint16_t Max(const DepthBox& box) const;
+  std::uint16_t Median(const DepthBox& box) const;
+
+  /** All of the box, the median only if median is true. */
+  DepthBoxResult Query(const DepthBox& box, bool median = false) const;
+
+  /** Query each box, results are in the order of boxes. */
+  void Query(const std::vector<DepthBox>& boxes,
+      std::vector<DepthBoxResult>* results, bool median = false) const;
+  void Mean(const std::vector<DepthBox>& boxes,
+      std::vector<double>* means) const;
+  void Min(const std::vector<DepthBox>& boxes,
+      std::vector<std::uint16_t>* mins) const;
+  void Median(const std::vector<DepthBox>& boxes,
+      std::vector<std::uint16_t>* medians) const;
+
+ private:
+  template <typename T>
+  using buffer_t = std::vector<T, AlignedAllocator<T>>;
+
+  /** Box clamped to the depth as [x0, x1) x [y0, y1), false if empty. */
+  bool Clamp(const DepthBox& box, int* x0, int* y0, int* x1, int* y1) const;
+
+  void BuildSums() const;
+  void BuildTiles() const;
+
+  void Sums(const DepthBox& box, std::uint32_t* count,
+      std::uint64_t* sum) const;
+  void MinMax(const DepthBox& box, std::uint16_t* min,
+      std::uint16_t* max) const;
+
+  Image::pointer depth_;
+  const std::uint16_t* data_;
+  int width_;
+  int height_;
+  int tiles_x_;
+  int tiles_y_;
+
+  mutable std::once_flag sums_once_;
+  /** (width + 1) x (height + 1), row 0 and column 0 are 0 */
+  mutable buffer_t<std::uint64_t> sum_;
+  mutable buffer_t<std::uint32_t> count_;
+
+  mutable std::once_flag tiles_once_;
+  /** Of valid depths, min is 0xFFFF and max is 0 if none */
+  mutable buffer_t<std::uint16_t> tile_min_;
+  mutable buffer_t<std::uint16_t> tile_max_;
+
+  MYNTEYE_DISABLE_COPY(DepthQuery)
+  MYNTEYE_DISABLE_MOVE(DepthQuery)
+};
+
+MYNTEYE_END_NAMESPACE
+
+#endif  // MYNTEYE_DEPTH_QUERY_H_
@@ -0,0 +1,150 @@
+// Copyright 2018 Slightech Co., Ltd. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#ifndef MYNTEYE_DEPTH_REGISTRATION_H_
+#define MYNTEYE_DEPTH_REGISTRATION_H_
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "mynteye/stubs/global.h"
+#include "mynteye/image.h"
+#include "mynteye/stereo_calibration.h"
+#include "mynteye/types.h"
+#include "mynteye/util/aligned_allocator.h"
+
+MYNTEYE_BEGIN_NAMESPACE
+
+/**
+ * Register raw depth onto the image plane of a color eye.
+ *
+ * The device computes depth on the rectified left eye. Each depth pixel is
+ * unprojected along its ray, moved into the color camera with the
+ * rectification rotation and the baseline, and projected with the color
+ * intrinsics and distortion. It is splatted over the footprint of the pixel
+ * in the color image, keeping the nearest depth of overlaps in a z-buffer.
+ *
+ * For the left eye the color camera shares the center of the depth, so
+ * where a pixel lands does not depend on its depth. The footprint of every
+ * pixel is then computed once. The right eye projects at every frame from
+ * rays of each column and row. Rows are split into bands on all cores.
+ * Register reuses the z-buffer, and its output image once no one else holds
+ * it, so the calls on an instance run one at a time.
+ */
+class MYNTEYE_API DepthRegistration {
+ public:
+  template <typename T>
+  using buffer_t = std::vector<T, AlignedAllocator<T>>;
+
+  /**
+   * @param calib the calibration, depth is of its size.
+   * @param eye IMAGE_LEFT_COLOR or IMAGE_RIGHT_COLOR.
+   * @param rectified whether the color is rectified, else it is raw.
+   * @param width, height the color size, 0 for the calibration size.
+   */
+  explicit DepthRegistration(const StereoCalibration& calib,
+      const ImageType& eye = ImageType::IMAGE_LEFT_COLOR,
+      bool rectified = false, int width = 0, int height = 0);
+  ~DepthRegistration();
+
+  bool IsValid() const {
+    return valid_;
+  }
+
+  /** Width of the registered depth, the color width. */
+  int width() const {
+    return width_;
+  }
+
+  /** Height of the registered depth, the color height. */
+  int height() const {
+    return height_;
+  }
+
+  ImageType eye() const {
+    return eye_;
+  }
+
+  bool rectified() const {
+    return rectified_;
+  }
+
+  const StereoCalibration& GetCalibration() const {
+    return calib_;
+  }
+
+  /**
+   * Register raw depth of the calibration size, in the calibration unit.
+   * @param dst output of width() * height(), 0 where no depth.
+   * @return false if not valid.
+   */
+  bool Register(const std::uint16_t* depth, std::size_t depth_step,
+      std::uint16_t* dst, std::size_t dst_step) const;
+
+  /**
+   * Register a DEPTH_RAW image.
+   * @param color the color frame, gives its frame id to the result.
+   * @return a DEPTH_RAW image of the color size, nullptr if failed.
+   */
+  Image::pointer Register(const Image::pointer& depth,
+      const Image::pointer& color = nullptr) const;
+
+ private:
+  /** Footprint of a depth pixel in the color image, inclusive. */
+  struct Box {
+    std::int16_t x0, y0, x1, y1;
+  };
+
+  bool Project(double x, double y, double z, double* u, double* v) const;
+  int CornerStep() const;
+
+  StereoCalibration calib_;
+  ImageType eye_;
+  bool rectified_;
+  int width_;
+  int height_;
+  bool valid_;
+  /** Depth is copied as is, the left rectified color of the same size */
+  bool identity_;
+
+  /** Color camera: rotation from the rectified left, center, intrinsics */
+  double rot_[9];
+  double center_[3];
+  double fx_, fy_, cx_, cy_;
+  double dist_[8];
+
+  /** Corner rays of depth columns and rows, width + 1 and height + 1 */
+  buffer_t<float> rays_x_;
+  buffer_t<float> rays_y_;
+
+  /** Left eye only, the footprint and depth scale of each depth pixel */
+  buffer_t<Box> boxes_;
+  buffer_t<float> z_scales_;
+
+  mutable std::mutex mutex_;
+  /** Nearest depth of each color pixel, of the last Register */
+  mutable std::unique_ptr<std::atomic<std::uint16_t>[]> zbuf_;
+  /** Image of the last Register, reused once no one else holds it */
+  mutable Image::pointer output_;
+
+  MYNTEYE_DISABLE_COPY(DepthRegistration)
+  MYNTEYE_DISABLE_MOVE(DepthRegistration)
+};
+
+MYNTEYE_END_NAMESPACE
+
+#endif  // MYNTEYE_DEPTH_REGISTRATION_H_
@@ -0,0 +1,87 @@
+// Copyright 2018 Slightech Co., Ltd. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#ifndef MYNTEYE_DEPTH_STATS_H_
+#define MYNTEYE_DEPTH_STATS_H_
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "mynteye/stubs/global.h"
+#include "mynteye/image.h"
+
+MYNTEYE_BEGIN_NAMESPACE
+
+/**
+ * @ingroup datatypes
+ * Statistics and invalid mask of a raw depth frame, in one pass.
+ *
+ * Invalid pixels (0 or 4096) are left out of every statistic and have their
+ * bit set in the mask. Rows are split into bands on all cores; each band
+ * reads its rows once, with a branch free inner loop of 64 pixels a mask
+ * word, and the band results are merged.
+ */
+struct MYNTEYE_API DepthStats {
+  /** Frame id of the depth */
+  int frame_id;
+  int width;
+  int height;
+
+  /** Nearest valid depth, 0 if none */
+  std::uint16_t min;
+  /** Farthest valid depth, 0 if none */
+  std::uint16_t max;
+  /** Mean of valid depths, 0 if none */
+  double mean;
+  /** Count of valid depths */
+  std::uint32_t valid;
+  /** valid / (width * height) */
+  float valid_ratio;
+
+  /**
+   * Count of valid depths of each bin, bin i is [i << shift, (i + 1) << shift)
+   * and the last bin also holds all depths beyond.
+   */
+  std::vector<std::uint32_t> histogram;
+  int histogram_shift;
+
+  /** Mask words per row, (width + 63) / 64 */
+  std::size_t mask_stride;
+  /**
+   * Packed invalid mask, bit (x % 64) of word y * mask_stride + x / 64 is set
+   * if depth (x, y) is invalid. The padding bits of each row are clear.
+   */
+  std::vector<std::uint64_t> mask;
+
+  /** Whether depth (x, y) is invalid, by the mask. */
+  bool IsInvalid(int x, int y) const {
+    return (mask[y * mask_stride + (x >> 6)] >> (x & 63)) & 1;
+  }
+
+  /**
+   * Compute stats of raw depth. The vectors of stats keep their capacity.
+   * @param step bytes per depth row.
+   * @param bins, shift the histogram bins and their width, 1 << shift.
+   */
+  static void Compute(const std::uint16_t* depth, int width, int height,
+      std::size_t step, DepthStats* stats, int bins = 128, int shift = 6);
+
+  /** Compute stats of a DEPTH_RAW image, false if not DEPTH_RAW. */
+  static bool Compute(const Image::pointer& depth, DepthStats* stats,
+      int bins = 128, int shift = 6);
+};
+
+MYNTEYE_END_NAMESPACE
+
+#endif  // MYNTEYE_DEPTH_STATS_H_
@@ -18,6 +18,7 @@
 #include <cstdint>
 #include <map>
 #include <memory>
+#include <utility>
 #include <vector>
 #include <iostream>
 
@@ -27,16 +28,19 @@
 
 #include "mynteye/stubs/global.h"
 #include "mynteye/types.h"
+#include "mynteye/util/aligned_allocator.h"
 
 MYNTEYE_BEGIN_NAMESPACE
 
 class MYNTEYE_API Image {
  public:
   using pointer = std::shared_ptr<Image>;
+  /** Pixel storage, aligned and not zero-filled on allocation or resize. */
+  using buffer_t = std::vector<std::uint8_t, AlignedAllocator<std::uint8_t>>;
 
  protected:
   Image(ImageType type, ImageFormat format, int width, int height,
-      bool is_buffer);
+      bool is_buffer, bool allocate = true);
 
  public:
   virtual ~Image();
@@ -44,6 +48,16 @@ class MYNTEYE_API Image {
   static pointer Create(ImageType type, ImageFormat format, int width,
       int height, bool is_buffer);
 
+  /**
+   * Create a view of size bytes at data, not copied, e.g. in a mapped file.
+   * The view holds owner to keep data alive. Its pixels are read-only, the
+   * non-const data() copies them first and the image is no more a view, so
+   * readers use cdata().
+   */
+  static pointer CreateView(ImageType type, ImageFormat format, int width,
+      int height, const std::uint8_t* data, std::size_t size,
+      std::shared_ptr<const void> owner);
+
   ImageType type() const {
     return type_;
   }
@@ -60,7 +74,7 @@ class MYNTEYE_API Image {
     return height_;
   }
 
-  int frame_id() {
+  int frame_id() const {
     return frame_id_;
   }
 
@@ -72,16 +86,26 @@ class MYNTEYE_API Image {
     return is_buffer_;
   }
 
+  bool is_view() const {
+    return view_ != nullptr;
+  }
+
   std::uint8_t* data() {
+    if (view_) Detach();
     return data_.data();
   }
 
   const std::uint8_t* data() const {
-    return data_.data();
+    return view_ ? view_ : data_.data();
+  }
+
+  /** The pixels to read, of a view not copied as by the non-const data(). */
+  const std::uint8_t* cdata() const {
+    return data();
   }
 
   std::size_t size() const {
-    return data_.size();
+    return view_ ? view_size_ : data_.size();
   }
 
   std::size_t valid_size() const {
@@ -92,12 +116,27 @@ class MYNTEYE_API Image {
     valid_size_ = valid_size;
   }
 
+  /**
+   * Resize data to valid size, the contents are left uninitialized.
+   * A view is not resized.
+   */
   void resize() {
-    data_.assign(valid_size_, 0);
+    if (!view_) data_.resize(valid_size_);
   }
 
   virtual pointer To(ImageFormat format) = 0;
 
+  /**
+   * Convert into dst of width * height pixels of format, e.g. a message
+   * buffer, writing each pixel once. This image and its caches are left
+   * as they are.
+   *
+   * Color converts to COLOR_RGB, COLOR_BGR and IMAGE_GRAY_8, and any
+   * format other than IMAGE_MJPG copies to itself.
+   * @return false if the conversion is not supported.
+   */
+  bool ConvertTo(ImageFormat format, std::uint8_t* dst) const;
+
 #ifdef WITH_OPENCV
   cv::Mat ToMat();
 #endif
@@ -109,6 +148,10 @@ class MYNTEYE_API Image {
 
  protected:
   Image::pointer GetCache(const ImageFormat& format);
+  void SetView(const std::uint8_t* data, std::size_t size,
+      std::shared_ptr<const void> owner);
+  /** Copy the pixels of a view to own, as they are to be written. */
+  void Detach();
 
   ImageType type_;
   ImageFormat format_;
@@ -119,9 +162,14 @@ class MYNTEYE_API Image {
 
   ImageFormat raw_format_;
 
-  std::vector<std::uint8_t> data_;
+  buffer_t data_;
   std::size_t valid_size_;
 
+  /** Pixels of a view in place of data_, kept alive by view_owner_ */
+  const std::uint8_t* view_ = nullptr;
+  std::size_t view_size_ = 0;
+  std::shared_ptr<const void> view_owner_;
+
   std::map<int, Image::pointer> bpp_caches_;
 
   MYNTEYE_DISABLE_COPY(Image)
@@ -134,7 +182,8 @@ class MYNTEYE_API ImageColor : public Image,
   using pointer = std::shared_ptr<ImageColor>;
 
  protected:
-  ImageColor(ImageFormat format, int width, int height, bool is_buffer);
+  ImageColor(ImageFormat format, int width, int height, bool is_buffer,
+      bool allocate = true);
 
  public:
   virtual ~ImageColor();
@@ -144,6 +193,14 @@ class MYNTEYE_API ImageColor : public Image,
     return pointer(new ImageColor(format, width, height, is_buffer));
   }
 
+  static pointer CreateView(ImageFormat format, int width, int height,
+      const std::uint8_t* data, std::size_t size,
+      std::shared_ptr<const void> owner) {
+    pointer image(new ImageColor(format, width, height, false, false));
+    image->SetView(data, size, std::move(owner));
+    return image;
+  }
+
   Image::pointer To(ImageFormat format) override;
 
  private:
@@ -157,14 +214,25 @@ class MYNTEYE_API ImageDepth : public Image,
   using pointer = std::shared_ptr<ImageDepth>;
 
  protected:
-  ImageDepth(ImageFormat format, int width, int height, bool is_buffer);
+  ImageDepth(ImageType type, ImageFormat format, int width, int height,
+      bool is_buffer, bool allocate = true);
 
  public:
   virtual ~ImageDepth();
 
+  /** Create of type, IMAGE_DEPTH or a type derived of it, e.g. pooled. */
   static pointer Create(ImageFormat format, int width, int height,
-      bool is_buffer) {
-    return pointer(new ImageDepth(format, width, height, is_buffer));
+      bool is_buffer, ImageType type = ImageType::IMAGE_DEPTH) {
+    return pointer(new ImageDepth(type, format, width, height, is_buffer));
+  }
+
+  static pointer CreateView(ImageFormat format, int width, int height,
+      const std::uint8_t* data, std::size_t size,
+      std::shared_ptr<const void> owner,
+      ImageType type = ImageType::IMAGE_DEPTH) {
+    pointer image(new ImageDepth(type, format, width, height, false, false));
+    image->SetView(data, size, std::move(owner));
+    return image;
   }
 
   Image::pointer To(ImageFormat format) override;
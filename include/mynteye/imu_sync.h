@@ -0,0 +1,87 @@
+// Copyright 2018 Slightech Co., Ltd. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#ifndef MYNTEYE_IMU_SYNC_H_
+#define MYNTEYE_IMU_SYNC_H_
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <vector>
+
+#include "mynteye/stubs/global.h"
+#include "mynteye/types.h"
+
+MYNTEYE_BEGIN_NAMESPACE
+
+/**
+ * @ingroup datatypes
+ * Accelerometer and gyroscope of one time, in the units of ImuData.
+ */
+struct MYNTEYE_API ImuSample {
+  /** Timestamp of the gyroscope */
+  std::uint64_t timestamp;
+  /** temperature */
+  double temperature;
+  /** Accelerometer, interpolated to timestamp */
+  double accel[3];
+  /** Gyroscope */
+  double gyro[3];
+};
+
+/**
+ * Pair the accelerometer and gyroscope records of the device, which come
+ * apart and at their own times, into samples.
+ *
+ * Each gyroscope record makes one sample, with the accelerometer linearly
+ * interpolated between the records before and after its time. A gyroscope
+ * newer than the last accelerometer waits for the next one, at most
+ * max_pending of them, then the last accelerometer is held.
+ */
+class MYNTEYE_API ImuSynchronizer {
+ public:
+  explicit ImuSynchronizer(std::size_t max_pending = 8);
+  ~ImuSynchronizer();
+
+  /**
+   * Push a record, flag 1 accelerometer or 2 gyroscope, in time order of
+   * its kind.
+   * @param samples the samples made of it are appended.
+   * @return the number of samples appended.
+   */
+  std::size_t Push(const ImuData& imu, std::vector<ImuSample>* samples);
+
+  /** Forget the records pushed. */
+  void Reset();
+
+ private:
+  struct Record {
+    std::uint64_t timestamp;
+    double temperature;
+    double values[3];
+  };
+
+  void Emit(const Record& gyro, std::vector<ImuSample>* samples);
+
+  std::size_t max_pending_;
+  /** Accelerometers from the one before the oldest pending gyroscope */
+  std::deque<Record> accels_;
+  std::deque<Record> gyros_;
+
+  MYNTEYE_DISABLE_COPY(ImuSynchronizer)
+  MYNTEYE_DISABLE_MOVE(ImuSynchronizer)
+};
+
+MYNTEYE_END_NAMESPACE
+
+#endif  // MYNTEYE_IMU_SYNC_H_
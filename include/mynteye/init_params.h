@@ -79,6 +79,40 @@ struct MYNTEYE_API InitParams {
   ~InitParams();
 };
 
+/**
+ * @ingroup datatypes
+ * Synthetic parameters, of a test pattern generated as a camera.
+ *
+ * The patterns, infos and imu are the same of the same params, but for the
+ * jitter and drops, the same of the same seed.
+ */
+struct MYNTEYE_API SyntheticParams {
+  /** Device name, to tell several cameras apart */
+  std::string name = "synthetic";
+  /** Color size, 0 as of the stream mode opened */
+  std::int32_t color_width = 0;
+  std::int32_t color_height = 0;
+  /** Depth size, 0 as of the stream mode opened */
+  std::int32_t depth_width = 0;
+  std::int32_t depth_height = 0;
+  /** Framerate, 0 as opened, not limited as of the device */
+  std::int32_t framerate = 0;
+  /** Image infos and imu generated, as by the hid of the device */
+  bool hid = true;
+  /** Imu rate in Hz, of an accel and a gyro each, 0 without */
+  std::int32_t imu_rate = 200;
+  /** Max delay of a frame after its time in ms, uniform */
+  double jitter_ms = 0;
+  /** Probability of each color, depth and image info dropped */
+  double drop_rate = 0;
+  /** The first frame id, e.g. near the wrap */
+  std::uint32_t frame_id_start = 0;
+  /** Frame ids count modulo, at most 0x10000 of the image infos */
+  std::uint32_t frame_id_wrap = 0x10000;
+  /** Seed of the jitter and drops */
+  std::uint32_t seed = 0;
+};
+
 MYNTEYE_END_NAMESPACE
 
 #endif  // MYNTEYE_INIT_PARAMS_H_
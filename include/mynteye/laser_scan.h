@@ -0,0 +1,128 @@
+// Copyright 2018 Slightech Co., Ltd. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#ifndef MYNTEYE_LASER_SCAN_H_
+#define MYNTEYE_LASER_SCAN_H_
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "mynteye/stubs/global.h"
+#include "mynteye/image.h"
+#include "mynteye/types.h"
+#include "mynteye/util/aligned_allocator.h"
+
+MYNTEYE_BEGIN_NAMESPACE
+
+/**
+ * @ingroup datatypes
+ * Planar scan of the depth camera, the same fields as sensor_msgs/LaserScan.
+ * Angles are counterclockwise seen from above, 0 is the optical axis, so
+ * the right of the image is negative.
+ */
+struct MYNTEYE_API LaserScan {
+  /** Frame id of the depth */
+  int frame_id;
+  /** Angle of the first range, radians */
+  float angle_min;
+  /** Angle of the last range, radians */
+  float angle_max;
+  /** Angle between ranges, radians */
+  float angle_increment;
+  /** Ranges out of [range_min, range_max] are discarded, meters */
+  float range_min;
+  float range_max;
+  /** Nearest range of each angle, meters, +inf if none */
+  std::vector<float> ranges;
+};
+
+/**
+ * Project a horizontal band of raw depth rows to a LaserScan.
+ *
+ * Each column is first reduced to its nearest depth over the band rows, a
+ * vertical min over whole rows. The column then gives its range, with its
+ * precomputed scale, to the bins its angular width covers, keeping the
+ * nearest.
+ * Columns are split into bands on all cores. An instance is immutable after
+ * construction.
+ */
+class MYNTEYE_API LaserScanProjector {
+ public:
+  /**
+   * @param in the intrinsics of the depth image.
+   * @param row_begin, row_end the band of rows [row_begin, row_end),
+   *   clamped to the image, e.g. a few rows around cy.
+   * @param bins ranges of the scan, 0 for one per column.
+   * @param range_min, range_max valid ranges, meters.
+   * @param depth_unit meters per raw depth value, default millimeters.
+   */
+  LaserScanProjector(const CameraIntrinsics& in, int row_begin, int row_end,
+      int bins = 0, float range_min = 0.2f, float range_max = 10.f,
+      float depth_unit = 0.001f);
+  ~LaserScanProjector();
+
+  const CameraIntrinsics& GetIntrinsics() const {
+    return in_;
+  }
+
+  int row_begin() const {
+    return row_begin_;
+  }
+
+  int row_end() const {
+    return row_end_;
+  }
+
+  int bins() const {
+    return bins_;
+  }
+
+  /**
+   * Project raw depth of the intrinsics size.
+   * @param step bytes per depth row.
+   * @param scan output, its ranges keep their capacity across calls.
+   */
+  void Project(const std::uint16_t* depth, std::size_t step,
+      LaserScan* scan) const;
+
+  /** Project a DEPTH_RAW image, false if not of the intrinsics. */
+  bool Project(const Image::pointer& depth, LaserScan* scan) const;
+
+ private:
+  template <typename T>
+  using buffer_t = std::vector<T, AlignedAllocator<T>>;
+
+  CameraIntrinsics in_;
+  int row_begin_;
+  int row_end_;
+  int bins_;
+  float range_min_;
+  float range_max_;
+  float angle_min_;
+  float angle_max_;
+  float angle_increment_;
+
+  /** Meters per raw depth value of each column, the depth to range scale */
+  buffer_t<float> scales_;
+  /** Bins covered by each column, first and last */
+  buffer_t<std::int32_t> bins_first_;
+  buffer_t<std::int32_t> bins_last_;
+
+  MYNTEYE_DISABLE_COPY(LaserScanProjector)
+  MYNTEYE_DISABLE_MOVE(LaserScanProjector)
+};
+
+MYNTEYE_END_NAMESPACE
+
+#endif  // MYNTEYE_LASER_SCAN_H_
@@ -0,0 +1,119 @@
+// Copyright 2018 Slightech Co., Ltd. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#ifndef MYNTEYE_NORMAL_ESTIMATION_H_
+#define MYNTEYE_NORMAL_ESTIMATION_H_
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "mynteye/stubs/global.h"
+#include "mynteye/image.h"
+#include "mynteye/point_cloud.h"
+#include "mynteye/types.h"
+
+MYNTEYE_BEGIN_NAMESPACE
+
+/**
+ * @ingroup datatypes
+ * Unit surface normal, facing the camera, NaN if none.
+ */
+struct MYNTEYE_API Normal {
+  float x;
+  float y;
+  float z;
+};
+
+/**
+ * Per-pixel surface normals of raw depth.
+ *
+ * Depth is unprojected with PointCloud to the organized layout. Integral
+ * images of the points and of their count then give the mean point of any
+ * box in four reads. The normal of a pixel is the cross product of the
+ * differences of the mean points of the boxes right and left of it and
+ * below and above it, each of (2 * radius + 1) ^ 2 pixels.
+ *
+ * A pixel has no normal if it has no depth, if a box has none, if depth
+ * changes more than max_depth_change of it across the boxes (an edge), or
+ * within 2 * radius of the image border.
+ *
+ * Rows are split into bands on all cores, and the normal of a row is a
+ * branch free loop. Buffers are kept across calls, an instance computes
+ * one frame at a time.
+ */
+class MYNTEYE_API NormalEstimator {
+ public:
+  template <typename T>
+  using buffer_t = std::vector<T, AlignedAllocator<T>>;
+
+  /**
+   * @param in the intrinsics of the depth image.
+   * @param radius smoothing radius of the boxes, pixels.
+   * @param max_depth_change relative depth change that is an edge.
+   * @param depth_unit meters per raw depth value, default millimeters.
+   */
+  explicit NormalEstimator(const CameraIntrinsics& in, int radius = 2,
+      float max_depth_change = 0.1f, float depth_unit = 0.001f);
+  ~NormalEstimator();
+
+  const CameraIntrinsics& GetIntrinsics() const {
+    return cloud_.GetIntrinsics();
+  }
+
+  int radius() const {
+    return radius_;
+  }
+
+  /**
+   * Compute normals of raw depth of the intrinsics size.
+   * @param step bytes per depth row.
+   * @param normals output of width * height normals.
+   * @return the number of pixels having a normal.
+   */
+  std::size_t Compute(const std::uint16_t* depth, std::size_t step,
+      Normal* normals);
+
+  /**
+   * Compute normals of a DEPTH_RAW image, normals is resized to it.
+   * @return the number of pixels having a normal, 0 if not of the size.
+   */
+  std::size_t Compute(const Image::pointer& depth,
+      buffer_t<Normal>* normals);
+
+  /** Organized points of the last depth, NaN if no depth. */
+  const PointCloud::buffer_t<PointXYZ>& GetPoints() const {
+    return points_;
+  }
+
+ private:
+  void Integrate();
+
+  PointCloud cloud_;
+  int radius_;
+  float max_depth_change_;
+
+  PointCloud::buffer_t<PointXYZ> points_;
+  /** Integral images, (width + 1) x (height + 1) */
+  buffer_t<double> sum_x_;
+  buffer_t<double> sum_y_;
+  buffer_t<double> sum_z_;
+  buffer_t<std::uint32_t> count_;
+
+  MYNTEYE_DISABLE_COPY(NormalEstimator)
+  MYNTEYE_DISABLE_MOVE(NormalEstimator)
+};
+
+MYNTEYE_END_NAMESPACE
+
+#endif  // MYNTEYE_NORMAL_ESTIMATION_H_
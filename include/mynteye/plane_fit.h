@@ -0,0 +1,165 @@
+// Copyright 2018 Slightech Co., Ltd. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#ifndef MYNTEYE_PLANE_FIT_H_
+#define MYNTEYE_PLANE_FIT_H_
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "mynteye/stubs/global.h"
+#include "mynteye/image.h"
+#include "mynteye/types.h"
+#include "mynteye/util/aligned_allocator.h"
+
+MYNTEYE_BEGIN_NAMESPACE
+
+/**
+ * @ingroup datatypes
+ * Plane a * x + b * y + c * z + d = 0 in the depth camera, meters. (a, b, c)
+ * is a unit normal facing the camera, so d >= 0 is the distance of the
+ * camera to the plane.
+ */
+struct MYNTEYE_API Plane {
+  float a;
+  float b;
+  float c;
+  float d;
+
+  /** Signed distance of a point to the plane, meters. */
+  float Distance(float x, float y, float z) const {
+    return a * x + b * y + c * z + d;
+  }
+};
+
+/**
+ * @ingroup datatypes
+ * Parameters of PlaneFitter.
+ */
+struct MYNTEYE_API PlaneFitParams {
+  /** Fit on every step pixels in rows and columns */
+  int step = 4;
+  /** Points within this distance of the plane are inliers, meters */
+  float threshold = 0.02f;
+  /** Random hypotheses per frame */
+  int iterations = 128;
+  /** Hypotheses are scored on at most this many of the points */
+  int score_points = 4096;
+  /** Depth beyond is not fit, meters */
+  float max_depth = 5.f;
+  /** A plane must hold this ratio of the points */
+  float min_ratio = 0.1f;
+  /**
+   * Only planes whose normal is within max_angle of axis, e.g. the floor
+   * with axis up in the camera, (0, -1, 0) if it looks level. The dominant
+   * plane if false.
+   */
+  bool use_axis = false;
+  float axis[3] = {0, -1, 0};
+  /** Degrees */
+  float max_angle = 15.f;
+  /** Start from the plane of the previous frame */
+  bool warm_start = true;
+};
+
+/**
+ * Fit the dominant plane, or the ground, of raw depth frames with RANSAC.
+ *
+ * The depth is subsampled to points in arrays of x, y and z. Hypotheses of
+ * three random points are scored on up to score_points of them, counting
+ * the points within threshold in a branch free loop. The best one is
+ * refined to the least squares plane of its inliers among them, the normal
+ * being the smallest eigenvector of their covariance by Jacobi rotations.
+ *
+ * With warm_start the plane of the previous frame is the first hypothesis,
+ * and if it still holds most of its inliers only a quarter of the random
+ * hypotheses are tried. The inlier mask is then computed at full
+ * resolution, rows on all cores.
+ *
+ * An instance fits one stream of frames at a time.
+ */
+class MYNTEYE_API PlaneFitter {
+ public:
+  template <typename T>
+  using buffer_t = std::vector<T, AlignedAllocator<T>>;
+
+  /**
+   * @param in the intrinsics of the depth image.
+   * @param depth_unit meters per raw depth value, default millimeters.
+   */
+  explicit PlaneFitter(const CameraIntrinsics& in,
+      const PlaneFitParams& params = PlaneFitParams(),
+      float depth_unit = 0.001f);
+  ~PlaneFitter();
+
+  const PlaneFitParams& GetParams() const {
+    return params_;
+  }
+
+  /**
+   * Fit raw depth of the intrinsics size.
+   * @param step bytes per depth row.
+   * @param mask output of width * height, 255 for inliers, may be nullptr.
+   * @return false if no plane is found, the mask is then all 0.
+   */
+  bool Fit(const std::uint16_t* depth, std::size_t step, Plane* plane,
+      std::uint8_t* mask = nullptr);
+
+  /** Fit a DEPTH_RAW image, mask is resized to it if not nullptr. */
+  bool Fit(const Image::pointer& depth, Plane* plane,
+      buffer_t<std::uint8_t>* mask = nullptr);
+
+  /** Inliers of the last plane among the subsampled points. */
+  std::size_t inliers() const {
+    return inliers_;
+  }
+
+  /** Forget the previous plane. */
+  void Reset();
+
+ private:
+  void Sample(const std::uint16_t* depth, std::size_t step);
+  std::size_t Score(const Plane& plane, std::size_t n) const;
+  bool Accept(const Plane& plane) const;
+  bool Refine(Plane* plane, std::size_t n) const;
+  void Mask(const std::uint16_t* depth, std::size_t step, const Plane& plane,
+      std::uint8_t* mask) const;
+
+  CameraIntrinsics in_;
+  PlaneFitParams params_;
+  float depth_unit_;
+
+  /** (u - cx) / fx of each column and (v - cy) / fy of each row */
+  buffer_t<float> rays_x_;
+  buffer_t<float> rays_y_;
+
+  /** Subsampled points */
+  buffer_t<float> xs_;
+  buffer_t<float> ys_;
+  buffer_t<float> zs_;
+
+  bool has_previous_;
+  Plane previous_;
+  /** Inlier ratio of the previous plane */
+  float previous_ratio_;
+  std::size_t inliers_;
+  std::uint32_t seed_;
+
+  MYNTEYE_DISABLE_COPY(PlaneFitter)
+  MYNTEYE_DISABLE_MOVE(PlaneFitter)
+};
+
+MYNTEYE_END_NAMESPACE
+
+#endif  // MYNTEYE_PLANE_FIT_H_
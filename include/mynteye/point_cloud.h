@@ -0,0 +1,148 @@
+// Copyright 2018 Slightech Co., Ltd. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#ifndef MYNTEYE_POINT_CLOUD_H_
+#define MYNTEYE_POINT_CLOUD_H_
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "mynteye/stubs/global.h"
+#include "mynteye/image.h"
+#include "mynteye/types.h"
+#include "mynteye/util/aligned_allocator.h"
+
+MYNTEYE_BEGIN_NAMESPACE
+
+/**
+ * @ingroup datatypes
+ * Point in meters.
+ */
+struct MYNTEYE_API PointXYZ {
+  float x;
+  float y;
+  float z;
+};
+
+/**
+ * @ingroup datatypes
+ * Point in meters with color, 16 bytes. The layout is the same as the fields
+ * "x y z rgb" of sensor_msgs/PointCloud2 with point_step 16.
+ */
+struct MYNTEYE_API PointXYZRGB {
+  float x;
+  float y;
+  float z;
+  std::uint8_t b;
+  std::uint8_t g;
+  std::uint8_t r;
+  std::uint8_t a;
+};
+
+/**
+ * @ingroup enumerations
+ * @brief Point cloud layouts.
+ */
+enum class PointCloudLayout : std::int32_t {
+  /** One point per depth pixel, no depth points are NaN */
+  ORGANIZED,
+  /** Only the points having depth, in row-major order */
+  COMPACT,
+};
+
+/**
+ * Generate point clouds from raw depth images.
+ *
+ * The rays of every column and row are computed once from the intrinsics, so
+ * a point costs two multiplies. Rows are split into bands and generated on
+ * all cores. An instance is immutable after construction and can be shared.
+ */
+class MYNTEYE_API PointCloud {
+ public:
+  template <typename T>
+  using buffer_t = std::vector<T, AlignedAllocator<T>>;
+
+  /**
+   * @param in the intrinsics of the depth image.
+   * @param depth_unit meters per raw depth value, default millimeters.
+   */
+  explicit PointCloud(const CameraIntrinsics& in, float depth_unit = 0.001f);
+  ~PointCloud();
+
+  const CameraIntrinsics& GetIntrinsics() const {
+    return in_;
+  }
+
+  float depth_unit() const {
+    return depth_unit_;
+  }
+
+  /**
+   * Generate points from raw depth.
+   * @param depth DEPTH_RAW data of the intrinsics size.
+   * @param depth_step bytes per depth row.
+   * @param points output of width * height points.
+   * @return the number of points having depth.
+   */
+  std::size_t Generate(const std::uint16_t* depth, std::size_t depth_step,
+      PointXYZ* points,
+      PointCloudLayout layout = PointCloudLayout::ORGANIZED) const;
+
+  /**
+   * Generate colored points from raw depth and a color image aligned to it.
+   * @param color COLOR_BGR or COLOR_RGB data of the intrinsics size.
+   * @param color_step bytes per color row.
+   * @param color_format COLOR_BGR or COLOR_RGB.
+   */
+  std::size_t Generate(const std::uint16_t* depth, std::size_t depth_step,
+      const std::uint8_t* color, std::size_t color_step,
+      ImageFormat color_format, PointXYZRGB* points,
+      PointCloudLayout layout = PointCloudLayout::ORGANIZED) const;
+
+  /**
+   * Generate points from a DEPTH_RAW image. points is resized to the result
+   * and keeps its capacity across calls.
+   */
+  std::size_t Generate(const Image::pointer& depth,
+      buffer_t<PointXYZ>* points,
+      PointCloudLayout layout = PointCloudLayout::ORGANIZED) const;
+
+  /**
+   * Generate colored points from a DEPTH_RAW image and a color image of the
+   * same size, the color is converted to COLOR_BGR if not BGR or RGB.
+   */
+  std::size_t Generate(const Image::pointer& depth,
+      const Image::pointer& color, buffer_t<PointXYZRGB>* points,
+      PointCloudLayout layout = PointCloudLayout::ORGANIZED) const;
+
+ private:
+  template <typename Point, typename Writer>
+  std::size_t Fill(const std::uint16_t* depth, std::size_t depth_step,
+      Point* points, PointCloudLayout layout, const Writer& writer) const;
+
+  CameraIntrinsics in_;
+  float depth_unit_;
+
+  /** (u - cx) / fx of each column */
+  buffer_t<float> rays_x_;
+  /** (v - cy) / fy of each row */
+  buffer_t<float> rays_y_;
+
+  MYNTEYE_DISABLE_COPY(PointCloud)
+  MYNTEYE_DISABLE_MOVE(PointCloud)
+};
+
+MYNTEYE_END_NAMESPACE
+
+#endif  // MYNTEYE_POINT_CLOUD_H_
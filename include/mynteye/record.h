@@ -0,0 +1,302 @@
+// Copyright 2018 Slightech Co., Ltd. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#ifndef MYNTEYE_RECORD_H_
+#define MYNTEYE_RECORD_H_
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "mynteye/image.h"
+#include "mynteye/types.h"
+#include "mynteye/stubs/global.h"
+
+MYNTEYE_BEGIN_NAMESPACE
+
+/**
+ * A record file is an append-only log of the raw device data, little endian:
+ *
+ *   RecordFileHeader, records..., RecordTrailer
+ *
+ * Each record is a RecordHeader and its payload, padded to 8 bytes. Every
+ * index_interval records an INDEX record lists the records since the last
+ * one, and links back to it. The trailer, the last bytes of the file, points
+ * to the last index, so a reader walks the indexes without a scan.
+ */
+
+/**
+ * @ingroup datatypes
+ * Record types.
+ */
+enum class RecordType : std::uint16_t {
+  /** RecordDevice, the stream parameters */
+  DEVICE = 1,
+  /** The color image as captured, YUYV or MJPG of its valid size */
+  COLOR = 2,
+  /** The depth image as captured */
+  DEPTH = 3,
+  /** RecordImgInfo, the info of a frame */
+  IMG_INFO = 4,
+  /** RecordImuSegment of a packet */
+  IMU = 5,
+  /** RecordIndexHeader and its RecordIndexEntry */
+  INDEX = 6,
+  /** Zeros, to pad the file end to the block size */
+  PAD = 7,
+  /** CameraCtrlRectLogData, of the log index in frame_id */
+  CALIBRATION = 8,
+  /** RecordMotion, the imu params */
+  MOTION = 9,
+};
+
+#pragma pack(push, 1)
+
+/**
+ * @ingroup datatypes
+ * Head of a record file.
+ */
+struct MYNTEYE_API RecordFileHeader {
+  /** "MYNTRCRD" */
+  char magic[8];
+  std::uint32_t version;
+  std::uint32_t header_size;
+  /** System time of the recording, in microseconds */
+  std::uint64_t created;
+  std::uint8_t reserved[40];
+};
+
+/**
+ * @ingroup datatypes
+ * Head of a record, 8 bytes aligned in the file.
+ */
+struct MYNTEYE_API RecordHeader {
+  /** kRecordSync */
+  std::uint32_t sync;
+  /** RecordType */
+  std::uint16_t type;
+  /** ImageFormat of images, else 0 */
+  std::uint16_t format;
+  /** Payload bytes, without the padding */
+  std::uint32_t size;
+  std::uint16_t width;
+  std::uint16_t height;
+  /** Frame id of images and infos, log index of calibrations, else 0 */
+  std::uint32_t frame_id;
+  std::uint32_t reserved;
+  /** Device timestamp of infos and imu, in 0.01 ms, else 0 */
+  std::uint64_t timestamp;
+  /** Steady time on the host when recorded, in nanoseconds */
+  std::uint64_t host_time;
+};
+
+/**
+ * @ingroup datatypes
+ * Payload of DEVICE, the values of InitParams.
+ */
+struct MYNTEYE_API RecordDevice {
+  std::int32_t framerate;
+  std::int32_t stream_mode;
+  std::int32_t depth_mode;
+  std::int32_t color_format;
+  std::int32_t depth_format;
+  std::int32_t ir_intensity;
+  std::uint8_t reserved[40];
+};
+
+/**
+ * @ingroup datatypes
+ * Payload of IMG_INFO.
+ */
+struct MYNTEYE_API RecordImgInfo {
+  std::uint16_t frame_id;
+  std::uint16_t exposure_time;
+  std::uint32_t timestamp;
+};
+
+/**
+ * @ingroup datatypes
+ * Element of the IMU payload, a segment of the device packet.
+ */
+struct MYNTEYE_API RecordImuSegment {
+  /** 1 accelerometer, 2 gyroscope */
+  std::uint8_t flag;
+  std::uint8_t reserved0;
+  std::int16_t temperature;
+  std::uint32_t timestamp;
+  std::int16_t accel_or_gyro[3];
+  std::uint16_t reserved1;
+};
+
+/**
+ * @ingroup datatypes
+ * Payload of MOTION, the intrinsics and extrinsics of the imu.
+ */
+struct MYNTEYE_API RecordMotion {
+  ImuIntrinsics accel;
+  ImuIntrinsics gyro;
+  Extrinsics left_to_imu;
+};
+
+/**
+ * @ingroup datatypes
+ * Head of the INDEX payload, count RecordIndexEntry follow.
+ */
+struct MYNTEYE_API RecordIndexHeader {
+  /** File offset of the index before, 0 if first */
+  std::uint64_t previous;
+  std::uint32_t count;
+  std::uint32_t reserved;
+};
+
+/**
+ * @ingroup datatypes
+ * Entry of an index, a copy of the record header fields to seek by.
+ */
+struct MYNTEYE_API RecordIndexEntry {
+  /** File offset of the RecordHeader */
+  std::uint64_t offset;
+  std::uint64_t timestamp;
+  std::uint64_t host_time;
+  std::uint32_t frame_id;
+  std::uint16_t type;
+  std::uint16_t reserved;
+};
+
+/**
+ * @ingroup datatypes
+ * Tail of a record file, its last bytes.
+ */
+struct MYNTEYE_API RecordTrailer {
+  /** "MYNTRIDX" */
+  char magic[8];
+  /** File offset of the last INDEX record */
+  std::uint64_t last_index;
+  /** Records in the file, of all types */
+  std::uint64_t records;
+  std::uint64_t reserved;
+};
+
+#pragma pack(pop)
+
+/** Magic of RecordFileHeader. */
+extern MYNTEYE_API const char kRecordMagic[8];
+/** Magic of RecordTrailer. */
+extern MYNTEYE_API const char kRecordTrailerMagic[8];
+/** Sync word of RecordHeader, "MREC". */
+const std::uint32_t kRecordSync = 0x4345524D;
+/** Version of the record file. */
+const std::uint32_t kRecordVersion = 1;
+
+/**
+ * @ingroup datatypes
+ * Recorder parameters.
+ */
+struct MYNTEYE_API RecorderParams {
+  /** Bytes of each write, rounded up to a multiple of 4096 */
+  std::size_t chunk_size = 4 << 20;
+  /** Bytes waiting to be written at most, records beyond are dropped */
+  std::size_t max_queued = 256 << 20;
+  /** Records between the indexes */
+  std::size_t index_interval = 256;
+  /** Write with O_DIRECT past the page cache, where supported */
+  bool direct_io = false;
+};
+
+/**
+ * Record the raw device data into a record file.
+ *
+ * Records are copied into aligned chunks under a short lock, and full chunks
+ * are written by an I/O thread, so the capture threads never wait on disk.
+ * If the disk falls behind by max_queued bytes, records are dropped whole and
+ * counted, never a part of one.
+ */
+class MYNTEYE_API Recorder {
+ public:
+  explicit Recorder(const RecorderParams& params = RecorderParams());
+  ~Recorder();
+
+  /** Create the file and start the I/O thread. */
+  bool Open(const std::string& path);
+  /** Write the last index and trailer, and wait the file written. */
+  void Close();
+  bool IsOpened() const;
+
+  bool WriteDevice(const RecordDevice& device);
+  /** Write the rectify log of index, 0 HD or 1 VGA. */
+  bool WriteCalibration(std::uint32_t index,
+      const CameraCtrlRectLogData& data);
+  bool WriteMotion(const RecordMotion& motion);
+  /** Write an image of type COLOR or DEPTH, its valid size. */
+  bool WriteImage(const RecordType& type, const Image& image);
+  bool WriteImgInfo(const RecordImgInfo& info);
+  /** Write the segments of an imu packet. */
+  bool WriteImu(const RecordImuSegment* segments, std::size_t count);
+
+  /** Records written, or queued to. */
+  std::uint64_t records() const { return records_; }
+  /** Records dropped, as the disk fell behind. */
+  std::uint64_t dropped() const { return dropped_; }
+  /** Bytes written to the disk. */
+  std::uint64_t bytes() const { return bytes_; }
+
+ private:
+  struct Chunk {
+    std::uint8_t* data;
+    std::size_t size;
+  };
+
+  bool Write(RecordHeader header, const void* payload);
+  /** Copy bytes into chunks, the space is reserved. */
+  void Append(const void* data, std::size_t size);
+  bool Reserve(std::size_t size);
+  void AppendIndex();
+  void Run();
+
+  RecorderParams params_;
+  std::atomic<bool> opened_;
+  int fd_;
+  bool direct_;
+
+  std::mutex mutex_;
+  std::condition_variable condition_;
+  std::thread thread_;
+  bool running_;
+
+  Chunk chunk_;
+  /** File offset of the chunk start */
+  std::uint64_t offset_;
+  std::size_t allocated_;
+  std::vector<std::uint8_t*> free_;
+  std::deque<Chunk> queue_;
+
+  std::vector<RecordIndexEntry> entries_;
+  std::uint64_t last_index_;
+
+  std::atomic<std::uint64_t> records_;
+  std::atomic<std::uint64_t> dropped_;
+  std::atomic<std::uint64_t> bytes_;
+
+  MYNTEYE_DISABLE_COPY(Recorder)
+  MYNTEYE_DISABLE_MOVE(Recorder)
+};
+
+MYNTEYE_END_NAMESPACE
+
+#endif  // MYNTEYE_RECORD_H_
@@ -0,0 +1,151 @@
+// Copyright 2018 Slightech Co., Ltd. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#ifndef MYNTEYE_RECORD_READER_H_
+#define MYNTEYE_RECORD_READER_H_
+#pragma once
+
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "mynteye/image.h"
+#include "mynteye/record.h"
+#include "mynteye/stubs/global.h"
+
+MYNTEYE_BEGIN_NAMESPACE
+
+class MappedFile;
+
+/**
+ * @ingroup datatypes
+ * Replay parameters, of a record file played as a camera.
+ */
+struct MYNTEYE_API ReplayParams {
+  /** The record file */
+  std::string path;
+  /**
+   * Times the recorded rate, 0 as fast as the images are retrieved, none
+   * dropped, so each type enabled must be retrieved
+   */
+  double speed = 1.0;
+  /** Play again from the start at the end */
+  bool loop = false;
+};
+
+/**
+ * Read a record file of Recorder, mapped into memory.
+ *
+ * Open loads the indexes by the trailer, or scans the records if the file
+ * was not closed, or its indexes point to records not whole in the
+ * file. Records are numbered in file order, without the indexes
+ * and pads. Images are views into the mapping, not copied, and keep it
+ * mapped while held.
+ *
+ * The device timestamps are unwrapped to 64 bits per type. Images take the
+ * timestamp of the image info of their frame id, recorded nearest to them,
+ * or 0 if there is none.
+ */
+class MYNTEYE_API RecordReader {
+ public:
+  RecordReader();
+  ~RecordReader();
+
+  bool Open(const std::string& path);
+  void Close();
+  bool IsOpened() const;
+
+  /** Get the stream parameters, false if not recorded. */
+  bool GetDevice(RecordDevice* device) const;
+  /** Get the rectify log of index, false if not recorded. */
+  bool GetCalibration(std::uint32_t index, CameraCtrlRectLogData* data) const;
+  /** Get the imu params, false if not recorded. */
+  bool GetMotion(RecordMotion* motion) const;
+
+  /** The number of records. */
+  std::size_t size() const {
+    return entries_.size();
+  }
+
+  /** The entry of record i, its timestamp unwrapped or resolved. */
+  const RecordIndexEntry& entry(std::size_t i) const {
+    return entries_[i];
+  }
+
+  RecordType type(std::size_t i) const {
+    return static_cast<RecordType>(entries_[i].type);
+  }
+
+  const RecordHeader& header(std::size_t i) const;
+  const std::uint8_t* payload(std::size_t i) const;
+
+  /** Get the image of a COLOR or DEPTH record, a view into the mapping. */
+  Image::pointer GetImage(std::size_t i) const;
+  bool GetImgInfo(std::size_t i, RecordImgInfo* info) const;
+  /** Get the segments of an IMU record, nullptr if not. */
+  const RecordImuSegment* GetImu(std::size_t i, std::size_t* count) const;
+
+  /**
+   * Seek the first record of type not before timestamp, in O(log n).
+   * @return its number, or size() if none.
+   */
+  std::size_t SeekTimestamp(const RecordType& type,
+      std::uint64_t timestamp) const;
+  /**
+   * Seek the first record of type with frame_id from record from, as frame
+   * ids wrap around, in O(log n).
+   * @return its number, or size() if none.
+   */
+  std::size_t SeekFrameId(const RecordType& type, std::uint32_t frame_id,
+      std::size_t from = 0) const;
+  /** The next record of type after record i, or size() if none. */
+  std::size_t Next(const RecordType& type, std::size_t i) const;
+
+  /** Hint records [i, i + count) are read soon, to read them ahead. */
+  void Prefetch(std::size_t i, std::size_t count) const;
+
+ private:
+  struct Key {
+    std::uint64_t key;
+    std::size_t index;
+  };
+
+  struct Stream {
+    /** Numbers of the records, in file order */
+    std::vector<std::size_t> records;
+    /** By timestamp, of the records that have one */
+    std::vector<Key> times;
+    /** By frame id, then number */
+    std::vector<Key> frames;
+  };
+
+  bool LoadIndexes();
+  /** Whether the record of entry is whole in the file, of its type. */
+  bool IsRecordInFile(const RecordIndexEntry& entry) const;
+  bool ScanRecords();
+  void BuildStreams();
+  const Stream* GetStream(const RecordType& type) const;
+
+  std::shared_ptr<MappedFile> file_;
+  std::vector<RecordIndexEntry> entries_;
+  std::map<RecordType, Stream> streams_;
+
+  MYNTEYE_DISABLE_COPY(RecordReader)
+  MYNTEYE_DISABLE_MOVE(RecordReader)
+};
+
+MYNTEYE_END_NAMESPACE
+
+#endif  // MYNTEYE_RECORD_READER_H_
@@ -0,0 +1,116 @@
+// Copyright 2018 Slightech Co., Ltd. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#ifndef MYNTEYE_RECTIFIER_H_
+#define MYNTEYE_RECTIFIER_H_
+#pragma once
+
+#include <cstdint>
+#include <memory>
+
+#include "mynteye/stubs/global.h"
+#include "mynteye/image.h"
+#include "mynteye/stereo_calibration.h"
+#include "mynteye/types.h"
+
+MYNTEYE_BEGIN_NAMESPACE
+
+/**
+ * Rectify raw left and right images on the host.
+ *
+ * The undistort and rectify maps of both eyes are built once from the
+ * calibration, the same maps as cv::initUndistortRectifyMap, and stored in
+ * fixed point: the integer source pixel, and a 5+5 bits subpixel index into
+ * a table of bilinear weights. Remapping is then integer only, and split
+ * into row bands on all cores. An instance is immutable after construction.
+ */
+class MYNTEYE_API Rectifier {
+ public:
+  /** Subpixel bits of each axis. */
+  static constexpr int kSubpixelBits = 5;
+  /** Subpixel steps of each axis. */
+  static constexpr int kSubpixelSize = 1 << kSubpixelBits;
+  /** Bits of a bilinear weight, the four weights sum to 1 << kWeightBits. */
+  static constexpr int kWeightBits = 14;
+  /** Source x of destination pixels that map outside the source. */
+  static constexpr std::int16_t kOutside = -32768;
+
+  /**
+   * Fixed point map of one eye, width * height entries in row-major order.
+   */
+  struct MYNTEYE_API Map {
+    /** Integer source x, y of each pixel, x is kOutside if none */
+    const std::int16_t* xy = nullptr;
+    /** Subpixel index of each pixel, y << kSubpixelBits | x */
+    const std::uint16_t* frac = nullptr;
+    /** Keeps xy and frac alive, own buffers or a mapped file */
+    std::shared_ptr<const void> storage;
+  };
+
+  /** Build the maps of both eyes at the calibration size. */
+  explicit Rectifier(const StereoCalibration& calib);
+  /** Use maps built before of the calibration size, e.g. from a cache. */
+  Rectifier(const StereoCalibration& calib, Map left, Map right);
+  ~Rectifier();
+
+  /** Whether the maps are built. */
+  bool IsValid() const {
+    return valid_;
+  }
+
+  int width() const {
+    return calib_.width();
+  }
+
+  int height() const {
+    return calib_.height();
+  }
+
+  const StereoCalibration& GetCalibration() const {
+    return calib_;
+  }
+
+  /** Map of IMAGE_LEFT_COLOR or IMAGE_RIGHT_COLOR. */
+  const Map& GetMap(const ImageType& eye) const;
+
+  /**
+   * Rectify a single eye image of the calibration size.
+   * @param eye IMAGE_LEFT_COLOR or IMAGE_RIGHT_COLOR.
+   * @param image COLOR_BGR or COLOR_RGB, others are converted to COLOR_RGB.
+   * @return the rectified image of the same format, nullptr if failed.
+   */
+  Image::pointer Rectify(const ImageType& eye,
+      const Image::pointer& image) const;
+
+  /**
+   * Rectify raw pixels of the calibration size.
+   * @param channels interleaved 8-bit channels, 1 to 4.
+   * @return false if eye or channels is unsupported.
+   */
+  bool Remap(const ImageType& eye, const std::uint8_t* src,
+      std::size_t src_step, std::uint8_t* dst, std::size_t dst_step,
+      int channels) const;
+
+ private:
+  StereoCalibration calib_;
+  bool valid_;
+  Map left_;
+  Map right_;
+
+  MYNTEYE_DISABLE_COPY(Rectifier)
+  MYNTEYE_DISABLE_MOVE(Rectifier)
+};
+
+MYNTEYE_END_NAMESPACE
+
+#endif  // MYNTEYE_RECTIFIER_H_
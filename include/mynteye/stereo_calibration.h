@@ -0,0 +1,145 @@
+// Copyright 2018 Slightech Co., Ltd. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#ifndef MYNTEYE_STEREO_CALIBRATION_H_
+#define MYNTEYE_STEREO_CALIBRATION_H_
+#pragma once
+
+#include <ostream>
+
+#include "mynteye/stubs/global.h"
+#include "mynteye/types.h"
+
+MYNTEYE_BEGIN_NAMESPACE
+
+/**
+ * @ingroup calibration
+ * Stereo calibration of the opened stream mode.
+ *
+ * Built once from the device rectification log data (HD or VGA) and scaled
+ * to the single eye size of the stream mode. Depth is aligned to the left
+ * rectified eye, so GetIntrinsics() is what 3D consumers need.
+ */
+class MYNTEYE_API StereoCalibration {
+ public:
+  /** An invalid calibration. */
+  StereoCalibration();
+  /**
+   * @param data the rectification log data of the stream resolution.
+   * @param width the single eye image width of the stream mode.
+   * @param height the single eye image height of the stream mode.
+   */
+  StereoCalibration(const CameraCtrlRectLogData& data, int width, int height);
+
+  /** Whether built from valid log data. */
+  bool IsValid() const {
+    return valid_;
+  }
+
+  /** Single eye image width. */
+  int width() const {
+    return left_.width;
+  }
+  /** Single eye image height. */
+  int height() const {
+    return left_.height;
+  }
+
+  /** Rectified left intrinsics, depth is aligned to it. */
+  const CameraIntrinsics& GetIntrinsics() const {
+    return left_;
+  }
+  /** Rectified right intrinsics. */
+  const CameraIntrinsics& GetRightIntrinsics() const {
+    return right_;
+  }
+
+  double fx() const { return left_.fx; }
+  double fy() const { return left_.fy; }
+  double cx() const { return left_.cx; }
+  double cy() const { return left_.cy; }
+
+  /** Distance between the two eyes, in the calibration unit (mm). */
+  double baseline() const {
+    return baseline_;
+  }
+
+  /**
+   * Element of the 4x4 reprojection matrix Q scaled to the stream mode,
+   * [x y z w]^T = Q * [u v disparity 1]^T.
+   */
+  double Q(int row, int col) const {
+    return q_[row][col];
+  }
+
+  /**
+   * Reproject pixel (u, v) with disparity to the left rectified camera.
+   * @return false if the disparity gives no point.
+   */
+  bool Reproject(double u, double v, double disparity,
+      double* x, double* y, double* z) const;
+
+  /** Unproject pixel (u, v) at depth to the left rectified camera. */
+  void Unproject(double u, double v, double depth,
+      double* x, double* y, double* z) const {
+    *x = (u - left_.cx) * depth / left_.fx;
+    *y = (v - left_.cy) * depth / left_.fy;
+    *z = depth;
+  }
+
+  /**
+   * Project a point in the left rectified camera to pixel (u, v).
+   * @return false if the point is behind the camera.
+   */
+  bool Project(double x, double y, double z, double* u, double* v) const {
+    if (z <= 0) return false;
+    *u = left_.fx * x / z + left_.cx;
+    *v = left_.fy * y / z + left_.cy;
+    return true;
+  }
+
+  /**
+   * Depth of disparity, in the unit of baseline(). Disparity includes the
+   * principal point offset of the two eyes, as in Q.
+   */
+  double DisparityToDepth(double disparity) const {
+    double d = disparity - (left_.cx - right_.cx);
+    return d > 0 ? left_.fx * baseline_ / d : 0;
+  }
+
+  /** Disparity of depth, in the unit of baseline(). */
+  double DepthToDisparity(double depth) const {
+    return depth > 0 ? left_.fx * baseline_ / depth + (left_.cx - right_.cx)
+                     : 0;
+  }
+
+  /** The log data this is built from, not scaled. */
+  const CameraCtrlRectLogData& GetLogData() const {
+    return data_;
+  }
+
+ private:
+  bool valid_;
+  CameraCtrlRectLogData data_;
+  CameraIntrinsics left_;
+  CameraIntrinsics right_;
+  double baseline_;
+  double q_[4][4];
+};
+
+MYNTEYE_API
+std::ostream &operator<<(std::ostream &os, const StereoCalibration &calib);
+
+MYNTEYE_END_NAMESPACE
+
+#endif  // MYNTEYE_STEREO_CALIBRATION_H_
@@ -0,0 +1,136 @@
+// Copyright 2018 Slightech Co., Ltd. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#ifndef MYNTEYE_STEREO_MATCHER_H_
+#define MYNTEYE_STEREO_MATCHER_H_
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "mynteye/stubs/global.h"
+#include "mynteye/image.h"
+#include "mynteye/stereo_calibration.h"
+#include "mynteye/util/aligned_allocator.h"
+
+MYNTEYE_BEGIN_NAMESPACE
+
+/**
+ * @ingroup datatypes
+ * Parameters of StereoMatcher.
+ */
+struct MYNTEYE_API StereoMatcherParams {
+  /** Disparities searched are [0, max_disparity), rounded up to 16 */
+  int max_disparity = 64;
+  /** Penalty of a disparity change of 1 along a path */
+  int p1 = 10;
+  /** Penalty of a larger disparity change along a path */
+  int p2 = 120;
+  /** The best cost must be this percent below the second, 0 to disable */
+  int uniqueness = 10;
+  /** Drop disparities the right to left match disagrees with */
+  bool lr_check = true;
+  /** Refine disparities with a parabola through the costs around */
+  bool subpixel = true;
+};
+
+/**
+ * Semi-global matching of a rectified gray image pair on the host.
+ *
+ * Costs are the hamming distances of 9x7 census transforms. They are
+ * aggregated along 4 paths, top to bottom, bottom to top, left to right
+ * and right to left; each path step updates all disparities of a pixel in
+ * one loop over plain arrays. Vertical paths run on bands of columns and
+ * horizontal paths and the winner take all on bands of rows, on all cores.
+ *
+ * The aggregated cost takes width * height * max_disparity * 2 bytes, e.g.
+ * 118 MB at 1280x720 with 64 disparities. Buffers are kept across calls.
+ * An instance computes one pair at a time.
+ */
+class MYNTEYE_API StereoMatcher {
+ public:
+  template <typename T>
+  using buffer_t = std::vector<T, AlignedAllocator<T>>;
+
+  /** Disparities are in 1 / kDisparityScale pixels. */
+  static constexpr int kDisparityScale = 16;
+  /** Disparity of pixels without a match. */
+  static constexpr std::uint16_t kInvalidDisparity = 0xFFFF;
+
+  StereoMatcher(int width, int height,
+      const StereoMatcherParams& params = StereoMatcherParams());
+  ~StereoMatcher();
+
+  int width() const {
+    return width_;
+  }
+
+  int height() const {
+    return height_;
+  }
+
+  const StereoMatcherParams& GetParams() const {
+    return params_;
+  }
+
+  /**
+   * Match 8 bit gray images of the size.
+   * @param disparity output of the left image, in 1 / kDisparityScale.
+   */
+  void Compute(const std::uint8_t* left, std::size_t left_step,
+      const std::uint8_t* right, std::size_t right_step,
+      std::uint16_t* disparity, std::size_t disparity_step);
+
+  /**
+   * Match images of the size, converted to gray if color.
+   * @return false if the sizes differ.
+   */
+  bool Compute(const Image::pointer& left, const Image::pointer& right,
+      buffer_t<std::uint16_t>* disparity);
+
+  /**
+   * Depth of disparity of the size, by the calibration, in its baseline
+   * unit, so comparable with the device depth.
+   * @return a DEPTH_RAW image, 0 where no disparity.
+   */
+  Image::pointer ToDepth(const buffer_t<std::uint16_t>& disparity,
+      const StereoCalibration& calib) const;
+
+ private:
+  void Census(const std::uint8_t* src, std::size_t step,
+      std::uint64_t* dst) const;
+  void CostRow(int y, int x0, int x1, std::uint8_t* cost) const;
+  void AggregateVertical();
+  void AggregateRows(std::uint16_t* disparity, std::size_t disparity_step);
+
+  int width_;
+  int height_;
+  int disparities_;
+  StereoMatcherParams params_;
+
+  buffer_t<std::uint64_t> census_left_;
+  /** Each row reversed, so costs of a pixel read it forward */
+  buffer_t<std::uint64_t> census_right_;
+  /** Sum of the paths, disparities_ per pixel */
+  buffer_t<std::uint16_t> sum_;
+  /** Gray copies of Image input */
+  buffer_t<std::uint8_t> gray_left_;
+  buffer_t<std::uint8_t> gray_right_;
+
+  MYNTEYE_DISABLE_COPY(StereoMatcher)
+  MYNTEYE_DISABLE_MOVE(StereoMatcher)
+};
+
+MYNTEYE_END_NAMESPACE
+
+#endif  // MYNTEYE_STEREO_MATCHER_H_
@@ -65,6 +65,20 @@ enum class ImageType : std::int32_t {
   IMAGE_DEPTH,
   /** All. */
   ALL,
+  /** Depth registered to LEFT Color, not enabled by ALL. */
+  IMAGE_DEPTH_REGISTERED,
+  /** Depth min pooled to 1/2 size, not enabled by ALL. */
+  IMAGE_DEPTH_MIN_2,
+  /** Depth min pooled to 1/4 size, not enabled by ALL. */
+  IMAGE_DEPTH_MIN_4,
+  /** Depth min pooled to 1/8 size, not enabled by ALL. */
+  IMAGE_DEPTH_MIN_8,
+  /** Depth median pooled to 1/2 size, not enabled by ALL. */
+  IMAGE_DEPTH_MEDIAN_2,
+  /** Depth median pooled to 1/4 size, not enabled by ALL. */
+  IMAGE_DEPTH_MEDIAN_4,
+  /** Depth median pooled to 1/8 size, not enabled by ALL. */
+  IMAGE_DEPTH_MEDIAN_8,
 };
 
 /**
@@ -306,6 +320,22 @@ struct MYNTEYE_API ImuData {
   }
 };
 
+/**
+ * @ingroup calibration
+ * Pinhole camera intrinsics of an image with the given size.
+ */
+struct MYNTEYE_API CameraIntrinsics {
+  int width;   /**< Image width in pixels */
+  int height;  /**< Image height in pixels */
+  double fx;   /**< Focal length x in pixels */
+  double fy;   /**< Focal length y in pixels */
+  double cx;   /**< Principal point x in pixels */
+  double cy;   /**< Principal point y in pixels */
+};
+
+MYNTEYE_API
+std::ostream &operator<<(std::ostream &os, const CameraIntrinsics &in);
+
 /**
  * @ingroup calibration
  * IMU intrinsics: scale, drift and variances.
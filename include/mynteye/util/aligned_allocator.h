@@ -0,0 +1,135 @@
+// Copyright 2018 Slightech Co., Ltd. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#ifndef MYNTEYE_UTIL_ALIGNED_ALLOCATOR_H_
+#define MYNTEYE_UTIL_ALIGNED_ALLOCATOR_H_
+#pragma once
+
+#include <cstddef>
+#include <cstdlib>
+#include <limits>
+#include <new>
+#include <utility>
+
+#ifdef MYNTEYE_OS_WIN
+#include <malloc.h>
+#endif
+
+#include "mynteye/stubs/global.h"
+
+MYNTEYE_BEGIN_NAMESPACE
+
+/** Alignment of image buffers, one cache line and wide enough for AVX-512. */
+#define MYNTEYE_BUFFER_ALIGNMENT 64
+
+/**
+ * Allocate size bytes aligned to alignment, which must be a power of two and
+ * a multiple of sizeof(void*). Returns nullptr on failure.
+ */
+inline void* aligned_malloc(std::size_t size,
+    std::size_t alignment = MYNTEYE_BUFFER_ALIGNMENT) {
+  if (size == 0) size = alignment;
+#ifdef MYNTEYE_OS_WIN
+  return _aligned_malloc(size, alignment);
+#else
+  void* ptr = nullptr;
+  if (posix_memalign(&ptr, alignment, size) != 0) {
+    return nullptr;
+  }
+  return ptr;
+#endif
+}
+
+/** Free memory returned by aligned_malloc(). */
+inline void aligned_free(void* ptr) {
+#ifdef MYNTEYE_OS_WIN
+  _aligned_free(ptr);
+#else
+  std::free(ptr);
+#endif
+}
+
+/**
+ * Allocator returning aligned storage, whose elements are default-initialized
+ * rather than value-initialized. For trivial types like std::uint8_t this
+ * means std::vector::resize() does not memset the new elements.
+ */
+template <typename T, std::size_t Alignment = MYNTEYE_BUFFER_ALIGNMENT>
+class AlignedAllocator {
+ public:
+  using value_type = T;
+  using pointer = T*;
+  using const_pointer = const T*;
+  using reference = T&;
+  using const_reference = const T&;
+  using size_type = std::size_t;
+  using difference_type = std::ptrdiff_t;
+
+  template <typename U>
+  struct rebind {
+    using other = AlignedAllocator<U, Alignment>;
+  };
+
+  AlignedAllocator() noexcept {}
+  template <typename U>
+  AlignedAllocator(const AlignedAllocator<U, Alignment>&) noexcept {}  // NOLINT
+
+  T* allocate(std::size_t n) {
+    if (n > std::numeric_limits<std::size_t>::max() / sizeof(T)) {
+      throw std::bad_alloc();
+    }
+    void* ptr = aligned_malloc(n * sizeof(T), Alignment);
+    if (!ptr) throw std::bad_alloc();
+    return static_cast<T*>(ptr);
+  }
+
+  void deallocate(T* ptr, std::size_t) noexcept {
+    aligned_free(ptr);
+  }
+
+  /** Default-initialize, leaves trivial types uninitialized. */
+  template <typename U>
+  void construct(U* ptr) {
+    ::new(static_cast<void*>(ptr)) U;
+  }
+
+  template <typename U, typename... Args>
+  void construct(U* ptr, Args&&... args) {
+    ::new(static_cast<void*>(ptr)) U(std::forward<Args>(args)...);
+  }
+
+  template <typename U>
+  void destroy(U* ptr) {
+    ptr->~U();
+  }
+
+  std::size_t max_size() const noexcept {
+    return std::numeric_limits<std::size_t>::max() / sizeof(T);
+  }
+};
+
+template <typename T, typename U, std::size_t Alignment>
+bool operator==(const AlignedAllocator<T, Alignment>&,
+    const AlignedAllocator<U, Alignment>&) noexcept {
+  return true;
+}
+
+template <typename T, typename U, std::size_t Alignment>
+bool operator!=(const AlignedAllocator<T, Alignment>&,
+    const AlignedAllocator<U, Alignment>&) noexcept {
+  return false;
+}
+
+MYNTEYE_END_NAMESPACE
+
+#endif  // MYNTEYE_UTIL_ALIGNED_ALLOCATOR_H_
@@ -0,0 +1,179 @@
+// Copyright 2018 Slightech Co., Ltd. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#ifndef MYNTEYE_VOXEL_GRID_H_
+#define MYNTEYE_VOXEL_GRID_H_
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#include "mynteye/stubs/global.h"
+#include "mynteye/image.h"
+#include "mynteye/point_cloud.h"
+#include "mynteye/types.h"
+
+MYNTEYE_BEGIN_NAMESPACE
+
+/**
+ * @ingroup datatypes
+ * Pose of the depth camera in the world, p_world = rotation * p + translation,
+ * in meters.
+ */
+struct MYNTEYE_API Pose {
+  float rotation[3][3];
+  float translation[3];
+
+  static Pose Identity() {
+    return {{{1, 0, 0}, {0, 1, 0}, {0, 0, 1}}, {0, 0, 0}};
+  }
+};
+
+/**
+ * @ingroup enumerations
+ * @brief State of a voxel.
+ */
+enum class VoxelState : std::int32_t {
+  /** Never observed, or evicted */
+  UNKNOWN,
+  FREE,
+  OCCUPIED,
+};
+
+/**
+ * @ingroup datatypes
+ * Parameters of VoxelGrid.
+ */
+struct MYNTEYE_API VoxelGridParams {
+  /** Side of a voxel, meters */
+  float voxel_size = 0.05f;
+  /** Depth beyond is cast as free space up to max_range, meters */
+  float max_range = 5.f;
+  /** Cast a ray every pixel_step pixels in rows and columns */
+  int pixel_step = 4;
+  /** Log-odds added to the voxel a ray ends in */
+  float log_odds_hit = 0.85f;
+  /** Log-odds added to the voxels a ray passes */
+  float log_odds_miss = -0.4f;
+  /** Clamp of log-odds, so a voxel can change its state again */
+  float log_odds_min = -2.f;
+  float log_odds_max = 3.5f;
+  /** Memory cap, blocks least recently updated are evicted beyond */
+  std::size_t max_blocks = 16384;
+};
+
+/**
+ * Sparse occupancy grid integrated from raw depth frames.
+ *
+ * Voxels are stored in blocks of 8x8x8, created when first touched and
+ * hashed by block coordinates. Each frame is unprojected with PointCloud,
+ * moved into the world with the pose, and every ray is cast through the
+ * grid from the camera center: voxels it passes get a miss, the voxel of
+ * the depth a hit, in log-odds.
+ *
+ * Rows are split into bands on all cores. Blocks are hashed into shards,
+ * each with its own lock, and a band gathers its updates per shard and
+ * applies them in batches. After a frame, blocks beyond max_blocks are
+ * evicted, the least recently updated first.
+ *
+ * Calls are serialized, Integrate() and queries may come from any thread.
+ */
+class MYNTEYE_API VoxelGrid {
+ public:
+  /** Voxels per block side. */
+  static constexpr int kBlockSize = 8;
+
+  /**
+   * @param in the intrinsics of the depth image.
+   * @param depth_unit meters per raw depth value, default millimeters.
+   */
+  explicit VoxelGrid(const CameraIntrinsics& in,
+      const VoxelGridParams& params = VoxelGridParams(),
+      float depth_unit = 0.001f);
+  ~VoxelGrid();
+
+  const VoxelGridParams& GetParams() const {
+    return params_;
+  }
+
+  /**
+   * Integrate raw depth of the intrinsics size taken at pose.
+   * @param step bytes per depth row.
+   */
+  void Integrate(const std::uint16_t* depth, std::size_t step,
+      const Pose& pose);
+
+  /** Integrate a DEPTH_RAW image, false if not of the intrinsics. */
+  bool Integrate(const Image::pointer& depth, const Pose& pose);
+
+  /** Log-odds of the voxel holding the world point, 0 if unknown. */
+  float GetLogOdds(const PointXYZ& point) const;
+
+  /** State of the voxel holding the world point. */
+  VoxelState GetState(const PointXYZ& point) const;
+
+  /** Centers of all occupied voxels, the count of them. */
+  std::size_t GetOccupied(std::vector<PointXYZ>* centers) const;
+
+  /** Blocks in memory. */
+  std::size_t blocks() const;
+
+  /** Frames integrated. */
+  std::uint64_t frames() const;
+
+  /** Drop all blocks. */
+  void Clear();
+
+ private:
+  static constexpr int kShards = 16;
+  static constexpr int kBlockVoxels = kBlockSize * kBlockSize * kBlockSize;
+
+  struct Block {
+    float log_odds[kBlockVoxels];
+    std::uint64_t last_used;
+  };
+
+  struct Shard {
+    std::mutex mtx;
+    std::unordered_map<std::uint64_t, std::unique_ptr<Block>> blocks;
+  };
+
+  struct Update {
+    std::uint64_t key;
+    std::uint16_t voxel;
+    bool hit;
+  };
+
+  void Apply(int shard, const std::vector<Update>& updates);
+  void Evict();
+  const Block* Find(const PointXYZ& point, int* voxel) const;
+
+  CameraIntrinsics in_;
+  VoxelGridParams params_;
+  PointCloud cloud_;
+  PointCloud::buffer_t<PointXYZ> points_;
+
+  mutable std::mutex mtx_;
+  std::uint64_t frame_;
+  Shard shards_[kShards];
+
+  MYNTEYE_DISABLE_COPY(VoxelGrid)
+  MYNTEYE_DISABLE_MOVE(VoxelGrid)
+};
+
+MYNTEYE_END_NAMESPACE
+
+#endif  // MYNTEYE_VOXEL_GRID_H_
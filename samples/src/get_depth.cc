@@ -169,6 +169,8 @@ int main(int argc, char const* argv[]) {
 
   cam.EnableImageType(mynteye::ImageType::IMAGE_LEFT_COLOR);
   cam.EnableImageType(mynteye::ImageType::IMAGE_DEPTH);
+  // stats and invalid mask of each depth, computed as it arrives
+  cam.EnableDepthStats();
 
   cam.Open(params);
 
@@ -225,6 +227,14 @@ int main(int argc, char const* argv[]) {
       cv::setMouseCallback("depth", OnDepthMouseCallback, &depth_region);
       // Note: DrawRect will change some depth values to show the rect.
       depth_region.DrawRect(depth);
+      if (data.depth_stats) {
+        std::ostringstream os;
+        os << "valid: " << util::to_string(data.depth_stats->valid_ratio * 100,
+            5, 1) << "%, min: " << data.depth_stats->min
+            << ", max: " << data.depth_stats->max
+            << ", mean: " << util::to_string(data.depth_stats->mean, 6, 1);
+        util::draw(depth, os.str(), util::TOP_LEFT);
+      }
       cv::imshow("depth", depth);
 
       depth_region.ShowElems<ushort>(depth, [](const ushort& elem) {
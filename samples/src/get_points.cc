@@ -16,9 +16,11 @@
 #include <pcl/visualization/cloud_viewer.h>
 
 #include <iostream>
+#include <memory>
 #include <opencv2/highgui/highgui.hpp>
 
 #include "mynteye/camera.h"
+#include "mynteye/point_cloud.h"
 #include "mynteye/utils.h"
 
 #include "util/cam_utils.h"
@@ -31,40 +33,26 @@ typedef pcl::PointCloud<PointT> PointCloud;
 PointCloud::Ptr cloud ( new PointCloud );
 pcl::visualization::PCLVisualizer viewer("point cloud viewer");
 
-// TODO replace the real camera param
-const float camera_factor = 1000.0;
-
-double camera_cx = 682.3;
-double camera_cy = 254.9;
-double camera_fx = 979.8;
-double camera_fy = 942.8;
+std::unique_ptr<mynteye::PointCloud> points_generator;
+mynteye::PointCloud::buffer_t<mynteye::PointXYZRGB> points;
 
 // show point cloud
-void show_points(cv::Mat rgb, cv::Mat depth) {
-  // loop the mat
-  for (int m = 0; m < depth.rows; m++) {
-    for (int n = 0; n < depth.cols; n++) {
-      // get depth value at (m, n)
-      std::uint16_t d = depth.ptr<std::uint16_t>(m)[n];
-      // when d is equal 0 or 4096 means no depth
-      if (d == 0 || d == 4096)
-        continue;
-
-      PointT p;
-
-      // get point x y z
-      p.z = static_cast<float>(d) / camera_factor;
-      p.x = (n - camera_cx) * p.z / camera_fx;
-      p.y = (m - camera_cy) * p.z / camera_fy;
-
-      // get colors
-      p.b = rgb.ptr<uchar>(m)[n * 3];
-      p.g = rgb.ptr<uchar>(m)[n * 3 + 1];
-      p.r = rgb.ptr<uchar>(m)[n * 3 + 2];
-
-      // add point to cloud
-      cloud->points.push_back(p);
-    }
+void show_points(mynteye::Image::pointer color, mynteye::Image::pointer depth) {
+  // only the points having depth
+  points_generator->Generate(depth, color, &points,
+      mynteye::PointCloudLayout::COMPACT);
+
+  cloud->points.resize(points.size());
+  for (std::size_t i = 0, n = points.size(); i < n; i++) {
+    const auto& pt = points[i];
+    PointT& p = cloud->points[i];
+    p.x = pt.x;
+    p.y = pt.y;
+    p.z = pt.z;
+    p.r = pt.r;
+    p.g = pt.g;
+    p.b = pt.b;
+    p.a = 255;
   }
 
   pcl::visualization::PointCloudColorHandlerRGBField<PointT>color(cloud);
@@ -94,32 +82,6 @@ int main(int argc, char const* argv[]) {
   cam.EnableImageType(mynteye::ImageType::IMAGE_LEFT_COLOR);
   cam.EnableImageType(mynteye::ImageType::IMAGE_DEPTH);
 
-  mynteye::StreamMode streamMode = cam.GetStreamMode();
-
-  if (streamMode == mynteye::StreamMode::STREAM_1280x720
-      || streamMode == mynteye::StreamMode::STREAM_2560x720) {
-    camera_cy = 254.9 * 2;
-  } else if (streamMode == mynteye::StreamMode::STREAM_1280x480
-      || streamMode == mynteye::StreamMode::STREAM_640x480) {
-    camera_cy = 254.9;
-  } else {
-    camera_cy = 0;
-  }
-
-  if (streamMode == mynteye::StreamMode::STREAM_1280x720
-      || streamMode == mynteye::StreamMode::STREAM_1280x480) {
-    camera_cx = 682.3;
-  } else if (streamMode == mynteye::StreamMode::STREAM_2560x720) {
-    camera_cx = 682.3 * 2;
-  } else if (streamMode == mynteye::StreamMode::STREAM_640x480) {
-    camera_cx = 682.3 / 2;
-  } else {
-    camera_cx = 0;
-  }
-
-  camera_fx = 979.8;
-  camera_fy = 942.8;
-
   cam.Open(params);
 
   std::cout << std::endl;
@@ -129,6 +91,15 @@ int main(int argc, char const* argv[]) {
   }
   std::cout << "Open device success" << std::endl << std::endl;
 
+  // depth is aligned to the rectified left eye
+  auto calib = cam.GetStereoCalibration();
+  if (!calib.IsValid()) {
+    std::cerr << "Error: Stereo calibration is invalid" << std::endl;
+    return 1;
+  }
+  std::cout << "Intrinsics: " << calib.GetIntrinsics() << std::endl;
+  points_generator.reset(new mynteye::PointCloud(calib.GetIntrinsics()));
+
   std::cout << "Press ESC/Q on Windows to terminate" << std::endl;
 
   {
@@ -150,13 +121,15 @@ int main(int argc, char const* argv[]) {
     auto image_color = cam.RetrieveImage(mynteye::ImageType::IMAGE_LEFT_COLOR);
     auto image_depth = cam.RetrieveImage(mynteye::ImageType::IMAGE_DEPTH);
     if (image_color.img && image_depth.img) {
-      cv::Mat color = image_color.img->To(mynteye::ImageFormat::COLOR_BGR)->ToMat();
-      cv::Mat depth = image_depth.img->To(mynteye::ImageFormat::DEPTH_RAW)->ToMat();
+      auto color_bgr = image_color.img->To(mynteye::ImageFormat::COLOR_BGR);
+      auto depth_raw = image_depth.img->To(mynteye::ImageFormat::DEPTH_RAW);
+      cv::Mat color = color_bgr->ToMat();
+      cv::Mat depth = depth_raw->ToMat();
       mynteye::util::draw(color, mynteye::util::to_string(counter.fps(), 5, 1),
           mynteye::util::TOP_RIGHT);
       cv::imshow("color", color);
       cv::imshow("depth", depth);
-      show_points(color, depth);
+      show_points(color_bgr, depth_raw);
     }
 
     char key = static_cast<char>(cv::waitKey(1));
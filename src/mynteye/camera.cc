@@ -13,7 +13,11 @@
 // limitations under the License.
 #include "mynteye/camera.h"
 
+#include <algorithm>
+
 #include "mynteye/internal/camera_p.h"
+#include "mynteye/internal/replay_backend.h"
+#include "mynteye/internal/synthetic_backend.h"
 #include "mynteye/util/log.h"
 
 MYNTEYE_USE_NAMESPACE
@@ -22,6 +26,16 @@ Camera::Camera() : p_(new CameraPrivate()) {
   DBG_LOGD(__func__);
 }
 
+Camera::Camera(const ReplayParams& params)
+  : p_(new CameraPrivate(std::make_shared<ReplayBackend>(params))) {
+  DBG_LOGD(__func__);
+}
+
+Camera::Camera(const SyntheticParams& params)
+  : p_(new CameraPrivate(std::make_shared<SyntheticBackend>(params))) {
+  DBG_LOGD(__func__);
+}
+
 Camera::~Camera() {
   DBG_LOGD(__func__);
   p_.release();
@@ -61,10 +75,60 @@ bool Camera::IsOpened() const {
   return p_->IsOpened();
 }
 
+bool Camera::IsEnded() const {
+  return p_->IsEnded();
+}
+
 void Camera::EnableImageType(const ImageType& type) {
   p_->EnableImageType(type);
 }
 
+void Camera::DisableImageType(const ImageType& type) {
+  p_->DisableImageType(type);
+}
+
+void Camera::SetStreamCallback(const ImageType& type,
+    stream_callback_t callback) {
+  if (!callback) {
+    p_->SetStreamCallback(type, nullptr);
+    return;
+  }
+  p_->SetStreamCallback(type, [callback](const device::StreamData& data) {
+    callback({data.img_info, data.img, data.depth_stats});
+  });
+}
+
+void Camera::SetMotionCallback(motion_callback_t callback) {
+  if (!callback) {
+    p_->SetMotionCallback(nullptr);
+    return;
+  }
+  p_->SetMotionCallback([callback](const device::MotionData& data) {
+    callback({data.imu});
+  });
+}
+
+void Camera::SetImuCallback(imu_callback_t callback, std::size_t batch) {
+  if (!callback) {
+    p_->SetMotionCallback(nullptr);
+    return;
+  }
+  // motions are passed on the one thread reading them, so no lock
+  auto sync = std::make_shared<ImuSynchronizer>();
+  auto samples = std::make_shared<std::vector<ImuSample>>();
+  batch = std::max<std::size_t>(1, batch);
+  samples->reserve(batch + 1);
+  p_->SetMotionCallback(
+      [callback, batch, sync, samples](const device::MotionData& data) {
+        if (!data.imu) return;
+        sync->Push(*data.imu, samples.get());
+        if (samples->size() >= batch) {
+          callback(*samples);
+          samples->clear();
+        }
+      });
+}
+
 std::vector<mynteye::StreamData> Camera::RetrieveImages(const ImageType& type) {
   ErrorCode code = ErrorCode::SUCCESS;
   return RetrieveImages(type, &code);
@@ -74,7 +138,7 @@ std::vector<mynteye::StreamData> Camera::RetrieveImages(
     const ImageType& type, ErrorCode* code) {
   std::vector<mynteye::StreamData> datas;
   for (auto &&data : p_->RetrieveImage(type, code)) {
-    mynteye::StreamData tmp = {data.img_info, data.img};
+    mynteye::StreamData tmp = {data.img_info, data.img, data.depth_stats};
     datas.push_back(tmp);
   }
   return datas;
@@ -88,7 +152,7 @@ mynteye::StreamData Camera::RetrieveImage(const ImageType& type) {
 mynteye::StreamData Camera::RetrieveImage(const ImageType& type,
     ErrorCode* code) {
   auto data = p_->RetrieveLatestImage(type, code);
-  return {data.img_info, data.img};
+  return {data.img_info, data.img, data.depth_stats};
 }
 
 std::vector<mynteye::MotionData> Camera::RetrieveMotions() {
@@ -122,10 +186,55 @@ struct CameraCtrlRectLogData Camera::GetVGACameraCtrlData() {
   return p_->GetVGACameraCtrlData();
 }
 
+StereoCalibration Camera::GetStereoCalibration() const {
+  return p_->GetStereoCalibration();
+}
+
 void Camera::SetImageMode(const ImageMode& mode) {
   p_->SetImageMode(mode);
 }
 
+void Camera::EnableHostRectification(bool enabled) {
+  p_->EnableHostRectification(enabled);
+}
+
+std::shared_ptr<Rectifier> Camera::GetRectifier() const {
+  return p_->GetRectifier();
+}
+
+void Camera::SetCacheDirectory(const std::string& dir) {
+  p_->SetCacheDirectory(dir);
+}
+
+void Camera::SetDepthFilter(const std::shared_ptr<DepthFilterChain>& filter) {
+  p_->SetDepthFilter(filter);
+}
+
+std::shared_ptr<DepthFilterChain> Camera::GetDepthFilter() const {
+  return p_->GetDepthFilter();
+}
+
+void Camera::SetLaserScan(
+    const std::shared_ptr<LaserScanProjector>& projector) {
+  p_->SetLaserScan(projector);
+}
+
+std::vector<LaserScan> Camera::RetrieveLaserScans() {
+  return p_->RetrieveLaserScans();
+}
+
+void Camera::EnableDepthStats(bool enabled) {
+  p_->EnableDepthStats(enabled);
+}
+
+void Camera::SetRecorder(const std::shared_ptr<Recorder>& recorder) {
+  p_->SetRecorder(recorder);
+}
+
+bool Camera::IsRecording() const {
+  return p_->IsRecording();
+}
+
 std::string Camera::GetInfo(const Info &info) const {
   return p_->GetInfo(info);
 }
@@ -0,0 +1,325 @@
+// Copyright 2018 Slightech Co., Ltd. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include "mynteye/depth_filter.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+#include "mynteye/util/depth.h"
+#include "mynteye/util/log.h"
+#include "mynteye/util/parallel.h"
+
+MYNTEYE_BEGIN_NAMESPACE
+
+namespace {
+
+const int kMinBandRows = 8;
+const int kMinBandCols = 64;
+
+/** Weight in 8 bits fixed point, at least 1. */
+inline int to_fixed_weight(float alpha) {
+  int a = static_cast<int>(std::lround(alpha * 256));
+  return std::min(256, std::max(1, a));
+}
+
+/** a * x + (1 - a) * y with a in 8 bits fixed point. */
+inline std::uint16_t blend(int a, int x, int y) {
+  return static_cast<std::uint16_t>((a * x + (256 - a) * y + 128) >> 8);
+}
+
+inline std::uint16_t* row_ptr(std::uint16_t* depth, std::size_t step, int v) {
+  return reinterpret_cast<std::uint16_t*>(
+      reinterpret_cast<std::uint8_t*>(depth) + v * step);
+}
+
+}  // namespace
+
+DepthFilter::~DepthFilter() {
+}
+
+// TemporalFilter
+
+TemporalFilter::TemporalFilter(float alpha, std::uint16_t delta,
+    int persistence)
+  : alpha_(to_fixed_weight(alpha)), delta_(delta),
+    persistence_(static_cast<std::uint8_t>(
+        std::min(255, std::max(0, persistence)))),
+    width_(0), height_(0) {
+}
+
+void TemporalFilter::Reset() {
+  width_ = height_ = 0;
+}
+
+void TemporalFilter::Process(std::uint16_t* depth, int width, int height,
+    std::size_t step) {
+  if (width != width_ || height != height_) {
+    width_ = width;
+    height_ = height;
+    // zero average starts every pixel from its first valid value
+    average_.assign(static_cast<std::size_t>(width) * height, 0);
+    age_.assign(static_cast<std::size_t>(width) * height, 0);
+  }
+  const int a = alpha_;
+  const int delta = delta_;
+  const std::uint8_t persistence = persistence_;
+  parallel::for_each(height, [&](int begin, int end) {
+    for (int v = begin; v < end; v++) {
+      std::size_t offset = static_cast<std::size_t>(v) * width;
+      std::uint16_t* d = row_ptr(depth, step, v);
+      std::uint16_t* avg = average_.data() + offset;
+      std::uint8_t* age = age_.data() + offset;
+      for (int u = 0; u < width; u++) {
+        int c = d[u], p = avg[u];
+        bool cv = depth::is_valid(d[u]);
+        bool pv = p != 0;
+        int diff = c > p ? c - p : p - c;
+        std::uint16_t kept = (pv & (age[u] < persistence)) ? p : 0;
+        std::uint16_t out = cv ? ((pv & (diff < delta)) ? blend(a, c, p) :
+            static_cast<std::uint16_t>(c)) : kept;
+        age[u] = cv ? 0 : (kept ? age[u] + 1 : 0);
+        avg[u] = out;
+        d[u] = out;
+      }
+    }
+  }, kMinBandRows);
+}
+
+// SpeckleFilter
+
+SpeckleFilter::SpeckleFilter(int max_size, std::uint16_t max_diff)
+  : max_size_(max_size), max_diff_(max_diff) {
+}
+
+void SpeckleFilter::Process(std::uint16_t* depth, int width, int height,
+    std::size_t step) {
+  // regions cross any row band, so labeling runs on this thread
+  const std::size_t n = static_cast<std::size_t>(width) * height;
+  labels_.assign(n, 0);
+  removed_.assign(1, 0);  // label 0 is none
+  const int max_diff = max_diff_;
+  // rows are addressed by the stride in pixels, step is even
+  const std::size_t stride = step / sizeof(std::uint16_t);
+
+  for (int v = 0; v < height; v++) {
+    std::uint16_t* row = row_ptr(depth, step, v);
+    for (int u = 0; u < width; u++) {
+      if (!depth::is_valid(row[u])) {
+        row[u] = depth::kInvalid;
+        continue;
+      }
+      std::int32_t i = v * width + u;
+      std::int32_t label = labels_[i];
+      if (label == 0) {
+        // first pixel of a new region in raster order, flood it
+        label = static_cast<std::int32_t>(removed_.size());
+        labels_[i] = label;
+        stack_.clear();
+        stack_.push_back(i);
+        int count = 0;
+        while (!stack_.empty()) {
+          std::int32_t p = stack_.back();
+          stack_.pop_back();
+          count++;
+          int pu = p % width, pv = p / width;
+          const std::uint16_t* pp = depth + pv * stride + pu;
+          int pd = *pp;
+          auto visit = [&](std::int32_t q, const std::uint16_t* qp) {
+            if (labels_[q]) return;
+            std::uint16_t qd = *qp;
+            if (depth::is_valid(qd) && std::abs(qd - pd) <= max_diff) {
+              labels_[q] = label;
+              stack_.push_back(q);
+            }
+          };
+          if (pu > 0) visit(p - 1, pp - 1);
+          if (pu < width - 1) visit(p + 1, pp + 1);
+          if (pv > 0) visit(p - width, pp - stride);
+          if (pv < height - 1) visit(p + width, pp + stride);
+        }
+        removed_.push_back(count <= max_size_ ? 1 : 0);
+      }
+      if (removed_[label]) row[u] = depth::kInvalid;
+    }
+  }
+}
+
+// HoleFillFilter
+
+HoleFillFilter::HoleFillFilter(int max_hole) : max_hole_(max_hole) {
+}
+
+void HoleFillFilter::Process(std::uint16_t* depth, int width, int height,
+    std::size_t step) {
+  const int max_hole = max_hole_;
+  parallel::for_each(height, [&](int begin, int end) {
+    for (int v = begin; v < end; v++) {
+      std::uint16_t* row = row_ptr(depth, step, v);
+      int u = 0;
+      while (u < width) {
+        if (depth::is_valid(row[u])) {
+          u++;
+          continue;
+        }
+        int start = u;
+        while (u < width && !depth::is_valid(row[u])) u++;
+        // the farther side is the background the hole belongs to
+        std::uint16_t fill = depth::kInvalid;
+        if (start > 0 && u < width && u - start <= max_hole) {
+          fill = std::max(row[start - 1], row[u]);
+        }
+        std::fill(row + start, row + u, fill);
+      }
+    }
+  }, kMinBandRows);
+}
+
+// SpatialFilter
+
+SpatialFilter::SpatialFilter(float alpha, std::uint16_t delta,
+    int iterations)
+  : alpha_(to_fixed_weight(alpha)), delta_(delta),
+    iterations_(std::max(1, iterations)) {
+}
+
+void SpatialFilter::Process(std::uint16_t* depth, int width, int height,
+    std::size_t step) {
+  const int a = alpha_;
+  const int delta = delta_;
+  // a pixel follows the filtered neighbor before it if both are valid and
+  // close, the neighbor is 0 if invalid
+  auto follow = [a, delta](int c, int p) -> std::uint16_t {
+    int diff = c > p ? c - p : p - c;
+    return (c != 0) & (p != 0) & (diff < delta) ? blend(a, c, p) :
+        static_cast<std::uint16_t>(c);
+  };
+
+  for (int it = 0; it < iterations_; it++) {
+    parallel::for_each(height, [&](int begin, int end) {
+      for (int v = begin; v < end; v++) {
+        std::uint16_t* row = row_ptr(depth, step, v);
+        if (it == 0) {
+          for (int u = 0; u < width; u++) {
+            row[u] = depth::is_valid(row[u]) ? row[u] : depth::kInvalid;
+          }
+        }
+        for (int u = 1; u < width; u++) {
+          row[u] = follow(row[u], row[u - 1]);
+        }
+        for (int u = width - 2; u >= 0; u--) {
+          row[u] = follow(row[u], row[u + 1]);
+        }
+      }
+    }, kMinBandRows);
+
+    // columns run across the band of each thread, a row at a time
+    parallel::for_each(width, [&](int begin, int end) {
+      for (int v = 1; v < height; v++) {
+        const std::uint16_t* prev = row_ptr(depth, step, v - 1);
+        std::uint16_t* row = row_ptr(depth, step, v);
+        for (int u = begin; u < end; u++) {
+          row[u] = follow(row[u], prev[u]);
+        }
+      }
+      for (int v = height - 2; v >= 0; v--) {
+        const std::uint16_t* next = row_ptr(depth, step, v + 1);
+        std::uint16_t* row = row_ptr(depth, step, v);
+        for (int u = begin; u < end; u++) {
+          row[u] = follow(row[u], next[u]);
+        }
+      }
+    }, kMinBandCols);
+  }
+}
+
+// DepthFilterChain
+
+DepthFilterChain::DepthFilterChain() {
+}
+
+DepthFilterChain::~DepthFilterChain() {
+}
+
+std::shared_ptr<DepthFilterChain> DepthFilterChain::CreateDefault() {
+  auto chain = std::make_shared<DepthFilterChain>();
+  chain->Add(std::make_shared<SpeckleFilter>());
+  chain->Add(std::make_shared<SpatialFilter>());
+  chain->Add(std::make_shared<TemporalFilter>());
+  chain->Add(std::make_shared<HoleFillFilter>());
+  return chain;
+}
+
+void DepthFilterChain::Add(const std::shared_ptr<DepthFilter>& filter) {
+  if (!filter) return;
+  std::lock_guard<std::mutex> _(mtx_);
+  Stage stage;
+  stage.filter = filter;
+  stage.timing = {filter->name(), 0, 0, 0};
+  stages_.push_back(stage);
+}
+
+void DepthFilterChain::Clear() {
+  std::lock_guard<std::mutex> _(mtx_);
+  stages_.clear();
+}
+
+std::size_t DepthFilterChain::size() const {
+  std::lock_guard<std::mutex> _(mtx_);
+  return stages_.size();
+}
+
+bool DepthFilterChain::Process(const Image::pointer& depth) {
+  if (!depth || depth->format() != ImageFormat::DEPTH_RAW) {
+    LOGE("Error: DepthFilterChain:: image must be DEPTH_RAW");
+    return false;
+  }
+  Process(reinterpret_cast<std::uint16_t*>(depth->data()), depth->width(),
+      depth->height(), depth->width() * sizeof(std::uint16_t));
+  return true;
+}
+
+void DepthFilterChain::Process(std::uint16_t* depth, int width, int height,
+    std::size_t step) {
+  if (!depth || width <= 0 || height <= 0) return;
+  std::lock_guard<std::mutex> _(mtx_);
+  for (auto&& stage : stages_) {
+    auto t0 = std::chrono::steady_clock::now();
+    stage.filter->Process(depth, width, height, step);
+    auto t1 = std::chrono::steady_clock::now();
+    DepthFilterTiming& timing = stage.timing;
+    timing.last_ms =
+        std::chrono::duration<double, std::milli>(t1 - t0).count();
+    timing.frames++;
+    timing.average_ms += (timing.last_ms - timing.average_ms) / timing.frames;
+  }
+}
+
+void DepthFilterChain::Reset() {
+  std::lock_guard<std::mutex> _(mtx_);
+  for (auto&& stage : stages_) {
+    stage.filter->Reset();
+  }
+}
+
+std::vector<DepthFilterTiming> DepthFilterChain::GetTimings() const {
+  std::lock_guard<std::mutex> _(mtx_);
+  std::vector<DepthFilterTiming> timings;
+  for (auto&& stage : stages_) {
+    timings.push_back(stage.timing);
+  }
+  return timings;
+}
+
+MYNTEYE_END_NAMESPACE
@@ -0,0 +1,150 @@
+// Copyright 2018 Slightech Co., Ltd. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include "mynteye/depth_pyramid.h"
+
+#include <algorithm>
+
+#include "mynteye/util/depth.h"
+#include "mynteye/util/log.h"
+#include "mynteye/util/parallel.h"
+
+MYNTEYE_BEGIN_NAMESPACE
+
+constexpr int DepthPyramid::kMaxLevels;
+
+namespace {
+
+const int kMinBandRows = 8;
+/** Invalid depth while pooling, above any valid one. */
+const std::uint16_t kNone = 0xFFFF;
+
+inline std::uint16_t to_key(std::uint16_t d) {
+  return depth::is_valid(d) ? d : kNone;
+}
+
+inline std::uint16_t from_key(std::uint16_t k) {
+  return k == kNone ? depth::kInvalid : k;
+}
+
+struct MinPool {
+  std::uint16_t operator()(std::uint16_t a, std::uint16_t b, std::uint16_t c,
+      std::uint16_t d) const {
+    return std::min(std::min(a, b), std::min(c, d));
+  }
+};
+
+struct MedianPool {
+  std::uint16_t operator()(std::uint16_t a, std::uint16_t b, std::uint16_t c,
+      std::uint16_t d) const {
+    // sorting network, invalid keys sort last
+    std::uint16_t lo1 = std::min(a, b), hi1 = std::max(a, b);
+    std::uint16_t lo2 = std::min(c, d), hi2 = std::max(c, d);
+    std::uint16_t s0 = std::min(lo1, lo2);
+    std::uint16_t s1 = std::min(std::max(lo1, lo2), std::min(hi1, hi2));
+    int n = (a != kNone) + (b != kNone) + (c != kNone) + (d != kNone);
+    // the lower median s[(n - 1) / 2]
+    return n >= 3 ? s1 : s0;
+  }
+};
+
+template <typename Op>
+void pool(const std::uint16_t* src, int width, int height, std::size_t step,
+    std::uint16_t* dst, std::size_t dst_step) {
+  const int dw = (width + 1) / 2, dh = (height + 1) / 2;
+  const int pairs = width / 2;
+  const Op op;
+  parallel::for_each(dh, [&](int begin, int end) {
+    for (int y = begin; y < end; y++) {
+      const std::uint16_t* r0 = reinterpret_cast<const std::uint16_t*>(
+          reinterpret_cast<const std::uint8_t*>(src) + 2 * y * step);
+      // the last row of an odd height pairs with itself
+      const std::uint16_t* r1 = 2 * y + 1 < height ?
+          reinterpret_cast<const std::uint16_t*>(
+              reinterpret_cast<const std::uint8_t*>(r0) + step) : r0;
+      std::uint16_t* d = reinterpret_cast<std::uint16_t*>(
+          reinterpret_cast<std::uint8_t*>(dst) + y * dst_step);
+      for (int x = 0; x < pairs; x++) {
+        d[x] = from_key(op(to_key(r0[2 * x]), to_key(r0[2 * x + 1]),
+            to_key(r1[2 * x]), to_key(r1[2 * x + 1])));
+      }
+      if (pairs < dw) {
+        int x = width - 1;
+        d[pairs] = from_key(op(to_key(r0[x]), to_key(r0[x]),
+            to_key(r1[x]), to_key(r1[x])));
+      }
+    }
+  }, kMinBandRows);
+}
+
+/** Type of a level, a pooled depth type up to 8, else IMAGE_DEPTH. */
+ImageType level_type(DepthPooling pooling, int level) {
+  static const ImageType types[2][3] = {
+    {ImageType::IMAGE_DEPTH_MIN_2, ImageType::IMAGE_DEPTH_MIN_4,
+        ImageType::IMAGE_DEPTH_MIN_8},
+    {ImageType::IMAGE_DEPTH_MEDIAN_2, ImageType::IMAGE_DEPTH_MEDIAN_4,
+        ImageType::IMAGE_DEPTH_MEDIAN_8}};
+  if (level < 1 || level > 3) return ImageType::IMAGE_DEPTH;
+  return types[pooling == DepthPooling::MIN ? 0 : 1][level - 1];
+}
+
+}  // namespace
+
+DepthPyramid::DepthPyramid(DepthPooling pooling, int levels)
+  : pooling_(pooling),
+    levels_(std::min(kMaxLevels, std::max(1, levels))) {
+}
+
+DepthPyramid::~DepthPyramid() {
+}
+
+void DepthPyramid::Pool(DepthPooling pooling, const std::uint16_t* src,
+    int width, int height, std::size_t step, std::uint16_t* dst,
+    std::size_t dst_step) {
+  if (pooling == DepthPooling::MEDIAN) {
+    pool<MedianPool>(src, width, height, step, dst, dst_step);
+  } else {
+    pool<MinPool>(src, width, height, step, dst, dst_step);
+  }
+}
+
+bool DepthPyramid::Build(const Image::pointer& depth) {
+  if (!depth || depth->format() != ImageFormat::DEPTH_RAW) {
+    LOGE("Error: DepthPyramid:: depth must be DEPTH_RAW");
+    return false;
+  }
+  Image::pointer src = depth;
+  for (std::size_t i = 0; i < levels_.size(); i++) {
+    auto&& level = levels_[i];
+    int width = (src->width() + 1) / 2, height = (src->height() + 1) / 2;
+    if (!level || level.use_count() > 1 || level->width() != width ||
+        level->height() != height) {
+      level = ImageDepth::Create(ImageFormat::DEPTH_RAW, width, height, false,
+          level_type(pooling_, static_cast<int>(i) + 1));
+    }
+    level->set_frame_id(depth->frame_id());
+    Pool(pooling_, reinterpret_cast<const std::uint16_t*>(src->cdata()),
+        src->width(), src->height(), src->width() * sizeof(std::uint16_t),
+        reinterpret_cast<std::uint16_t*>(level->data()),
+        width * sizeof(std::uint16_t));
+    src = level;
+  }
+  return true;
+}
+
+Image::pointer DepthPyramid::GetLevel(int level) const {
+  if (level < 1 || level > levels()) return nullptr;
+  return levels_[level - 1];
+}
+
+MYNTEYE_END_NAMESPACE
@@ -0,0 +1,296 @@
+// Copyright 2018 Slightech Co., Ltd. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include "mynteye/depth_query.h"
+
+#include <algorithm>
+
+#include "mynteye/util/depth.h"
+#include "mynteye/util/log.h"
+#include "mynteye/util/parallel.h"
+
+MYNTEYE_BEGIN_NAMESPACE
+
+constexpr int DepthQuery::kTileSize;
+
+namespace {
+
+const int kMinBandRows = 8;
+const int kMinBandBoxes = 16;
+/** Invalid depth while taking the min, above any valid one. */
+const std::uint16_t kNone = 0xFFFF;
+
+inline std::uint16_t min_key(std::uint16_t d) {
+  return depth::is_valid(d) ? d : kNone;
+}
+
+inline std::uint16_t max_key(std::uint16_t d) {
+  return depth::is_valid(d) ? d : 0;
+}
+
+}  // namespace
+
+DepthQuery::DepthQuery(const Image::pointer& depth)
+  : depth_(depth), data_(nullptr), width_(0), height_(0),
+    tiles_x_(0), tiles_y_(0) {
+  if (!depth || depth->format() != ImageFormat::DEPTH_RAW) {
+    LOGE("Error: DepthQuery:: depth must be DEPTH_RAW");
+    return;
+  }
+  data_ = reinterpret_cast<const std::uint16_t*>(depth->cdata());
+  width_ = depth->width();
+  height_ = depth->height();
+  tiles_x_ = (width_ + kTileSize - 1) / kTileSize;
+  tiles_y_ = (height_ + kTileSize - 1) / kTileSize;
+}
+
+DepthQuery::~DepthQuery() {
+}
+
+bool DepthQuery::Clamp(const DepthBox& box, int* x0, int* y0, int* x1,
+    int* y1) const {
+  *x0 = std::max(0, box.x);
+  *y0 = std::max(0, box.y);
+  *x1 = std::min(width_, box.x + std::max(0, box.width));
+  *y1 = std::min(height_, box.y + std::max(0, box.height));
+  return data_ && *x0 < *x1 && *y0 < *y1;
+}
+
+void DepthQuery::BuildSums() const {
+  std::call_once(sums_once_, [this]() {
+    const int stride = width_ + 1;
+    sum_.assign(static_cast<std::size_t>(stride) * (height_ + 1), 0);
+    count_.assign(sum_.size(), 0);
+    // prefix of each row, rows in parallel
+    parallel::for_each(height_, [this, stride](int begin, int end) {
+      for (int y = begin; y < end; y++) {
+        const std::uint16_t* d = data_ + y * width_;
+        std::uint64_t* s = sum_.data() + (y + 1) * stride + 1;
+        std::uint32_t* c = count_.data() + (y + 1) * stride + 1;
+        std::uint64_t sum = 0;
+        std::uint32_t count = 0;
+        for (int x = 0; x < width_; x++) {
+          std::uint32_t v = depth::is_valid(d[x]);
+          sum += d[x] * v;
+          count += v;
+          s[x] = sum;
+          c[x] = count;
+        }
+      }
+    }, kMinBandRows);
+    // then down the columns, a band of columns adds whole row spans
+    parallel::for_each(stride, [this, stride](int begin, int end) {
+      for (int y = 1; y <= height_; y++) {
+        std::uint64_t* s = sum_.data() + y * stride;
+        std::uint32_t* c = count_.data() + y * stride;
+        const std::uint64_t* s0 = s - stride;
+        const std::uint32_t* c0 = c - stride;
+        for (int x = begin; x < end; x++) {
+          s[x] += s0[x];
+          c[x] += c0[x];
+        }
+      }
+    }, 64);
+  });
+}
+
+void DepthQuery::BuildTiles() const {
+  std::call_once(tiles_once_, [this]() {
+    tile_min_.assign(static_cast<std::size_t>(tiles_x_) * tiles_y_, kNone);
+    tile_max_.assign(tile_min_.size(), 0);
+    parallel::for_each(tiles_y_, [this](int begin, int end) {
+      for (int ty = begin; ty < end; ty++) {
+        std::uint16_t* tmin = tile_min_.data() + ty * tiles_x_;
+        std::uint16_t* tmax = tile_max_.data() + ty * tiles_x_;
+        const int y1 = std::min(height_, (ty + 1) * kTileSize);
+        for (int y = ty * kTileSize; y < y1; y++) {
+          const std::uint16_t* d = data_ + y * width_;
+          for (int tx = 0; tx < tiles_x_; tx++) {
+            const int x0 = tx * kTileSize;
+            const int x1 = std::min(width_, x0 + kTileSize);
+            std::uint16_t lo = tmin[tx], hi = tmax[tx];
+            for (int x = x0; x < x1; x++) {
+              lo = std::min(lo, min_key(d[x]));
+              hi = std::max(hi, max_key(d[x]));
+            }
+            tmin[tx] = lo;
+            tmax[tx] = hi;
+          }
+        }
+      }
+    });
+  });
+}
+
+void DepthQuery::Sums(const DepthBox& box, std::uint32_t* count,
+    std::uint64_t* sum) const {
+  int x0, y0, x1, y1;
+  if (!Clamp(box, &x0, &y0, &x1, &y1)) {
+    *count = 0;
+    *sum = 0;
+    return;
+  }
+  BuildSums();
+  const std::size_t stride = width_ + 1;
+  const std::size_t a = y0 * stride + x0, b = y0 * stride + x1;
+  const std::size_t c = y1 * stride + x0, d = y1 * stride + x1;
+  *count = count_[d] - count_[b] - count_[c] + count_[a];
+  *sum = sum_[d] - sum_[b] - sum_[c] + sum_[a];
+}
+
+void DepthQuery::MinMax(const DepthBox& box, std::uint16_t* min,
+    std::uint16_t* max) const {
+  std::uint16_t lo = kNone, hi = 0;
+  int x0, y0, x1, y1;
+  if (Clamp(box, &x0, &y0, &x1, &y1)) {
+    BuildTiles();
+    // tiles wholly inside the box
+    const int tx0 = (x0 + kTileSize - 1) / kTileSize, tx1 = x1 / kTileSize;
+    const int ty0 = (y0 + kTileSize - 1) / kTileSize, ty1 = y1 / kTileSize;
+    auto scan = [&](int sx0, int sy0, int sx1, int sy1) {
+      for (int y = sy0; y < sy1; y++) {
+        const std::uint16_t* d = data_ + y * width_;
+        for (int x = sx0; x < sx1; x++) {
+          lo = std::min(lo, min_key(d[x]));
+          hi = std::max(hi, max_key(d[x]));
+        }
+      }
+    };
+    if (tx0 < tx1 && ty0 < ty1) {
+      for (int ty = ty0; ty < ty1; ty++) {
+        for (int tx = tx0; tx < tx1; tx++) {
+          lo = std::min(lo, tile_min_[ty * tiles_x_ + tx]);
+          hi = std::max(hi, tile_max_[ty * tiles_x_ + tx]);
+        }
+      }
+      const int ix0 = tx0 * kTileSize, ix1 = tx1 * kTileSize;
+      const int iy0 = ty0 * kTileSize, iy1 = ty1 * kTileSize;
+      scan(x0, y0, x1, iy0);   // above
+      scan(x0, iy1, x1, y1);   // below
+      scan(x0, iy0, ix0, iy1);  // left
+      scan(ix1, iy0, x1, iy1);  // right
+    } else {
+      scan(x0, y0, x1, y1);
+    }
+  }
+  *min = lo == kNone ? 0 : lo;
+  *max = hi;
+}
+
+std::uint32_t DepthQuery::Count(const DepthBox& box) const {
+  std::uint32_t count;
+  std::uint64_t sum;
+  Sums(box, &count, &sum);
+  return count;
+}
+
+double DepthQuery::Mean(const DepthBox& box) const {
+  std::uint32_t count;
+  std::uint64_t sum;
+  Sums(box, &count, &sum);
+  return count ? static_cast<double>(sum) / count : 0;
+}
+
+std::uint16_t DepthQuery::Min(const DepthBox& box) const {
+  std::uint16_t min, max;
+  MinMax(box, &min, &max);
+  return min;
+}
+
+std::uint16_t DepthQuery::Max(const DepthBox& box) const {
+  std::uint16_t min, max;
+  MinMax(box, &min, &max);
+  return max;
+}
+
+std::uint16_t DepthQuery::Median(const DepthBox& box) const {
+  int x0, y0, x1, y1;
+  if (!Clamp(box, &x0, &y0, &x1, &y1)) return 0;
+  std::vector<std::uint16_t> values;
+  values.reserve(static_cast<std::size_t>(x1 - x0) * (y1 - y0));
+  for (int y = y0; y < y1; y++) {
+    const std::uint16_t* d = data_ + y * width_;
+    for (int x = x0; x < x1; x++) {
+      if (depth::is_valid(d[x])) values.push_back(d[x]);
+    }
+  }
+  if (values.empty()) return 0;
+  auto mid = values.begin() + (values.size() - 1) / 2;
+  std::nth_element(values.begin(), mid, values.end());
+  return *mid;
+}
+
+DepthBoxResult DepthQuery::Query(const DepthBox& box, bool median) const {
+  DepthBoxResult result;
+  std::uint64_t sum;
+  Sums(box, &result.count, &sum);
+  result.mean = result.count ? static_cast<double>(sum) / result.count : 0;
+  MinMax(box, &result.min, &result.max);
+  result.median = median && result.count ? Median(box) : 0;
+  return result;
+}
+
+void DepthQuery::Query(const std::vector<DepthBox>& boxes,
+    std::vector<DepthBoxResult>* results, bool median) const {
+  results->resize(boxes.size());
+  if (boxes.empty() || !data_) {
+    std::fill(results->begin(), results->end(), DepthBoxResult{});
+    return;
+  }
+  // build before splitting, not in the first band to get there
+  BuildSums();
+  BuildTiles();
+  parallel::for_each(static_cast<int>(boxes.size()),
+      [&](int begin, int end) {
+    for (int i = begin; i < end; i++) {
+      (*results)[i] = Query(boxes[i], median);
+    }
+  }, kMinBandBoxes);
+}
+
+void DepthQuery::Mean(const std::vector<DepthBox>& boxes,
+    std::vector<double>* means) const {
+  means->resize(boxes.size());
+  if (boxes.empty()) return;
+  BuildSums();
+  // four reads a box, not worth the threads
+  for (std::size_t i = 0; i < boxes.size(); i++) {
+    (*means)[i] = Mean(boxes[i]);
+  }
+}
+
+void DepthQuery::Min(const std::vector<DepthBox>& boxes,
+    std::vector<std::uint16_t>* mins) const {
+  mins->resize(boxes.size());
+  if (boxes.empty()) return;
+  BuildTiles();
+  parallel::for_each(static_cast<int>(boxes.size()),
+      [&](int begin, int end) {
+    for (int i = begin; i < end; i++) {
+      (*mins)[i] = Min(boxes[i]);
+    }
+  }, kMinBandBoxes);
+}
+
+void DepthQuery::Median(const std::vector<DepthBox>& boxes,
+    std::vector<std::uint16_t>* medians) const {
+  medians->resize(boxes.size());
+  parallel::for_each(static_cast<int>(boxes.size()),
+      [&](int begin, int end) {
+    for (int i = begin; i < end; i++) {
+      (*medians)[i] = Median(boxes[i]);
+    }
+  }, kMinBandBoxes);
+}
+
+MYNTEYE_END_NAMESPACE
@@ -0,0 +1,352 @@
+// Copyright 2018 Slightech Co., Ltd. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include "mynteye/depth_registration.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <memory>
+
+#include "mynteye/util/depth.h"
+#include "mynteye/util/log.h"
+#include "mynteye/util/parallel.h"
+
+MYNTEYE_BEGIN_NAMESPACE
+
+namespace {
+
+const int kMinBandRows = 8;
+/** Largest footprint side in pixels, larger ones are cut at its center. */
+const int kMaxSplat = 4;
+/** Z-buffer value of no depth, above any raw depth. */
+const std::uint16_t kEmpty = 0xFFFF;
+
+inline void splat_min(std::atomic<std::uint16_t>* cell, std::uint16_t z) {
+  std::uint16_t cur = cell->load(std::memory_order_relaxed);
+  while (z < cur && !cell->compare_exchange_weak(cur, z,
+      std::memory_order_relaxed)) {
+  }
+}
+
+inline const std::uint16_t* row_ptr(const std::uint16_t* p, std::size_t step,
+    int v) {
+  return reinterpret_cast<const std::uint16_t*>(
+      reinterpret_cast<const std::uint8_t*>(p) + v * step);
+}
+
+inline std::uint16_t* row_ptr(std::uint16_t* p, std::size_t step, int v) {
+  return reinterpret_cast<std::uint16_t*>(
+      reinterpret_cast<std::uint8_t*>(p) + v * step);
+}
+
+/** Pixels whose centers are in [a, b] of size n, the nearest one if none. */
+inline bool to_range(double a, double b, int n, std::int16_t* i0,
+    std::int16_t* i1) {
+  double c = (a + b) / 2;
+  int lo = static_cast<int>(std::ceil(a));
+  int hi = static_cast<int>(std::floor(b));
+  if (lo > hi) lo = hi = static_cast<int>(std::lround(c));
+  if (hi - lo >= kMaxSplat) {
+    lo = static_cast<int>(std::lround(c)) - kMaxSplat / 2;
+    hi = lo + kMaxSplat - 1;
+  }
+  lo = std::max(lo, 0);
+  hi = std::min(hi, n - 1);
+  if (lo > hi) return false;
+  *i0 = static_cast<std::int16_t>(lo);
+  *i1 = static_cast<std::int16_t>(hi);
+  return true;
+}
+
+}  // namespace
+
+DepthRegistration::DepthRegistration(const StereoCalibration& calib,
+    const ImageType& eye, bool rectified, int width, int height)
+  : calib_(calib), eye_(eye), rectified_(rectified),
+    width_(width > 0 ? width : calib.width()),
+    height_(height > 0 ? height : calib.height()),
+    valid_(false), identity_(false) {
+  if (!calib_.IsValid() || width_ <= 0 || height_ <= 0 ||
+      width_ > 32767 || height_ > 32767) {
+    LOGE("Error: DepthRegistration needs a valid calibration");
+    return;
+  }
+  if (eye_ != ImageType::IMAGE_LEFT_COLOR &&
+      eye_ != ImageType::IMAGE_RIGHT_COLOR) {
+    LOGE("Error: DepthRegistration:: eye must be left or right color");
+    return;
+  }
+  const bool right = eye_ == ImageType::IMAGE_RIGHT_COLOR;
+  identity_ = !right && rectified_ && width_ == calib_.width() &&
+      height_ == calib_.height();
+
+  // the right camera is at the baseline along x of the rectified left
+  center_[0] = right ? calib_.baseline() : 0;
+  center_[1] = center_[2] = 0;
+  std::fill(rot_, rot_ + 9, 0.);
+  std::fill(dist_, dist_ + 8, 0.);
+  if (rectified_) {
+    const CameraIntrinsics& in = right ? calib_.GetRightIntrinsics() :
+        calib_.GetIntrinsics();
+    double sx = static_cast<double>(width_) / calib_.width();
+    double sy = static_cast<double>(height_) / calib_.height();
+    rot_[0] = rot_[4] = rot_[8] = 1;
+    fx_ = in.fx * sx;
+    fy_ = in.fy * sy;
+    cx_ = in.cx * sx;
+    cy_ = in.cy * sy;
+  } else {
+    const CameraCtrlRectLogData& data = calib_.GetLogData();
+    int in_width = (data.InImgWidth ? data.InImgWidth : data.OutImgWidth) / 2;
+    int in_height = data.InImgHeight ? data.InImgHeight : data.OutImgHeight;
+    double sx = static_cast<double>(width_) / in_width;
+    double sy = static_cast<double>(height_) / in_height;
+    const float* cam = right ? data.CamMat2 : data.CamMat1;
+    const float* dist = right ? data.CamDist2 : data.CamDist1;
+    const float* rot = right ? data.RRotaMat : data.LRotaMat;
+    // the rectification rotation maps raw to rectified, use its inverse
+    for (int r = 0; r < 3; r++) {
+      for (int c = 0; c < 3; c++) {
+        rot_[r * 3 + c] = rot[c * 3 + r];
+      }
+    }
+    std::copy(dist, dist + 8, dist_);
+    fx_ = cam[0] * sx;
+    cx_ = cam[2] * sx;
+    fy_ = cam[4] * sy;
+    cy_ = cam[5] * sy;
+  }
+  valid_ = true;
+  if (identity_) return;
+
+  const CameraIntrinsics& in = calib_.GetIntrinsics();
+  const int dw = calib_.width(), dh = calib_.height();
+  rays_x_.resize(dw + 1);
+  rays_y_.resize(dh + 1);
+  for (int u = 0; u <= dw; u++) {
+    rays_x_[u] = static_cast<float>((u - 0.5 - in.cx) / in.fx);
+  }
+  for (int v = 0; v <= dh; v++) {
+    rays_y_[v] = static_cast<float>((v - 0.5 - in.cy) / in.fy);
+  }
+  if (right) return;
+
+  // the left eye shares the center, footprints do not depend on depth
+  const int corner_step = CornerStep();
+  const std::size_t n = static_cast<std::size_t>(dw) * dh;
+  boxes_.resize(n);
+  z_scales_.resize(n);
+  parallel::for_each(dh, [&](int begin, int end) {
+    for (int v = begin; v < end; v++) {
+      for (int u = 0; u < dw; u++) {
+        std::size_t i = static_cast<std::size_t>(v) * dw + u;
+        double xc = (u - in.cx) / in.fx, yc = (v - in.cy) / in.fy;
+        z_scales_[i] = static_cast<float>(
+            rot_[6] * xc + rot_[7] * yc + rot_[8]);
+        Box& box = boxes_[i];
+        double umin = 1e9, umax = -1e9, vmin = 1e9, vmax = -1e9;
+        bool ok = true;
+        for (int k = 0; k < 4 && ok; k += corner_step) {
+          double px, py;
+          ok = Project(rays_x_[u + (k & 1)], rays_y_[v + (k >> 1)], 1,
+              &px, &py);
+          umin = std::min(umin, px);
+          umax = std::max(umax, px);
+          vmin = std::min(vmin, py);
+          vmax = std::max(vmax, py);
+        }
+        if (!ok || !to_range(umin, umax, width_, &box.x0, &box.x1) ||
+            !to_range(vmin, vmax, height_, &box.y0, &box.y1)) {
+          box.x0 = box.y0 = 1;  // empty
+          box.x1 = box.y1 = 0;
+        }
+      }
+    }
+  }, kMinBandRows);
+}
+
+DepthRegistration::~DepthRegistration() {
+}
+
+bool DepthRegistration::Project(double x, double y, double z,
+    double* u, double* v) const {
+  double X = rot_[0] * x + rot_[1] * y + rot_[2] * z;
+  double Y = rot_[3] * x + rot_[4] * y + rot_[5] * z;
+  double Z = rot_[6] * x + rot_[7] * y + rot_[8] * z;
+  if (Z <= 0) return false;
+  x = X / Z;
+  y = Y / Z;
+  if (!rectified_) {
+    const double k1 = dist_[0], k2 = dist_[1], p1 = dist_[2], p2 = dist_[3];
+    const double k3 = dist_[4], k4 = dist_[5], k5 = dist_[6], k6 = dist_[7];
+    double x2 = x * x, y2 = y * y, r2 = x2 + y2, _2xy = 2 * x * y;
+    double kr = (1 + ((k3 * r2 + k2) * r2 + k1) * r2) /
+        (1 + ((k6 * r2 + k5) * r2 + k4) * r2);
+    double xd = x * kr + p1 * _2xy + p2 * (r2 + 2 * x2);
+    double yd = y * kr + p1 * (r2 + 2 * y2) + p2 * _2xy;
+    x = xd;
+    y = yd;
+  }
+  *u = fx_ * x + cx_;
+  *v = fy_ * y + cy_;
+  return true;
+}
+
+int DepthRegistration::CornerStep() const {
+  // a rectified color keeps rows and columns, two opposite corners bound
+  // the footprint, else all four do
+  return rectified_ ? 3 : 1;
+}
+
+bool DepthRegistration::Register(const std::uint16_t* depth,
+    std::size_t depth_step, std::uint16_t* dst, std::size_t dst_step) const {
+  if (!valid_ || !depth || !dst) return false;
+  const int dw = calib_.width(), dh = calib_.height();
+
+  if (identity_) {
+    parallel::for_each(dh, [&](int begin, int end) {
+      for (int v = begin; v < end; v++) {
+        const std::uint16_t* s = row_ptr(depth, depth_step, v);
+        std::uint16_t* d = row_ptr(dst, dst_step, v);
+        for (int u = 0; u < dw; u++) {
+          d[u] = depth::is_valid(s[u]) ? s[u] : depth::kInvalid;
+        }
+      }
+    }, kMinBandRows);
+    return true;
+  }
+
+  const int width = width_, height = height_;
+  std::lock_guard<std::mutex> _(mutex_);
+  if (!zbuf_) {
+    zbuf_.reset(new std::atomic<std::uint16_t>[
+        static_cast<std::size_t>(width) * height]);
+  }
+  auto&& zbuf = zbuf_;
+  parallel::for_each(height, [&](int begin, int end) {
+    for (std::size_t i = static_cast<std::size_t>(begin) * width,
+        n = static_cast<std::size_t>(end) * width; i < n; i++) {
+      zbuf[i].store(kEmpty, std::memory_order_relaxed);
+    }
+  }, kMinBandRows);
+
+  auto splat = [&](const Box& box, double z) {
+    if (!(z > 0) || z >= kEmpty) return;
+    std::uint16_t value = static_cast<std::uint16_t>(z + 0.5);
+    for (int y = box.y0; y <= box.y1; y++) {
+      std::atomic<std::uint16_t>* row = zbuf.get() +
+          static_cast<std::size_t>(y) * width;
+      for (int x = box.x0; x <= box.x1; x++) {
+        splat_min(row + x, value);
+      }
+    }
+  };
+
+  if (!boxes_.empty()) {
+    parallel::for_each(dh, [&](int begin, int end) {
+      for (int v = begin; v < end; v++) {
+        const std::uint16_t* s = row_ptr(depth, depth_step, v);
+        std::size_t offset = static_cast<std::size_t>(v) * dw;
+        for (int u = 0; u < dw; u++) {
+          if (!depth::is_valid(s[u])) continue;
+          splat(boxes_[offset + u],
+              static_cast<double>(s[u]) * z_scales_[offset + u]);
+        }
+      }
+    }, kMinBandRows);
+  } else {
+    const CameraIntrinsics& in = calib_.GetIntrinsics();
+    const int corner_step = CornerStep();
+    parallel::for_each(dh, [&](int begin, int end) {
+      for (int v = begin; v < end; v++) {
+        const std::uint16_t* s = row_ptr(depth, depth_step, v);
+        double yc = (v - in.cy) / in.fy;
+        for (int u = 0; u < dw; u++) {
+          if (!depth::is_valid(s[u])) continue;
+          double z = s[u];
+          double xc = (u - in.cx) / in.fx;
+          double px = xc * z - center_[0], py = yc * z - center_[1];
+          double pz = z - center_[2];
+          double zc = rot_[6] * px + rot_[7] * py + rot_[8] * pz;
+          double umin = 1e9, umax = -1e9, vmin = 1e9, vmax = -1e9;
+          bool ok = true;
+          for (int k = 0; k < 4 && ok; k += corner_step) {
+            double cu, cv;
+            ok = Project(rays_x_[u + (k & 1)] * z - center_[0],
+                rays_y_[v + (k >> 1)] * z - center_[1], pz, &cu, &cv);
+            umin = std::min(umin, cu);
+            umax = std::max(umax, cu);
+            vmin = std::min(vmin, cv);
+            vmax = std::max(vmax, cv);
+          }
+          Box box;
+          if (ok && to_range(umin, umax, width, &box.x0, &box.x1) &&
+              to_range(vmin, vmax, height, &box.y0, &box.y1)) {
+            splat(box, zc);
+          }
+        }
+      }
+    }, kMinBandRows);
+  }
+
+  parallel::for_each(height, [&](int begin, int end) {
+    for (int v = begin; v < end; v++) {
+      const std::atomic<std::uint16_t>* z = zbuf.get() +
+          static_cast<std::size_t>(v) * width;
+      std::uint16_t* d = row_ptr(dst, dst_step, v);
+      for (int u = 0; u < width; u++) {
+        std::uint16_t value = z[u].load(std::memory_order_relaxed);
+        d[u] = value == kEmpty ? depth::kInvalid : value;
+      }
+    }
+  }, kMinBandRows);
+  return true;
+}
+
+Image::pointer DepthRegistration::Register(const Image::pointer& depth,
+    const Image::pointer& color) const {
+  if (!valid_ || !depth) return nullptr;
+  if (depth->format() != ImageFormat::DEPTH_RAW ||
+      depth->width() != calib_.width() ||
+      depth->height() != calib_.height()) {
+    LOGE("Error: DepthRegistration:: depth must be DEPTH_RAW of %dx%d",
+        calib_.width(), calib_.height());
+    return nullptr;
+  }
+  if (color && (color->width() != width_ || color->height() != height_)) {
+    LOGE("Error: DepthRegistration:: color must be %dx%d", width_, height_);
+    return nullptr;
+  }
+  Image::pointer dst;
+  {
+    std::lock_guard<std::mutex> _(mutex_);
+    if (output_ && output_.use_count() == 1) {
+      dst = output_;
+    } else {
+      dst = ImageDepth::Create(ImageFormat::DEPTH_RAW, width_, height_,
+          false, ImageType::IMAGE_DEPTH_REGISTERED);
+      output_ = dst;
+    }
+  }
+  dst->set_frame_id(color ? color->frame_id() : depth->frame_id());
+  if (!Register(reinterpret_cast<const std::uint16_t*>(depth->cdata()),
+      depth->width() * sizeof(std::uint16_t),
+      reinterpret_cast<std::uint16_t*>(dst->data()),
+      width_ * sizeof(std::uint16_t))) {
+    return nullptr;
+  }
+  return dst;
+}
+
+MYNTEYE_END_NAMESPACE
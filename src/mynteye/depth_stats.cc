@@ -0,0 +1,126 @@
+// Copyright 2018 Slightech Co., Ltd. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include "mynteye/depth_stats.h"
+
+#include <algorithm>
+
+#include "mynteye/util/depth.h"
+#include "mynteye/util/log.h"
+#include "mynteye/util/parallel.h"
+
+MYNTEYE_BEGIN_NAMESPACE
+
+namespace {
+
+/** Invalid depth while taking the min, above any valid one. */
+const std::uint16_t kNone = 0xFFFF;
+
+/** Stats of a band of rows, merged after. */
+struct Partial {
+  std::uint16_t min = kNone;
+  std::uint16_t max = 0;
+  std::uint64_t sum = 0;
+  std::uint32_t valid = 0;
+  std::vector<std::uint32_t> histogram;
+};
+
+}  // namespace
+
+void DepthStats::Compute(const std::uint16_t* depth, int width, int height,
+    std::size_t step, DepthStats* stats, int bins, int shift) {
+  width = std::max(0, width);
+  height = std::max(0, height);
+  bins = std::max(1, bins);
+  shift = std::max(0, std::min(15, shift));
+  stats->width = width;
+  stats->height = height;
+  stats->histogram_shift = shift;
+  stats->histogram.assign(bins, 0);
+  stats->mask_stride = (width + 63) / 64;
+  stats->mask.resize(stats->mask_stride * height);
+
+  const std::size_t stride = stats->mask_stride;
+  const std::uint32_t last = bins - 1;
+  parallel::Bands bands(height);
+  std::vector<Partial> partials(bands.bands());
+  bands.Run([&](int band, int begin, int end) {
+    Partial& p = partials[band];
+    p.histogram.assign(bins, 0);
+    std::uint32_t* hist = p.histogram.data();
+    for (int y = begin; y < end; y++) {
+      const std::uint16_t* row = reinterpret_cast<const std::uint16_t*>(
+          reinterpret_cast<const std::uint8_t*>(depth) + y * step);
+      std::uint64_t* mask = stats->mask.data() + y * stride;
+      for (std::size_t w = 0; w < stride; w++) {
+        const int x0 = static_cast<int>(w * 64);
+        const int n = std::min(64, width - x0);
+        const std::uint16_t* d = row + x0;
+        std::uint64_t bits = 0;
+        std::uint16_t lo = kNone, hi = 0;
+        std::uint32_t sum = 0, valid = 0;
+        for (int i = 0; i < n; i++) {
+          std::uint16_t v = depth::is_valid(d[i]);
+          bits |= static_cast<std::uint64_t>(v ^ 1) << i;
+          lo = std::min(lo, v ? d[i] : kNone);
+          hi = std::max(hi, static_cast<std::uint16_t>(d[i] * v));
+          sum += d[i] * v;
+          valid += v;
+        }
+        // the histogram scatters, kept out of the loop above
+        for (int i = 0; i < n; i++) {
+          std::uint32_t b = std::min<std::uint32_t>(d[i] >> shift, last);
+          hist[b] += depth::is_valid(d[i]);
+        }
+        mask[w] = bits;
+        p.min = std::min(p.min, lo);
+        p.max = std::max(p.max, hi);
+        p.sum += sum;
+        p.valid += valid;
+      }
+    }
+  });
+
+  Partial total;
+  for (auto&& p : partials) {
+    total.min = std::min(total.min, p.min);
+    total.max = std::max(total.max, p.max);
+    total.sum += p.sum;
+    total.valid += p.valid;
+    for (int i = 0; i < bins; i++) {
+      stats->histogram[i] += p.histogram[i];
+    }
+  }
+  stats->min = total.valid ? total.min : 0;
+  stats->max = total.max;
+  stats->valid = total.valid;
+  stats->mean = total.valid ?
+      static_cast<double>(total.sum) / total.valid : 0;
+  stats->valid_ratio = width > 0 && height > 0 ?
+      static_cast<float>(total.valid) / (width * height) : 0;
+}
+
+bool DepthStats::Compute(const Image::pointer& depth, DepthStats* stats,
+    int bins, int shift) {
+  if (!depth || depth->format() != ImageFormat::DEPTH_RAW) {
+    LOGE("Error: DepthStats:: depth must be DEPTH_RAW");
+    return false;
+  }
+  stats->frame_id = depth->frame_id();
+  Compute(reinterpret_cast<const std::uint16_t*>(depth->cdata()),
+      depth->width(), depth->height(),
+      depth->width() * sizeof(std::uint16_t), stats, bins, shift);
+  return true;
+}
+
+MYNTEYE_END_NAMESPACE
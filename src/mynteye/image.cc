@@ -13,6 +13,8 @@
 // limitations under the License.
 #include "mynteye/image.h"
 
+#include <algorithm>
+
 #include "mynteye/util/convertor.h"
 #include "mynteye/util/log.h"
 
@@ -53,26 +55,27 @@ int get_mat_type(const ImageFormat& format) {
 }
 #endif
 
+// the left half of each row of a side by side image, width * bpp bytes a row
 inline void copyLeft(const std::uint8_t *in, std::uint8_t *out,
-    int width, int height) {
+    int width, int height, int bpp) {
+  const int row = width * bpp, half = width / 2 * bpp;
   for (int i = 0; i < height; i++) {
-    std::copy(in + i * width * 2,
-        in + (width - 1) + i * width * 2, out + i * width);
+    std::copy(in + i * row, in + i * row + half, out + i * half);
   }
 }
 
 inline void copyRight(const std::uint8_t *in, std::uint8_t *out,
-    int width, int height) {
+    int width, int height, int bpp) {
+  const int row = width * bpp, half = width / 2 * bpp;
   for (int i = 0; i < height; i++) {
-    std::copy(in + i * width * 2 + width,
-        in + (i + 1) * width * 2 - 1, out + i * width);
+    std::copy(in + i * row + row - half, in + (i + 1) * row, out + i * half);
   }
 }
 
 }  // namespace
 
 Image::Image(ImageType type, ImageFormat format, int width, int height,
-    bool is_buffer)
+    bool is_buffer, bool allocate)
   : type_(type),
     format_(format),
     width_(width),
@@ -80,7 +83,7 @@ Image::Image(ImageType type, ImageFormat format, int width, int height,
     is_buffer_(is_buffer),
     raw_format_(format) {
   auto n = get_image_size(format, width, height);
-  data_.assign(n, 0);
+  if (allocate) data_.resize(n);
   set_valid_size(n);
   set_frame_id(0);
 }
@@ -95,12 +98,58 @@ Image::pointer Image::Create(ImageType type, ImageFormat format, int width,
     case ImageType::IMAGE_RIGHT_COLOR:
       return ImageColor::Create(format, width, height, is_buffer);
     case ImageType::IMAGE_DEPTH:
-      return ImageDepth::Create(format, width, height, is_buffer);
+    case ImageType::IMAGE_DEPTH_REGISTERED:
+    case ImageType::IMAGE_DEPTH_MIN_2:
+    case ImageType::IMAGE_DEPTH_MIN_4:
+    case ImageType::IMAGE_DEPTH_MIN_8:
+    case ImageType::IMAGE_DEPTH_MEDIAN_2:
+    case ImageType::IMAGE_DEPTH_MEDIAN_4:
+    case ImageType::IMAGE_DEPTH_MEDIAN_8:
+      return ImageDepth::Create(format, width, height, is_buffer, type);
+    default:
+      throw new std::runtime_error("ImageType must be color or depth");
+  }
+}
+
+Image::pointer Image::CreateView(ImageType type, ImageFormat format,
+    int width, int height, const std::uint8_t* data, std::size_t size,
+    std::shared_ptr<const void> owner) {
+  switch (type) {
+    case ImageType::IMAGE_LEFT_COLOR:
+    case ImageType::IMAGE_RIGHT_COLOR:
+      return ImageColor::CreateView(format, width, height, data, size,
+          std::move(owner));
+    case ImageType::IMAGE_DEPTH:
+    case ImageType::IMAGE_DEPTH_REGISTERED:
+    case ImageType::IMAGE_DEPTH_MIN_2:
+    case ImageType::IMAGE_DEPTH_MIN_4:
+    case ImageType::IMAGE_DEPTH_MIN_8:
+    case ImageType::IMAGE_DEPTH_MEDIAN_2:
+    case ImageType::IMAGE_DEPTH_MEDIAN_4:
+    case ImageType::IMAGE_DEPTH_MEDIAN_8:
+      return ImageDepth::CreateView(format, width, height, data, size,
+          std::move(owner), type);
     default:
       throw new std::runtime_error("ImageType must be color or depth");
   }
 }
 
+void Image::SetView(const std::uint8_t* data, std::size_t size,
+    std::shared_ptr<const void> owner) {
+  buffer_t().swap(data_);
+  view_ = data;
+  view_size_ = size;
+  view_owner_ = std::move(owner);
+  set_valid_size(size);
+}
+
+void Image::Detach() {
+  buffer_t(view_, view_ + view_size_).swap(data_);
+  view_ = nullptr;
+  view_size_ = 0;
+  view_owner_ = nullptr;
+}
+
 #ifdef WITH_OPENCV
 cv::Mat Image::ToMat() {
   return cv::Mat(height_, width_, get_mat_type(format_), data());
@@ -112,23 +161,33 @@ Image::pointer Image::Clone() const {
   image->set_valid_size(valid_size_);
   image->set_frame_id(frame_id_);
   image->resize();
-  std::copy(data_.begin(), data_.end(), image->data_.begin());
+  // only the valid bytes, the clone is not zero-filled first
+  auto n = std::min(valid_size_, size());
+  std::copy(data(), data() + n, image->data_.begin());
   return image;
 }
 
 Image::pointer Image::CutPart(ImageType type) const {
+  if (format_ == ImageFormat::COLOR_MJPG) {
+    // half of a jpeg bitstream is no image, decode first
+    auto rgb = Create(type_, ImageFormat::COLOR_RGB, width_, height_, false);
+    if (!ConvertTo(ImageFormat::COLOR_RGB, rgb->data())) return nullptr;
+    rgb->set_frame_id(frame_id_);
+    return rgb->CutPart(type);
+  }
   auto image = Create(type_, format_, width_ / 2, height_, false);
-  image->set_valid_size(valid_size_ / 2);
   image->set_frame_id(frame_id_);
   image->resize();
   switch (type) {
     case ImageType::IMAGE_LEFT_COLOR:
       // std::copy(data_.begin(), data_.begin() + (valid_size_ / 2 - 1), image->data_.begin());
-      copyLeft(data_.data(), image->data(), width_, height_);
+      copyLeft(data(), image->data(), width_, height_,
+          get_image_bpp(format_));
       break;
     case ImageType::IMAGE_RIGHT_COLOR:
       // std::copy(data_.begin() + (valid_size_ / 2), data_.end(), image->data_.begin());
-      copyRight(data_.data(), image->data(), width_, height_);
+      copyRight(data(), image->data(), width_, height_,
+          get_image_bpp(format_));
       break;
     default:
       throw new std::runtime_error("Image:: ImageType is unknow.");
@@ -137,6 +196,64 @@ Image::pointer Image::CutPart(ImageType type) const {
   return image;
 }
 
+bool Image::ConvertTo(ImageFormat format, std::uint8_t* dst) const {
+  // the converters take pixels that are not const, but do not write them
+  auto src = const_cast<std::uint8_t*>(data());
+  if (format == format_) {
+    if (format == ImageFormat::IMAGE_MJPG) return false;
+    auto n = std::min<std::size_t>(
+        get_image_size(format, width_, height_), size());
+    std::copy(src, src + n, dst);
+    return true;
+  }
+  switch (format_) {  // src
+    case ImageFormat::IMAGE_RGB_24:
+      if (format == ImageFormat::IMAGE_BGR_24) {
+        RGB_TO_BGR(src, dst, width_, height_);
+        return true;
+      } else if (format == ImageFormat::IMAGE_GRAY_8) {
+        RGB_TO_GRAY(src, dst, width_, height_);
+        return true;
+      }
+      break;
+    case ImageFormat::IMAGE_BGR_24:
+      if (format == ImageFormat::IMAGE_RGB_24) {
+        BGR_TO_RGB(src, dst, width_, height_);
+        return true;
+      } else if (format == ImageFormat::IMAGE_GRAY_8) {
+        BGR_TO_GRAY(src, dst, width_, height_);
+        return true;
+      }
+      break;
+    case ImageFormat::IMAGE_YUYV:
+      if (format == ImageFormat::IMAGE_RGB_24) {
+        YUYV_TO_RGB(src, dst, width_, height_);
+        return true;
+      } else if (format == ImageFormat::IMAGE_BGR_24) {
+        YUYV_TO_BGR(src, dst, width_, height_);
+        return true;
+      } else if (format == ImageFormat::IMAGE_GRAY_8) {
+        YUYV_TO_GRAY(src, dst, width_, height_);
+        return true;
+      }
+      break;
+    case ImageFormat::IMAGE_MJPG:
+      if (format == ImageFormat::IMAGE_RGB_24) {
+        MJPEG_TO_RGB_LIBJPEG(src, valid_size_, dst);
+        return true;
+      } else if (format == ImageFormat::IMAGE_BGR_24) {
+        MJPEG_TO_BGR_LIBJPEG(src, valid_size_, dst);
+        return true;
+      } else if (format == ImageFormat::IMAGE_GRAY_8) {
+        MJPEG_TO_GRAY_LIBJPEG(src, valid_size_, dst);
+        return true;
+      }
+      break;
+    default: break;
+  }
+  return false;
+}
+
 Image::pointer Image::GetCache(const ImageFormat& format) {
   auto bpp = get_image_bpp(format);
   if (bpp_caches_.find(bpp) != bpp_caches_.end()) {
@@ -159,8 +276,8 @@ bool Image::ResetBuffer() {
 // ImageColor
 
 ImageColor::ImageColor(ImageFormat format, int width, int height,
-    bool is_buffer)
-  : Image(ImageType::IMAGE_LEFT_COLOR, format, width, height, is_buffer) {
+    bool is_buffer, bool allocate)
+  : Image(ImageType::IMAGE_LEFT_COLOR, format, width, height, is_buffer, allocate) {
 }
 
 ImageColor::~ImageColor() {
@@ -171,6 +288,8 @@ Image::pointer ImageColor::To(ImageFormat format) {
   if (format == format_) {
     return shared_from_this();
   }
+  // a view is not copied to be read
+  auto src = const_cast<std::uint8_t*>(cdata());
   switch (format_) {  // src
     case ImageFormat::COLOR_BGR:
       if (format == ImageFormat::COLOR_RGB) {
@@ -189,18 +308,18 @@ Image::pointer ImageColor::To(ImageFormat format) {
     case ImageFormat::COLOR_YUYV:
       if (format == ImageFormat::COLOR_RGB) {
         auto image = GetCache(format);
-        YUYV_TO_RGB(data(), image->data(), width_, height_);
+        YUYV_TO_RGB(src, image->data(), width_, height_);
         return image;
       } else if (format == ImageFormat::COLOR_BGR) {
         auto image = GetCache(format);
-        YUYV_TO_BGR(data(), image->data(), width_, height_);
+        YUYV_TO_BGR(src, image->data(), width_, height_);
         return image;
       }
       break;
     case ImageFormat::COLOR_MJPG:
       if (format == ImageFormat::COLOR_RGB) {
         auto image = GetCache(format);
-        MJPEG_TO_RGB_LIBJPEG(data(), valid_size_, image->data());
+        MJPEG_TO_RGB_LIBJPEG(src, valid_size_, image->data());
         return image;
       } else if (format == ImageFormat::COLOR_BGR) {
         return To(ImageFormat::COLOR_RGB)->To(ImageFormat::COLOR_BGR);
@@ -214,9 +333,9 @@ Image::pointer ImageColor::To(ImageFormat format) {
 
 // ImageDepth
 
-ImageDepth::ImageDepth(ImageFormat format, int width, int height,
-    bool is_buffer)
-  : Image(ImageType::IMAGE_DEPTH, format, width, height, is_buffer) {
+ImageDepth::ImageDepth(ImageType type, ImageFormat format, int width,
+    int height, bool is_buffer, bool allocate)
+  : Image(type, format, width, height, is_buffer, allocate) {
 }
 
 ImageDepth::~ImageDepth() {
@@ -230,7 +349,7 @@ Image::pointer ImageDepth::To(ImageFormat format) {
   switch (format_) {  // src
     case ImageFormat::DEPTH_RAW:
       if (format == ImageFormat::DEPTH_GRAY) {
-        std::uint16_t* depths = reinterpret_cast<std::uint16_t*>(data());
+        auto depths = reinterpret_cast<const std::uint16_t*>(cdata());
         std::uint16_t depth, depth_min, depth_max;
         depth = depth_min = depth_max = *(depths);
         for (int i = 0; i < height_; ++i) {  // row
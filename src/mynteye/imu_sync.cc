@@ -0,0 +1,94 @@
+// Copyright 2018 Slightech Co., Ltd. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include "mynteye/imu_sync.h"
+
+#include <algorithm>
+
+#include "mynteye/util/log.h"
+
+MYNTEYE_BEGIN_NAMESPACE
+
+ImuSynchronizer::ImuSynchronizer(std::size_t max_pending)
+  : max_pending_(std::max<std::size_t>(1, max_pending)) {
+}
+
+ImuSynchronizer::~ImuSynchronizer() {
+}
+
+void ImuSynchronizer::Reset() {
+  accels_.clear();
+  gyros_.clear();
+}
+
+std::size_t ImuSynchronizer::Push(const ImuData& imu,
+    std::vector<ImuSample>* samples) {
+  const std::size_t n = samples->size();
+  if (imu.flag == 1) {
+    Record accel{imu.timestamp, imu.temperature,
+        {imu.accel[0], imu.accel[1], imu.accel[2]}};
+    accels_.push_back(accel);
+  } else if (imu.flag == 2) {
+    Record gyro{imu.timestamp, imu.temperature,
+        {imu.gyro[0], imu.gyro[1], imu.gyro[2]}};
+    gyros_.push_back(gyro);
+  } else {
+    LOGE("Error: ImuSynchronizer:: imu flag %d is unknown", imu.flag);
+    return 0;
+  }
+  if (accels_.empty()) {
+    // nothing to pair with yet, keep the latest
+    if (gyros_.size() > max_pending_) gyros_.pop_front();
+    return 0;
+  }
+  while (!gyros_.empty() &&
+      (gyros_.front().timestamp <= accels_.back().timestamp ||
+       gyros_.size() > max_pending_)) {
+    Emit(gyros_.front(), samples);
+    gyros_.pop_front();
+  }
+  // keep the accelerometer before the next gyroscope, or the last one
+  std::uint64_t next = gyros_.empty() ? accels_.back().timestamp :
+      gyros_.front().timestamp;
+  while (accels_.size() > 1 && accels_[1].timestamp <= next) {
+    accels_.pop_front();
+  }
+  return samples->size() - n;
+}
+
+void ImuSynchronizer::Emit(const Record& gyro,
+    std::vector<ImuSample>* samples) {
+  // the first accelerometer not before the gyroscope, and the one before
+  std::size_t i = 0;
+  while (i < accels_.size() && accels_[i].timestamp < gyro.timestamp) ++i;
+  ImuSample sample;
+  sample.timestamp = gyro.timestamp;
+  sample.temperature = gyro.temperature;
+  std::copy(gyro.values, gyro.values + 3, sample.gyro);
+  if (i == 0 || i == accels_.size()) {
+    // before the first or after the last, held
+    const Record& a = accels_[i == 0 ? 0 : i - 1];
+    std::copy(a.values, a.values + 3, sample.accel);
+  } else {
+    const Record& a0 = accels_[i - 1];
+    const Record& a1 = accels_[i];
+    double t = static_cast<double>(gyro.timestamp - a0.timestamp) /
+        static_cast<double>(a1.timestamp - a0.timestamp);
+    for (int k = 0; k < 3; k++) {
+      sample.accel[k] = a0.values[k] + (a1.values[k] - a0.values[k]) * t;
+    }
+  }
+  samples->push_back(sample);
+}
+
+MYNTEYE_END_NAMESPACE
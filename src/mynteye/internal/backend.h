@@ -0,0 +1,141 @@
+// Copyright 2018 Slightech Co., Ltd. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#ifndef MYNTEYE_INTERNAL_BACKEND_H_
+#define MYNTEYE_INTERNAL_BACKEND_H_
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "mynteye/device_info.h"
+#include "mynteye/image.h"
+#include "mynteye/init_params.h"
+#include "mynteye/stream_info.h"
+#include "mynteye/types.h"
+#include "mynteye/internal/channels.h"
+#include "mynteye/internal/types.h"
+
+MYNTEYE_BEGIN_NAMESPACE
+
+/**
+ * The source of the images, their infos and the imu under CameraPrivate.
+ *
+ * CameraPrivate captures, matches and converts the same over any backend.
+ * Images are retrieved by its capture thread, and may be reused by the
+ * backend on the next retrieve. Infos and imu packets are called back from a
+ * thread of the backend, between StartHidTracking and StopHidTracking.
+ *
+ * The controls of a device are unsupported by default.
+ */
+class MYNTEYE_API Backend {
+ public:
+  using imu_callback_t = Channels::imu_callback_t;
+  using img_callback_t = Channels::img_callback_t;
+  using imu_params_t = Channels::imu_params_t;
+
+  virtual ~Backend() = default;
+
+  virtual void GetDevices(std::vector<DeviceInfo>* dev_infos) = 0;
+  virtual void GetResolutions(const std::int32_t& dev_index,
+      std::vector<StreamInfo>* color_infos,
+      std::vector<StreamInfo>* depth_infos) = 0;
+
+  /** Open the streams of params, updated to the streams opened. */
+  virtual ErrorCode Open(InitParams* params) = 0;
+  virtual void Close() = 0;
+  virtual bool IsOpened() const = 0;
+  /** No more images will come, as a replay played to its end. */
+  virtual bool IsEnded() const { return false; }
+  /**
+   * Every image is to be delivered, as by a replay as fast as possible.
+   * The capture then takes both streams as they come, and waits for the
+   * queues retrieved instead of dropping.
+   */
+  virtual bool IsLossless() const { return false; }
+
+  virtual Image::pointer RetrieveImageColor(ErrorCode* code) = 0;
+  virtual Image::pointer RetrieveImageDepth(ErrorCode* code) = 0;
+
+  /** Whether the image infos and imu are provided. */
+  virtual bool IsHidExist() = 0;
+  virtual bool StartHidTracking(imu_callback_t imu_callback,
+      img_callback_t img_callback) = 0;
+  virtual void StopHidTracking() = 0;
+  /** Read the device info and the imu params. */
+  virtual bool GetFiles(DeviceParams* info, imu_params_t* imu_params) = 0;
+
+  /** Get the rectify log of index, 0 HD or 1 VGA, once opened. */
+  virtual bool GetRectifyLogData(int index, CameraCtrlRectLogData* data) = 0;
+  /** Write a rectify log file into the device. */
+  virtual bool SetRectifyLogData(const std::uint8_t* data, std::size_t size) {
+    UNUSED(data, size);
+    return false;
+  }
+
+  /** Set the depth data type of eSPDI, applied on open. */
+  virtual void SetDepthDataType(int type) {
+    UNUSED(type);
+  }
+
+  virtual ErrorCode SetAutoExposureEnabled(bool enabled) {
+    UNUSED(enabled);
+    return ErrorCode::ERROR_FAILURE;
+  }
+  virtual ErrorCode SetAutoWhiteBalanceEnabled(bool enabled) {
+    UNUSED(enabled);
+    return ErrorCode::ERROR_FAILURE;
+  }
+
+  virtual bool GetSensorRegister(int id, std::uint16_t address,
+      std::uint16_t* value, int flag) {
+    UNUSED(id, address, value, flag);
+    return false;
+  }
+  virtual bool GetHWRegister(std::uint16_t address, std::uint16_t* value,
+      int flag) {
+    UNUSED(address, value, flag);
+    return false;
+  }
+  virtual bool GetFWRegister(std::uint16_t address, std::uint16_t* value,
+      int flag) {
+    UNUSED(address, value, flag);
+    return false;
+  }
+
+  virtual bool SetSensorRegister(int id, std::uint16_t address,
+      std::uint16_t value, int flag) {
+    UNUSED(id, address, value, flag);
+    return false;
+  }
+  virtual bool SetHWRegister(std::uint16_t address, std::uint16_t value,
+      int flag) {
+    UNUSED(address, value, flag);
+    return false;
+  }
+  virtual bool SetFWRegister(std::uint16_t address, std::uint16_t value,
+      int flag) {
+    UNUSED(address, value, flag);
+    return false;
+  }
+
+  /** The hid channels of the device, to write its files, or nullptr. */
+  virtual std::shared_ptr<Channels> channels() const {
+    return nullptr;
+  }
+};
+
+MYNTEYE_END_NAMESPACE
+
+#endif  // MYNTEYE_INTERNAL_BACKEND_H_
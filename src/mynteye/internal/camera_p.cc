@@ -12,6 +12,7 @@
 // See the License for the specific language governing permissions and
 // limitations under the License.
 #include <string.h>
+#include <algorithm>
 #include <fstream>
 
 #include <stdexcept>
@@ -20,6 +21,9 @@
 
 #include "mynteye/internal/camera_p.h"
 #include "mynteye/internal/channels.h"
+#include "mynteye/internal/etron_backend.h"
+#include "mynteye/internal/rectify_cache.h"
+#include "mynteye/util/files.h"
 #include "mynteye/util/log.h"
 #include "mynteye/util/rate.h"
 #include "mynteye/util/times.h"
@@ -55,17 +59,47 @@ void get_stream_size(const StreamMode& stream_mode, int* width, int* height) {
   }
 }
 
-std::string get_stream_format_string(const StreamFormat& stream_format) {
-  switch (stream_format) {
-    case StreamFormat::STREAM_MJPG:
-      return "MJPG";
-    case StreamFormat::STREAM_YUYV:
-      return "YUYV";
+/** Pooling and pyramid level of a pooled depth type, false if not. */
+bool get_pooled_level(const ImageType& type, DepthPooling* pooling,
+    int* level) {
+  switch (type) {
+    case ImageType::IMAGE_DEPTH_MIN_2:
+      *pooling = DepthPooling::MIN; *level = 1; return true;
+    case ImageType::IMAGE_DEPTH_MIN_4:
+      *pooling = DepthPooling::MIN; *level = 2; return true;
+    case ImageType::IMAGE_DEPTH_MIN_8:
+      *pooling = DepthPooling::MIN; *level = 3; return true;
+    case ImageType::IMAGE_DEPTH_MEDIAN_2:
+      *pooling = DepthPooling::MEDIAN; *level = 1; return true;
+    case ImageType::IMAGE_DEPTH_MEDIAN_4:
+      *pooling = DepthPooling::MEDIAN; *level = 2; return true;
+    case ImageType::IMAGE_DEPTH_MEDIAN_8:
+      *pooling = DepthPooling::MEDIAN; *level = 3; return true;
     default:
-      throw new std::runtime_error("StreamFormat is unknown");
+      return false;
   }
 }
 
+/** Sleep of the capture threads while no image type is active. */
+const int kIdleSleepMs = 20;
+
+/** Datas queued of each type till retrieved. */
+const std::size_t kMaxQueued = 30;
+/** Colors kept waiting for their image infos. */
+const std::size_t kMaxWaiting = 5;
+/** Raw depths kept to pair, more than the colors waiting for infos. */
+const std::size_t kMaxRecentDepths = 2 * kMaxWaiting;
+
+/** Whether frame id a comes before b, of 16 bits wrapped. */
+bool frame_id_before(int a, int b) {
+  return static_cast<std::int16_t>(static_cast<std::uint16_t>(a - b)) < 0;
+}
+
+/** Bit of type in CameraPrivate::disabled_images_. */
+std::uint32_t image_bit(const ImageType& type) {
+  return 1u << static_cast<int>(type);
+}
+
 void matrix_3x1(const double (*src1)[3], const double (*src2)[1],
     double (*dst)[1]) {
   for (int i = 0; i < 3; i++) {
@@ -91,7 +125,12 @@ void matrix_3x3(const double (*src1)[3], const double (*src2)[3],
 }  // namespace
 
 CameraPrivate::CameraPrivate()
-  : etron_di_(nullptr), dev_sel_info_({-1}), rate_(nullptr) {
+  : CameraPrivate(std::make_shared<EtronBackend>()) {
+}
+
+CameraPrivate::CameraPrivate(const std::shared_ptr<Backend>& backend)
+  : cache_dir_(rectify_cache::default_dir()), backend_(backend),
+    rate_(nullptr) {
   DBG_LOGD(__func__);
 
   Init();
@@ -101,40 +140,31 @@ CameraPrivate::CameraPrivate()
 }
 
 void CameraPrivate::Init() {
-  int ret = EtronDI_Init(&etron_di_, false);
-  DBG_LOGI("MYNTEYE Init: %d", ret);
-  UNUSED(ret);
-
-  stream_color_info_ptr_ =
-      (PETRONDI_STREAM_INFO)malloc(sizeof(ETRONDI_STREAM_INFO)*64);
-  stream_depth_info_ptr_ =
-      (PETRONDI_STREAM_INFO)malloc(sizeof(ETRONDI_STREAM_INFO)*64);
-  // default image type
-  depth_data_type_ = 9;
   // default frame rate
   framerate_ = 10;
 
-  OnInit();
-
   is_enable_image_ = {{ImageType::IMAGE_LEFT_COLOR, false},
                       {ImageType::IMAGE_RIGHT_COLOR, false},
-                      {ImageType::IMAGE_DEPTH, false}};
+                      {ImageType::IMAGE_DEPTH, false},
+                      {ImageType::IMAGE_DEPTH_REGISTERED, false},
+                      {ImageType::IMAGE_DEPTH_MIN_2, false},
+                      {ImageType::IMAGE_DEPTH_MIN_4, false},
+                      {ImageType::IMAGE_DEPTH_MIN_8, false},
+                      {ImageType::IMAGE_DEPTH_MEDIAN_2, false},
+                      {ImageType::IMAGE_DEPTH_MEDIAN_4, false},
+                      {ImageType::IMAGE_DEPTH_MEDIAN_8, false}};
 
   is_process_mode_ = {{ProcessMode::ASSEMBLY, false},
                       {ProcessMode::WARM_DRIFT, false},
                       {ProcessMode::ALL, false}};
 
-  channels_ = std::make_shared<Channels>();
   IsHidExist();
 }
 
 CameraPrivate::~CameraPrivate() {
   DBG_LOGD(__func__);
-  free(stream_color_info_ptr_);
-  free(stream_depth_info_ptr_);
-
   if (is_hid_exist_) {
-    channels_->StopHidTracking();
+    backend_->StopHidTracking();
   }
   if (is_capture_image_) {
     StopCaptureImage();
@@ -143,266 +173,57 @@ CameraPrivate::~CameraPrivate() {
 }
 
 void CameraPrivate::GetDevices(std::vector<DeviceInfo>* dev_infos) {
-  if (!dev_infos) {
-    LOGE("GetDevices: dev_infos is null.");
-    return;
-  }
-  dev_infos->clear();
-
-  int count = EtronDI_GetDeviceNumber(etron_di_);
-  DBG_LOGD("GetDevices: %d", count);
-
-  DEVSELINFO dev_sel_info;
-  DEVINFORMATION* p_dev_info =
-      (DEVINFORMATION*)malloc(sizeof(DEVINFORMATION)*count);  // NOLINT
-
-  for (int i = 0; i < count; i++) {
-    dev_sel_info.index = i;
-
-    EtronDI_GetDeviceInfo(etron_di_, &dev_sel_info, p_dev_info+i);
-
-    char sz_buf[256];
-    int actual_length = 0;
-    if (ETronDI_OK == EtronDI_GetFwVersion(
-        etron_di_, &dev_sel_info, sz_buf, 256, &actual_length)) {
-      DeviceInfo info;
-      info.index = i;
-      info.name = p_dev_info[i].strDevName;
-      info.type = p_dev_info[i].nDevType;
-      info.pid = p_dev_info[i].wPID;
-      info.vid = p_dev_info[i].wVID;
-      info.chip_id = p_dev_info[i].nChipID;
-      info.fw_version = sz_buf;
-      dev_infos->push_back(std::move(info));
-    }
-  }
-
-  free(p_dev_info);
+  backend_->GetDevices(dev_infos);
 }
 
 void CameraPrivate::GetResolutions(const std::int32_t& dev_index,
     std::vector<StreamInfo>* color_infos,
     std::vector<StreamInfo>* depth_infos) {
-  if (!color_infos) {
-    LOGE("GetResolutions: color_infos is null.");
-    return;
-  }
-  color_infos->clear();
-
-  if (!depth_infos) {
-    LOGE("GetResolutions: depth_infos is null.");
-    return;
-  }
-  depth_infos->clear();
-
-  memset(stream_color_info_ptr_, 0, sizeof(ETRONDI_STREAM_INFO)*64);
-  memset(stream_depth_info_ptr_, 0, sizeof(ETRONDI_STREAM_INFO)*64);
-
-  DEVSELINFO dev_sel_info{dev_index};
-  EtronDI_GetDeviceResolutionList(etron_di_, &dev_sel_info, 64,
-      stream_color_info_ptr_, 64, stream_depth_info_ptr_);
-
-  PETRONDI_STREAM_INFO stream_temp_info_ptr = stream_color_info_ptr_;
-  int i = 0;
-  while (i < 64) {
-    if (stream_temp_info_ptr->nWidth > 0) {
-      StreamInfo info;
-      info.index = i;
-      info.width = stream_temp_info_ptr->nWidth;
-      info.height = stream_temp_info_ptr->nHeight;
-      info.format = stream_temp_info_ptr->bFormatMJPG ?
-          StreamFormat::STREAM_MJPG : StreamFormat::STREAM_YUYV;
-      color_infos->push_back(info);
-    }
-    stream_temp_info_ptr++;
-    i++;
-  }
-
-  stream_temp_info_ptr = stream_depth_info_ptr_;
-  i = 0;
-  while (i < 64) {
-    if (stream_temp_info_ptr->nWidth > 0) {
-      StreamInfo info;
-      info.index = i;
-      info.width = stream_temp_info_ptr->nWidth;
-      info.height = stream_temp_info_ptr->nHeight;
-      info.format = stream_temp_info_ptr->bFormatMJPG ?
-          StreamFormat::STREAM_MJPG : StreamFormat::STREAM_YUYV;
-      depth_infos->push_back(info);
-    }
-    stream_temp_info_ptr++;
-    i++;
-  }
-
-  stream_info_dev_index_ = dev_index;
-}
-
-void CameraPrivate::GetResolutionIndex(const InitParams& params,
-    int* color_res_index,
-    int* depth_res_index) {
-  return GetResolutionIndex(
-      params.dev_index, params.stream_mode,
-      params.color_stream_format, params.depth_stream_format,
-      color_res_index, depth_res_index);
-}
-
-void CameraPrivate::GetResolutionIndex(const std::int32_t& dev_index,
-    const StreamMode& stream_mode,
-    const StreamFormat& color_stream_format,
-    const StreamFormat& depth_stream_format,
-    int *color_res_index,
-    int *depth_res_index) {
-  if (!color_res_index) {
-    LOGE("GetResolutionIndex: color_res_index is null.");
-    return;
-  }
-  if (!depth_res_index) {
-    LOGE("GetResolutionIndex: depth_res_index is null.");
-    return;
-  }
-
-  *color_res_index = -1;
-  *depth_res_index = -1;
-
-  int width = 0, height = 0;
-  if (is_enable_image_[ImageType::IMAGE_RIGHT_COLOR]) {
-    get_stream_size(stream_mode_, &width, &height);
-  } else {
-    get_stream_size(stream_mode, &width, &height);
-  }
-
-  memset(stream_color_info_ptr_, 0, sizeof(ETRONDI_STREAM_INFO)*64);
-  memset(stream_depth_info_ptr_, 0, sizeof(ETRONDI_STREAM_INFO)*64);
-
-  DEVSELINFO dev_sel_info{dev_index};
-  EtronDI_GetDeviceResolutionList(etron_di_, &dev_sel_info, 64,
-      stream_color_info_ptr_, 64, stream_depth_info_ptr_);
-
-  PETRONDI_STREAM_INFO stream_temp_info_ptr = stream_color_info_ptr_;
-  int i = 0;
-  while (i < 64) {
-    if (stream_temp_info_ptr->nWidth == width &&
-        stream_temp_info_ptr->nHeight == height &&
-        color_stream_format == (stream_temp_info_ptr->bFormatMJPG ?
-            StreamFormat::STREAM_MJPG : StreamFormat::STREAM_YUYV)) {
-      *color_res_index = i;
-      break;
-    }
-    stream_temp_info_ptr++;
-    i++;
-  }
-
-  if (*color_res_index == -1) {
-    LOGE("Error: Color Mode width[%d] height[%d] format[%s] not support. "
-        "Please check the resolution list.", width, height,
-        get_stream_format_string(color_stream_format));
-    *color_res_index = 0;
-  }
-
-  stream_temp_info_ptr = stream_depth_info_ptr_;
-  i = 0;
-  while (i < 64) {
-    if (stream_temp_info_ptr->nHeight == height &&
-        depth_stream_format == (stream_temp_info_ptr->bFormatMJPG ?
-            StreamFormat::STREAM_MJPG : StreamFormat::STREAM_YUYV)) {
-      *depth_res_index = i;
-      break;
-    }
-    stream_temp_info_ptr++;
-    i++;
-  }
-
-  if (*depth_res_index == -1) {
-    LOGE("Error: Depth Mode width[%d] height[%d] format[%s] not support. "
-        "Please check the resolution list.", width, height,
-        get_stream_format_string(depth_stream_format));
-    *depth_res_index = 0;
-  }
+  backend_->GetResolutions(dev_index, color_infos, depth_infos);
 }
 
 ErrorCode CameraPrivate::SetAutoExposureEnabled(bool enabled) {
-  bool ok;
-  if (enabled) {
-    ok = ETronDI_OK == EtronDI_EnableAE(etron_di_, &dev_sel_info_);
-  } else {
-    ok = ETronDI_OK == EtronDI_DisableAE(etron_di_, &dev_sel_info_);
-  }
-  if (ok) {
-    LOGI("-- Auto-exposure state: %s", enabled ? "enabled" : "disabled");
-  } else {
-    LOGW("-- %s auto-exposure failed", enabled ? "Enable" : "Disable");
-  }
-  return ok ? ErrorCode::SUCCESS : ErrorCode::ERROR_FAILURE;
+  return backend_->SetAutoExposureEnabled(enabled);
 }
 
 ErrorCode CameraPrivate::SetAutoWhiteBalanceEnabled(bool enabled) {
-  bool ok;
-  if (enabled) {
-    ok = ETronDI_OK == EtronDI_EnableAWB(etron_di_, &dev_sel_info_);
-  } else {
-    ok = ETronDI_OK == EtronDI_DisableAWB(etron_di_, &dev_sel_info_);
-  }
-  if (ok) {
-    LOGI("-- Auto-white balance state: %s", enabled ? "enabled" : "disabled");
-  } else {
-    LOGW("-- %s auto-white balance failed", enabled ? "Enable" : "Disable");
-  }
-  return ok ? ErrorCode::SUCCESS : ErrorCode::ERROR_FAILURE;
+  return backend_->SetAutoWhiteBalanceEnabled(enabled);
 }
 
 bool CameraPrivate::GetSensorRegister(int id, std::uint16_t address,
     std::uint16_t* value, int flag) {
-  if (!IsOpened()) return false;
-#ifdef MYNTEYE_OS_WIN
-  return ETronDI_OK == EtronDI_GetSensorRegister(etron_di_, &dev_sel_info_, id,
-      address, value, flag, 2);
-#else
-  return ETronDI_OK == EtronDI_GetSensorRegister(etron_di_, &dev_sel_info_, id,
-      address, value, flag, SENSOR_BOTH);
-#endif
+  return backend_->GetSensorRegister(id, address, value, flag);
 }
 
 bool CameraPrivate::GetHWRegister(std::uint16_t address, std::uint16_t* value,
     int flag) {
-  if (!IsOpened()) return false;
-  return ETronDI_OK == EtronDI_GetHWRegister(etron_di_, &dev_sel_info_,
-      address, value, flag);
+  return backend_->GetHWRegister(address, value, flag);
 }
 
 bool CameraPrivate::GetFWRegister(std::uint16_t address, std::uint16_t* value,
     int flag) {
-  if (!IsOpened()) return false;
-  return ETronDI_OK == EtronDI_GetFWRegister(etron_di_, &dev_sel_info_, address,
-      value, flag);
+  return backend_->GetFWRegister(address, value, flag);
 }
 
 bool CameraPrivate::SetSensorRegister(int id, std::uint16_t address,
     std::uint16_t value, int flag) {
-  if (!IsOpened()) return false;
-#ifdef MYNTEYE_OS_WIN
-  return ETronDI_OK == EtronDI_SetSensorRegister(etron_di_, &dev_sel_info_, id,
-      address, value, flag, 2);
-#else
-  return ETronDI_OK == EtronDI_SetSensorRegister(etron_di_, &dev_sel_info_, id,
-      address, value, flag, SENSOR_BOTH);
-#endif
+  return backend_->SetSensorRegister(id, address, value, flag);
 }
 
 bool CameraPrivate::SetHWRegister(std::uint16_t address, std::uint16_t value,
     int flag) {
-  if (!IsOpened()) return false;
-  return ETronDI_OK == EtronDI_SetHWRegister(etron_di_, &dev_sel_info_, address,
-      value, flag);
+  return backend_->SetHWRegister(address, value, flag);
 }
 
 bool CameraPrivate::SetFWRegister(std::uint16_t address, std::uint16_t value,
     int flag) {
-  if (!IsOpened()) return false;
-  return ETronDI_OK == EtronDI_SetFWRegister(etron_di_, &dev_sel_info_, address,
-      value, flag);
+  return backend_->SetFWRegister(address, value, flag);
 }
 
 ErrorCode CameraPrivate::Open(const InitParams& params) {
+  if (!is_enable_image_[ImageType::IMAGE_RIGHT_COLOR]) {
+    stream_mode_ = params.stream_mode;
+  }
   if (stream_mode_ == StreamMode::STREAM_2560x720 &&
       params.framerate > 30) {
     LOGI("The frame rate chosen is too large, please use a smaller frame rate.");
@@ -412,135 +233,68 @@ ErrorCode CameraPrivate::Open(const InitParams& params) {
     return ErrorCode::ERROR_FAILURE;
   }
 
-  dev_sel_info_.index = params.dev_index;
-
-  EtronDI_SetDepthDataType(etron_di_, &dev_sel_info_, depth_data_type_);
-  DBG_LOGI("SetDepthDataType: %d", depth_data_type_);
-
-  SetAutoExposureEnabled(params.state_ae);
-  SetAutoWhiteBalanceEnabled(params.state_awb);
-
   if (params.framerate > 0) framerate_ = params.framerate;
   LOGI("-- Framerate: %d", framerate_);
 
-  rate_.reset(new Rate(framerate_));
-
-#ifdef MYNTEYE_OS_LINUX
-  std::string dtc_name = "Unknown";
-  switch (params.depth_mode) {
-    case DepthMode::DEPTH_GRAY:
-      dtc_ = DEPTH_IMG_GRAY_TRANSFER;
-      dtc_name = "Gray";
-      break;
-    case DepthMode::DEPTH_COLORFUL:
-      dtc_ = DEPTH_IMG_COLORFUL_TRANSFER;
-      dtc_name = "Colorful";
-      break;
-    case DepthMode::DEPTH_RAW:
-    default:
-      dtc_ = DEPTH_IMG_NON_TRANSFER;
-      dtc_name = "Raw";
-      break;
+  // the backend opens the streams it can, as a replay those recorded
+  InitParams opened(params);
+  opened.stream_mode = stream_mode_;
+  opened.framerate = framerate_;
+  ErrorCode code = backend_->Open(&opened);
+  if (code != ErrorCode::SUCCESS) {
+    return code;
   }
-#endif
-  depth_mode_ = params.depth_mode;
+  stream_mode_ = opened.stream_mode;
+  framerate_ = opened.framerate;
+  depth_mode_ = opened.depth_mode;
+  is_lossless_ = backend_->IsLossless();
 
-  if (params.dev_index != stream_info_dev_index_) {
-    std::vector<StreamInfo> color_infos;
-    std::vector<StreamInfo> depth_infos;
-    GetResolutions(params.dev_index, &color_infos, &depth_infos);
+  // the types enabled are fixed at open, others only switched on later
+  std::uint32_t disabled = 0;
+  for (auto&& it : is_enable_image_) {
+    if (!it.second) disabled |= image_bit(it.first);
   }
+  disabled_images_ = disabled;
+
+  rate_.reset(new Rate(framerate_));
 
-  GetResolutionIndex(params, &color_res_index_, &depth_res_index_);
-  LOGI("-- Color Stream: %dx%d %s",
-      stream_color_info_ptr_[color_res_index_].nWidth,
-      stream_color_info_ptr_[color_res_index_].nHeight,
-      stream_color_info_ptr_[color_res_index_].bFormatMJPG ? "MJPG" : "YUYV");
-  LOGI("-- Depth Stream: %dx%d %s",
-      stream_depth_info_ptr_[depth_res_index_].nWidth,
-      stream_depth_info_ptr_[depth_res_index_].nHeight,
-      stream_depth_info_ptr_[depth_res_index_].bFormatMJPG ? "MJPG" : "YUYV");
+  memset(&record_device_, 0, sizeof(record_device_));
+  record_device_.framerate = framerate_;
+  record_device_.stream_mode = static_cast<std::int32_t>(stream_mode_);
+  record_device_.depth_mode = static_cast<std::int32_t>(depth_mode_);
+  record_device_.color_format =
+      static_cast<std::int32_t>(opened.color_stream_format);
+  record_device_.depth_format =
+      static_cast<std::int32_t>(opened.depth_stream_format);
+  record_device_.ir_intensity = opened.ir_intensity;
 
-  if (params.ir_intensity >= 0) {
-    if (SetFWRegister(0xE0, params.ir_intensity)) {
-      LOGI("-- IR intensity: %d", params.ir_intensity);
-    } else {
-      LOGI("-- IR intensity: %d (failed)", params.ir_intensity);
+  if (is_hid_exist_) {
+    if (!StartHidTracking()) {
+      return ErrorCode::ERROR_IMU_OPEN_FAILED;
     }
   }
-
-  ReleaseBuf();
-
-#ifdef MYNTEYE_OS_WIN
-
-  SetHWPostProcess(true);
-  // int EtronDI_OpenDeviceEx(
-  //     void* pHandleEtronDI,
-  //     PDEVSELINFO pDevSelInfo,
-  //     int colorStreamIndex,
-  //     bool toRgb,
-  //     int depthStreamIndex,
-  //     int depthStreamSwitch,
-  //     EtronDI_ImgCallbackFn callbackFn,
-  //     void* pCallbackParam,
-  //     int* pFps,
-  //     BYTE ctrlMode)
-
-  bool toRgb = false;
-  // Depth0: none
-  // Depth1: unshort
-  // Depth2: ?
-  int depthStreamSwitch = EtronDIDepthSwitch::Depth1;
-  // 0x01: color and depth frame output synchrously, for depth map module only
-  // 0x02: enable post-process, for Depth Map module only
-  // 0x04: stitch images if this bit is set, for fisheye spherical module only
-  // 0x08: use OpenCL in stitching. This bit effective only when bit-2 is set.
-  BYTE ctrlMode = 0x01;
-
-  int ret = EtronDI_OpenDeviceEx(etron_di_, &dev_sel_info_,
-      color_res_index_, toRgb,
-      depth_res_index_, depthStreamSwitch,
-      CameraPrivate::ImgCallback, this, &framerate_, ctrlMode);
-#else
-  int ret = EtronDI_OpenDevice2(etron_di_, &dev_sel_info_,
-      stream_color_info_ptr_[color_res_index_].nWidth,
-      stream_color_info_ptr_[color_res_index_].nHeight,
-      stream_color_info_ptr_[color_res_index_].bFormatMJPG,
-      stream_depth_info_ptr_[depth_res_index_].nWidth,
-      stream_depth_info_ptr_[depth_res_index_].nHeight,
-      dtc_, false, NULL, &framerate_);
-#endif
-
-  if (ETronDI_OK == ret) {
-    if (is_hid_exist_) {
-      if (!StartHidTracking()) {
-        return ErrorCode::ERROR_IMU_OPEN_FAILED;
-      }
-    }
-    StartCaptureImage();
-    StartSyntheticImage();
-    SyncCameraLogData();
-    /*
-    unsigned char pdata[100] = {};
-    int plen, nbufferSize = 9;
-    EtronDI_GetSerialNumber(etron_di_, &dev_sel_info_, pdata, nbufferSize, &plen);
-    printf ("pdata = %s, nbufferSize = %d, plen = %d\n", pdata, nbufferSize, plen);
-    */
-    return ErrorCode::SUCCESS;
-  } else {
-    dev_sel_info_.index = -1;  // reset flag
-    return ErrorCode::ERROR_CAMERA_OPEN_FAILED;
+  StartCaptureImage();
+  StartSyntheticImage();
+  SyncCameraLogData();
+  if (is_recording_) {
+    auto &&recorder = GetRecorder();
+    if (recorder) WriteRecordParams(recorder.get());
   }
+  return ErrorCode::SUCCESS;
 }
 
 bool CameraPrivate::IsOpened() const {
-  return dev_sel_info_.index != -1;
+  return backend_->IsOpened();
 }
 
 void CameraPrivate::CheckOpened() const {
   if (!IsOpened()) throw std::runtime_error("Error: Camera not opened.");
 }
 
+bool CameraPrivate::IsEnded() const {
+  return backend_->IsEnded();
+}
+
 std::vector<device::StreamData> CameraPrivate::RetrieveImage(const ImageType& type,
     ErrorCode* code) {
   if (!IsOpened()) {
@@ -571,6 +325,23 @@ std::vector<device::StreamData> CameraPrivate::RetrieveImage(const ImageType& ty
       depth_data_.clear();
       return data;
     } break;
+    case ImageType::IMAGE_DEPTH_REGISTERED: {
+      std::lock_guard<std::mutex> _(cap_depth_mtx_);
+      stream_datas_t data = registered_depth_data_;
+      registered_depth_data_.clear();
+      return data;
+    } break;
+    case ImageType::IMAGE_DEPTH_MIN_2:
+    case ImageType::IMAGE_DEPTH_MIN_4:
+    case ImageType::IMAGE_DEPTH_MIN_8:
+    case ImageType::IMAGE_DEPTH_MEDIAN_2:
+    case ImageType::IMAGE_DEPTH_MEDIAN_4:
+    case ImageType::IMAGE_DEPTH_MEDIAN_8: {
+      std::lock_guard<std::mutex> _(cap_depth_mtx_);
+      stream_datas_t data;
+      data.swap(pooled_depth_data_[type]);
+      return data;
+    } break;
     default:
       throw new std::runtime_error("RetrieveImage: ImageType is unknown");
   }
@@ -605,6 +376,26 @@ CameraPrivate::stream_data_t CameraPrivate::RetrieveLatestImage(const ImageType&
       depth_data_.clear();
       return data;
     } break;
+    case ImageType::IMAGE_DEPTH_REGISTERED: {
+      std::lock_guard<std::mutex> _(cap_depth_mtx_);
+      if (registered_depth_data_.empty()) { return {}; }
+      auto data = registered_depth_data_.back();
+      registered_depth_data_.clear();
+      return data;
+    } break;
+    case ImageType::IMAGE_DEPTH_MIN_2:
+    case ImageType::IMAGE_DEPTH_MIN_4:
+    case ImageType::IMAGE_DEPTH_MIN_8:
+    case ImageType::IMAGE_DEPTH_MEDIAN_2:
+    case ImageType::IMAGE_DEPTH_MEDIAN_4:
+    case ImageType::IMAGE_DEPTH_MEDIAN_8: {
+      std::lock_guard<std::mutex> _(cap_depth_mtx_);
+      auto&& datas = pooled_depth_data_[type];
+      if (datas.empty()) { return {}; }
+      auto data = datas.back();
+      datas.clear();
+      return data;
+    } break;
     default:
       throw new std::runtime_error("RetrieveImage: ImageType is unknown");
   }
@@ -612,8 +403,13 @@ CameraPrivate::stream_data_t CameraPrivate::RetrieveLatestImage(const ImageType&
 
 void CameraPrivate::CaptureImageColor(ErrorCode* code) {
   std::unique_lock<std::mutex> _(cap_color_mtx_);
-  auto p = RetrieveImageColor(code);
-  if (p) {
+  auto p = backend_->RetrieveImageColor(code);
+  if (p && is_recording_) {
+    auto &&recorder = GetRecorder();
+    if (recorder) recorder->WriteImage(RecordType::COLOR, *p);
+  }
+  // captured only to be recorded
+  if (p && IsColorActive()) {
     auto color = p->Clone();
     image_color_.push_back(color);
     image_color_wait_.notify_one();
@@ -622,8 +418,12 @@ void CameraPrivate::CaptureImageColor(ErrorCode* code) {
 
 void CameraPrivate::CaptureImageDepth(ErrorCode* code) {
   std::unique_lock<std::mutex> _(cap_depth_mtx_);
-  auto p = RetrieveImageDepth(code);
-  if (p) {
+  auto p = backend_->RetrieveImageDepth(code);
+  if (p && is_recording_) {
+    auto &&recorder = GetRecorder();
+    if (recorder) recorder->WriteImage(RecordType::DEPTH, *p);
+  }
+  if (p && IsDepthActive()) {
     auto depth = p->Clone();
     image_depth_.push_back(depth);
     image_depth_wait_.notify_one();
@@ -632,71 +432,121 @@ void CameraPrivate::CaptureImageDepth(ErrorCode* code) {
 
 void CameraPrivate::SyntheticImageColor() {
   std::unique_lock<std::mutex> _(cap_color_mtx_);
-  image_color_wait_.wait_for(_, std::chrono::seconds(1));
-
-  if (image_color_.empty() || img_info_.empty()) { return; }
-
-  if (image_color_.front()->frame_id() >
-      img_info_.back().img_info->frame_id) {
-    if (image_color_.size() > 5) { image_color_.clear(); }
-    img_info_.clear();
-    return;
-  } else if (image_color_.back()->frame_id() <
-      img_info_.front().img_info->frame_id) {
-    if (img_info_.size() > 5) { img_info_.clear(); }
-    image_color_.clear();
+  // not waiting for a notify missed meanwhile, e.g. of the last color
+  image_color_wait_.wait_for(_, std::chrono::seconds(1),
+      [this]() { return !image_color_.empty(); });
+
+  // the infos taken out, as the hid keeps inserting them meanwhile
+  img_info_datas_t img_info;
+  {
+    std::lock_guard<std::mutex> lock(mtx_img_info_);
+    img_info.swap(img_info_);
+  }
+  if (image_color_.empty()) {
+    std::lock_guard<std::mutex> lock(mtx_img_info_);
+    img_info_.insert(img_info_.begin(), img_info.begin(), img_info.end());
     return;
   }
 
+  // colors after all infos wait for theirs, the others without are dropped
+  std::vector<Image::pointer> waiting;
+  std::vector<bool> matched(img_info.size(), false);
   for (auto color : image_color_) {
-    for (auto info : img_info_) {
-      if (color->frame_id() == info.img_info->frame_id) {
-        TransferColor(color, info);
-        if (left_color_data_.size() > 30) { left_color_data_.clear(); }
-        if (right_color_data_.size() > 30) { right_color_data_.clear(); }
-        if (img_info_.size() > 30) { img_info_.clear(); }
+    bool found = false;
+    for (std::size_t i = 0; i < img_info.size(); i++) {
+      if (!matched[i] && color->frame_id() == img_info[i].img_info->frame_id) {
+        TransferColor(color, img_info[i]);
+        TrimQueue(&left_color_data_);
+        TrimQueue(&right_color_data_);
+        matched[i] = found = true;
+        break;
       }
     }
+    if (!found && (img_info.empty() || frame_id_before(
+        img_info.back().img_info->frame_id, color->frame_id()))) {
+      waiting.push_back(color);
+    }
   }
-  image_color_.clear();
-  img_info_.clear();
+  if (!is_lossless_ && waiting.size() > kMaxWaiting) waiting.clear();
+
+  // infos after the last color are of the colors to come
+  int last_id = image_color_.back()->frame_id();
+  image_color_.swap(waiting);
+  img_info_datas_t ahead;
+  for (std::size_t i = 0; i < img_info.size(); i++) {
+    if (!matched[i] &&
+        frame_id_before(last_id, img_info[i].img_info->frame_id)) {
+      ahead.push_back(img_info[i]);
+    }
+  }
+  if (ahead.empty()) return;
+  if (!is_lossless_ && ahead.size() > kMaxQueued) return;
+  std::lock_guard<std::mutex> lock(mtx_img_info_);
+  img_info_.insert(img_info_.begin(), ahead.begin(), ahead.end());
 }
 
 void CameraPrivate::OldSyntheticImageColor() {
   std::unique_lock<std::mutex> _(cap_color_mtx_);
-  image_color_wait_.wait_for(_, std::chrono::seconds(1));
+  image_color_wait_.wait_for(_, std::chrono::seconds(1),
+      [this]() { return !image_color_.empty(); });
   if (image_color_.empty()) { return; }
 
   for (auto color : image_color_) {
     OldTransferColor(color);
-    if (left_color_data_.size() > 30) { left_color_data_.clear(); }
-    if (right_color_data_.size() > 30) { right_color_data_.clear(); }
+    TrimQueue(&left_color_data_);
+    TrimQueue(&right_color_data_);
   }
   image_color_.clear();
 }
 
 void CameraPrivate::TransferColor(Image::pointer color, img_info_data_t info) {
+  // right enabled at open streams left and right side by side
+  bool left = IsImageActive(ImageType::IMAGE_LEFT_COLOR) ||
+      IsImageActive(ImageType::IMAGE_DEPTH_REGISTERED);
   if (!is_enable_image_[ImageType::IMAGE_RIGHT_COLOR]) {
+    if (!left) return;
     stream_data_t data;
     data.img_info = std::make_shared<ImgInfo>();
     *data.img_info = *info.img_info;
-    data.img = color->Clone();
-    left_color_data_.push_back(data);
+    data.img = RectifyColor(ImageType::IMAGE_LEFT_COLOR, color);
+    if (!data.img) data.img = color->Clone();
+    if (IsImageActive(ImageType::IMAGE_LEFT_COLOR) &&
+        !DeferToCallback(ImageType::IMAGE_LEFT_COLOR, data)) {
+      left_color_data_.push_back(data);
+    }
+    if (IsImageActive(ImageType::IMAGE_DEPTH_REGISTERED)) {
+      register_datas_.push_back(data);
+    }
   } else {
-    CutPart(ImageType::IMAGE_LEFT_COLOR, color, info);
-    CutPart(ImageType::IMAGE_RIGHT_COLOR, color, info);
+    bool right = IsImageActive(ImageType::IMAGE_RIGHT_COLOR);
+    if (left && right && color->format() == ImageFormat::COLOR_MJPG) {
+      // decode once for both halves
+      color = color->To(ImageFormat::COLOR_RGB);
+      if (!color) return;
+    }
+    if (left) CutPart(ImageType::IMAGE_LEFT_COLOR, color, info);
+    if (right) CutPart(ImageType::IMAGE_RIGHT_COLOR, color, info);
   }
 }
 
 void CameraPrivate::OldTransferColor(Image::pointer color) {
+  bool left = IsImageActive(ImageType::IMAGE_LEFT_COLOR);
   if (!is_enable_image_[ImageType::IMAGE_RIGHT_COLOR]) {
+    if (!left) return;
     stream_data_t data;
     data.img_info = nullptr;
     data.img = color->Clone();
-    left_color_data_.push_back(data);
+    if (!DeferToCallback(ImageType::IMAGE_LEFT_COLOR, data)) {
+      left_color_data_.push_back(data);
+    }
   } else {
-    OldCutPart(ImageType::IMAGE_LEFT_COLOR, color);
-    OldCutPart(ImageType::IMAGE_RIGHT_COLOR, color);
+    bool right = IsImageActive(ImageType::IMAGE_RIGHT_COLOR);
+    if (left && right && color->format() == ImageFormat::COLOR_MJPG) {
+      color = color->To(ImageFormat::COLOR_RGB);
+      if (!color) return;
+    }
+    if (left) OldCutPart(ImageType::IMAGE_LEFT_COLOR, color);
+    if (right) OldCutPart(ImageType::IMAGE_RIGHT_COLOR, color);
   }
 }
 
@@ -707,9 +557,21 @@ void CameraPrivate::CutPart(ImageType type,
   *data.img_info = *info.img_info;
   if (type == ImageType::IMAGE_LEFT_COLOR) {
     data.img = color->CutPart(ImageType::IMAGE_LEFT_COLOR);
-    left_color_data_.push_back(data);
   } else if (type == ImageType::IMAGE_RIGHT_COLOR) {
     data.img = color->CutPart(ImageType::IMAGE_RIGHT_COLOR);
+  } else {
+    return;
+  }
+  auto rectified = RectifyColor(type, data.img);
+  if (rectified) data.img = rectified;
+  if (type == ImageType::IMAGE_LEFT_COLOR) {
+    if (IsImageActive(type) && !DeferToCallback(type, data)) {
+      left_color_data_.push_back(data);
+    }
+    if (IsImageActive(ImageType::IMAGE_DEPTH_REGISTERED)) {
+      register_datas_.push_back(data);
+    }
+  } else if (!DeferToCallback(type, data)) {
     right_color_data_.push_back(data);
   }
 }
@@ -719,24 +581,244 @@ void CameraPrivate::OldCutPart(ImageType type, Image::pointer color) {
   data.img_info = nullptr;
   if (type == ImageType::IMAGE_LEFT_COLOR) {
     data.img = color->CutPart(ImageType::IMAGE_LEFT_COLOR);
-    left_color_data_.push_back(data);
+    if (!DeferToCallback(type, data)) left_color_data_.push_back(data);
   } else if (type == ImageType::IMAGE_RIGHT_COLOR) {
     data.img = color->CutPart(ImageType::IMAGE_RIGHT_COLOR);
-    right_color_data_.push_back(data);
+    if (!DeferToCallback(type, data)) right_color_data_.push_back(data);
   }
 }
 
 void CameraPrivate::SyntheticImageDepth() {
-  std::unique_lock<std::mutex> _(cap_depth_mtx_);
-  image_depth_wait_.wait_for(_, std::chrono::seconds(1));
-  for (auto depth : image_depth_) {
-    stream_data_t data;
+  std::vector<Image::pointer> depths;
+  {
+    std::unique_lock<std::mutex> _(cap_depth_mtx_);
+    image_depth_wait_.wait_for(_, std::chrono::seconds(1),
+        [this]() { return !image_depth_.empty(); });
+    depths.swap(image_depth_);
+  }
+  if (depths.empty()) { return; }
+  // filter outside the lock, capture goes on meanwhile. the images are
+  // cloned when captured, so they are filtered in place.
+  auto filter = GetDepthFilter();
+  if (filter) {
+    for (auto&& depth : depths) {
+      if (depth->format() == ImageFormat::DEPTH_RAW) filter->Process(depth);
+    }
+  }
+  for (auto&& depth : depths) {
+    PoolDepth(depth);
+    ProjectLaserScan(depth);
+  }
+  if (IsImageActive(ImageType::IMAGE_DEPTH_REGISTERED)) {
+    for (auto&& depth : depths) {
+      if (depth->format() != ImageFormat::DEPTH_RAW) continue;
+      recent_depths_.push_back(depth);
+      if (recent_depths_.size() > kMaxRecentDepths) recent_depths_.pop_front();
+    }
+  }
+  if (!IsImageActive(ImageType::IMAGE_DEPTH)) return;
+  bool is_depth_stats;
+  {
+    std::lock_guard<std::mutex> _(mtx_depth_stages_);
+    is_depth_stats = is_depth_stats_;
+  }
+  stream_datas_t datas(depths.size());
+  for (std::size_t i = 0; i < depths.size(); i++) {
+    auto&& data = datas[i];
     data.img_info = nullptr;
-    data.img = depth->Clone();
+    data.img = depths[i];
+    if (is_depth_stats && depths[i]->format() == ImageFormat::DEPTH_RAW) {
+      data.depth_stats = std::make_shared<DepthStats>();
+      DepthStats::Compute(depths[i], data.depth_stats.get());
+    }
+  }
+  std::lock_guard<std::mutex> _(cap_depth_mtx_);
+  for (auto&& data : datas) {
+    if (DeferToCallback(ImageType::IMAGE_DEPTH, data)) continue;
     depth_data_.push_back(data);
-    if (depth_data_.size() > 30) { depth_data_.clear(); }
+    TrimQueue(&depth_data_);
+  }
+}
+
+void CameraPrivate::PoolDepth(const Image::pointer& depth) {
+  if (depth->format() != ImageFormat::DEPTH_RAW) return;
+  // levels of each pooling up to the finest enabled
+  int levels[2] = {0, 0};
+  for (auto&& it : is_enable_image_) {
+    DepthPooling pooling;
+    int level;
+    if (IsImageActive(it.first) &&
+        get_pooled_level(it.first, &pooling, &level)) {
+      int& n = levels[pooling == DepthPooling::MIN ? 0 : 1];
+      n = std::max(n, level);
+    }
+  }
+  for (int i = 0; i < 2; i++) {
+    if (levels[i] == 0) continue;
+    // kept across frames, its levels are reused once retrieved
+    auto&& pyramid = depth_pyramids_[i];
+    if (!pyramid || pyramid->levels() != levels[i]) {
+      pyramid = std::make_shared<DepthPyramid>(
+          i == 0 ? DepthPooling::MIN : DepthPooling::MEDIAN, levels[i]);
+    }
+    if (!pyramid->Build(depth)) continue;
+    std::lock_guard<std::mutex> _(cap_depth_mtx_);
+    for (auto&& it : is_enable_image_) {
+      DepthPooling pooling;
+      int level;
+      if (!IsImageActive(it.first) ||
+          !get_pooled_level(it.first, &pooling, &level) ||
+          pooling != pyramid->pooling()) {
+        continue;
+      }
+      stream_data_t data;
+      data.img_info = nullptr;
+      data.img = pyramid->GetLevel(level);
+      if (DeferToCallback(it.first, data)) continue;
+      auto&& datas = pooled_depth_data_[it.first];
+      datas.push_back(data);
+      TrimQueue(&datas);
+    }
+  }
+}
+
+void CameraPrivate::RegisterDepths() {
+  if (!IsImageActive(ImageType::IMAGE_DEPTH_REGISTERED)) {
+    register_datas_.clear();
+    recent_depths_.clear();
+    return;
+  }
+  // out of the capture lock, colors are captured meanwhile. a color waits
+  // for the depth of its frame id, dropped once a later depth came without.
+  while (!register_datas_.empty()) {
+    auto&& color = register_datas_.front();
+    if (!color.img) {
+      register_datas_.pop_front();
+      continue;
+    }
+    int frame_id = color.img->frame_id();
+    Image::pointer depth;
+    for (auto&& d : recent_depths_) {
+      if (d->frame_id() == frame_id) depth = d;
+    }
+    if (depth) {
+      RegisterDepth(color, depth);
+    } else if (recent_depths_.empty() ||
+        !frame_id_before(frame_id, recent_depths_.back()->frame_id())) {
+      break;
+    }
+    register_datas_.pop_front();
+  }
+  while (register_datas_.size() > kMaxQueued) register_datas_.pop_front();
+}
+
+void CameraPrivate::RegisterDepth(const stream_data_t& color,
+    const Image::pointer& depth) {
+  // the target is rectified if the device or the host rectifies color
+  bool rectified = image_mode_ == ImageMode::IMAGE_RECTIFIED ||
+      GetRectifier() != nullptr;
+  auto&& reg = depth_registration_;
+  if (!reg || reg->rectified() != rectified ||
+      reg->width() != color.img->width() ||
+      reg->height() != color.img->height() ||
+      reg->GetCalibration().width() != depth->width() ||
+      reg->GetCalibration().height() != depth->height()) {
+    auto calib = GetStereoCalibration();
+    if (!calib.IsValid() || calib.width() != depth->width() ||
+        calib.height() != depth->height()) {
+      return;
+    }
+    reg = std::make_shared<DepthRegistration>(calib,
+        ImageType::IMAGE_LEFT_COLOR, rectified, color.img->width(),
+        color.img->height());
+  }
+  stream_data_t data;
+  data.img_info = color.img_info;
+  data.img = reg->Register(depth, color.img);
+  if (!data.img) return;
+  if (DeferToCallback(ImageType::IMAGE_DEPTH_REGISTERED, data)) return;
+  std::lock_guard<std::mutex> _(cap_depth_mtx_);
+  registered_depth_data_.push_back(data);
+  TrimQueue(&registered_depth_data_);
+}
+
+void CameraPrivate::ProjectLaserScan(const Image::pointer& depth) {
+  std::shared_ptr<LaserScanProjector> projector;
+  {
+    std::lock_guard<std::mutex> _(mtx_depth_stages_);
+    projector = laser_scan_;
+  }
+  if (!projector || depth->format() != ImageFormat::DEPTH_RAW) return;
+  LaserScan scan;
+  if (!projector->Project(depth, &scan)) return;
+  std::lock_guard<std::mutex> _(cap_depth_mtx_);
+  laser_scans_.push_back(std::move(scan));
+  if (laser_scans_.size() > 30) { laser_scans_.clear(); }
+}
+
+void CameraPrivate::SetLaserScan(
+    const std::shared_ptr<LaserScanProjector>& projector) {
+  std::lock_guard<std::mutex> _(mtx_depth_stages_);
+  laser_scan_ = projector;
+}
+
+std::vector<LaserScan> CameraPrivate::RetrieveLaserScans() {
+  std::lock_guard<std::mutex> _(cap_depth_mtx_);
+  std::vector<LaserScan> scans;
+  scans.swap(laser_scans_);
+  return scans;
+}
+
+void CameraPrivate::EnableDepthStats(bool enabled) {
+  std::lock_guard<std::mutex> _(mtx_depth_stages_);
+  is_depth_stats_ = enabled;
+}
+
+void CameraPrivate::SetRecorder(const std::shared_ptr<Recorder>& recorder) {
+  if (recorder && !recorder->IsOpened()) {
+    LOGE("Error: CameraPrivate:: the recorder must be opened");
+    return;
+  }
+  if (recorder && IsOpened()) {
+    WriteRecordParams(recorder.get());
+  }
+  std::lock_guard<std::mutex> _(mtx_recorder_);
+  recorder_ = recorder;
+  is_recording_ = recorder != nullptr;
+}
+
+bool CameraPrivate::IsRecording() {
+  return is_recording_;
+}
+
+std::shared_ptr<Recorder> CameraPrivate::GetRecorder() {
+  std::lock_guard<std::mutex> _(mtx_recorder_);
+  return recorder_;
+}
+
+void CameraPrivate::WriteRecordParams(Recorder* recorder) {
+  recorder->WriteDevice(record_device_);
+  for (std::size_t i = 0; i < camera_log_datas_.size(); i++) {
+    recorder->WriteCalibration(i, camera_log_datas_[i]);
   }
-  image_depth_.clear();
+  if (motion_intrinsics_ && motion_from_extrinsics_) {
+    RecordMotion motion;
+    motion.accel = motion_intrinsics_->accel;
+    motion.gyro = motion_intrinsics_->gyro;
+    motion.left_to_imu = *motion_from_extrinsics_;
+    recorder->WriteMotion(motion);
+  }
+}
+
+void CameraPrivate::SetDepthFilter(
+    const std::shared_ptr<DepthFilterChain>& filter) {
+  std::lock_guard<std::mutex> _(mtx_depth_stages_);
+  depth_filter_ = filter;
+}
+
+std::shared_ptr<DepthFilterChain> CameraPrivate::GetDepthFilter() {
+  std::lock_guard<std::mutex> _(mtx_depth_stages_);
+  return depth_filter_;
 }
 
 void CameraPrivate::StartCaptureImage() {
@@ -744,15 +826,25 @@ void CameraPrivate::StartCaptureImage() {
   cap_image_thread_ = std::thread([this]() {
     ErrorCode code = ErrorCode::SUCCESS;
     while (is_capture_image_) {
-      if (is_enable_image_[ImageType::IMAGE_LEFT_COLOR] ||
-          is_enable_image_[ImageType::IMAGE_RIGHT_COLOR]) {
+      // a lossless backend waits for the queues retrieved, not dropped
+      if (is_lossless_ && IsQueueFull()) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        continue;
+      }
+      // streams are captured to be recorded, even if all types disabled,
+      // and all of a lossless backend, never left waiting for a retrieve
+      bool recording = is_recording_ || is_lossless_;
+      bool color = recording || IsColorActive();
+      bool depth = recording || IsDepthActive();
+      if (color) {
         CaptureImageColor(&code);
       }
-      if (is_enable_image_[ImageType::IMAGE_DEPTH]) {
+      if (depth) {
         CaptureImageDepth(&code);
       }
+      // idle while all types are disabled, until one is enabled again
       std::this_thread::sleep_for(
-          std::chrono::milliseconds(1));
+          std::chrono::milliseconds(color || depth ? 1 : kIdleSleepMs));
     }
   });
 }
@@ -768,19 +860,23 @@ void CameraPrivate::StartSyntheticImage() {
   is_synthetic_image_ = true;
   sync_thread_ = std::thread([this]() {
     while (is_capture_image_) {
-      if (is_enable_image_[ImageType::IMAGE_LEFT_COLOR] ||
-          is_enable_image_[ImageType::IMAGE_RIGHT_COLOR]) {
+      bool color = IsColorActive(), depth = IsDepthActive();
+      if (color) {
         if (is_hid_exist_) {
           SyntheticImageColor();
         } else {
           OldSyntheticImageColor();
         }
+        DispatchStreamCallbacks();
       }
-      if (is_enable_image_[ImageType::IMAGE_DEPTH]) {
+      if (depth) {
         SyntheticImageDepth();
+        // colors of this and the last rounds paired with their depths
+        if (color) RegisterDepths();
+        DispatchStreamCallbacks();
       }
       std::this_thread::sleep_for(
-          std::chrono::milliseconds(1));
+          std::chrono::milliseconds(color || depth ? 1 : kIdleSleepMs));
     }
   });
 }
@@ -792,39 +888,28 @@ void CameraPrivate::StopSyntheticImage() {
 
 void CameraPrivate::Wait() {
   if (rate_) {
-    OnPreWait();
     rate_->Sleep();
-    OnPostWait();
   }
 }
 
 void CameraPrivate::Close() {
-  if (dev_sel_info_.index != -1) {
+  if (IsOpened()) {
     StopCaptureImage();
     StopSyntheticImage();
-    channels_->StopHidTracking();
-    EtronDI_CloseDevice(etron_di_, &dev_sel_info_);
-    dev_sel_info_.index = -1;
-  }
-  ReleaseBuf();
-  EtronDI_Release(&etron_di_);
-}
-
-void CameraPrivate::ReleaseBuf() {
-  color_image_buf_ = nullptr;
-  depth_image_buf_ = nullptr;
-  if (!depth_buf_) {
-    delete depth_buf_;
-    depth_buf_ = nullptr;
+    depth_registration_ = nullptr;
+    register_datas_.clear();
+    recent_depths_.clear();
+    depth_pyramids_[0] = depth_pyramids_[1] = nullptr;
+    backend_->StopHidTracking();
   }
+  backend_->Close();
 }
 
 bool CameraPrivate::StartHidTracking() {
-  channels_->SetImuCallback(std::bind(&CameraPrivate::ImuDataCallback,
-        this, std::placeholders::_1));
-  channels_->SetImgInfoCallback(std::bind(&CameraPrivate::ImageInfoCallback,
-        this, std::placeholders::_1));
-  if (!channels_->StartHidTracking()) {
+  if (!backend_->StartHidTracking(
+        std::bind(&CameraPrivate::ImuDataCallback, this, std::placeholders::_1),
+        std::bind(&CameraPrivate::ImageInfoCallback, this,
+            std::placeholders::_1))) {
     return false;
   }
 
@@ -833,6 +918,22 @@ bool CameraPrivate::StartHidTracking() {
 }
 
 void CameraPrivate::ImuDataCallback(const ImuPacket &packet) {
+  if (is_recording_ && !packet.segments.empty()) {
+    auto &&recorder = GetRecorder();
+    if (recorder) {
+      std::vector<RecordImuSegment> segments(packet.segments.size());
+      for (std::size_t i = 0; i < segments.size(); i++) {
+        auto &&seg = packet.segments[i];
+        auto &&s = segments[i];
+        memset(&s, 0, sizeof(s));
+        s.flag = seg.flag;
+        s.temperature = seg.temperature;
+        s.timestamp = seg.timestamp;
+        std::copy(seg.accel_or_gyro, seg.accel_or_gyro + 3, s.accel_or_gyro);
+      }
+      recorder->WriteImu(segments.data(), segments.size());
+    }
+  }
   for (auto &&seg : packet.segments) {
     auto &&imu = std::make_shared<ImuData>();
     imu->flag = seg.flag;
@@ -868,6 +969,16 @@ void CameraPrivate::ImuDataCallback(const ImuPacket &packet) {
 
     ++motion_count_;
     if (motion_count_ > 20) {
+      motion_callback_t callback;
+      {
+        std::lock_guard<std::mutex> _(mtx_callbacks_);
+        callback = motion_callback_;
+      }
+      if (callback) {
+        // as it arrives, instead of queued for GetImuDatas()
+        callback({imu});
+        continue;
+      }
       motion_data_t tmp = {imu};
       cache_imu_data_.push_back(tmp);
       std::lock_guard<std::mutex> _(mtx_imu_);
@@ -879,6 +990,17 @@ void CameraPrivate::ImuDataCallback(const ImuPacket &packet) {
 }
 
 void CameraPrivate::ImageInfoCallback(const ImgInfoPacket &packet) {
+  if (is_recording_) {
+    auto &&recorder = GetRecorder();
+    if (recorder) {
+      RecordImgInfo info;
+      info.frame_id = packet.frame_id;
+      info.exposure_time = packet.exposure_time;
+      info.timestamp = packet.timestamp;
+      recorder->WriteImgInfo(info);
+    }
+  }
+
   auto &&img_info = std::make_shared<ImgInfo>();
 
   img_info->frame_id = packet.frame_id;
@@ -915,61 +1037,84 @@ void CameraPrivate::SyncCameraLogData() {
   camera_log_datas_.clear();
   for (int index = 0; index < 2 ; index++) {
     struct CameraCtrlRectLogData camera_log_data;
-    eSPCtrl_RectLogData eSPRectLogData;
-    EtronDI_GetRectifyMatLogData(etron_di_,
-      &dev_sel_info_, &eSPRectLogData, index);
-    int i;
-    camera_log_data.InImgWidth = eSPRectLogData.InImgWidth;
-    camera_log_data.InImgHeight = eSPRectLogData.InImgHeight;
-    camera_log_data.OutImgWidth = eSPRectLogData.OutImgWidth;
-    camera_log_data.OutImgHeight = eSPRectLogData.OutImgHeight;
-    camera_log_data.RECT_ScaleWidth = eSPRectLogData.RECT_ScaleWidth;
-    camera_log_data.RECT_ScaleHeight = eSPRectLogData.RECT_ScaleHeight;
-    for (i=0; i < 9; i++) {
-      camera_log_data.CamMat1[i] = eSPRectLogData.CamMat1[i];
-    }
-    for (i=0; i < 8; i++) {
-        camera_log_data.CamDist1[i] = eSPRectLogData.CamDist1[i];
-    }
-    for (i=0; i < 9; i++) {
-        camera_log_data.CamMat2[i] = eSPRectLogData.CamMat2[i];
-    }
-    for (i=0; i < 8; i++) {
-        camera_log_data.CamDist2[i] = eSPRectLogData.CamDist2[i];
-    }
-    for (i=0; i < 9; i++) {
-        camera_log_data.RotaMat[i] = eSPRectLogData.RotaMat[i];
-    }
-    for (i=0; i < 3; i++) {
-        camera_log_data.TranMat[i] = eSPRectLogData.TranMat[i];
-    }
-    for (i=0; i < 9; i++) {
-        camera_log_data.LRotaMat[i] = eSPRectLogData.LRotaMat[i];
+    memset(&camera_log_data, 0, sizeof(camera_log_data));
+    if (!backend_->GetRectifyLogData(index, &camera_log_data)) {
+      DBG_LOGI("GetRectifyLogData %d failed", index);
     }
-    for (i=0; i < 9; i++) {
-        camera_log_data.RRotaMat[i] = eSPRectLogData.RRotaMat[i];
-    }
-    for (i=0; i < 12; i++) {
-        camera_log_data.NewCamMat1[i] = eSPRectLogData.NewCamMat1[i];
-    }
-    for (i=0; i < 12; i++) {
-        camera_log_data.NewCamMat2[i] = eSPRectLogData.NewCamMat2[i];
+    camera_log_datas_.push_back(camera_log_data);
+  }
+
+  // depth is aligned to the left eye, of the single eye size
+  int width = 0, height = 0;
+  get_stream_size(stream_mode_, &width, &height);
+  if (stream_mode_ == StreamMode::STREAM_2560x720 ||
+      stream_mode_ == StreamMode::STREAM_1280x480) {
+    width /= 2;
+  }
+  int index = (height == 720) ? 0 : 1;  // HD or VGA
+  {
+    std::lock_guard<std::mutex> _(mtx_calibration_);
+    stereo_calibration_ = StereoCalibration(
+        camera_log_datas_[index], width, height);
+  }
+  UpdateRectifier();
+}
+
+StereoCalibration CameraPrivate::GetStereoCalibration() {
+  std::lock_guard<std::mutex> _(mtx_calibration_);
+  return stereo_calibration_;
+}
+
+void CameraPrivate::EnableHostRectification(bool enabled) {
+  is_host_rectification_ = enabled;
+  if (IsOpened()) UpdateRectifier();
+}
+
+std::shared_ptr<Rectifier> CameraPrivate::GetRectifier() {
+  std::lock_guard<std::mutex> _(mtx_calibration_);
+  return rectifier_;
+}
+
+void CameraPrivate::SetCacheDirectory(const std::string& dir) {
+  cache_dir_ = dir;
+}
+
+void CameraPrivate::UpdateRectifier() {
+  // build outside the lock, the sync thread keeps the last one meanwhile
+  std::shared_ptr<Rectifier> rectifier;
+  // the device rectifies already, not to be rectified twice
+  bool host = is_host_rectification_;
+  if (host && image_mode_ == ImageMode::IMAGE_RECTIFIED) {
+    LOGW("Host rectification is skipped, the image mode is rectified");
+    host = false;
+  }
+  if (host) {
+    auto calib = GetStereoCalibration();
+    std::string path;
+    if (!cache_dir_.empty() && calib.IsValid()) {
+      std::string serial = device_params_ ?
+          device_params_->serial_number : "unknown";
+      path = rectify_cache::file_path(cache_dir_, serial, stream_mode_, calib);
+      rectifier = rectify_cache::load(path, calib);
     }
-    camera_log_data.RECT_Crop_Row_BG = eSPRectLogData.RECT_Crop_Row_BG;
-    camera_log_data.RECT_Crop_Row_ED = eSPRectLogData.RECT_Crop_Row_ED;
-    camera_log_data.RECT_Crop_Col_BG_L = eSPRectLogData.RECT_Crop_Col_BG_L;
-    camera_log_data.RECT_Crop_Col_ED_L = eSPRectLogData.RECT_Crop_Col_ED_L;
-    camera_log_data.RECT_Scale_Col_M = eSPRectLogData.RECT_Scale_Col_M;
-    camera_log_data.RECT_Scale_Col_N = eSPRectLogData.RECT_Scale_Col_N;
-    camera_log_data.RECT_Scale_Row_M = eSPRectLogData.RECT_Scale_Row_M;
-    camera_log_data.RECT_Scale_Row_N = eSPRectLogData.RECT_Scale_Row_N;
-    camera_log_data.RECT_AvgErr = eSPRectLogData.RECT_AvgErr;
-    camera_log_data.nLineBuffers = eSPRectLogData.nLineBuffers;
-    for (i = 0; i < 16; i++) {
-      camera_log_data.ReProjectMat[i] = eSPRectLogData.ReProjectMat[i];
+    if (!rectifier) {
+      rectifier = std::make_shared<Rectifier>(calib);
+      if (!rectifier->IsValid()) {
+        rectifier = nullptr;
+      } else if (!path.empty() && files::mkdir(cache_dir_)) {
+        rectify_cache::save(path, *rectifier);
+      }
     }
-    camera_log_datas_.push_back(camera_log_data);
   }
+  std::lock_guard<std::mutex> _(mtx_calibration_);
+  rectifier_ = rectifier;
+}
+
+Image::pointer CameraPrivate::RectifyColor(const ImageType& type,
+    const Image::pointer& color) {
+  auto rectifier = GetRectifier();
+  if (!rectifier) return nullptr;
+  return rectifier->Rectify(type, color);
 }
 
 struct CameraCtrlRectLogData  CameraPrivate::GetCameraCtrlData(int index) {
@@ -977,15 +1122,11 @@ struct CameraCtrlRectLogData  CameraPrivate::GetCameraCtrlData(int index) {
 }
 
 void CameraPrivate::GetCameraLogData(int index) {
-  int nRet;
-
   // for parse log test
-  eSPCtrl_RectLogData eSPRectLogData;
-  // EtronDI_GetRectifyLogData in puma
-  // EtronDI_GetRectifyMatLogData
-  nRet = EtronDI_GetRectifyMatLogData(etron_di_,
-    &dev_sel_info_, &eSPRectLogData, index);
-  printf("nRet = %d", nRet);
+  struct CameraCtrlRectLogData eSPRectLogData;
+  memset(&eSPRectLogData, 0, sizeof(eSPRectLogData));
+  bool ok = backend_->GetRectifyLogData(index, &eSPRectLogData);
+  printf("nRet = %d", ok ? 0 : -1);
 
   FILE *pfile;
   char buf[128];
@@ -1103,10 +1244,8 @@ void CameraPrivate::SetCameraLogData(const std::string& file) {
   t.read(buffer, length);
   t.close();
 
-  int nActualLength = 0;
-
-  if ( ETronDI_OK != EtronDI_SetLogData( etron_di_, &dev_sel_info_,
-    (unsigned char*)buffer, length, &nActualLength, 0)) {
+  if (!backend_->SetRectifyLogData(
+      reinterpret_cast<const std::uint8_t*>(buffer), length)) {
     printf("error when setLogData\n");
   }
   delete[] buffer;
@@ -1123,17 +1262,23 @@ struct CameraCtrlRectLogData CameraPrivate::GetVGACameraCtrlData() {
 void CameraPrivate::SetImageMode(const ImageMode& mode) {
   switch (mode) {
     case ImageMode::IMAGE_RAW:
-      depth_data_type_ = 9; // ETronDI_DEPTH_DATA_11_BITS_RAW
+      backend_->SetDepthDataType(9);  // ETronDI_DEPTH_DATA_11_BITS_RAW
       break;
     case ImageMode::IMAGE_RECTIFIED:
-      depth_data_type_ = 4; // ETronDI_DEPTH_DATA_11_BITS
+      backend_->SetDepthDataType(4);  // ETronDI_DEPTH_DATA_11_BITS
       break;
     default:
       throw new std::runtime_error("ImageMode is unknown");
   }
+  image_mode_ = mode;
+  if (IsOpened()) UpdateRectifier();
 }
 
 void CameraPrivate::EnableImageType(const ImageType& type) {
+  if (IsOpened()) {
+    EnableOpenedImageType(type);
+    return;
+  }
   switch (type) {
     case ImageType::IMAGE_LEFT_COLOR:
       is_enable_image_[type] = true;
@@ -1145,6 +1290,20 @@ void CameraPrivate::EnableImageType(const ImageType& type) {
     case ImageType::IMAGE_DEPTH:
       is_enable_image_[type] = true;
       break;
+    case ImageType::IMAGE_DEPTH_REGISTERED:
+      EnableImageType(ImageType::IMAGE_LEFT_COLOR);
+      EnableImageType(ImageType::IMAGE_DEPTH);
+      is_enable_image_[type] = true;
+      break;
+    case ImageType::IMAGE_DEPTH_MIN_2:
+    case ImageType::IMAGE_DEPTH_MIN_4:
+    case ImageType::IMAGE_DEPTH_MIN_8:
+    case ImageType::IMAGE_DEPTH_MEDIAN_2:
+    case ImageType::IMAGE_DEPTH_MEDIAN_4:
+    case ImageType::IMAGE_DEPTH_MEDIAN_8:
+      EnableImageType(ImageType::IMAGE_DEPTH);
+      is_enable_image_[type] = true;
+      break;
     case ImageType::ALL:
       EnableImageType(ImageType::IMAGE_LEFT_COLOR);
       EnableImageType(ImageType::IMAGE_RIGHT_COLOR);
@@ -1155,11 +1314,157 @@ void CameraPrivate::EnableImageType(const ImageType& type) {
   }
 }
 
+void CameraPrivate::EnableOpenedImageType(const ImageType& type) {
+  // the threads read is_enable_image_, only the atomic bits change now
+  switch (type) {
+    case ImageType::IMAGE_RIGHT_COLOR:
+      if (!is_enable_image_[type]) {
+        LOGE("EnableImageType:: Right color must be enabled before open.");
+        return;
+      }
+      break;
+    case ImageType::IMAGE_DEPTH_REGISTERED:
+      EnableOpenedImageType(ImageType::IMAGE_LEFT_COLOR);
+      EnableOpenedImageType(ImageType::IMAGE_DEPTH);
+      break;
+    case ImageType::IMAGE_DEPTH_MIN_2:
+    case ImageType::IMAGE_DEPTH_MIN_4:
+    case ImageType::IMAGE_DEPTH_MIN_8:
+    case ImageType::IMAGE_DEPTH_MEDIAN_2:
+    case ImageType::IMAGE_DEPTH_MEDIAN_4:
+    case ImageType::IMAGE_DEPTH_MEDIAN_8:
+      EnableOpenedImageType(ImageType::IMAGE_DEPTH);
+      break;
+    case ImageType::ALL:
+      EnableOpenedImageType(ImageType::IMAGE_LEFT_COLOR);
+      if (is_enable_image_[ImageType::IMAGE_RIGHT_COLOR]) {
+        EnableOpenedImageType(ImageType::IMAGE_RIGHT_COLOR);
+      }
+      EnableOpenedImageType(ImageType::IMAGE_DEPTH);
+      return;
+    default:
+      if (is_enable_image_.find(type) == is_enable_image_.end()) {
+        LOGE("EnableImageType:: ImageType is unknown.");
+        return;
+      }
+  }
+  disabled_images_ &= ~image_bit(type);
+}
+
+void CameraPrivate::DisableImageType(const ImageType& type) {
+  if (type == ImageType::ALL) {
+    for (auto&& it : is_enable_image_) {
+      DisableImageType(it.first);
+    }
+    return;
+  }
+  if (is_enable_image_.find(type) == is_enable_image_.end()) {
+    LOGE("DisableImageType:: ImageType is unknown.");
+    return;
+  }
+  if (IsOpened()) {
+    // the streams of the device are kept, frames are dropped
+    disabled_images_ |= image_bit(type);
+  } else {
+    is_enable_image_[type] = false;
+  }
+}
+
+bool CameraPrivate::IsImageActive(const ImageType& type) {
+  std::uint32_t disabled = disabled_images_;
+  if (disabled & image_bit(type)) return false;
+  switch (type) {
+    case ImageType::IMAGE_LEFT_COLOR:
+    case ImageType::IMAGE_RIGHT_COLOR:
+    case ImageType::IMAGE_DEPTH:
+      return true;
+    default:
+      // the other types are made of depth, and stop with it
+      return !(disabled & image_bit(ImageType::IMAGE_DEPTH));
+  }
+}
+
+bool CameraPrivate::IsColorActive() {
+  return IsImageActive(ImageType::IMAGE_LEFT_COLOR) ||
+      IsImageActive(ImageType::IMAGE_RIGHT_COLOR) ||
+      IsImageActive(ImageType::IMAGE_DEPTH_REGISTERED);
+}
+
+bool CameraPrivate::IsDepthActive() {
+  // any active type made of depth has it active too
+  return IsImageActive(ImageType::IMAGE_DEPTH);
+}
+
+void CameraPrivate::SetStreamCallback(const ImageType& type,
+    stream_callback_t callback) {
+  std::lock_guard<std::mutex> _(mtx_callbacks_);
+  if (callback) {
+    stream_callbacks_[type] = callback;
+  } else {
+    stream_callbacks_.erase(type);
+  }
+}
+
+void CameraPrivate::SetMotionCallback(motion_callback_t callback) {
+  std::lock_guard<std::mutex> _(mtx_callbacks_);
+  motion_callback_ = callback;
+}
+
+bool CameraPrivate::DeferToCallback(const ImageType& type,
+    const stream_data_t& data) {
+  {
+    std::lock_guard<std::mutex> _(mtx_callbacks_);
+    if (stream_callbacks_.find(type) == stream_callbacks_.end()) return false;
+  }
+  callback_datas_.push_back({type, data});
+  return true;
+}
+
+void CameraPrivate::TrimQueue(stream_datas_t* datas) {
+  if (!is_lossless_ && datas->size() > kMaxQueued) datas->clear();
+}
+
+bool CameraPrivate::IsQueueFull() {
+  {
+    std::lock_guard<std::mutex> _(cap_color_mtx_);
+    if (left_color_data_.size() >= kMaxQueued ||
+        right_color_data_.size() >= kMaxQueued) {
+      return true;
+    }
+  }
+  std::lock_guard<std::mutex> _(cap_depth_mtx_);
+  if (depth_data_.size() >= kMaxQueued ||
+      registered_depth_data_.size() >= kMaxQueued) {
+    return true;
+  }
+  for (auto&& it : pooled_depth_data_) {
+    if (it.second.size() >= kMaxQueued) return true;
+  }
+  return false;
+}
+
+void CameraPrivate::DispatchStreamCallbacks() {
+  // called by the sync thread outside the capture locks, so a callback may
+  // retrieve or take its time without stalling capture
+  std::vector<std::pair<ImageType, stream_data_t>> datas;
+  datas.swap(callback_datas_);
+  for (auto&& it : datas) {
+    stream_callback_t callback;
+    {
+      std::lock_guard<std::mutex> _(mtx_callbacks_);
+      auto&& found = stream_callbacks_.find(it.first);
+      if (found == stream_callbacks_.end()) continue;
+      callback = found->second;
+    }
+    callback(it.second);
+  }
+}
+
 void CameraPrivate::ReadAllInfos() {
   device_params_ = std::make_shared<DeviceParams>();
 
   Channels::imu_params_t imu_params;
-  if (!channels_->GetFiles(device_params_.get(), &imu_params)) {
+  if (!backend_->GetFiles(device_params_.get(), &imu_params)) {
     LOGE("%s %d:: Read device infos failed. Please upgrade"
         "your firmware to the latest version.", __FILE__, __LINE__);
     return;
@@ -1327,5 +1632,5 @@ void CameraPrivate::ScaleAssemCompensate(std::shared_ptr<ImuData> data) {
 }
 
 void CameraPrivate::IsHidExist() {
-  is_hid_exist_ = channels_->IsHidExist();
+  is_hid_exist_ = backend_->IsHidExist();
 }
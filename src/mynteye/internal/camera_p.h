@@ -17,29 +17,32 @@
 
 #include "mynteye/camera.h"
 
-#ifdef MYNTEYE_OS_WIN
-#include <Windows.h>
-#endif
-
+#include <atomic>
 #include <string>
+#include <functional>
 #include <memory>
 #include <mutex>
+#include <utility>
 #include <vector>
 #include <thread>
 #include <condition_variable>
+#include <deque>
 #include <map>
 
 #include "eSPDI.h"
 
+#include "mynteye/depth_pyramid.h"
+#include "mynteye/depth_registration.h"
 #include "mynteye/image.h"
+#include "mynteye/record.h"
 #include "mynteye/types.h"
 #include "mynteye/internal/types.h"
 #include "mynteye/callbacks.h"
+#include "mynteye/internal/backend.h"
 
 MYNTEYE_BEGIN_NAMESPACE
 
 class Rate;
-class Channels;
 
 class MYNTEYE_API CameraPrivate {
  public:
@@ -50,8 +53,12 @@ class MYNTEYE_API CameraPrivate {
   using motion_datas_t = std::vector<motion_data_t>;
   using img_info_data_t = device::ImgInfoData;
   using img_info_datas_t = std::vector<img_info_data_t>;
+  using stream_callback_t = std::function<void(const stream_data_t&)>;
+  using motion_callback_t = std::function<void(const motion_data_t&)>;
 
   CameraPrivate();
+  /** Over the backend, instead of the device of eSPDI. */
+  explicit CameraPrivate(const std::shared_ptr<Backend>& backend);
   ~CameraPrivate();
 
   void GetDevices(std::vector<DeviceInfo>* dev_infos);
@@ -59,16 +66,6 @@ class MYNTEYE_API CameraPrivate {
       std::vector<StreamInfo>* color_infos,
       std::vector<StreamInfo>* depth_infos);
 
-  void GetResolutionIndex(const InitParams& params,
-      int* color_res_index,
-      int* depth_res_index);
-  void GetResolutionIndex(const std::int32_t& dev_index,
-      const StreamMode& stream_mode,
-      const StreamFormat& color_stream_format,
-      const StreamFormat& depth_stream_format,
-      int* color_res_index,
-      int* depth_res_index);
-
   ErrorCode SetAutoExposureEnabled(bool enabled);
   ErrorCode SetAutoWhiteBalanceEnabled(bool enabled);
 
@@ -86,12 +83,12 @@ class MYNTEYE_API CameraPrivate {
   bool SetFWRegister(std::uint16_t address, std::uint16_t value,
       int flag = FG_Address_1Byte);
 
-  bool SetHWPostProcess(bool enable);
-
   ErrorCode Open(const InitParams& params);
 
   bool IsOpened() const;
   void CheckOpened() const;
+  /** Whether the backend ended, as a replay played to its end. */
+  bool IsEnded() const;
 
   /** Get datas of stream and status */
   stream_datas_t RetrieveImage(const ImageType& type, ErrorCode* code);
@@ -119,6 +116,10 @@ class MYNTEYE_API CameraPrivate {
   motion_datas_t GetImuDatas();
 
   void EnableImageType(const ImageType& type);
+  void DisableImageType(const ImageType& type);
+
+  void SetStreamCallback(const ImageType& type, stream_callback_t callback);
+  void SetMotionCallback(motion_callback_t callback);
 
   /** Wait according to framerate. */
   void Wait();
@@ -129,6 +130,22 @@ class MYNTEYE_API CameraPrivate {
 
   struct CameraCtrlRectLogData GetHDCameraCtrlData();
   struct CameraCtrlRectLogData GetVGACameraCtrlData();
+  StereoCalibration GetStereoCalibration();
+
+  void EnableHostRectification(bool enabled);
+  std::shared_ptr<Rectifier> GetRectifier();
+  void SetCacheDirectory(const std::string& dir);
+
+  void SetDepthFilter(const std::shared_ptr<DepthFilterChain>& filter);
+  std::shared_ptr<DepthFilterChain> GetDepthFilter();
+
+  void SetLaserScan(const std::shared_ptr<LaserScanProjector>& projector);
+  std::vector<LaserScan> RetrieveLaserScans();
+
+  void EnableDepthStats(bool enabled);
+
+  void SetRecorder(const std::shared_ptr<Recorder>& recorder);
+  bool IsRecording();
 
   void GetCameraLogData(int index);
   struct CameraCtrlRectLogData GetCameraCtrlData(int index);
@@ -154,7 +171,7 @@ class MYNTEYE_API CameraPrivate {
 
   // protected:
   std::shared_ptr<Channels> channels() const {
-    return channels_;
+    return backend_->channels();
   }
 
   StreamMode GetStreamMode() { return stream_mode_; }
@@ -166,9 +183,6 @@ class MYNTEYE_API CameraPrivate {
 
  private:
   void Init();
-  void OnInit();
-  void OnPreWait();
-  void OnPostWait();
 
   void SyntheticImageColor();
   void SyntheticImageDepth();
@@ -181,50 +195,67 @@ class MYNTEYE_API CameraPrivate {
   void OldTransferColor(Image::pointer color);
   void OldCutPart(ImageType type, Image::pointer color);
 
-  Image::pointer RetrieveImageColor(ErrorCode* code);
-  Image::pointer RetrieveImageDepth(ErrorCode* code);
-
-  void ReleaseBuf();
+  /** Switch on a type while opened, of the streams opened. */
+  void EnableOpenedImageType(const ImageType& type);
+  bool IsImageActive(const ImageType& type);
+  bool IsColorActive();
+  bool IsDepthActive();
+  bool DeferToCallback(const ImageType& type, const stream_data_t& data);
+  /** Drop a queue retrieved too slowly, but of a lossless backend. */
+  void TrimQueue(stream_datas_t* datas);
+  /** Whether a queue is full, the capture of a lossless backend waits. */
+  bool IsQueueFull();
+  void DispatchStreamCallbacks();
+
+  void UpdateRectifier();
+  void RegisterDepths();
+  void RegisterDepth(const stream_data_t& color,
+      const Image::pointer& depth);
+  void PoolDepth(const Image::pointer& depth);
+  void ProjectLaserScan(const Image::pointer& depth);
+  Image::pointer RectifyColor(const ImageType& type,
+      const Image::pointer& color);
 
-#ifdef MYNTEYE_OS_WIN
-  static void ImgCallback(EtronDIImageType::Value imgType, int imgId,
-      unsigned char* imgBuf, int imgSize, int width, int height,
-      int serialNumber, void *pParam);
-#endif
   std::vector <struct CameraCtrlRectLogData> camera_log_datas_;
+  std::mutex mtx_calibration_;
+  StereoCalibration stereo_calibration_;
+  bool is_host_rectification_ = false;
+  std::shared_ptr<Rectifier> rectifier_;
+  std::string cache_dir_;
+
+  std::mutex mtx_depth_stages_;
+  std::shared_ptr<DepthFilterChain> depth_filter_;
+  std::shared_ptr<LaserScanProjector> laser_scan_;
+  bool is_depth_stats_ = false;
+
+  std::mutex mtx_recorder_;
+  std::shared_ptr<Recorder> recorder_;
+  std::atomic<bool> is_recording_{false};
+  /** Stream parameters of the last open, the DEVICE record */
+  RecordDevice record_device_;
+  std::shared_ptr<Recorder> GetRecorder();
+  /** Write the stream parameters, calibration and imu params. */
+  void WriteRecordParams(Recorder* recorder);
+
+  ImageMode image_mode_ = ImageMode::IMAGE_RAW;
+  /** Used by the sync thread only */
+  std::shared_ptr<DepthRegistration> depth_registration_;
+  /** Raw depths of the last frames, the colors are paired with by frame id */
+  std::deque<Image::pointer> recent_depths_;
+  /** Left colors matched, waiting for the depth of their frame id */
+  std::deque<stream_data_t> register_datas_;
+  /** Pyramids of the min and median pooling */
+  std::shared_ptr<DepthPyramid> depth_pyramids_[2];
+
+  std::shared_ptr<Backend> backend_;
+  /** Every image of the backend delivered, as of the last open */
+  bool is_lossless_ = false;
 
-  void* etron_di_;
-
-  DEVSELINFO dev_sel_info_;
-  int depth_data_type_;
-
-  PETRONDI_STREAM_INFO stream_color_info_ptr_;
-  PETRONDI_STREAM_INFO stream_depth_info_ptr_;
-  int color_res_index_ = 0;
-  int depth_res_index_ = 0;
   int framerate_ = 0;
   std::unique_ptr<Rate> rate_;
 
-  std::int32_t stream_info_dev_index_ = -1;
-
-  int color_serial_number_ = 0;
-  int depth_serial_number_ = 0;
-  image_size_t color_image_size_ = 0;
-  image_size_t depth_image_size_ = 0;
-  Image::pointer color_image_buf_ = nullptr;
-  Image::pointer depth_image_buf_ = nullptr;
-  unsigned char* depth_buf_ = nullptr;
-
-#ifdef MYNTEYE_OS_WIN
-  std::mutex mtx_imgs_;
-  RGBQUAD color_palette_z14_[16384];
-#else  // MYNTEYE_OS_LINUX
-  DEPTH_TRANSFER_CTRL dtc_;
-#endif
-
   DepthMode depth_mode_;
 
-  std::shared_ptr<Channels> channels_;
   std::mutex mtx_img_info_;
   std::mutex mtx_imu_;
 
@@ -248,15 +279,27 @@ class MYNTEYE_API CameraPrivate {
   stream_datas_t left_color_data_;
   stream_datas_t right_color_data_;
   stream_datas_t depth_data_;
+  stream_datas_t registered_depth_data_;
+  std::map<ImageType, stream_datas_t> pooled_depth_data_;
+  std::vector<LaserScan> laser_scans_;
   bool is_capture_image_ = false;
   bool is_synthetic_image_ = false;
   bool is_imu_open_ = false;
 
   bool is_start_ = false;
 
+  /** Types enabled at open, not changed while opened */
   std::map<ImageType, bool> is_enable_image_;
+  /** A bit of each type not active while opened, its frames are dropped */
+  std::atomic<std::uint32_t> disabled_images_{0};
   StreamMode stream_mode_;
 
+  std::mutex mtx_callbacks_;
+  std::map<ImageType, stream_callback_t> stream_callbacks_;
+  motion_callback_t motion_callback_;
+  /** Datas for callbacks, used by the sync thread only */
+  std::vector<std::pair<ImageType, stream_data_t>> callback_datas_;
+
   void ReadAllInfos();
   std::shared_ptr<DeviceParams> device_params_;
 
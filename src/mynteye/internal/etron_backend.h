@@ -0,0 +1,140 @@
+// Copyright 2018 Slightech Co., Ltd. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#ifndef MYNTEYE_INTERNAL_ETRON_BACKEND_H_
+#define MYNTEYE_INTERNAL_ETRON_BACKEND_H_
+#pragma once
+
+#ifdef MYNTEYE_OS_WIN
+#include <Windows.h>
+#endif
+
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "eSPDI.h"
+
+#include "mynteye/internal/backend.h"
+
+MYNTEYE_BEGIN_NAMESPACE
+
+/**
+ * The device backend over eSPDI, with the image infos and imu of its hid.
+ */
+class MYNTEYE_API EtronBackend : public Backend {
+ public:
+  using image_size_t = unsigned long int;  // NOLINT
+
+  EtronBackend();
+  ~EtronBackend();
+
+  void GetDevices(std::vector<DeviceInfo>* dev_infos) override;
+  void GetResolutions(const std::int32_t& dev_index,
+      std::vector<StreamInfo>* color_infos,
+      std::vector<StreamInfo>* depth_infos) override;
+
+  ErrorCode Open(InitParams* params) override;
+  void Close() override;
+  bool IsOpened() const override;
+
+  Image::pointer RetrieveImageColor(ErrorCode* code) override;
+  Image::pointer RetrieveImageDepth(ErrorCode* code) override;
+
+  bool IsHidExist() override;
+  bool StartHidTracking(imu_callback_t imu_callback,
+      img_callback_t img_callback) override;
+  void StopHidTracking() override;
+  bool GetFiles(DeviceParams* info, imu_params_t* imu_params) override;
+
+  bool GetRectifyLogData(int index, CameraCtrlRectLogData* data) override;
+  bool SetRectifyLogData(const std::uint8_t* data, std::size_t size) override;
+
+  void SetDepthDataType(int type) override;
+
+  ErrorCode SetAutoExposureEnabled(bool enabled) override;
+  ErrorCode SetAutoWhiteBalanceEnabled(bool enabled) override;
+
+  bool GetSensorRegister(int id, std::uint16_t address, std::uint16_t* value,
+      int flag) override;
+  bool GetHWRegister(std::uint16_t address, std::uint16_t* value,
+      int flag) override;
+  bool GetFWRegister(std::uint16_t address, std::uint16_t* value,
+      int flag) override;
+
+  bool SetSensorRegister(int id, std::uint16_t address, std::uint16_t value,
+      int flag) override;
+  bool SetHWRegister(std::uint16_t address, std::uint16_t value,
+      int flag) override;
+  bool SetFWRegister(std::uint16_t address, std::uint16_t value,
+      int flag) override;
+
+  std::shared_ptr<Channels> channels() const override {
+    return channels_;
+  }
+
+ private:
+  void OnInit();
+
+  void GetResolutionIndex(const std::int32_t& dev_index,
+      const StreamMode& stream_mode,
+      const StreamFormat& color_stream_format,
+      const StreamFormat& depth_stream_format,
+      int* color_res_index,
+      int* depth_res_index);
+
+  void ReleaseBuf();
+
+#ifdef MYNTEYE_OS_WIN
+  bool SetHWPostProcess(bool enable);
+
+  static void ImgCallback(EtronDIImageType::Value imgType, int imgId,
+      unsigned char* imgBuf, int imgSize, int width, int height,
+      int serialNumber, void *pParam);
+#endif
+
+  void* etron_di_;
+
+  DEVSELINFO dev_sel_info_;
+  int depth_data_type_;
+
+  PETRONDI_STREAM_INFO stream_color_info_ptr_;
+  PETRONDI_STREAM_INFO stream_depth_info_ptr_;
+  int color_res_index_ = 0;
+  int depth_res_index_ = 0;
+
+  std::int32_t stream_info_dev_index_ = -1;
+
+  int color_serial_number_ = 0;
+  int depth_serial_number_ = 0;
+  image_size_t color_image_size_ = 0;
+  image_size_t depth_image_size_ = 0;
+  Image::pointer color_image_buf_ = nullptr;
+  Image::pointer depth_image_buf_ = nullptr;
+  unsigned char* depth_buf_ = nullptr;
+
+#ifdef MYNTEYE_OS_WIN
+  std::mutex mtx_imgs_;
+  RGBQUAD color_palette_z14_[16384];
+#else  // MYNTEYE_OS_LINUX
+  DEPTH_TRANSFER_CTRL dtc_;
+#endif
+
+  DepthMode depth_mode_;
+
+  std::shared_ptr<Channels> channels_;
+};
+
+MYNTEYE_END_NAMESPACE
+
+#endif  // MYNTEYE_INTERNAL_ETRON_BACKEND_H_
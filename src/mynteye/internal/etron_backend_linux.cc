@@ -11,7 +11,7 @@
 // WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
 // See the License for the specific language governing permissions and
 // limitations under the License.
-#include "mynteye/internal/camera_p.h"
+#include "mynteye/internal/etron_backend.h"
 
 #ifdef MYNTEYE_OS_LINUX
 
@@ -22,22 +22,16 @@
 
 MYNTEYE_USE_NAMESPACE
 
-void CameraPrivate::OnInit() {
+void EtronBackend::OnInit() {
   dtc_ = DEPTH_IMG_NON_TRANSFER;
 }
 
-void CameraPrivate::OnPreWait() {
-}
-
-void CameraPrivate::OnPostWait() {
-}
-
 // int ret = EtronDI_Get2Image(etron_di_, &dev_sel_info_,
 //     (BYTE*)color_img_buf_, (BYTE*)depth_img_buf_,
 //     &color_image_size_, &depth_image_size_,
 //     &color_serial_number_, &depth_serial_number_, depth_data_type_);
 
-Image::pointer CameraPrivate::RetrieveImageColor(ErrorCode* code) {
+Image::pointer EtronBackend::RetrieveImageColor(ErrorCode* code) {
   unsigned int color_img_width  = (unsigned int)(
       stream_color_info_ptr_[color_res_index_].nWidth);
   unsigned int color_img_height = (unsigned int)(
@@ -68,7 +62,7 @@ Image::pointer CameraPrivate::RetrieveImageColor(ErrorCode* code) {
   return color_image_buf_;
 }
 
-Image::pointer CameraPrivate::RetrieveImageDepth(ErrorCode* code) {
+Image::pointer EtronBackend::RetrieveImageDepth(ErrorCode* code) {
   unsigned int depth_img_width  = (unsigned int)(
       stream_depth_info_ptr_[depth_res_index_].nWidth);
   unsigned int depth_img_height = (unsigned int)(
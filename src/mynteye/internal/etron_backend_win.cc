@@ -11,7 +11,7 @@
 // WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
 // See the License for the specific language governing permissions and
 // limitations under the License.
-#include "mynteye/internal/camera_p.h"
+#include "mynteye/internal/etron_backend.h"
 
 #ifdef MYNTEYE_OS_WIN
 
@@ -168,20 +168,14 @@ void UpdateZ14DisplayImage_DIB24(RGBQUAD* pColorPaletteZ14, BYTE* pDepthZ14,
 
 }  // namespace
 
-void CameraPrivate::OnInit() {
+void EtronBackend::OnInit() {
   DmColorMode14(color_palette_z14_, 0/*normal*/);
 }
 
-void CameraPrivate::OnPreWait() {
-}
-
-void CameraPrivate::OnPostWait() {
-}
-
-void CameraPrivate::ImgCallback(EtronDIImageType::Value imgType, int imgId,
+void EtronBackend::ImgCallback(EtronDIImageType::Value imgType, int imgId,
       unsigned char* imgBuf, int imgSize, int width, int height,
       int serialNumber, void *pParam) {
-  CameraPrivate* p = static_cast<CameraPrivate*>(pParam);
+  EtronBackend* p = static_cast<EtronBackend*>(pParam);
   std::lock_guard<std::mutex> _(p->mtx_imgs_);
 
   if (EtronDIImageType::IsImageColor(imgType)) {
@@ -231,7 +225,7 @@ void CameraPrivate::ImgCallback(EtronDIImageType::Value imgType, int imgId,
   }
 }
 
-Image::pointer CameraPrivate::RetrieveImageColor(ErrorCode* code) {
+Image::pointer EtronBackend::RetrieveImageColor(ErrorCode* code) {
   // LOGI("Retrieve image color");
   if (!color_image_buf_) {
     *code = ErrorCode::ERROR_CAMERA_RETRIEVE_FAILED;
@@ -268,7 +262,7 @@ Image::pointer CameraPrivate::RetrieveImageColor(ErrorCode* code) {
   return nullptr;
 }
 
-Image::pointer CameraPrivate::RetrieveImageDepth(ErrorCode* code) {
+Image::pointer EtronBackend::RetrieveImageDepth(ErrorCode* code) {
   // LOGI("Retrieve image depth");
   if (!depth_image_buf_) {
     *code = ErrorCode::ERROR_CAMERA_RETRIEVE_FAILED;
@@ -308,7 +302,7 @@ Image::pointer CameraPrivate::RetrieveImageDepth(ErrorCode* code) {
   return nullptr;
 }
 
-bool CameraPrivate::SetHWPostProcess(bool enable) {
+bool EtronBackend::SetHWPostProcess(bool enable) {
   return ETronDI_OK == EtronDI_SetHWPostProcess(etron_di_, &dev_sel_info_, enable);
 }
 
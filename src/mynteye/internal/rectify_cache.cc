@@ -0,0 +1,249 @@
+// Copyright 2018 Slightech Co., Ltd. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include "mynteye/internal/rectify_cache.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+
+#include "mynteye/util/log.h"
+#include "mynteye/util/mapped_file.h"
+
+MYNTEYE_BEGIN_NAMESPACE
+
+namespace rectify_cache {
+
+namespace {
+
+const char kMagic[8] = {'M', 'Y', 'N', 'T', 'R', 'E', 'C', 'T'};
+const std::uint32_t kVersion = 1;
+const std::size_t kAlignment = 64;
+
+/** Maps in file order: left xy, left frac, right xy, right frac. */
+const int kMapCount = 4;
+
+struct Header {
+  char magic[8];
+  std::uint32_t version;
+  std::uint32_t header_size;
+  std::int32_t width;
+  std::int32_t height;
+  std::uint64_t checksum;
+  std::uint64_t offsets[kMapCount];
+};
+
+inline std::size_t align(std::size_t n) {
+  return (n + kAlignment - 1) / kAlignment * kAlignment;
+}
+
+inline std::uint64_t fnv1a(const void* data, std::size_t size,
+    std::uint64_t hash = 14695981039346656037ULL) {
+  const std::uint8_t* p = static_cast<const std::uint8_t*>(data);
+  for (std::size_t i = 0; i < size; i++) {
+    hash ^= p[i];
+    hash *= 1099511628211ULL;
+  }
+  return hash;
+}
+
+/** Byte sizes of the maps in file order. */
+void map_sizes(int width, int height, std::size_t sizes[kMapCount]) {
+  std::size_t n = static_cast<std::size_t>(width) * height;
+  sizes[0] = sizes[2] = n * 2 * sizeof(std::int16_t);
+  sizes[1] = sizes[3] = n * sizeof(std::uint16_t);
+}
+
+/**
+ * Check the map indexes the source of width x height, as the remap reads
+ * the 2x2 pixels at xy and the table of subpixels at frac unchecked.
+ */
+bool map_in_range(const std::int16_t* xy, const std::uint16_t* frac,
+    int width, int height) {
+  const int subpixels = Rectifier::kSubpixelSize * Rectifier::kSubpixelSize;
+  std::size_t n = static_cast<std::size_t>(width) * height;
+  for (std::size_t i = 0; i < n; i++) {
+    int x = xy[i * 2], y = xy[i * 2 + 1];
+    if (x == Rectifier::kOutside) continue;
+    if (x < 0 || x > width - 2 || y < 0 || y > height - 2 ||
+        frac[i] >= subpixels) {
+      return false;
+    }
+  }
+  return true;
+}
+
+std::string mode_name(const StreamMode& mode) {
+  switch (mode) {
+    case StreamMode::STREAM_1280x720: return "1280x720";
+    case StreamMode::STREAM_2560x720: return "2560x720";
+    case StreamMode::STREAM_1280x480: return "1280x480";
+    case StreamMode::STREAM_640x480: return "640x480";
+    default: return "unknown";
+  }
+}
+
+/** Keep the serial number safe as a file name. */
+std::string safe_name(const std::string& name) {
+  std::string s;
+  for (char c : name) {
+    bool ok = (c >= '0' && c <= '9') || (c >= 'a' && c <= 'z') ||
+        (c >= 'A' && c <= 'Z') || c == '-' || c == '_';
+    s.push_back(ok ? c : '_');
+  }
+  return s.empty() ? "unknown" : s;
+}
+
+}  // namespace
+
+std::string default_dir() {
+  const char* dir = std::getenv("MYNTEYE_CACHE_DIR");
+  if (dir && *dir) return dir;
+#ifdef MYNTEYE_OS_WIN
+  const char* home = std::getenv("USERPROFILE");
+#else
+  const char* home = std::getenv("HOME");
+#endif
+  if (!home || !*home) return "";
+  return std::string(home) + MYNTEYE_OS_SEP ".mynteye" MYNTEYE_OS_SEP "cache";
+}
+
+std::uint64_t checksum(const StereoCalibration& calib) {
+  const CameraCtrlRectLogData& data = calib.GetLogData();
+  std::int32_t size[2] = {calib.width(), calib.height()};
+  return fnv1a(size, sizeof(size), fnv1a(&data, sizeof(data)));
+}
+
+std::string file_path(const std::string& dir, const std::string& serial,
+    const StreamMode& mode, const StereoCalibration& calib) {
+  char hash[17];
+  std::snprintf(hash, sizeof(hash), "%016llx",
+      static_cast<unsigned long long>(checksum(calib)));  // NOLINT
+  return dir + MYNTEYE_OS_SEP "rectify_" + safe_name(serial) + "_" +
+      mode_name(mode) + "_" + hash + ".bin";
+}
+
+std::shared_ptr<Rectifier> load(const std::string& path,
+    const StereoCalibration& calib) {
+  if (!calib.IsValid()) return nullptr;
+  auto file = std::make_shared<MappedFile>();
+  if (!file->Open(path)) return nullptr;
+
+  const std::size_t data_size = sizeof(CameraCtrlRectLogData);
+  if (file->size() < sizeof(Header) + data_size) return nullptr;
+  Header header;
+  std::memcpy(&header, file->data(), sizeof(Header));
+  if (std::memcmp(header.magic, kMagic, sizeof(kMagic)) != 0 ||
+      header.version != kVersion || header.header_size != sizeof(Header) ||
+      header.width != calib.width() || header.height != calib.height() ||
+      header.checksum != checksum(calib) ||
+      std::memcmp(file->data() + sizeof(Header), &calib.GetLogData(),
+          data_size) != 0) {
+    LOGE("Error: rectify cache is not of the calibration, %s", path.c_str());
+    return nullptr;
+  }
+
+  std::size_t sizes[kMapCount];
+  map_sizes(header.width, header.height, sizes);
+  const void* maps[kMapCount];
+  for (int i = 0; i < kMapCount; i++) {
+    std::uint64_t offset = header.offsets[i];
+    if (offset % kAlignment != 0 || offset > file->size() ||
+        sizes[i] > file->size() - offset) {
+      LOGE("Error: rectify cache is broken, %s", path.c_str());
+      return nullptr;
+    }
+    maps[i] = file->data() + offset;
+  }
+
+  Rectifier::Map left, right;
+  left.xy = static_cast<const std::int16_t*>(maps[0]);
+  left.frac = static_cast<const std::uint16_t*>(maps[1]);
+  left.storage = file;
+  right.xy = static_cast<const std::int16_t*>(maps[2]);
+  right.frac = static_cast<const std::uint16_t*>(maps[3]);
+  right.storage = file;
+  if (!map_in_range(left.xy, left.frac, header.width, header.height) ||
+      !map_in_range(right.xy, right.frac, header.width, header.height)) {
+    LOGE("Error: rectify cache is broken, %s", path.c_str());
+    return nullptr;
+  }
+  auto rectifier = std::make_shared<Rectifier>(calib, left, right);
+  if (!rectifier->IsValid()) return nullptr;
+  return rectifier;
+}
+
+bool save(const std::string& path, const Rectifier& rectifier) {
+  if (!rectifier.IsValid()) return false;
+  const StereoCalibration& calib = rectifier.GetCalibration();
+  const Rectifier::Map& left = rectifier.GetMap(ImageType::IMAGE_LEFT_COLOR);
+  const Rectifier::Map& right =
+      rectifier.GetMap(ImageType::IMAGE_RIGHT_COLOR);
+  const void* maps[kMapCount] = {left.xy, left.frac, right.xy, right.frac};
+
+  Header header;
+  std::memcpy(header.magic, kMagic, sizeof(kMagic));
+  header.version = kVersion;
+  header.header_size = sizeof(Header);
+  header.width = calib.width();
+  header.height = calib.height();
+  header.checksum = checksum(calib);
+  std::size_t sizes[kMapCount];
+  map_sizes(header.width, header.height, sizes);
+  std::size_t offset = align(sizeof(Header) + sizeof(CameraCtrlRectLogData));
+  for (int i = 0; i < kMapCount; i++) {
+    header.offsets[i] = offset;
+    offset = align(offset + sizes[i]);
+  }
+
+  // write aside and rename, readers never see a partial file
+  std::string tmp = path + ".tmp";
+  {
+    std::ofstream out(tmp, std::ios::out | std::ios::binary);
+    if (!out.is_open()) {
+      LOGE("Error: can not write rectify cache, %s", tmp.c_str());
+      return false;
+    }
+    const char zeros[kAlignment] = {};
+    out.write(reinterpret_cast<const char*>(&header), sizeof(Header));
+    out.write(reinterpret_cast<const char*>(&calib.GetLogData()),
+        sizeof(CameraCtrlRectLogData));
+    std::size_t pos = sizeof(Header) + sizeof(CameraCtrlRectLogData);
+    for (int i = 0; i < kMapCount; i++) {
+      out.write(zeros, header.offsets[i] - pos);
+      out.write(static_cast<const char*>(maps[i]), sizes[i]);
+      pos = header.offsets[i] + sizes[i];
+    }
+    if (!out.good()) {
+      out.close();
+      std::remove(tmp.c_str());
+      LOGE("Error: can not write rectify cache, %s", tmp.c_str());
+      return false;
+    }
+  }
+#ifdef MYNTEYE_OS_WIN
+  // rename does not replace on windows
+  std::remove(path.c_str());
+#endif
+  if (std::rename(tmp.c_str(), path.c_str()) != 0) {
+    std::remove(tmp.c_str());
+    LOGE("Error: can not write rectify cache, %s", path.c_str());
+    return false;
+  }
+  return true;
+}
+
+}  // namespace rectify_cache
+
+MYNTEYE_END_NAMESPACE
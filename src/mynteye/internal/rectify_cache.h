@@ -0,0 +1,61 @@
+// Copyright 2018 Slightech Co., Ltd. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#ifndef MYNTEYE_INTERNAL_RECTIFY_CACHE_H_
+#define MYNTEYE_INTERNAL_RECTIFY_CACHE_H_
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+
+#include "mynteye/rectifier.h"
+#include "mynteye/stereo_calibration.h"
+#include "mynteye/stubs/global.h"
+#include "mynteye/types.h"
+
+MYNTEYE_BEGIN_NAMESPACE
+
+/**
+ * Cache files of rectification maps, one per device serial, stream mode and
+ * calibration. A file has a header, the calibration log data it is built
+ * from, and the maps of both eyes at 64 bytes aligned offsets, so that a
+ * loaded Rectifier uses the mapped file directly.
+ */
+namespace rectify_cache {
+
+/** The default directory, $MYNTEYE_CACHE_DIR or ~/.mynteye/cache. */
+std::string default_dir();
+
+/** FNV-1a checksum of the calibration log data and its eye size. */
+std::uint64_t checksum(const StereoCalibration& calib);
+
+/** Path of the cache file in dir. */
+std::string file_path(const std::string& dir, const std::string& serial,
+    const StreamMode& mode, const StereoCalibration& calib);
+
+/**
+ * Map the cache file, nullptr if missing, not of calib, or its maps out of
+ * the image, to be built again.
+ */
+std::shared_ptr<Rectifier> load(const std::string& path,
+    const StereoCalibration& calib);
+
+/** Write the cache file, replacing an existing one atomically. */
+bool save(const std::string& path, const Rectifier& rectifier);
+
+}  // namespace rectify_cache
+
+MYNTEYE_END_NAMESPACE
+
+#endif  // MYNTEYE_INTERNAL_RECTIFY_CACHE_H_
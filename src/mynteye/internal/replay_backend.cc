@@ -0,0 +1,351 @@
+// Copyright 2018 Slightech Co., Ltd. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include "mynteye/internal/replay_backend.h"
+
+#include <algorithm>
+#include <utility>
+
+#include "mynteye/util/log.h"
+
+MYNTEYE_BEGIN_NAMESPACE
+
+namespace {
+
+/** Wait of a retrieve for the next image. */
+const std::chrono::milliseconds kRetrieveTimeout(20);
+/** Records read ahead of the replay. */
+const std::size_t kPrefetchRecords = 64;
+
+StreamFormat to_stream_format(const ImageFormat& format) {
+  return format == ImageFormat::COLOR_MJPG ?
+      StreamFormat::STREAM_MJPG : StreamFormat::STREAM_YUYV;
+}
+
+}  // namespace
+
+ReplayBackend::ReplayBackend(const ReplayParams& params)
+  : params_(params), running_(false), tracking_(false), opened_(false),
+    ended_(false) {
+  reader_.Open(params_.path);
+}
+
+ReplayBackend::~ReplayBackend() {
+  Close();
+}
+
+void ReplayBackend::GetDevices(std::vector<DeviceInfo>* dev_infos) {
+  if (!dev_infos) {
+    LOGE("GetDevices: dev_infos is null.");
+    return;
+  }
+  dev_infos->clear();
+  if (!reader_.IsOpened()) return;
+
+  DeviceInfo info;
+  info.index = 0;
+  info.name = params_.path;
+  info.type = 0;
+  info.pid = 0;
+  info.vid = 0;
+  info.chip_id = 0;
+  info.fw_version = "replay";
+  dev_infos->push_back(std::move(info));
+}
+
+void ReplayBackend::GetResolutions(const std::int32_t& dev_index,
+    std::vector<StreamInfo>* color_infos,
+    std::vector<StreamInfo>* depth_infos) {
+  UNUSED(dev_index);
+  if (!color_infos) {
+    LOGE("GetResolutions: color_infos is null.");
+    return;
+  }
+  color_infos->clear();
+
+  if (!depth_infos) {
+    LOGE("GetResolutions: depth_infos is null.");
+    return;
+  }
+  depth_infos->clear();
+
+  // the streams of the first images
+  for (auto &&type : {RecordType::COLOR, RecordType::DEPTH}) {
+    std::size_t i = reader_.size() > 0 && reader_.type(0) == type ?
+        0 : reader_.Next(type, 0);
+    if (i >= reader_.size()) continue;
+    auto &&header = reader_.header(i);
+    StreamInfo info;
+    info.index = 0;
+    info.width = header.width;
+    info.height = header.height;
+    info.format = to_stream_format(static_cast<ImageFormat>(header.format));
+    (type == RecordType::COLOR ? color_infos : depth_infos)->push_back(info);
+  }
+}
+
+ErrorCode ReplayBackend::Open(InitParams* params) {
+  if (!reader_.IsOpened()) {
+    LOGE("Error: ReplayBackend:: %s is not a record file",
+        params_.path.c_str());
+    return ErrorCode::ERROR_FILE_OPEN_FAILED;
+  }
+  Close();
+
+  RecordDevice device;
+  if (reader_.GetDevice(&device)) {
+    params->framerate = device.framerate;
+    params->stream_mode = static_cast<StreamMode>(device.stream_mode);
+    params->depth_mode = static_cast<DepthMode>(device.depth_mode);
+    params->color_stream_format =
+        static_cast<StreamFormat>(device.color_format);
+    params->depth_stream_format =
+        static_cast<StreamFormat>(device.depth_format);
+    params->ir_intensity = device.ir_intensity;
+  } else {
+    LOGW("Warning: ReplayBackend:: the stream parameters are not recorded, "
+        "those of open are assumed");
+  }
+  LOGI("-- Replay: %s, %zu records, speed %g%s", params_.path.c_str(),
+      reader_.size(), params_.speed, params_.loop ? ", loop" : "");
+
+  {
+    std::lock_guard<std::mutex> _(mutex_);
+    running_ = true;
+    color_ = nullptr;
+    depth_ = nullptr;
+  }
+  ended_ = false;
+  opened_ = true;
+  thread_ = std::thread(&ReplayBackend::Run, this);
+  return ErrorCode::SUCCESS;
+}
+
+void ReplayBackend::Close() {
+  {
+    std::lock_guard<std::mutex> _(mutex_);
+    running_ = false;
+  }
+  condition_.notify_all();
+  if (thread_.joinable()) {
+    thread_.join();
+  }
+  std::lock_guard<std::mutex> _(mutex_);
+  color_ = nullptr;
+  depth_ = nullptr;
+  opened_ = false;
+}
+
+bool ReplayBackend::IsOpened() const {
+  return opened_;
+}
+
+bool ReplayBackend::IsEnded() const {
+  return ended_;
+}
+
+bool ReplayBackend::IsLossless() const {
+  return params_.speed <= 0;
+}
+
+void ReplayBackend::Run() {
+  using clock = std::chrono::steady_clock;
+  const std::size_t n = reader_.size();
+  const std::uint64_t first = n > 0 ? reader_.entry(0).host_time : 0;
+  if (IsHidExist()) {
+    // the first infos and imu are not lost before their callbacks are set
+    std::unique_lock<std::mutex> lock(mutex_);
+    condition_.wait(lock, [this]() { return tracking_ || !running_; });
+    if (!running_) return;
+  }
+  auto begin = clock::now();
+  std::size_t i = 0;
+  while (true) {
+    if (i >= n) {
+      if (!params_.loop || n == 0) break;
+      i = 0;
+      begin = clock::now();
+    }
+    if (i % kPrefetchRecords == 0) {
+      reader_.Prefetch(i, kPrefetchRecords);
+    }
+    std::uint64_t host_time = reader_.entry(i).host_time;
+    if (params_.speed > 0 && host_time > first) {
+      auto offset = std::chrono::nanoseconds(static_cast<std::int64_t>(
+          (host_time - first) / params_.speed));
+      if (!WaitUntil(begin + std::chrono::duration_cast<clock::duration>(
+          offset))) {
+        return;
+      }
+    } else {
+      std::lock_guard<std::mutex> _(mutex_);
+      if (!running_) return;
+    }
+    Deliver(i++);
+  }
+  if (params_.speed <= 0) {
+    // ended once the last images are taken too
+    std::unique_lock<std::mutex> lock(mutex_);
+    condition_.wait(lock, [this]() {
+      return (!color_ && !depth_) || !running_;
+    });
+  }
+  ended_ = true;
+  condition_.notify_all();
+}
+
+bool ReplayBackend::WaitUntil(
+    const std::chrono::steady_clock::time_point& time) {
+  std::unique_lock<std::mutex> lock(mutex_);
+  condition_.wait_until(lock, time, [this]() { return !running_; });
+  return running_;
+}
+
+void ReplayBackend::Deliver(std::size_t i) {
+  switch (reader_.type(i)) {
+    case RecordType::COLOR:
+      Post(&color_, reader_.GetImage(i));
+      break;
+    case RecordType::DEPTH:
+      Post(&depth_, reader_.GetImage(i));
+      break;
+    case RecordType::IMG_INFO: {
+      RecordImgInfo info;
+      if (!reader_.GetImgInfo(i, &info)) break;
+      ImgInfoPacket packet;
+      packet.frame_id = info.frame_id;
+      packet.timestamp = info.timestamp;
+      packet.exposure_time = info.exposure_time;
+      img_callback_t callback;
+      {
+        std::lock_guard<std::mutex> _(mtx_callbacks_);
+        callback = img_callback_;
+      }
+      if (callback) callback(packet);
+    } break;
+    case RecordType::IMU: {
+      std::size_t count = 0;
+      auto &&segments = reader_.GetImu(i, &count);
+      if (count == 0) break;
+      ImuPacket packet;
+      packet.segments.resize(count);
+      for (std::size_t k = 0; k < count; k++) {
+        auto &&s = segments[k];
+        auto &&seg = packet.segments[k];
+        seg.flag = s.flag;
+        seg.timestamp = s.timestamp;
+        seg.temperature = s.temperature;
+        std::copy(s.accel_or_gyro, s.accel_or_gyro + 3, seg.accel_or_gyro);
+      }
+      imu_callback_t callback;
+      {
+        std::lock_guard<std::mutex> _(mtx_callbacks_);
+        callback = imu_callback_;
+      }
+      if (callback) callback(packet);
+    } break;
+    default:
+      // the parameters are read on open
+      break;
+  }
+}
+
+void ReplayBackend::Post(Image::pointer* slot, const Image::pointer& image) {
+  if (!image) return;
+  std::unique_lock<std::mutex> lock(mutex_);
+  if (params_.speed <= 0) {
+    // none overwritten as fast as possible, the capture takes each
+    condition_.wait(lock, [this, slot]() { return !*slot || !running_; });
+    if (!running_) return;
+  }
+  *slot = image;
+  lock.unlock();
+  condition_.notify_all();
+}
+
+Image::pointer ReplayBackend::Take(Image::pointer* slot, ErrorCode* code) {
+  std::unique_lock<std::mutex> lock(mutex_);
+  condition_.wait_for(lock, kRetrieveTimeout, [this, slot]() {
+    return *slot || ended_ || !running_;
+  });
+  if (!*slot) {
+    *code = ErrorCode::ERROR_CAMERA_RETRIEVE_FAILED;
+    return nullptr;
+  }
+  Image::pointer image = std::move(*slot);
+  *slot = nullptr;
+  lock.unlock();
+  condition_.notify_all();
+  *code = ErrorCode::SUCCESS;
+  return image;
+}
+
+Image::pointer ReplayBackend::RetrieveImageColor(ErrorCode* code) {
+  return Take(&color_, code);
+}
+
+Image::pointer ReplayBackend::RetrieveImageDepth(ErrorCode* code) {
+  return Take(&depth_, code);
+}
+
+bool ReplayBackend::IsHidExist() {
+  return reader_.IsOpened() &&
+      reader_.SeekTimestamp(RecordType::IMG_INFO, 0) < reader_.size();
+}
+
+bool ReplayBackend::StartHidTracking(imu_callback_t imu_callback,
+    img_callback_t img_callback) {
+  {
+    std::lock_guard<std::mutex> _(mtx_callbacks_);
+    imu_callback_ = imu_callback;
+    img_callback_ = img_callback;
+  }
+  {
+    std::lock_guard<std::mutex> _(mutex_);
+    tracking_ = true;
+  }
+  condition_.notify_all();
+  return true;
+}
+
+void ReplayBackend::StopHidTracking() {
+  {
+    std::lock_guard<std::mutex> _(mtx_callbacks_);
+    imu_callback_ = nullptr;
+    img_callback_ = nullptr;
+  }
+  std::lock_guard<std::mutex> _(mutex_);
+  tracking_ = false;
+}
+
+bool ReplayBackend::GetFiles(DeviceParams* info, imu_params_t* imu_params) {
+  info->name = "MYNT-EYE-D replay";
+  info->serial_number = "replay";
+  info->nominal_baseline = 0;
+
+  RecordMotion motion;
+  imu_params->ok = reader_.GetMotion(&motion);
+  if (imu_params->ok) {
+    imu_params->in_accel = motion.accel;
+    imu_params->in_gyro = motion.gyro;
+    imu_params->ex_left_to_imu = motion.left_to_imu;
+  }
+  return true;
+}
+
+bool ReplayBackend::GetRectifyLogData(int index,
+    CameraCtrlRectLogData* data) {
+  return reader_.GetCalibration(index, data);
+}
+
+MYNTEYE_END_NAMESPACE
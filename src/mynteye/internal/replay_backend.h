@@ -0,0 +1,96 @@
+// Copyright 2018 Slightech Co., Ltd. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#ifndef MYNTEYE_INTERNAL_REPLAY_BACKEND_H_
+#define MYNTEYE_INTERNAL_REPLAY_BACKEND_H_
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "mynteye/record_reader.h"
+#include "mynteye/internal/backend.h"
+
+MYNTEYE_BEGIN_NAMESPACE
+
+/**
+ * The backend of a record file, played as the device it was recorded from.
+ *
+ * A thread walks the records in file order, paced by their host times over
+ * the speed. Images are posted into a slot of each stream, overwritten as the
+ * device does, and infos and imu are called back. As fast as possible, a
+ * slot waits its image retrieved, and the replay is lossless.
+ * The stream parameters, calibration and imu params are those recorded.
+ */
+class MYNTEYE_API ReplayBackend : public Backend {
+ public:
+  explicit ReplayBackend(const ReplayParams& params);
+  ~ReplayBackend();
+
+  void GetDevices(std::vector<DeviceInfo>* dev_infos) override;
+  void GetResolutions(const std::int32_t& dev_index,
+      std::vector<StreamInfo>* color_infos,
+      std::vector<StreamInfo>* depth_infos) override;
+
+  ErrorCode Open(InitParams* params) override;
+  void Close() override;
+  bool IsOpened() const override;
+  bool IsEnded() const override;
+  bool IsLossless() const override;
+
+  Image::pointer RetrieveImageColor(ErrorCode* code) override;
+  Image::pointer RetrieveImageDepth(ErrorCode* code) override;
+
+  bool IsHidExist() override;
+  bool StartHidTracking(imu_callback_t imu_callback,
+      img_callback_t img_callback) override;
+  void StopHidTracking() override;
+  bool GetFiles(DeviceParams* info, imu_params_t* imu_params) override;
+
+  bool GetRectifyLogData(int index, CameraCtrlRectLogData* data) override;
+
+ private:
+  void Run();
+  /** Wait till time, false if closed meanwhile. */
+  bool WaitUntil(const std::chrono::steady_clock::time_point& time);
+  void Deliver(std::size_t i);
+  void Post(Image::pointer* slot, const Image::pointer& image);
+  Image::pointer Take(Image::pointer* slot, ErrorCode* code);
+
+  ReplayParams params_;
+  RecordReader reader_;
+
+  std::mutex mutex_;
+  std::condition_variable condition_;
+  std::thread thread_;
+  bool running_;
+  /** Infos and imu called back, the replay waits for it if recorded */
+  bool tracking_;
+  Image::pointer color_;
+  Image::pointer depth_;
+
+  std::atomic<bool> opened_;
+  std::atomic<bool> ended_;
+
+  std::mutex mtx_callbacks_;
+  imu_callback_t imu_callback_;
+  img_callback_t img_callback_;
+};
+
+MYNTEYE_END_NAMESPACE
+
+#endif  // MYNTEYE_INTERNAL_REPLAY_BACKEND_H_
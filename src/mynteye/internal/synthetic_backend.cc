@@ -0,0 +1,559 @@
+// Copyright 2018 Slightech Co., Ltd. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include "mynteye/internal/synthetic_backend.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <utility>
+
+#include "mynteye/util/convertor.h"
+#include "mynteye/util/log.h"
+
+MYNTEYE_BEGIN_NAMESPACE
+
+namespace {
+
+/** Wait of a retrieve for the next image. */
+const std::chrono::milliseconds kRetrieveTimeout(20);
+/** Frames of a pattern, till it repeats. */
+const int kPatternFrames = 16;
+/** Quality of the MJPG frames. */
+const int kJpegQuality = 90;
+/** Depth range of the slope, in mm. */
+const int kDepthNear = 500;
+const int kDepthFar = 4500;
+/** Exposure time of each image info. */
+const std::uint16_t kExposureTime = 100;
+/** Pinhole of the calibration, focal in widths, baseline in mm. */
+const float kFocalScale = 0.8f;
+const float kBaseline = 120.f;
+
+const double kPi = 3.14159265358979323846;
+
+/** Colors of the bars, white yellow cyan green magenta red blue black. */
+const std::uint8_t kBarColors[8][3] = {
+  {235, 235, 235}, {235, 235, 16}, {16, 235, 235}, {16, 235, 16},
+  {235, 16, 235}, {235, 16, 16}, {16, 16, 235}, {16, 16, 16},
+};
+
+void get_stream_size(const StreamMode& stream_mode, int* width, int* height) {
+  switch (stream_mode) {
+    case StreamMode::STREAM_1280x720:
+      *width = 1280;
+      *height = 720;
+      break;
+    case StreamMode::STREAM_2560x720:
+      *width = 2560;
+      *height = 720;
+      break;
+    case StreamMode::STREAM_1280x480:
+      *width = 1280;
+      *height = 480;
+      break;
+    case StreamMode::STREAM_640x480:
+    default:
+      *width = 640;
+      *height = 480;
+      break;
+  }
+}
+
+/** Depth of the stream mode, a single eye of the side by side color. */
+void get_depth_size(const StreamMode& stream_mode, int* width, int* height) {
+  get_stream_size(stream_mode, width, height);
+  if (stream_mode == StreamMode::STREAM_2560x720 ||
+      stream_mode == StreamMode::STREAM_1280x480) {
+    *width /= 2;
+  }
+}
+
+/**
+ * Width of the diagonal bars, even so that the pixels of a YUYV pair are of
+ * one bar, and the period of 8 bars a multiple of the pattern frames.
+ */
+int bar_width(int width) {
+  return std::max(4, width / 16 / 4 * 4);
+}
+
+const std::uint8_t* bar_color(int x, int y, int bar) {
+  return kBarColors[((x + y) / bar) % 8];
+}
+
+/** The slope of x + y, in periods of a multiple of the pattern frames. */
+std::uint16_t slope_depth(int x, int y, int period) {
+  return static_cast<std::uint16_t>(kDepthNear +
+      (x + y) % period * (kDepthFar - kDepthNear) / period);
+}
+
+void rgb_to_yuv(const std::uint8_t* rgb, std::uint8_t* y, std::uint8_t* u,
+    std::uint8_t* v) {
+  int r = rgb[0], g = rgb[1], b = rgb[2];
+  *y = static_cast<std::uint8_t>(((66 * r + 129 * g + 25 * b + 128) >> 8) + 16);
+  *u = static_cast<std::uint8_t>(
+      ((-38 * r - 74 * g + 112 * b + 128) >> 8) + 128);
+  *v = static_cast<std::uint8_t>(
+      ((112 * r - 94 * g - 18 * b + 128) >> 8) + 128);
+}
+
+}  // namespace
+
+SyntheticBackend::SyntheticBackend(const SyntheticParams& params)
+  : params_(params), framerate_(0), running_(false), opened_(false) {
+  if (params_.frame_id_wrap == 0 || params_.frame_id_wrap > 0x10000) {
+    params_.frame_id_wrap = 0x10000;
+  }
+}
+
+SyntheticBackend::~SyntheticBackend() {
+  Close();
+}
+
+void SyntheticBackend::GetDevices(std::vector<DeviceInfo>* dev_infos) {
+  if (!dev_infos) {
+    LOGE("GetDevices: dev_infos is null.");
+    return;
+  }
+  dev_infos->clear();
+
+  DeviceInfo info;
+  info.index = 0;
+  info.name = params_.name;
+  info.type = 0;
+  info.pid = 0;
+  info.vid = 0;
+  info.chip_id = 0;
+  info.fw_version = "synthetic";
+  dev_infos->push_back(std::move(info));
+}
+
+void SyntheticBackend::GetResolutions(const std::int32_t& dev_index,
+    std::vector<StreamInfo>* color_infos,
+    std::vector<StreamInfo>* depth_infos) {
+  UNUSED(dev_index);
+  if (!color_infos) {
+    LOGE("GetResolutions: color_infos is null.");
+    return;
+  }
+  color_infos->clear();
+
+  if (!depth_infos) {
+    LOGE("GetResolutions: depth_infos is null.");
+    return;
+  }
+  depth_infos->clear();
+
+  // those of the stream modes, as of the device
+  for (int i = 0; i < static_cast<int>(StreamMode::STREAM_MODE_LAST); i++) {
+    auto mode = static_cast<StreamMode>(i);
+    StreamInfo info;
+    get_stream_size(mode, &info.width, &info.height);
+    for (auto &&format : {StreamFormat::STREAM_MJPG,
+        StreamFormat::STREAM_YUYV}) {
+      info.format = format;
+      info.index = static_cast<int>(color_infos->size());
+      color_infos->push_back(info);
+    }
+    get_depth_size(mode, &info.width, &info.height);
+    info.format = StreamFormat::STREAM_YUYV;
+    info.index = static_cast<int>(depth_infos->size());
+    depth_infos->push_back(info);
+  }
+}
+
+ErrorCode SyntheticBackend::Open(InitParams* params) {
+  Close();
+
+  int color_width = 0, color_height = 0;
+  int depth_width = 0, depth_height = 0;
+  get_stream_size(params->stream_mode, &color_width, &color_height);
+  get_depth_size(params->stream_mode, &depth_width, &depth_height);
+  if (params_.color_width > 0 && params_.color_height > 0) {
+    color_width = params_.color_width;
+    color_height = params_.color_height;
+  }
+  if (params_.depth_width > 0 && params_.depth_height > 0) {
+    depth_width = params_.depth_width;
+    depth_height = params_.depth_height;
+  }
+  // YUYV of pixel pairs
+  color_width -= color_width % 2;
+  if (params_.framerate > 0) {
+    params->framerate = params_.framerate;
+  }
+  if (params->framerate <= 0) {
+    LOGE("Error: SyntheticBackend:: framerate %d is not supported",
+        params->framerate);
+    return ErrorCode::ERROR_CAMERA_OPEN_FAILED;
+  }
+  framerate_ = params->framerate;
+
+  // the depth is generated raw, of any depth mode
+  params->depth_mode = DepthMode::DEPTH_RAW;
+  params->depth_stream_format = StreamFormat::STREAM_YUYV;
+
+  RenderColor(&params->color_stream_format, color_width, color_height);
+  RenderDepth(depth_width, depth_height);
+
+  LOGI("-- Synthetic: %s, color %dx%d %s, depth %dx%d, %d fps",
+      params_.name.c_str(), color_width, color_height,
+      params->color_stream_format == StreamFormat::STREAM_MJPG ?
+          "MJPG" : "YUYV",
+      depth_width, depth_height, framerate_);
+  if (params_.hid) {
+    LOGI("-- Synthetic: imu %d Hz", params_.imu_rate);
+  }
+  if (params_.jitter_ms > 0 || params_.drop_rate > 0) {
+    LOGI("-- Synthetic: jitter %g ms, drop rate %g, seed %u",
+        params_.jitter_ms, params_.drop_rate, params_.seed);
+  }
+
+  random_.seed(params_.seed);
+  {
+    std::lock_guard<std::mutex> _(mutex_);
+    running_ = true;
+    color_ = nullptr;
+    depth_ = nullptr;
+  }
+  opened_ = true;
+  thread_ = std::thread(&SyntheticBackend::Run, this);
+  return ErrorCode::SUCCESS;
+}
+
+void SyntheticBackend::Close() {
+  {
+    std::lock_guard<std::mutex> _(mutex_);
+    running_ = false;
+  }
+  condition_.notify_all();
+  if (thread_.joinable()) {
+    thread_.join();
+  }
+  std::lock_guard<std::mutex> _(mutex_);
+  color_ = nullptr;
+  depth_ = nullptr;
+  opened_ = false;
+}
+
+bool SyntheticBackend::IsOpened() const {
+  return opened_;
+}
+
+void SyntheticBackend::RenderColor(StreamFormat* format, int width,
+    int height) {
+#ifndef WITH_JPEG
+  if (*format == StreamFormat::STREAM_MJPG) {
+    LOGW("Warning: SyntheticBackend:: MJPG is generated as YUYV, "
+        "as libjpeg not found");
+    *format = StreamFormat::STREAM_YUYV;
+  }
+#endif
+  const int bar = bar_width(width);
+  const int step = 8 * bar / kPatternFrames;
+
+  Pattern &pattern = color_pattern_;
+  pattern.width = width;
+  pattern.height = height;
+  pattern.offsets.clear();
+  pattern.sizes.clear();
+  pattern.data = std::make_shared<std::vector<std::uint8_t>>();
+  auto &&data = *pattern.data;
+
+  if (*format == StreamFormat::STREAM_MJPG) {
+    // each frame encoded, the bars moved by a step
+    pattern.format = ImageFormat::COLOR_MJPG;
+    std::vector<std::uint8_t> rgb(width * height * 3);
+    std::vector<unsigned char> jpg;
+    for (int k = 0; k < kPatternFrames; k++) {
+      std::uint8_t* p = rgb.data();
+      for (int y = 0; y < height; y++) {
+        for (int x = 0; x < width; x++, p += 3) {
+          std::memcpy(p, bar_color(x, y + k * step, bar), 3);
+        }
+      }
+      RGB_TO_MJPEG_LIBJPEG(rgb.data(), width, height, kJpegQuality, &jpg);
+      pattern.offsets.push_back(data.size());
+      pattern.sizes.push_back(jpg.size());
+      data.insert(data.end(), jpg.begin(), jpg.end());
+    }
+    return;
+  }
+
+  // one image of the rows of all frames, each frame a step of rows down
+  pattern.format = ImageFormat::COLOR_YUYV;
+  const int rows = height + (kPatternFrames - 1) * step;
+  data.resize(static_cast<std::size_t>(width) * 2 * rows);
+  std::uint8_t* p = data.data();
+  for (int y = 0; y < rows; y++) {
+    for (int x = 0; x + 1 < width; x += 2, p += 4) {
+      std::uint8_t u, v;
+      rgb_to_yuv(bar_color(x, y, bar), &p[0], &u, &v);
+      p[1] = u;
+      p[2] = p[0];
+      p[3] = v;
+    }
+  }
+  for (int k = 0; k < kPatternFrames; k++) {
+    pattern.offsets.push_back(static_cast<std::size_t>(width) * 2 * k * step);
+    pattern.sizes.push_back(static_cast<std::size_t>(width) * 2 * height);
+  }
+}
+
+void SyntheticBackend::RenderDepth(int width, int height) {
+  const int period = std::max(1, height / kPatternFrames) * kPatternFrames;
+  const int step = period / kPatternFrames;
+
+  Pattern &pattern = depth_pattern_;
+  pattern.format = ImageFormat::DEPTH_RAW;
+  pattern.width = width;
+  pattern.height = height;
+  pattern.offsets.clear();
+  pattern.sizes.clear();
+  pattern.data = std::make_shared<std::vector<std::uint8_t>>();
+  auto &&data = *pattern.data;
+
+  const int rows = height + (kPatternFrames - 1) * step;
+  data.resize(static_cast<std::size_t>(width) * 2 * rows);
+  std::uint16_t* p = reinterpret_cast<std::uint16_t*>(data.data());
+  for (int y = 0; y < rows; y++) {
+    for (int x = 0; x < width; x++) {
+      *p++ = slope_depth(x, y, period);
+    }
+  }
+  for (int k = 0; k < kPatternFrames; k++) {
+    pattern.offsets.push_back(static_cast<std::size_t>(width) * 2 * k * step);
+    pattern.sizes.push_back(static_cast<std::size_t>(width) * 2 * height);
+  }
+}
+
+void SyntheticBackend::Run() {
+  const auto frame_period = std::chrono::duration_cast<clock::duration>(
+      std::chrono::duration<double>(1. / framerate_));
+  const bool with_imu = params_.hid && params_.imu_rate > 0;
+  const auto imu_period = std::chrono::duration_cast<clock::duration>(
+      std::chrono::duration<double>(with_imu ? 1. / params_.imu_rate : 0));
+  const auto jitter = std::chrono::duration_cast<clock::duration>(
+      std::chrono::duration<double, std::milli>(params_.jitter_ms));
+
+  // timestamps of the device, in 0.01 ms
+  auto to_timestamp = [](const clock::duration& time) {
+    return static_cast<std::uint32_t>(
+        std::chrono::duration_cast<std::chrono::microseconds>(time).count()
+        / 10);
+  };
+
+  // jitter and drops drawn for each frame in order, the same of the seed
+  std::uniform_real_distribution<double> uniform(0, 1);
+  struct Draw {
+    clock::duration delay;
+    bool color, depth, info;
+  };
+  auto draw = [&]() {
+    Draw d;
+    d.delay = std::chrono::duration_cast<clock::duration>(
+        jitter * uniform(random_));
+    d.color = uniform(random_) >= params_.drop_rate;
+    d.depth = uniform(random_) >= params_.drop_rate;
+    d.info = uniform(random_) >= params_.drop_rate;
+    return d;
+  };
+
+  const auto begin = clock::now();
+  std::uint64_t frame = 0, imu = 0;
+  clock::time_point delivered = begin;
+  Draw next = draw();
+  while (true) {
+    clock::time_point frame_time = begin + frame * frame_period;
+    // frames are delivered in order, a delay may delay the next
+    clock::time_point delivery = std::max(delivered, frame_time + next.delay);
+    if (with_imu && begin + imu * imu_period < delivery) {
+      clock::time_point imu_time = begin + imu * imu_period;
+      if (!WaitUntil(imu_time)) return;
+      DeliverImu(imu++, to_timestamp(imu_time - begin));
+      continue;
+    }
+    if (!WaitUntil(delivery)) return;
+    // lost if later than the next frame, as overwritten on the device
+    if (clock::now() - delivery < frame_period) {
+      DeliverFrame(frame, to_timestamp(frame_time - begin),
+          next.color, next.depth, next.info);
+    }
+    delivered = delivery;
+    frame++;
+    next = draw();
+  }
+}
+
+bool SyntheticBackend::WaitUntil(const clock::time_point& time) {
+  std::unique_lock<std::mutex> lock(mutex_);
+  condition_.wait_until(lock, time, [this]() { return !running_; });
+  return running_;
+}
+
+void SyntheticBackend::DeliverFrame(std::uint64_t index,
+    std::uint32_t timestamp, bool color, bool depth, bool info) {
+  int frame_id = static_cast<int>(
+      (params_.frame_id_start + index) % params_.frame_id_wrap);
+
+  // the info first, for the image to match it as it arrives
+  if (info && params_.hid) {
+    ImgInfoPacket packet;
+    packet.frame_id = static_cast<std::uint16_t>(frame_id);
+    packet.timestamp = timestamp;
+    packet.exposure_time = kExposureTime;
+    img_callback_t callback;
+    {
+      std::lock_guard<std::mutex> _(mtx_callbacks_);
+      callback = img_callback_;
+    }
+    if (callback) callback(packet);
+  }
+
+  if (!color && !depth) return;
+  {
+    std::lock_guard<std::mutex> _(mutex_);
+    if (color) color_ = Frame(color_pattern_, index, frame_id);
+    if (depth) depth_ = Frame(depth_pattern_, index, frame_id);
+  }
+  condition_.notify_all();
+}
+
+void SyntheticBackend::DeliverImu(std::uint64_t index,
+    std::uint32_t timestamp) {
+  imu_callback_t callback;
+  {
+    std::lock_guard<std::mutex> _(mtx_callbacks_);
+    callback = imu_callback_;
+  }
+  if (!callback) return;
+
+  // a slow sway of 0.05 g and 10 deg/s at 0.5 Hz, under 1 g, at 25 degrees
+  double t = static_cast<double>(index) / params_.imu_rate;
+  double sway = std::sin(2 * kPi * 0.5 * t);
+  ImuPacket packet;
+  packet.segments.resize(2);
+  auto &&accel = packet.segments[0];
+  accel.flag = 1;
+  accel.timestamp = timestamp;
+  accel.temperature = 16;
+  accel.accel_or_gyro[0] =
+      static_cast<std::int16_t>(0.05 * sway * 0x10000 / 12);
+  accel.accel_or_gyro[1] = 0;
+  accel.accel_or_gyro[2] = static_cast<std::int16_t>(0x10000 / 12);
+  auto &&gyro = packet.segments[1];
+  gyro.flag = 2;
+  gyro.timestamp = timestamp;
+  gyro.temperature = 16;
+  gyro.accel_or_gyro[0] = 0;
+  gyro.accel_or_gyro[1] = 0;
+  gyro.accel_or_gyro[2] =
+      static_cast<std::int16_t>(10 * sway * 0x10000 / 2000);
+  callback(packet);
+}
+
+Image::pointer SyntheticBackend::Frame(const Pattern& pattern,
+    std::uint64_t index, int frame_id) const {
+  std::size_t k = index % pattern.offsets.size();
+  const std::uint8_t* data = pattern.data->data() + pattern.offsets[k];
+  Image::pointer image;
+  if (pattern.format == ImageFormat::DEPTH_RAW) {
+    image = ImageDepth::CreateView(pattern.format, pattern.width,
+        pattern.height, data, pattern.sizes[k], pattern.data);
+  } else {
+    image = ImageColor::CreateView(pattern.format, pattern.width,
+        pattern.height, data, pattern.sizes[k], pattern.data);
+  }
+  image->set_frame_id(frame_id);
+  return image;
+}
+
+Image::pointer SyntheticBackend::Take(Image::pointer* slot, ErrorCode* code) {
+  std::unique_lock<std::mutex> lock(mutex_);
+  condition_.wait_for(lock, kRetrieveTimeout, [this, slot]() {
+    return *slot || !running_;
+  });
+  if (!*slot) {
+    *code = ErrorCode::ERROR_CAMERA_RETRIEVE_FAILED;
+    return nullptr;
+  }
+  Image::pointer image = std::move(*slot);
+  *slot = nullptr;
+  *code = ErrorCode::SUCCESS;
+  return image;
+}
+
+Image::pointer SyntheticBackend::RetrieveImageColor(ErrorCode* code) {
+  return Take(&color_, code);
+}
+
+Image::pointer SyntheticBackend::RetrieveImageDepth(ErrorCode* code) {
+  return Take(&depth_, code);
+}
+
+bool SyntheticBackend::IsHidExist() {
+  return params_.hid;
+}
+
+bool SyntheticBackend::StartHidTracking(imu_callback_t imu_callback,
+    img_callback_t img_callback) {
+  std::lock_guard<std::mutex> _(mtx_callbacks_);
+  imu_callback_ = imu_callback;
+  img_callback_ = img_callback;
+  return true;
+}
+
+void SyntheticBackend::StopHidTracking() {
+  std::lock_guard<std::mutex> _(mtx_callbacks_);
+  imu_callback_ = nullptr;
+  img_callback_ = nullptr;
+}
+
+bool SyntheticBackend::GetFiles(DeviceParams* info,
+    imu_params_t* imu_params) {
+  info->name = "MYNT-EYE-D synthetic";
+  info->serial_number = params_.name;
+  info->nominal_baseline = static_cast<std::uint16_t>(kBaseline);
+  imu_params->ok = false;
+  return true;
+}
+
+bool SyntheticBackend::GetRectifyLogData(int index,
+    CameraCtrlRectLogData* data) {
+  // a rectified pinhole of the eye, 0 HD or 1 VGA
+  int width = index == 0 ? 1280 : 640;
+  int height = index == 0 ? 720 : 480;
+  float f = kFocalScale * width;
+  float cx = width / 2.f, cy = height / 2.f;
+
+  std::memset(data, 0, sizeof(*data));
+  data->InImgWidth = data->OutImgWidth =
+      static_cast<unsigned short>(width * 2);  // NOLINT
+  data->InImgHeight = data->OutImgHeight =
+      static_cast<unsigned short>(height);  // NOLINT
+  const float cam[9] = {f, 0, cx, 0, f, cy, 0, 0, 1};
+  const float eye[9] = {1, 0, 0, 0, 1, 0, 0, 0, 1};
+  std::copy(cam, cam + 9, data->CamMat1);
+  std::copy(cam, cam + 9, data->CamMat2);
+  std::copy(eye, eye + 9, data->RotaMat);
+  std::copy(eye, eye + 9, data->LRotaMat);
+  std::copy(eye, eye + 9, data->RRotaMat);
+  data->TranMat[0] = -kBaseline;
+  const float proj[12] = {f, 0, cx, 0, 0, f, cy, 0, 0, 0, 1, 0};
+  std::copy(proj, proj + 12, data->NewCamMat1);
+  std::copy(proj, proj + 12, data->NewCamMat2);
+  data->NewCamMat2[3] = -f * kBaseline;
+  return true;
+}
+
+MYNTEYE_END_NAMESPACE
@@ -0,0 +1,119 @@
+// Copyright 2018 Slightech Co., Ltd. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#ifndef MYNTEYE_INTERNAL_SYNTHETIC_BACKEND_H_
+#define MYNTEYE_INTERNAL_SYNTHETIC_BACKEND_H_
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include "mynteye/internal/backend.h"
+
+MYNTEYE_BEGIN_NAMESPACE
+
+/**
+ * The backend of a test pattern, generated as a device at any size and rate.
+ *
+ * A thread ticks the frames and imu at their rates. Each frame posts a color
+ * of moving bars, YUYV or MJPG, and a DEPTH_RAW of a moving slope into a slot
+ * of its stream, overwritten as the device does, and calls back its image
+ * info. The patterns are rendered on open, a frame is a view into them.
+ *
+ * Frames may be delayed and dropped, by the seed, and frame ids wrap as set.
+ * The calibration is a pinhole of the stream mode, without the imu params.
+ */
+class MYNTEYE_API SyntheticBackend : public Backend {
+ public:
+  explicit SyntheticBackend(const SyntheticParams& params);
+  ~SyntheticBackend();
+
+  void GetDevices(std::vector<DeviceInfo>* dev_infos) override;
+  void GetResolutions(const std::int32_t& dev_index,
+      std::vector<StreamInfo>* color_infos,
+      std::vector<StreamInfo>* depth_infos) override;
+
+  ErrorCode Open(InitParams* params) override;
+  void Close() override;
+  bool IsOpened() const override;
+
+  Image::pointer RetrieveImageColor(ErrorCode* code) override;
+  Image::pointer RetrieveImageDepth(ErrorCode* code) override;
+
+  bool IsHidExist() override;
+  bool StartHidTracking(imu_callback_t imu_callback,
+      img_callback_t img_callback) override;
+  void StopHidTracking() override;
+  bool GetFiles(DeviceParams* info, imu_params_t* imu_params) override;
+
+  bool GetRectifyLogData(int index, CameraCtrlRectLogData* data) override;
+
+ private:
+  using clock = std::chrono::steady_clock;
+
+  /** Frames of the pattern, each a view of size bytes at offset. */
+  struct Pattern {
+    ImageFormat format;
+    int width;
+    int height;
+    std::vector<std::size_t> offsets;
+    std::vector<std::size_t> sizes;
+    std::shared_ptr<std::vector<std::uint8_t>> data;
+  };
+
+  void RenderColor(StreamFormat* format, int width, int height);
+  void RenderDepth(int width, int height);
+
+  void Run();
+  /** Wait till time, false if closed meanwhile. */
+  bool WaitUntil(const clock::time_point& time);
+  /** Deliver the frame of index, of the color, depth and info not dropped. */
+  void DeliverFrame(std::uint64_t index, std::uint32_t timestamp,
+      bool color, bool depth, bool info);
+  void DeliverImu(std::uint64_t index, std::uint32_t timestamp);
+  Image::pointer Frame(const Pattern& pattern, std::uint64_t index,
+      int frame_id) const;
+  Image::pointer Take(Image::pointer* slot, ErrorCode* code);
+
+  SyntheticParams params_;
+
+  Pattern color_pattern_;
+  Pattern depth_pattern_;
+  int framerate_;
+
+  std::mutex mutex_;
+  std::condition_variable condition_;
+  std::thread thread_;
+  bool running_;
+  Image::pointer color_;
+  Image::pointer depth_;
+
+  std::atomic<bool> opened_;
+
+  std::mt19937 random_;
+
+  std::mutex mtx_callbacks_;
+  imu_callback_t imu_callback_;
+  img_callback_t img_callback_;
+};
+
+MYNTEYE_END_NAMESPACE
+
+#endif  // MYNTEYE_INTERNAL_SYNTHETIC_BACKEND_H_
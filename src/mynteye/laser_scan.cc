@@ -0,0 +1,140 @@
+// Copyright 2018 Slightech Co., Ltd. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include "mynteye/laser_scan.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#include "mynteye/util/depth.h"
+#include "mynteye/util/log.h"
+#include "mynteye/util/parallel.h"
+
+MYNTEYE_BEGIN_NAMESPACE
+
+namespace {
+
+const int kMinBandCols = 64;
+/** Invalid depth while reducing, above any valid one. */
+const std::uint16_t kNone = 0xFFFF;
+
+}  // namespace
+
+LaserScanProjector::LaserScanProjector(const CameraIntrinsics& in,
+    int row_begin, int row_end, int bins, float range_min, float range_max,
+    float depth_unit)
+  : in_(in),
+    row_begin_(std::max(0, std::min(row_begin, in.height))),
+    row_end_(std::max(0, std::min(row_end, in.height))),
+    bins_(bins > 0 ? bins : in.width),
+    range_min_(range_min), range_max_(range_max),
+    angle_min_(0), angle_max_(0), angle_increment_(0) {
+  if (in_.width <= 0 || in_.fx <= 0 || row_begin_ >= row_end_) {
+    LOGE("Error: LaserScanProjector:: intrinsics or rows are invalid");
+    row_end_ = row_begin_;
+  }
+  const int width = std::max(0, in_.width);
+  // counterclockwise from above, so the right of the image is negative
+  auto angle = [this](int u) {
+    return static_cast<float>(std::atan2(-(u - in_.cx), in_.fx));
+  };
+  angle_min_ = angle(width - 1);
+  angle_max_ = angle(0);
+  if (bins_ > 1) {
+    angle_increment_ = (angle_max_ - angle_min_) / (bins_ - 1);
+  }
+
+  scales_.resize(width);
+  bins_first_.resize(width);
+  bins_last_.resize(width);
+  // bins whose angles are in [lo, hi], the nearest one if none
+  auto to_bins = [this](double lo, double hi, std::int32_t* first,
+      std::int32_t* last) {
+    if (angle_increment_ <= 0) {
+      *first = *last = 0;
+      return;
+    }
+    double a = (lo - angle_min_) / angle_increment_;
+    double b = (hi - angle_min_) / angle_increment_;
+    int i0 = static_cast<int>(std::ceil(a));
+    int i1 = static_cast<int>(std::floor(b));
+    if (i0 > i1) i0 = i1 = static_cast<int>(std::lround((a + b) / 2));
+    *first = std::max(0, std::min(bins_ - 1, i0));
+    *last = std::max(0, std::min(bins_ - 1, i1));
+  };
+  for (int u = 0; u < width; u++) {
+    double x = (u - in_.cx) / in_.fx;
+    scales_[u] = static_cast<float>(depth_unit * std::sqrt(1 + x * x));
+    // the column spans [u - 0.5, u + 0.5], so no bin falls between two
+    to_bins(std::atan2(-(u + 0.5 - in_.cx), in_.fx),
+        std::atan2(-(u - 0.5 - in_.cx), in_.fx),
+        &bins_first_[u], &bins_last_[u]);
+  }
+}
+
+LaserScanProjector::~LaserScanProjector() {
+}
+
+void LaserScanProjector::Project(const std::uint16_t* depth,
+    std::size_t step, LaserScan* scan) const {
+  const int width = static_cast<int>(scales_.size());
+  scan->angle_min = angle_min_;
+  scan->angle_max = angle_max_;
+  scan->angle_increment = angle_increment_;
+  scan->range_min = range_min_;
+  scan->range_max = range_max_;
+  scan->ranges.assign(bins_, std::numeric_limits<float>::infinity());
+  if (!depth || row_begin_ >= row_end_) return;
+
+  // nearest depth of each column over the band
+  buffer_t<std::uint16_t> nearest(width);
+  parallel::for_each(width, [&](int begin, int end) {
+    std::uint16_t* n = nearest.data();
+    std::fill(n + begin, n + end, kNone);
+    for (int v = row_begin_; v < row_end_; v++) {
+      const std::uint16_t* row = reinterpret_cast<const std::uint16_t*>(
+          reinterpret_cast<const std::uint8_t*>(depth) + v * step);
+      for (int u = begin; u < end; u++) {
+        std::uint16_t d = depth::is_valid(row[u]) ? row[u] : kNone;
+        n[u] = std::min(n[u], d);
+      }
+    }
+  }, kMinBandCols);
+
+  float* ranges = scan->ranges.data();
+  for (int u = 0; u < width; u++) {
+    if (nearest[u] == kNone) continue;
+    float range = nearest[u] * scales_[u];
+    if (range < range_min_ || range > range_max_) continue;
+    for (int b = bins_first_[u]; b <= bins_last_[u]; b++) {
+      ranges[b] = std::min(ranges[b], range);
+    }
+  }
+}
+
+bool LaserScanProjector::Project(const Image::pointer& depth,
+    LaserScan* scan) const {
+  if (!depth || depth->format() != ImageFormat::DEPTH_RAW ||
+      depth->width() != in_.width || depth->height() != in_.height) {
+    LOGE("Error: LaserScanProjector:: depth must be DEPTH_RAW of %dx%d",
+        in_.width, in_.height);
+    return false;
+  }
+  scan->frame_id = depth->frame_id();
+  Project(reinterpret_cast<const std::uint16_t*>(depth->cdata()),
+      depth->width() * sizeof(std::uint16_t), scan);
+  return true;
+}
+
+MYNTEYE_END_NAMESPACE
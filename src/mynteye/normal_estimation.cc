@@ -0,0 +1,189 @@
+// Copyright 2018 Slightech Co., Ltd. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include "mynteye/normal_estimation.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <limits>
+
+#include "mynteye/util/log.h"
+#include "mynteye/util/parallel.h"
+
+MYNTEYE_BEGIN_NAMESPACE
+
+namespace {
+
+const int kMinBandRows = 8;
+const int kMinBandCols = 64;
+
+}  // namespace
+
+NormalEstimator::NormalEstimator(const CameraIntrinsics& in, int radius,
+    float max_depth_change, float depth_unit)
+  : cloud_(in, depth_unit), radius_(std::max(1, radius)),
+    max_depth_change_(max_depth_change) {
+}
+
+NormalEstimator::~NormalEstimator() {
+}
+
+void NormalEstimator::Integrate() {
+  const int w = cloud_.GetIntrinsics().width;
+  const int h = cloud_.GetIntrinsics().height;
+  const int stride = w + 1;
+  const std::size_t size = static_cast<std::size_t>(stride) * (h + 1);
+  sum_x_.assign(size, 0);
+  sum_y_.assign(size, 0);
+  sum_z_.assign(size, 0);
+  count_.assign(size, 0);
+  // prefix of each row, rows in parallel
+  parallel::for_each(h, [&](int begin, int end) {
+    for (int v = begin; v < end; v++) {
+      const PointXYZ* p = points_.data() + v * w;
+      const std::size_t row = (v + 1) * stride + 1;
+      double* sx = sum_x_.data() + row;
+      double* sy = sum_y_.data() + row;
+      double* sz = sum_z_.data() + row;
+      std::uint32_t* c = count_.data() + row;
+      double ax = 0, ay = 0, az = 0;
+      std::uint32_t n = 0;
+      for (int u = 0; u < w; u++) {
+        // NaN is not equal to itself, no depth adds nothing
+        bool valid = p[u].z == p[u].z;
+        ax += valid ? p[u].x : 0;
+        ay += valid ? p[u].y : 0;
+        az += valid ? p[u].z : 0;
+        n += valid;
+        sx[u] = ax;
+        sy[u] = ay;
+        sz[u] = az;
+        c[u] = n;
+      }
+    }
+  }, kMinBandRows);
+  // then down the columns, a band of columns adds whole row spans
+  parallel::for_each(stride, [&](int begin, int end) {
+    for (int v = 1; v <= h; v++) {
+      const std::size_t row = v * stride, prev = row - stride;
+      for (int u = begin; u < end; u++) {
+        sum_x_[row + u] += sum_x_[prev + u];
+        sum_y_[row + u] += sum_y_[prev + u];
+        sum_z_[row + u] += sum_z_[prev + u];
+        count_[row + u] += count_[prev + u];
+      }
+    }
+  }, kMinBandCols);
+}
+
+std::size_t NormalEstimator::Compute(const std::uint16_t* depth,
+    std::size_t step, Normal* normals) {
+  const int w = cloud_.GetIntrinsics().width;
+  const int h = cloud_.GetIntrinsics().height;
+  points_.resize(static_cast<std::size_t>(w) * h);
+  cloud_.Generate(depth, step, points_.data());
+  Integrate();
+
+  const float nan = std::numeric_limits<float>::quiet_NaN();
+  const int r = radius_, border = 2 * radius_;
+  const std::size_t stride = w + 1;
+  const double max_change = max_depth_change_;
+  std::atomic<std::size_t> total(0);
+  parallel::for_each(h, [&](int begin, int end) {
+    std::size_t valid_count = 0;
+    for (int v = begin; v < end; v++) {
+      Normal* out = normals + v * w;
+      if (v < border || v >= h - border || w <= 2 * border) {
+        std::fill(out, out + w, Normal{nan, nan, nan});
+        continue;
+      }
+      const PointXYZ* p = points_.data() + v * w;
+      // rows of the box corners: left/right boxes span v -+ r, down/up
+      // boxes span [v, v + 2r] and [v - 2r, v]
+      const std::size_t rm = (v - r) * stride, rp = (v + r + 1) * stride;
+      const std::size_t ru = (v - border) * stride, rc0 = v * stride;
+      const std::size_t rc1 = (v + 1) * stride;
+      const std::size_t rd = (v + border + 1) * stride;
+      auto box = [&](const double* s, std::size_t y0, std::size_t y1,
+          int x0, int x1) {
+        return s[y1 + x1] - s[y0 + x1] - s[y1 + x0] + s[y0 + x0];
+      };
+      auto count = [&](std::size_t y0, std::size_t y1, int x0, int x1) {
+        const std::uint32_t* c = count_.data();
+        return c[y1 + x1] - c[y0 + x1] - c[y1 + x0] + c[y0 + x0];
+      };
+      std::fill(out, out + border, Normal{nan, nan, nan});
+      std::fill(out + w - border, out + w, Normal{nan, nan, nan});
+      for (int u = border; u < w - border; u++) {
+        const double* sx = sum_x_.data();
+        const double* sy = sum_y_.data();
+        const double* sz = sum_z_.data();
+        // right [u, u + 2r] and left [u - 2r, u] over rows [v - r, v + r]
+        std::uint32_t cr = count(rm, rp, u, u + border + 1);
+        std::uint32_t cl = count(rm, rp, u - border, u + 1);
+        // down [v, v + 2r] and up [v - 2r, v] over cols [u - r, u + r]
+        std::uint32_t cd = count(rc0, rd, u - r, u + r + 1);
+        std::uint32_t cu = count(ru, rc1, u - r, u + r + 1);
+        double ir = 1. / std::max(cr, 1u), il = 1. / std::max(cl, 1u);
+        double id = 1. / std::max(cd, 1u), iu = 1. / std::max(cu, 1u);
+        double dxx = box(sx, rm, rp, u, u + border + 1) * ir -
+            box(sx, rm, rp, u - border, u + 1) * il;
+        double dxy = box(sy, rm, rp, u, u + border + 1) * ir -
+            box(sy, rm, rp, u - border, u + 1) * il;
+        double dxz = box(sz, rm, rp, u, u + border + 1) * ir -
+            box(sz, rm, rp, u - border, u + 1) * il;
+        double dyx = box(sx, rc0, rd, u - r, u + r + 1) * id -
+            box(sx, ru, rc1, u - r, u + r + 1) * iu;
+        double dyy = box(sy, rc0, rd, u - r, u + r + 1) * id -
+            box(sy, ru, rc1, u - r, u + r + 1) * iu;
+        double dyz = box(sz, rc0, rd, u - r, u + r + 1) * id -
+            box(sz, ru, rc1, u - r, u + r + 1) * iu;
+        double nx = dxy * dyz - dxz * dyy;
+        double ny = dxz * dyx - dxx * dyz;
+        double nz = dxx * dyy - dxy * dyx;
+        double norm = std::sqrt(nx * nx + ny * ny + nz * nz);
+        const PointXYZ& c = p[u];
+        const double limit = max_change * c.z;
+        // face the camera, the normal against the ray of the pixel
+        double sign = nx * c.x + ny * c.y + nz * c.z > 0 ? -1 : 1;
+        double scale = sign / std::max(norm, 1e-12);
+        bool valid = (c.z == c.z) & (cr > 0) & (cl > 0) & (cd > 0) &
+            (cu > 0) & (std::abs(dxz) <= limit) & (std::abs(dyz) <= limit) &
+            (norm > 0);
+        out[u].x = valid ? static_cast<float>(nx * scale) : nan;
+        out[u].y = valid ? static_cast<float>(ny * scale) : nan;
+        out[u].z = valid ? static_cast<float>(nz * scale) : nan;
+        valid_count += valid;
+      }
+    }
+    total += valid_count;
+  }, kMinBandRows);
+  return total;
+}
+
+std::size_t NormalEstimator::Compute(const Image::pointer& depth,
+    buffer_t<Normal>* normals) {
+  const CameraIntrinsics& in = cloud_.GetIntrinsics();
+  if (!depth || depth->format() != ImageFormat::DEPTH_RAW ||
+      depth->width() != in.width || depth->height() != in.height) {
+    LOGE("Error: NormalEstimator:: depth must be DEPTH_RAW of %dx%d",
+        in.width, in.height);
+    return 0;
+  }
+  normals->resize(static_cast<std::size_t>(in.width) * in.height);
+  return Compute(reinterpret_cast<const std::uint16_t*>(depth->cdata()),
+      depth->width() * sizeof(std::uint16_t), normals->data());
+}
+
+MYNTEYE_END_NAMESPACE
@@ -0,0 +1,349 @@
+// Copyright 2018 Slightech Co., Ltd. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include "mynteye/plane_fit.h"
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <utility>
+
+#include "mynteye/util/depth.h"
+#include "mynteye/util/log.h"
+#include "mynteye/util/parallel.h"
+
+MYNTEYE_BEGIN_NAMESPACE
+
+namespace {
+
+const int kMinBandRows = 16;
+const int kRefineIterations = 2;
+const int kJacobiSweeps = 8;
+const double kPi = 3.14159265358979323846;
+
+/** Plane through three points, facing the camera, false if degenerate. */
+bool plane_of(const float* p0, const float* p1, const float* p2,
+    Plane* plane) {
+  float ux = p1[0] - p0[0], uy = p1[1] - p0[1], uz = p1[2] - p0[2];
+  float vx = p2[0] - p0[0], vy = p2[1] - p0[1], vz = p2[2] - p0[2];
+  float nx = uy * vz - uz * vy;
+  float ny = uz * vx - ux * vz;
+  float nz = ux * vy - uy * vx;
+  float norm = std::sqrt(nx * nx + ny * ny + nz * nz);
+  if (!(norm > 1e-9f)) return false;
+  float d = -(nx * p0[0] + ny * p0[1] + nz * p0[2]) / norm;
+  float sign = d < 0 ? -1.f : 1.f;
+  plane->a = sign * nx / norm;
+  plane->b = sign * ny / norm;
+  plane->c = sign * nz / norm;
+  plane->d = sign * d;
+  return true;
+}
+
+/**
+ * Eigenvector of the smallest eigenvalue of symmetric m, by cyclic Jacobi
+ * rotations.
+ */
+void smallest_eigenvector(double m[3][3], double vec[3]) {
+  double v[3][3] = {{1, 0, 0}, {0, 1, 0}, {0, 0, 1}};
+  for (int sweep = 0; sweep < kJacobiSweeps; sweep++) {
+    double off = m[0][1] * m[0][1] + m[0][2] * m[0][2] + m[1][2] * m[1][2];
+    if (off < 1e-30) break;
+    for (int p = 0; p < 2; p++) {
+      for (int q = p + 1; q < 3; q++) {
+        if (m[p][q] == 0) continue;
+        double theta = (m[q][q] - m[p][p]) / (2 * m[p][q]);
+        double t = (theta >= 0 ? 1. : -1.) /
+            (std::abs(theta) + std::sqrt(theta * theta + 1));
+        double c = 1 / std::sqrt(t * t + 1), s = t * c;
+        // m = J^T m J, J the rotation in the p, q plane
+        for (int k = 0; k < 3; k++) {
+          double mkp = m[k][p], mkq = m[k][q];
+          m[k][p] = c * mkp - s * mkq;
+          m[k][q] = s * mkp + c * mkq;
+        }
+        for (int k = 0; k < 3; k++) {
+          double mpk = m[p][k], mqk = m[q][k];
+          m[p][k] = c * mpk - s * mqk;
+          m[q][k] = s * mpk + c * mqk;
+        }
+        for (int k = 0; k < 3; k++) {
+          double vkp = v[k][p], vkq = v[k][q];
+          v[k][p] = c * vkp - s * vkq;
+          v[k][q] = s * vkp + c * vkq;
+        }
+      }
+    }
+  }
+  int min = 0;
+  for (int i = 1; i < 3; i++) {
+    if (m[i][i] < m[min][min]) min = i;
+  }
+  for (int k = 0; k < 3; k++) vec[k] = v[k][min];
+}
+
+/**
+ * Inliers of a depth row, the plane distance of pixel u being
+ * z * (kx[u] + ky) + d. Values as arguments, so the stores of bytes do not
+ * make the compiler reload them and the loop vectorizes.
+ */
+void mask_row(const std::uint16_t* depth, const float* kx, float ky, float d,
+    int w, float unit, float threshold, float max_depth, std::uint8_t* out) {
+  for (int u = 0; u < w; u++) {
+    const float z = depth[u] * unit;
+    const float dist = std::abs(z * (kx[u] + ky) + d);
+    int in = (depth[u] != depth::kOutOfRange) & (z > 0) & (z <= max_depth) &
+        (dist < threshold);
+    out[u] = static_cast<std::uint8_t>(-in);
+  }
+}
+
+}  // namespace
+
+PlaneFitter::PlaneFitter(const CameraIntrinsics& in,
+    const PlaneFitParams& params, float depth_unit)
+  : in_(in), params_(params), depth_unit_(depth_unit), has_previous_(false),
+    previous_{0, 0, 0, 0}, previous_ratio_(0), inliers_(0), seed_(0) {
+  params_.step = std::max(1, params_.step);
+  params_.iterations = std::max(1, params_.iterations);
+  params_.score_points = std::max(3, params_.score_points);
+  rays_x_.resize(in_.width);
+  for (int u = 0; u < in_.width; u++) {
+    rays_x_[u] = static_cast<float>((u - in_.cx) / in_.fx);
+  }
+  rays_y_.resize(in_.height);
+  for (int v = 0; v < in_.height; v++) {
+    rays_y_[v] = static_cast<float>((v - in_.cy) / in_.fy);
+  }
+}
+
+PlaneFitter::~PlaneFitter() {
+}
+
+void PlaneFitter::Reset() {
+  has_previous_ = false;
+  previous_ratio_ = 0;
+  inliers_ = 0;
+}
+
+void PlaneFitter::Sample(const std::uint16_t* depth, std::size_t step) {
+  const int s = params_.step;
+  const float max_depth = params_.max_depth;
+  const std::size_t capacity = static_cast<std::size_t>(
+      (in_.width - s / 2 + s - 1) / s) * ((in_.height - s / 2 + s - 1) / s);
+  xs_.resize(capacity);
+  ys_.resize(capacity);
+  zs_.resize(capacity);
+  // write every point, advance past the valid ones only
+  std::size_t n = 0;
+  for (int v = s / 2; v < in_.height; v += s) {
+    const std::uint16_t* row = reinterpret_cast<const std::uint16_t*>(
+        reinterpret_cast<const std::uint8_t*>(depth) + v * step);
+    const float ry = rays_y_[v];
+    for (int u = s / 2; u < in_.width; u += s) {
+      const std::uint16_t d = row[u];
+      const float z = d * depth_unit_;
+      xs_[n] = rays_x_[u] * z;
+      ys_[n] = ry * z;
+      zs_[n] = z;
+      n += depth::is_valid(d) & (z <= max_depth);
+    }
+  }
+  xs_.resize(n);
+  ys_.resize(n);
+  zs_.resize(n);
+  // spread the points scored to the whole image, moving every stride-th
+  // point to the front
+  const std::size_t m = params_.score_points;
+  if (n > m) {
+    const std::size_t stride = n / m;
+    for (std::size_t i = 1; i < m; i++) {
+      std::swap(xs_[i], xs_[i * stride]);
+      std::swap(ys_[i], ys_[i * stride]);
+      std::swap(zs_[i], zs_[i * stride]);
+    }
+  }
+}
+
+std::size_t PlaneFitter::Score(const Plane& plane, std::size_t n) const {
+  const float* x = xs_.data();
+  const float* y = ys_.data();
+  const float* z = zs_.data();
+  const float a = plane.a, b = plane.b, c = plane.c, d = plane.d;
+  const float t = params_.threshold;
+  // branch free
+  std::uint32_t count = 0;
+  for (std::size_t i = 0; i < n; i++) {
+    count += std::abs(a * x[i] + b * y[i] + c * z[i] + d) < t;
+  }
+  return count;
+}
+
+bool PlaneFitter::Accept(const Plane& plane) const {
+  if (!params_.use_axis) return true;
+  const float* axis = params_.axis;
+  float norm = std::sqrt(axis[0] * axis[0] + axis[1] * axis[1] +
+      axis[2] * axis[2]);
+  if (!(norm > 0)) return true;
+  float cos = (plane.a * axis[0] + plane.b * axis[1] + plane.c * axis[2]) /
+      norm;
+  return std::abs(cos) >= std::cos(params_.max_angle * kPi / 180);
+}
+
+bool PlaneFitter::Refine(Plane* plane, std::size_t n) const {
+  const float* x = xs_.data();
+  const float* y = ys_.data();
+  const float* z = zs_.data();
+  const float t = params_.threshold;
+  Plane p = *plane;
+  for (int it = 0; it < kRefineIterations; it++) {
+    // centroid and covariance of the inliers, weights of 0 or 1 keep the
+    // loop branch free
+    double w = 0, sx = 0, sy = 0, sz = 0;
+    double sxx = 0, sxy = 0, sxz = 0, syy = 0, syz = 0, szz = 0;
+    for (std::size_t i = 0; i < n; i++) {
+      double in = std::abs(p.a * x[i] + p.b * y[i] + p.c * z[i] + p.d) < t;
+      double xi = x[i], yi = y[i], zi = z[i];
+      w += in;
+      sx += in * xi;
+      sy += in * yi;
+      sz += in * zi;
+      sxx += in * xi * xi;
+      sxy += in * xi * yi;
+      sxz += in * xi * zi;
+      syy += in * yi * yi;
+      syz += in * yi * zi;
+      szz += in * zi * zi;
+    }
+    if (w < 3) return false;
+    double cx = sx / w, cy = sy / w, cz = sz / w;
+    double m[3][3] = {
+      {sxx / w - cx * cx, sxy / w - cx * cy, sxz / w - cx * cz},
+      {0, syy / w - cy * cy, syz / w - cy * cz},
+      {0, 0, szz / w - cz * cz},
+    };
+    m[1][0] = m[0][1];
+    m[2][0] = m[0][2];
+    m[2][1] = m[1][2];
+    double normal[3];
+    smallest_eigenvector(m, normal);
+    double d = -(normal[0] * cx + normal[1] * cy + normal[2] * cz);
+    double sign = d < 0 ? -1 : 1;
+    p.a = static_cast<float>(sign * normal[0]);
+    p.b = static_cast<float>(sign * normal[1]);
+    p.c = static_cast<float>(sign * normal[2]);
+    p.d = static_cast<float>(sign * d);
+  }
+  *plane = p;
+  return true;
+}
+
+void PlaneFitter::Mask(const std::uint16_t* depth, std::size_t step,
+    const Plane& plane, std::uint8_t* mask) const {
+  const int w = in_.width;
+  // the point of a pixel is z * (rx, ry, 1), so its distance to the plane
+  // is z * (a * rx + b * ry + c) + d
+  buffer_t<float> ka(w);
+  for (int u = 0; u < w; u++) ka[u] = plane.a * rays_x_[u];
+  const float t = params_.threshold, unit = depth_unit_;
+  const float max_depth = params_.max_depth;
+  parallel::for_each(in_.height, [&](int begin, int end) {
+    for (int v = begin; v < end; v++) {
+      mask_row(reinterpret_cast<const std::uint16_t*>(
+          reinterpret_cast<const std::uint8_t*>(depth) + v * step),
+          ka.data(), plane.b * rays_y_[v] + plane.c, plane.d, w, unit, t,
+          max_depth, mask + static_cast<std::size_t>(v) * w);
+    }
+  }, kMinBandRows);
+}
+
+bool PlaneFitter::Fit(const std::uint16_t* depth, std::size_t step,
+    Plane* plane, std::uint8_t* mask) {
+  Sample(depth, step);
+  const std::size_t n = zs_.size();
+  const std::size_t m = std::min<std::size_t>(n, params_.score_points);
+  auto fail = [&]() {
+    Reset();
+    if (mask) {
+      std::fill(mask, mask + static_cast<std::size_t>(in_.width) * in_.height,
+          0);
+    }
+    return false;
+  };
+  if (n < 3) return fail();
+
+  Plane best{0, 0, 0, 0};
+  std::size_t best_score = 0;
+  int iterations = params_.iterations;
+  if (params_.warm_start && has_previous_) {
+    best = previous_;
+    best_score = Score(previous_, m);
+    // the previous plane still holds, a few tries to catch a better one
+    if (best_score >= 0.8f * previous_ratio_ * m) {
+      iterations = std::max(1, iterations / 4);
+    }
+  }
+
+  std::minstd_rand rng(seed_);
+  std::uniform_int_distribution<std::size_t> pick(0, m - 1);
+  const float* x = xs_.data();
+  const float* y = ys_.data();
+  const float* z = zs_.data();
+  for (int i = 0; i < iterations; i++) {
+    std::size_t i0 = pick(rng), i1 = pick(rng), i2 = pick(rng);
+    if (i0 == i1 || i0 == i2 || i1 == i2) continue;
+    const float p0[3] = {x[i0], y[i0], z[i0]};
+    const float p1[3] = {x[i1], y[i1], z[i1]};
+    const float p2[3] = {x[i2], y[i2], z[i2]};
+    Plane hypothesis;
+    if (!plane_of(p0, p1, p2, &hypothesis) || !Accept(hypothesis)) continue;
+    std::size_t score = Score(hypothesis, m);
+    if (score > best_score) {
+      best = hypothesis;
+      best_score = score;
+    }
+  }
+  seed_ = static_cast<std::uint32_t>(rng());
+  if (best_score < 3 || best_score < params_.min_ratio * m) return fail();
+
+  Plane refined = best;
+  if (Refine(&refined, m) && Accept(refined) &&
+      Score(refined, m) >= best_score) {
+    best = refined;
+  }
+  inliers_ = Score(best, n);
+  if (inliers_ < params_.min_ratio * n) return fail();
+
+  has_previous_ = true;
+  previous_ = best;
+  previous_ratio_ = static_cast<float>(Score(best, m)) / m;
+  *plane = best;
+  if (mask) Mask(depth, step, best, mask);
+  return true;
+}
+
+bool PlaneFitter::Fit(const Image::pointer& depth, Plane* plane,
+    buffer_t<std::uint8_t>* mask) {
+  if (!depth || depth->format() != ImageFormat::DEPTH_RAW ||
+      depth->width() != in_.width || depth->height() != in_.height) {
+    LOGE("Error: PlaneFitter:: depth must be DEPTH_RAW of %dx%d",
+        in_.width, in_.height);
+    return false;
+  }
+  if (mask) mask->resize(static_cast<std::size_t>(in_.width) * in_.height);
+  return Fit(reinterpret_cast<const std::uint16_t*>(depth->cdata()),
+      depth->width() * sizeof(std::uint16_t), plane,
+      mask ? mask->data() : nullptr);
+}
+
+MYNTEYE_END_NAMESPACE
@@ -0,0 +1,206 @@
+// Copyright 2018 Slightech Co., Ltd. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include "mynteye/point_cloud.h"
+
+#include <atomic>
+#include <limits>
+
+#include "mynteye/util/depth.h"
+#include "mynteye/util/log.h"
+#include "mynteye/util/parallel.h"
+
+MYNTEYE_BEGIN_NAMESPACE
+
+namespace {
+
+// Rows per parallel band at least, a band of a 640 wide image is ~40 KB.
+const int kMinBandRows = 16;
+
+inline const std::uint16_t* depth_row(const std::uint16_t* depth,
+    std::size_t step, int v) {
+  return reinterpret_cast<const std::uint16_t*>(
+      reinterpret_cast<const std::uint8_t*>(depth) + v * step);
+}
+
+struct NoColor {
+  void operator()(int, int, PointXYZ*) const {}
+};
+
+struct Color {
+  const std::uint8_t* data;
+  std::size_t step;
+  int r;  // byte index of red in a pixel
+  int b;  // byte index of blue in a pixel
+
+  void operator()(int v, int u, PointXYZRGB* p) const {
+    const std::uint8_t* c = data + v * step + u * 3;
+    p->b = c[b];
+    p->g = c[1];
+    p->r = c[r];
+    p->a = 255;
+  }
+};
+
+}  // namespace
+
+PointCloud::PointCloud(const CameraIntrinsics& in, float depth_unit)
+  : in_(in), depth_unit_(depth_unit) {
+  rays_x_.resize(in_.width);
+  for (int u = 0; u < in_.width; u++) {
+    rays_x_[u] = static_cast<float>((u - in_.cx) / in_.fx);
+  }
+  rays_y_.resize(in_.height);
+  for (int v = 0; v < in_.height; v++) {
+    rays_y_[v] = static_cast<float>((v - in_.cy) / in_.fy);
+  }
+}
+
+PointCloud::~PointCloud() {
+}
+
+template <typename Point, typename Writer>
+std::size_t PointCloud::Fill(const std::uint16_t* depth,
+    std::size_t depth_step, Point* points, PointCloudLayout layout,
+    const Writer& writer) const {
+  const int width = in_.width;
+  const int height = in_.height;
+  const float* rays_x = rays_x_.data();
+  const float* rays_y = rays_y_.data();
+  const float unit = depth_unit_;
+  const float nan = std::numeric_limits<float>::quiet_NaN();
+
+  if (layout == PointCloudLayout::ORGANIZED) {
+    std::atomic<std::size_t> total(0);
+    parallel::for_each(height, [&](int begin, int end) {
+      std::size_t n = 0;
+      for (int v = begin; v < end; v++) {
+        const std::uint16_t* d = depth_row(depth, depth_step, v);
+        const float ray_y = rays_y[v];
+        Point* p = points + static_cast<std::size_t>(v) * width;
+        for (int u = 0; u < width; u++) {
+          bool valid = depth::is_valid(d[u]);
+          float z = valid ? d[u] * unit : nan;
+          p[u].x = rays_x[u] * z;
+          p[u].y = ray_y * z;
+          p[u].z = z;
+          writer(v, u, &p[u]);
+          n += valid;
+        }
+      }
+      total += n;
+    }, kMinBandRows);
+    return total;
+  }
+
+  // Compact: count the points of each band, then each band writes from the
+  // prefix sum of the counts before it.
+  parallel::Bands bands(height, (height + kMinBandRows - 1) / kMinBandRows);
+  std::vector<std::size_t> offsets(bands.bands() + 1, 0);
+  bands.Run([&](int band, int begin, int end) {
+    std::size_t n = 0;
+    for (int v = begin; v < end; v++) {
+      const std::uint16_t* d = depth_row(depth, depth_step, v);
+      for (int u = 0; u < width; u++) {
+        n += depth::is_valid(d[u]);
+      }
+    }
+    offsets[band + 1] = n;
+  });
+  for (int band = 0; band < bands.bands(); band++) {
+    offsets[band + 1] += offsets[band];
+  }
+  bands.Run([&](int band, int begin, int end) {
+    Point* p = points + offsets[band];
+    for (int v = begin; v < end; v++) {
+      const std::uint16_t* d = depth_row(depth, depth_step, v);
+      const float ray_y = rays_y[v];
+      for (int u = 0; u < width; u++) {
+        if (!depth::is_valid(d[u])) continue;
+        float z = d[u] * unit;
+        p->x = rays_x[u] * z;
+        p->y = ray_y * z;
+        p->z = z;
+        writer(v, u, p);
+        ++p;
+      }
+    }
+  });
+  return offsets.back();
+}
+
+std::size_t PointCloud::Generate(const std::uint16_t* depth,
+    std::size_t depth_step, PointXYZ* points, PointCloudLayout layout) const {
+  return Fill(depth, depth_step, points, layout, NoColor());
+}
+
+std::size_t PointCloud::Generate(const std::uint16_t* depth,
+    std::size_t depth_step, const std::uint8_t* color, std::size_t color_step,
+    ImageFormat color_format, PointXYZRGB* points,
+    PointCloudLayout layout) const {
+  Color writer{color, color_step, 2, 0};
+  if (color_format == ImageFormat::COLOR_RGB) {
+    writer.r = 0;
+    writer.b = 2;
+  } else if (color_format != ImageFormat::COLOR_BGR) {
+    LOGE("Error: Point cloud color must be BGR or RGB");
+    return 0;
+  }
+  return Fill(depth, depth_step, points, layout, writer);
+}
+
+std::size_t PointCloud::Generate(const Image::pointer& depth,
+    buffer_t<PointXYZ>* points, PointCloudLayout layout) const {
+  if (!depth || !points) return 0;
+  if (depth->format() != ImageFormat::DEPTH_RAW ||
+      depth->width() != in_.width || depth->height() != in_.height) {
+    LOGE("Error: Point cloud depth must be DEPTH_RAW %dx%d",
+        in_.width, in_.height);
+    return 0;
+  }
+  points->resize(static_cast<std::size_t>(in_.width) * in_.height);
+  auto n = Generate(reinterpret_cast<const std::uint16_t*>(depth->cdata()),
+      in_.width * sizeof(std::uint16_t), points->data(), layout);
+  if (layout == PointCloudLayout::COMPACT) points->resize(n);
+  return n;
+}
+
+std::size_t PointCloud::Generate(const Image::pointer& depth,
+    const Image::pointer& color, buffer_t<PointXYZRGB>* points,
+    PointCloudLayout layout) const {
+  if (!depth || !color || !points) return 0;
+  if (depth->format() != ImageFormat::DEPTH_RAW ||
+      depth->width() != in_.width || depth->height() != in_.height) {
+    LOGE("Error: Point cloud depth must be DEPTH_RAW %dx%d",
+        in_.width, in_.height);
+    return 0;
+  }
+  if (color->width() != in_.width || color->height() != in_.height) {
+    LOGE("Error: Point cloud color must be %dx%d", in_.width, in_.height);
+    return 0;
+  }
+  auto bgr = color;
+  if (color->format() != ImageFormat::COLOR_BGR &&
+      color->format() != ImageFormat::COLOR_RGB) {
+    bgr = color->To(ImageFormat::COLOR_BGR);
+    if (!bgr) return 0;
+  }
+  points->resize(static_cast<std::size_t>(in_.width) * in_.height);
+  auto n = Generate(reinterpret_cast<const std::uint16_t*>(depth->cdata()),
+      in_.width * sizeof(std::uint16_t), bgr->cdata(), in_.width * 3,
+      bgr->format(), points->data(), layout);
+  if (layout == PointCloudLayout::COMPACT) points->resize(n);
+  return n;
+}
+
+MYNTEYE_END_NAMESPACE
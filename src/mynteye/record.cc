@@ -0,0 +1,409 @@
+// Copyright 2018 Slightech Co., Ltd. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include "mynteye/record.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+
+#ifdef MYNTEYE_OS_WIN
+#include <fcntl.h>
+#include <io.h>
+#include <sys/stat.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#include "mynteye/util/aligned_allocator.h"
+#include "mynteye/util/log.h"
+
+MYNTEYE_BEGIN_NAMESPACE
+
+const char kRecordMagic[8] = {'M', 'Y', 'N', 'T', 'R', 'C', 'R', 'D'};
+const char kRecordTrailerMagic[8] = {'M', 'Y', 'N', 'T', 'R', 'I', 'D', 'X'};
+
+namespace {
+
+/** Alignment of the chunks, their sizes and the file end, for O_DIRECT. */
+const std::size_t kBlockSize = 4096;
+
+inline std::size_t align(std::size_t n, std::size_t alignment) {
+  return (n + alignment - 1) / alignment * alignment;
+}
+
+inline std::uint64_t host_now() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+      std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+inline std::size_t index_size(std::size_t count) {
+  return sizeof(RecordHeader) + sizeof(RecordIndexHeader) +
+      count * sizeof(RecordIndexEntry);
+}
+
+int open_file(const std::string& path, bool direct, bool* opened_direct) {
+  *opened_direct = false;
+#ifdef MYNTEYE_OS_WIN
+  (void)direct;
+  return _open(path.c_str(), _O_WRONLY | _O_CREAT | _O_TRUNC | _O_BINARY,
+      _S_IREAD | _S_IWRITE);
+#else
+  int flags = O_WRONLY | O_CREAT | O_TRUNC;
+#ifdef O_DIRECT
+  if (direct) {
+    int fd = ::open(path.c_str(), flags | O_DIRECT, 0644);
+    if (fd >= 0) {
+      *opened_direct = true;
+      return fd;
+    }
+    LOGW("Warning: Recorder:: O_DIRECT is not supported, written cached");
+  }
+#else
+  (void)direct;
+#endif
+  return ::open(path.c_str(), flags, 0644);
+#endif
+}
+
+bool write_file(int fd, const std::uint8_t* data, std::size_t size) {
+  while (size > 0) {
+#ifdef MYNTEYE_OS_WIN
+    int n = _write(fd, data, static_cast<unsigned int>(size));
+#else
+    ssize_t n = ::write(fd, data, size);
+#endif
+    if (n <= 0) return false;
+    data += n;
+    size -= static_cast<std::size_t>(n);
+  }
+  return true;
+}
+
+void close_file(int fd) {
+#ifdef MYNTEYE_OS_WIN
+  _close(fd);
+#else
+  ::fsync(fd);
+  ::close(fd);
+#endif
+}
+
+}  // namespace
+
+Recorder::Recorder(const RecorderParams& params)
+  : params_(params),
+    opened_(false),
+    fd_(-1),
+    direct_(false),
+    running_(false),
+    chunk_{nullptr, 0},
+    offset_(0),
+    allocated_(0),
+    last_index_(0),
+    records_(0),
+    dropped_(0),
+    bytes_(0) {
+  params_.chunk_size = align(std::max<std::size_t>(1, params_.chunk_size),
+      kBlockSize);
+  params_.max_queued = std::max(params_.max_queued, params_.chunk_size * 2);
+  params_.index_interval = std::max<std::size_t>(1, params_.index_interval);
+}
+
+Recorder::~Recorder() {
+  Close();
+}
+
+bool Recorder::Open(const std::string& path) {
+  Close();
+  fd_ = open_file(path, params_.direct_io, &direct_);
+  if (fd_ < 0) {
+    LOGE("Error: Recorder:: open %s failed", path.c_str());
+    return false;
+  }
+
+  offset_ = 0;
+  allocated_ = 0;
+  last_index_ = 0;
+  entries_.clear();
+  entries_.reserve(params_.index_interval);
+  records_ = 0;
+  dropped_ = 0;
+  bytes_ = 0;
+
+  chunk_.data = static_cast<std::uint8_t*>(
+      aligned_malloc(params_.chunk_size, kBlockSize));
+  chunk_.size = 0;
+  allocated_ = params_.chunk_size;
+
+  RecordFileHeader header;
+  std::memset(&header, 0, sizeof(header));
+  std::memcpy(header.magic, kRecordMagic, sizeof(header.magic));
+  header.version = kRecordVersion;
+  header.header_size = sizeof(RecordFileHeader);
+  header.created = std::chrono::duration_cast<std::chrono::microseconds>(
+      std::chrono::system_clock::now().time_since_epoch()).count();
+  Append(&header, sizeof(header));
+
+  running_ = true;
+  thread_ = std::thread(&Recorder::Run, this);
+  opened_ = true;
+  return true;
+}
+
+void Recorder::Close() {
+  if (!opened_) return;
+  {
+    std::lock_guard<std::mutex> _(mutex_);
+    AppendIndex();
+
+    // pad so the trailer ends the last block, a pad record fits or it is none
+    const std::size_t trailer = sizeof(RecordTrailer);
+    std::size_t gap = kBlockSize - (offset_ + chunk_.size) % kBlockSize;
+    if (gap != trailer && gap < trailer + sizeof(RecordHeader)) {
+      gap += kBlockSize;
+    }
+    if (gap != trailer) {
+      RecordHeader header;
+      std::memset(&header, 0, sizeof(header));
+      header.sync = kRecordSync;
+      header.type = static_cast<std::uint16_t>(RecordType::PAD);
+      header.size = static_cast<std::uint32_t>(
+          gap - trailer - sizeof(RecordHeader));
+      header.host_time = host_now();
+      Append(&header, sizeof(header));
+      Append(nullptr, header.size);
+    }
+
+    RecordTrailer tail;
+    std::memset(&tail, 0, sizeof(tail));
+    std::memcpy(tail.magic, kRecordTrailerMagic, sizeof(tail.magic));
+    tail.last_index = last_index_;
+    tail.records = records_;
+    Append(&tail, sizeof(tail));
+
+    if (chunk_.size > 0) {
+      queue_.push_back(chunk_);
+    } else {
+      free_.push_back(chunk_.data);
+    }
+    chunk_ = {nullptr, 0};
+    running_ = false;
+  }
+  condition_.notify_all();
+  if (thread_.joinable()) {
+    thread_.join();
+  }
+  close_file(fd_);
+  fd_ = -1;
+  for (auto &&data : free_) {
+    aligned_free(data);
+  }
+  free_.clear();
+  allocated_ = 0;
+  opened_ = false;
+  if (dropped_ > 0) {
+    LOGW("Warning: Recorder:: %llu records dropped as the disk fell behind",
+        static_cast<unsigned long long>(dropped_.load()));  // NOLINT
+  }
+}
+
+bool Recorder::IsOpened() const {
+  return opened_;
+}
+
+bool Recorder::WriteDevice(const RecordDevice& device) {
+  RecordHeader header;
+  std::memset(&header, 0, sizeof(header));
+  header.type = static_cast<std::uint16_t>(RecordType::DEVICE);
+  header.size = sizeof(RecordDevice);
+  return Write(header, &device);
+}
+
+bool Recorder::WriteCalibration(std::uint32_t index,
+    const CameraCtrlRectLogData& data) {
+  RecordHeader header;
+  std::memset(&header, 0, sizeof(header));
+  header.type = static_cast<std::uint16_t>(RecordType::CALIBRATION);
+  header.size = sizeof(CameraCtrlRectLogData);
+  header.frame_id = index;
+  return Write(header, &data);
+}
+
+bool Recorder::WriteMotion(const RecordMotion& motion) {
+  RecordHeader header;
+  std::memset(&header, 0, sizeof(header));
+  header.type = static_cast<std::uint16_t>(RecordType::MOTION);
+  header.size = sizeof(RecordMotion);
+  return Write(header, &motion);
+}
+
+bool Recorder::WriteImage(const RecordType& type, const Image& image) {
+  if (type != RecordType::COLOR && type != RecordType::DEPTH) {
+    LOGE("Error: Recorder:: only COLOR or DEPTH images are recorded");
+    return false;
+  }
+  RecordHeader header;
+  std::memset(&header, 0, sizeof(header));
+  header.type = static_cast<std::uint16_t>(type);
+  header.format = static_cast<std::uint16_t>(image.format());
+  header.size = static_cast<std::uint32_t>(image.valid_size());
+  header.width = static_cast<std::uint16_t>(image.width());
+  header.height = static_cast<std::uint16_t>(image.height());
+  header.frame_id = image.frame_id();
+  return Write(header, image.cdata());
+}
+
+bool Recorder::WriteImgInfo(const RecordImgInfo& info) {
+  RecordHeader header;
+  std::memset(&header, 0, sizeof(header));
+  header.type = static_cast<std::uint16_t>(RecordType::IMG_INFO);
+  header.size = sizeof(RecordImgInfo);
+  header.frame_id = info.frame_id;
+  header.timestamp = info.timestamp;
+  return Write(header, &info);
+}
+
+bool Recorder::WriteImu(const RecordImuSegment* segments, std::size_t count) {
+  if (count == 0) return true;
+  RecordHeader header;
+  std::memset(&header, 0, sizeof(header));
+  header.type = static_cast<std::uint16_t>(RecordType::IMU);
+  header.size = static_cast<std::uint32_t>(count * sizeof(RecordImuSegment));
+  header.timestamp = segments[0].timestamp;
+  return Write(header, segments);
+}
+
+bool Recorder::Write(RecordHeader header, const void* payload) {
+  if (!opened_) return false;
+  header.sync = kRecordSync;
+  header.host_time = host_now();
+  const std::size_t padded = align(header.size, 8);
+  bool queued;
+  {
+    std::lock_guard<std::mutex> _(mutex_);
+    if (!running_) return false;
+    // the index of the records before goes first, if due
+    bool index = entries_.size() >= params_.index_interval;
+    std::size_t size = sizeof(RecordHeader) + padded +
+        (index ? index_size(entries_.size()) : 0);
+    if (!Reserve(size)) {
+      ++dropped_;
+      return false;
+    }
+    if (index) AppendIndex();
+    RecordIndexEntry entry;
+    entry.offset = offset_ + chunk_.size;
+    entry.timestamp = header.timestamp;
+    entry.host_time = header.host_time;
+    entry.frame_id = header.frame_id;
+    entry.type = header.type;
+    entry.reserved = 0;
+    entries_.push_back(entry);
+    Append(&header, sizeof(header));
+    Append(payload, header.size);
+    Append(nullptr, padded - header.size);
+    queued = !queue_.empty();
+  }
+  ++records_;
+  if (queued) condition_.notify_one();
+  return true;
+}
+
+bool Recorder::Reserve(std::size_t size) {
+  std::size_t fill = chunk_.size + size;
+  if (fill < params_.chunk_size) return true;
+  std::size_t needed = fill / params_.chunk_size;
+  std::size_t available = free_.size() +
+      (params_.max_queued - std::min(params_.max_queued, allocated_)) /
+      params_.chunk_size;
+  return needed <= available;
+}
+
+void Recorder::Append(const void* data, std::size_t size) {
+  const std::uint8_t* src = static_cast<const std::uint8_t*>(data);
+  while (size > 0) {
+    std::size_t n = std::min(params_.chunk_size - chunk_.size, size);
+    if (src) {
+      std::memcpy(chunk_.data + chunk_.size, src, n);
+      src += n;
+    } else {
+      std::memset(chunk_.data + chunk_.size, 0, n);
+    }
+    chunk_.size += n;
+    size -= n;
+    if (chunk_.size == params_.chunk_size) {
+      queue_.push_back(chunk_);
+      offset_ += params_.chunk_size;
+      if (free_.empty()) {
+        chunk_.data = static_cast<std::uint8_t*>(
+            aligned_malloc(params_.chunk_size, kBlockSize));
+        allocated_ += params_.chunk_size;
+      } else {
+        chunk_.data = free_.back();
+        free_.pop_back();
+      }
+      chunk_.size = 0;
+    }
+  }
+}
+
+void Recorder::AppendIndex() {
+  RecordHeader header;
+  std::memset(&header, 0, sizeof(header));
+  header.sync = kRecordSync;
+  header.type = static_cast<std::uint16_t>(RecordType::INDEX);
+  header.size = static_cast<std::uint32_t>(
+      index_size(entries_.size()) - sizeof(RecordHeader));
+  header.host_time = host_now();
+
+  RecordIndexHeader index;
+  index.previous = last_index_;
+  index.count = static_cast<std::uint32_t>(entries_.size());
+  index.reserved = 0;
+
+  last_index_ = offset_ + chunk_.size;
+  Append(&header, sizeof(header));
+  Append(&index, sizeof(index));
+  Append(entries_.data(), entries_.size() * sizeof(RecordIndexEntry));
+  entries_.clear();
+}
+
+void Recorder::Run() {
+  bool failed = false;
+  while (true) {
+    Chunk chunk;
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      condition_.wait(lock, [this] { return !running_ || !queue_.empty(); });
+      if (queue_.empty()) break;
+      chunk = queue_.front();
+      queue_.pop_front();
+    }
+    if (!failed) {
+      if (write_file(fd_, chunk.data, chunk.size)) {
+        bytes_ += chunk.size;
+      } else {
+        LOGE("Error: Recorder:: write failed, the rest is not recorded");
+        failed = true;
+      }
+    }
+    {
+      std::lock_guard<std::mutex> _(mutex_);
+      free_.push_back(chunk.data);
+    }
+  }
+}
+
+MYNTEYE_END_NAMESPACE
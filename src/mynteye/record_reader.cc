@@ -0,0 +1,378 @@
+// Copyright 2018 Slightech Co., Ltd. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include "mynteye/record_reader.h"
+
+#include <algorithm>
+#include <cstring>
+#include <unordered_map>
+#include <utility>
+
+#include "mynteye/util/log.h"
+#include "mynteye/util/mapped_file.h"
+
+MYNTEYE_BEGIN_NAMESPACE
+
+namespace {
+
+inline std::size_t align8(std::size_t n) {
+  return (n + 7) / 8 * 8;
+}
+
+inline bool key_less(const std::uint64_t& a_key, const std::size_t& a_index,
+    const std::uint64_t& b_key, const std::size_t& b_index) {
+  return a_key < b_key || (a_key == b_key && a_index < b_index);
+}
+
+/** Unwrap the 32 bits timestamps of the device, in order. */
+class Unwrapper {
+ public:
+  Unwrapper() : epoch_(0), last_(0), first_(true) {}
+
+  std::uint64_t operator()(std::uint64_t timestamp) {
+    std::uint32_t t = static_cast<std::uint32_t>(timestamp);
+    if (!first_ && t < last_ && last_ - t > 0x80000000u) {
+      epoch_ += 0x100000000ull;
+    }
+    first_ = false;
+    last_ = t;
+    return epoch_ + t;
+  }
+
+ private:
+  std::uint64_t epoch_;
+  std::uint32_t last_;
+  bool first_;
+};
+
+}  // namespace
+
+RecordReader::RecordReader() {
+}
+
+RecordReader::~RecordReader() {
+  Close();
+}
+
+bool RecordReader::Open(const std::string& path) {
+  Close();
+  auto file = std::make_shared<MappedFile>();
+  if (!file->Open(path)) {
+    LOGE("Error: RecordReader:: open %s failed", path.c_str());
+    return false;
+  }
+  RecordFileHeader head;
+  if (file->size() < sizeof(head)) {
+    LOGE("Error: RecordReader:: %s is not a record file", path.c_str());
+    return false;
+  }
+  std::memcpy(&head, file->data(), sizeof(head));
+  if (std::memcmp(head.magic, kRecordMagic, sizeof(head.magic)) != 0 ||
+      head.version != kRecordVersion || head.header_size < sizeof(head)) {
+    LOGE("Error: RecordReader:: %s is not a record file of version %u",
+        path.c_str(), kRecordVersion);
+    return false;
+  }
+  file_ = file;
+  if (!LoadIndexes()) {
+    LOGW("Warning: RecordReader:: %s has no whole indexes, its records are "
+        "scanned", path.c_str());
+    if (!ScanRecords()) {
+      Close();
+      return false;
+    }
+  }
+  BuildStreams();
+  return true;
+}
+
+void RecordReader::Close() {
+  // held views keep the mapping
+  file_ = nullptr;
+  entries_.clear();
+  streams_.clear();
+}
+
+bool RecordReader::IsOpened() const {
+  return file_ != nullptr;
+}
+
+bool RecordReader::LoadIndexes() {
+  const std::uint8_t* data = file_->data();
+  const std::size_t size = file_->size();
+  if (size < sizeof(RecordFileHeader) + sizeof(RecordTrailer)) return false;
+  RecordTrailer tail;
+  std::memcpy(&tail, data + size - sizeof(tail), sizeof(tail));
+  if (std::memcmp(tail.magic, kRecordTrailerMagic, sizeof(tail.magic)) != 0) {
+    return false;
+  }
+
+  // the indexes link back from the last, their entries are in file order
+  std::vector<std::pair<const RecordIndexEntry*, std::size_t>> indexes;
+  std::size_t count = 0;
+  std::uint64_t offset = tail.last_index;
+  while (offset != 0) {
+    if (offset % 8 != 0 ||
+        offset + sizeof(RecordHeader) + sizeof(RecordIndexHeader) > size) {
+      return false;
+    }
+    RecordHeader header;
+    std::memcpy(&header, data + offset, sizeof(header));
+    if (header.sync != kRecordSync ||
+        header.type != static_cast<std::uint16_t>(RecordType::INDEX)) {
+      return false;
+    }
+    RecordIndexHeader index;
+    std::memcpy(&index, data + offset + sizeof(header), sizeof(index));
+    std::size_t bytes = index.count * sizeof(RecordIndexEntry);
+    std::uint64_t begin = offset + sizeof(header) + sizeof(index);
+    if (begin + bytes > size || index.previous >= offset) return false;
+    indexes.emplace_back(
+        reinterpret_cast<const RecordIndexEntry*>(data + begin), index.count);
+    count += index.count;
+    offset = index.previous;
+  }
+
+  entries_.reserve(count);
+  for (auto it = indexes.rbegin(); it != indexes.rend(); ++it) {
+    for (std::size_t i = 0; i < it->second; i++) {
+      const RecordIndexEntry& entry = it->first[i];
+      if (!IsRecordInFile(entry)) {
+        entries_.clear();
+        return false;
+      }
+      entries_.push_back(entry);
+    }
+  }
+  return true;
+}
+
+bool RecordReader::IsRecordInFile(const RecordIndexEntry& entry) const {
+  const std::size_t size = file_->size();
+  // aligned, as the headers are read in place
+  if (entry.offset % 8 != 0 || entry.offset < sizeof(RecordFileHeader) ||
+      entry.offset > size || size - entry.offset < sizeof(RecordHeader)) {
+    return false;
+  }
+  RecordHeader header;
+  std::memcpy(&header, file_->data() + entry.offset, sizeof(header));
+  return header.sync == kRecordSync && header.type == entry.type &&
+      align8(header.size) <= size - entry.offset - sizeof(header);
+}
+
+bool RecordReader::ScanRecords() {
+  const std::uint8_t* data = file_->data();
+  const std::size_t size = file_->size();
+  RecordFileHeader head;
+  std::memcpy(&head, data, sizeof(head));
+  std::uint64_t offset = head.header_size;
+  // till the trailer, or the first record not written whole
+  while (offset + sizeof(RecordHeader) <= size) {
+    RecordHeader header;
+    std::memcpy(&header, data + offset, sizeof(header));
+    std::uint64_t next = offset + sizeof(header) + align8(header.size);
+    if (header.sync != kRecordSync || next > size || offset % 8 != 0) break;
+    auto type = static_cast<RecordType>(header.type);
+    if (type != RecordType::INDEX && type != RecordType::PAD) {
+      RecordIndexEntry entry;
+      entry.offset = offset;
+      entry.timestamp = header.timestamp;
+      entry.host_time = header.host_time;
+      entry.frame_id = header.frame_id;
+      entry.type = header.type;
+      entry.reserved = 0;
+      entries_.push_back(entry);
+    }
+    offset = next;
+  }
+  return true;
+}
+
+void RecordReader::BuildStreams() {
+  std::map<RecordType, Unwrapper> unwrappers;
+  // image infos of each frame id, in file order
+  std::unordered_map<std::uint32_t,
+      std::vector<std::pair<std::size_t, std::uint64_t>>> infos;
+  for (std::size_t i = 0, n = entries_.size(); i < n; i++) {
+    auto &&entry = entries_[i];
+    auto t = static_cast<RecordType>(entry.type);
+    if (t == RecordType::IMG_INFO || t == RecordType::IMU) {
+      entry.timestamp = unwrappers[t](entry.timestamp);
+    }
+    if (t == RecordType::IMG_INFO) {
+      infos[entry.frame_id].emplace_back(i, entry.timestamp);
+    }
+    streams_[t].records.push_back(i);
+  }
+
+  for (auto &&it : streams_) {
+    const RecordType& t = it.first;
+    Stream& stream = it.second;
+    bool image = t == RecordType::COLOR || t == RecordType::DEPTH;
+    for (auto &&i : stream.records) {
+      auto &&entry = entries_[i];
+      if (image) {
+        // the info of the frame id recorded nearest
+        auto found = infos.find(entry.frame_id);
+        if (found != infos.end()) {
+          auto &&list = found->second;
+          auto next = std::lower_bound(list.begin(), list.end(),
+              std::make_pair(i, std::uint64_t(0)));
+          if (next == list.end() || (next != list.begin() &&
+              i - (next - 1)->first < next->first - i)) {
+            --next;
+          }
+          entry.timestamp = next->second;
+        }
+      }
+      if (entry.timestamp != 0 || !image) {
+        stream.times.push_back({entry.timestamp, i});
+      }
+      stream.frames.push_back({entry.frame_id, i});
+    }
+    auto less = [](const Key& a, const Key& b) {
+      return key_less(a.key, a.index, b.key, b.index);
+    };
+    std::sort(stream.times.begin(), stream.times.end(), less);
+    std::sort(stream.frames.begin(), stream.frames.end(), less);
+  }
+}
+
+const RecordReader::Stream* RecordReader::GetStream(
+    const RecordType& type) const {
+  auto it = streams_.find(type);
+  return it == streams_.end() ? nullptr : &it->second;
+}
+
+bool RecordReader::GetDevice(RecordDevice* device) const {
+  auto stream = GetStream(RecordType::DEVICE);
+  if (!stream || stream->records.empty()) return false;
+  std::size_t i = stream->records.back();
+  if (header(i).size < sizeof(RecordDevice)) return false;
+  std::memcpy(device, payload(i), sizeof(RecordDevice));
+  return true;
+}
+
+bool RecordReader::GetCalibration(std::uint32_t index,
+    CameraCtrlRectLogData* data) const {
+  auto stream = GetStream(RecordType::CALIBRATION);
+  if (!stream) return false;
+  // the last of index
+  for (auto it = stream->records.rbegin(); it != stream->records.rend();
+      ++it) {
+    auto &&h = header(*it);
+    if (h.frame_id == index && h.size >= sizeof(CameraCtrlRectLogData)) {
+      std::memcpy(data, payload(*it), sizeof(CameraCtrlRectLogData));
+      return true;
+    }
+  }
+  return false;
+}
+
+bool RecordReader::GetMotion(RecordMotion* motion) const {
+  auto stream = GetStream(RecordType::MOTION);
+  if (!stream || stream->records.empty()) return false;
+  std::size_t i = stream->records.back();
+  if (header(i).size < sizeof(RecordMotion)) return false;
+  std::memcpy(motion, payload(i), sizeof(RecordMotion));
+  return true;
+}
+
+const RecordHeader& RecordReader::header(std::size_t i) const {
+  // records are 8 bytes aligned in the mapping
+  return *reinterpret_cast<const RecordHeader*>(
+      file_->data() + entries_[i].offset);
+}
+
+const std::uint8_t* RecordReader::payload(std::size_t i) const {
+  return file_->data() + entries_[i].offset + sizeof(RecordHeader);
+}
+
+Image::pointer RecordReader::GetImage(std::size_t i) const {
+  auto &&h = header(i);
+  ImageType image_type;
+  switch (static_cast<RecordType>(h.type)) {
+    case RecordType::COLOR: image_type = ImageType::IMAGE_LEFT_COLOR; break;
+    case RecordType::DEPTH: image_type = ImageType::IMAGE_DEPTH; break;
+    default:
+      LOGE("Error: RecordReader:: record %zu is not an image", i);
+      return nullptr;
+  }
+  if (entries_[i].offset + sizeof(RecordHeader) + h.size > file_->size()) {
+    return nullptr;
+  }
+  auto &&image = Image::CreateView(image_type,
+      static_cast<ImageFormat>(h.format), h.width, h.height, payload(i),
+      h.size, file_);
+  image->set_frame_id(h.frame_id);
+  return image;
+}
+
+bool RecordReader::GetImgInfo(std::size_t i, RecordImgInfo* info) const {
+  if (type(i) != RecordType::IMG_INFO ||
+      header(i).size < sizeof(RecordImgInfo)) {
+    return false;
+  }
+  std::memcpy(info, payload(i), sizeof(RecordImgInfo));
+  return true;
+}
+
+const RecordImuSegment* RecordReader::GetImu(std::size_t i,
+    std::size_t* count) const {
+  if (type(i) != RecordType::IMU) {
+    *count = 0;
+    return nullptr;
+  }
+  *count = header(i).size / sizeof(RecordImuSegment);
+  return reinterpret_cast<const RecordImuSegment*>(payload(i));
+}
+
+std::size_t RecordReader::SeekTimestamp(const RecordType& type,
+    std::uint64_t timestamp) const {
+  auto stream = GetStream(type);
+  if (!stream) return size();
+  auto it = std::lower_bound(stream->times.begin(), stream->times.end(),
+      timestamp, [](const Key& a, std::uint64_t t) { return a.key < t; });
+  return it == stream->times.end() ? size() : it->index;
+}
+
+std::size_t RecordReader::SeekFrameId(const RecordType& type,
+    std::uint32_t frame_id, std::size_t from) const {
+  auto stream = GetStream(type);
+  if (!stream) return size();
+  auto it = std::lower_bound(stream->frames.begin(), stream->frames.end(),
+      Key{frame_id, from}, [](const Key& a, const Key& b) {
+        return key_less(a.key, a.index, b.key, b.index);
+      });
+  if (it == stream->frames.end() || it->key != frame_id) return size();
+  return it->index;
+}
+
+std::size_t RecordReader::Next(const RecordType& type, std::size_t i) const {
+  auto stream = GetStream(type);
+  if (!stream) return size();
+  auto it = std::upper_bound(stream->records.begin(), stream->records.end(),
+      i);
+  return it == stream->records.end() ? size() : *it;
+}
+
+void RecordReader::Prefetch(std::size_t i, std::size_t count) const {
+  if (!file_ || i >= size() || count == 0) return;
+  std::size_t last = std::min(size(), i + count) - 1;
+  std::uint64_t begin = entries_[i].offset;
+  std::uint64_t end = entries_[last].offset + sizeof(RecordHeader) +
+      header(last).size;
+  file_->Prefetch(begin, end - begin);
+}
+
+MYNTEYE_END_NAMESPACE
@@ -0,0 +1,270 @@
+// Copyright 2018 Slightech Co., Ltd. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include "mynteye/rectifier.h"
+
+#include <cmath>
+#include <cstring>
+#include <utility>
+#include <vector>
+
+#include "mynteye/util/aligned_allocator.h"
+#include "mynteye/util/log.h"
+#include "mynteye/util/parallel.h"
+
+MYNTEYE_BEGIN_NAMESPACE
+
+constexpr int Rectifier::kSubpixelBits;
+constexpr int Rectifier::kSubpixelSize;
+constexpr int Rectifier::kWeightBits;
+constexpr std::int16_t Rectifier::kOutside;
+
+namespace {
+
+const int kMinBandRows = 8;
+
+/** Bilinear weights of every subpixel index, each four sum to 1 << 14. */
+struct BilinearTable {
+  std::int16_t weights[Rectifier::kSubpixelSize * Rectifier::kSubpixelSize][4];
+
+  BilinearTable() {
+    const int n = Rectifier::kSubpixelSize;
+    const float scale = 1 << Rectifier::kWeightBits;
+    for (int fy = 0; fy < n; fy++) {
+      for (int fx = 0; fx < n; fx++) {
+        float ax = static_cast<float>(fx) / n;
+        float ay = static_cast<float>(fy) / n;
+        std::int16_t* w = weights[fy * n + fx];
+        w[0] = to_weight((1 - ax) * (1 - ay) * scale);
+        w[1] = to_weight(ax * (1 - ay) * scale);
+        w[2] = to_weight((1 - ax) * ay * scale);
+        // the rounding error goes to the last weight
+        w[3] = static_cast<std::int16_t>((1 << Rectifier::kWeightBits)
+            - w[0] - w[1] - w[2]);
+      }
+    }
+  }
+
+  static std::int16_t to_weight(float w) {
+    return static_cast<std::int16_t>(std::lround(w));
+  }
+
+  static const BilinearTable& instance() {
+    static BilinearTable table;
+    return table;
+  }
+};
+
+/** Fixed point of a source coordinate, false if outside [0, size - 1]. */
+inline bool to_fixed(double pos, int size, std::int16_t* i, int* frac) {
+  if (!(pos >= 0) || pos > size - 1) return false;
+  int fixed = static_cast<int>(pos * Rectifier::kSubpixelSize);
+  int n = fixed >> Rectifier::kSubpixelBits;
+  int f = fixed & (Rectifier::kSubpixelSize - 1);
+  if (n >= size - 1) {
+    // last pixel, sample it as the full weight of the next to last
+    n = size - 2;
+    f = Rectifier::kSubpixelSize - 1;
+  }
+  *i = static_cast<std::int16_t>(n);
+  *frac = f;
+  return true;
+}
+
+struct MapBuffers {
+  std::vector<std::int16_t, AlignedAllocator<std::int16_t>> xy;
+  std::vector<std::uint16_t, AlignedAllocator<std::uint16_t>> frac;
+};
+
+/**
+ * Build the map of one eye like cv::initUndistortRectifyMap.
+ * @param cam camera matrix of the raw image, scaled by (ksx, ksy).
+ * @param dist distortion k1, k2, p1, p2, k3, k4, k5, k6.
+ * @param rot rectification rotation.
+ * @param rect rectified intrinsics of the output.
+ */
+void build_map(const float* cam, const float* dist, const float* rot,
+    double ksx, double ksy, const CameraIntrinsics& rect,
+    Rectifier::Map* map) {
+  const int width = rect.width;
+  const int height = rect.height;
+  auto storage = std::make_shared<MapBuffers>();
+  storage->xy.resize(static_cast<std::size_t>(width) * height * 2);
+  storage->frac.resize(static_cast<std::size_t>(width) * height);
+  map->xy = storage->xy.data();
+  map->frac = storage->frac.data();
+  map->storage = storage;
+
+  const double fx = cam[0] * ksx, cx = cam[2] * ksx;
+  const double fy = cam[4] * ksy, cy = cam[5] * ksy;
+  const double k1 = dist[0], k2 = dist[1], p1 = dist[2], p2 = dist[3];
+  const double k3 = dist[4], k4 = dist[5], k5 = dist[6], k6 = dist[7];
+  // inverse of rotation is its transpose
+  const double r[9] = {rot[0], rot[3], rot[6], rot[1], rot[4], rot[7],
+      rot[2], rot[5], rot[8]};
+
+  std::int16_t* xy = storage->xy.data();
+  std::uint16_t* frac = storage->frac.data();
+  parallel::for_each(height, [&](int begin, int end) {
+    for (int v = begin; v < end; v++) {
+      double y0 = (v - rect.cy) / rect.fy;
+      for (int u = 0; u < width; u++) {
+        double x0 = (u - rect.cx) / rect.fx;
+        double X = r[0] * x0 + r[1] * y0 + r[2];
+        double Y = r[3] * x0 + r[4] * y0 + r[5];
+        double W = r[6] * x0 + r[7] * y0 + r[8];
+        W = W ? 1. / W : 1;
+        double x = X * W, y = Y * W;
+        double x2 = x * x, y2 = y * y, r2 = x2 + y2, _2xy = 2 * x * y;
+        double kr = (1 + ((k3 * r2 + k2) * r2 + k1) * r2) /
+            (1 + ((k6 * r2 + k5) * r2 + k4) * r2);
+        double mx = fx * (x * kr + p1 * _2xy + p2 * (r2 + 2 * x2)) + cx;
+        double my = fy * (y * kr + p1 * (r2 + 2 * y2) + p2 * _2xy) + cy;
+
+        std::size_t i = static_cast<std::size_t>(v) * width + u;
+        int ax, ay;
+        if (to_fixed(mx, width, &xy[i * 2], &ax) &&
+            to_fixed(my, height, &xy[i * 2 + 1], &ay)) {
+          frac[i] = static_cast<std::uint16_t>(
+              (ay << Rectifier::kSubpixelBits) | ax);
+        } else {
+          xy[i * 2] = Rectifier::kOutside;
+          xy[i * 2 + 1] = 0;
+          frac[i] = 0;
+        }
+      }
+    }
+  }, kMinBandRows);
+}
+
+template <int CN>
+void remap(const Rectifier::Map& map, int width, int height,
+    const std::uint8_t* src, std::size_t src_step,
+    std::uint8_t* dst, std::size_t dst_step) {
+  const auto& table = BilinearTable::instance();
+  const int round = 1 << (Rectifier::kWeightBits - 1);
+  parallel::for_each(height, [&](int begin, int end) {
+    for (int v = begin; v < end; v++) {
+      std::size_t offset = static_cast<std::size_t>(v) * width;
+      const std::int16_t* xy = map.xy + offset * 2;
+      const std::uint16_t* frac = map.frac + offset;
+      std::uint8_t* d = dst + v * dst_step;
+      for (int u = 0; u < width; u++, d += CN) {
+        int sx = xy[u * 2];
+        if (sx == Rectifier::kOutside) {
+          for (int c = 0; c < CN; c++) d[c] = 0;
+          continue;
+        }
+        int sy = xy[u * 2 + 1];
+        const std::uint8_t* p0 = src + sy * src_step + sx * CN;
+        const std::uint8_t* p1 = p0 + src_step;
+        const std::int16_t* w = table.weights[frac[u]];
+        for (int c = 0; c < CN; c++) {
+          int value = p0[c] * w[0] + p0[c + CN] * w[1] +
+              p1[c] * w[2] + p1[c + CN] * w[3];
+          d[c] = static_cast<std::uint8_t>(
+              (value + round) >> Rectifier::kWeightBits);
+        }
+      }
+    }
+  }, kMinBandRows);
+}
+
+}  // namespace
+
+Rectifier::Rectifier(const StereoCalibration& calib)
+  : calib_(calib), valid_(false) {
+  if (!calib_.IsValid() || width() < 2 || height() < 2) {
+    LOGE("Error: Rectifier needs a valid calibration");
+    return;
+  }
+  const CameraCtrlRectLogData& data = calib_.GetLogData();
+  // the raw image of the calibration, side by side
+  int in_width = (data.InImgWidth ? data.InImgWidth : data.OutImgWidth) / 2;
+  int in_height = data.InImgHeight ? data.InImgHeight : data.OutImgHeight;
+  double ksx = static_cast<double>(width()) / in_width;
+  double ksy = static_cast<double>(height()) / in_height;
+
+  build_map(data.CamMat1, data.CamDist1, data.LRotaMat, ksx, ksy,
+      calib_.GetIntrinsics(), &left_);
+  build_map(data.CamMat2, data.CamDist2, data.RRotaMat, ksx, ksy,
+      calib_.GetRightIntrinsics(), &right_);
+  valid_ = true;
+}
+
+Rectifier::Rectifier(const StereoCalibration& calib, Map left, Map right)
+  : calib_(calib), valid_(false), left_(std::move(left)),
+    right_(std::move(right)) {
+  valid_ = calib_.IsValid() && width() >= 2 && height() >= 2 &&
+      left_.xy && left_.frac && right_.xy && right_.frac;
+}
+
+Rectifier::~Rectifier() {
+}
+
+const Rectifier::Map& Rectifier::GetMap(const ImageType& eye) const {
+  return eye == ImageType::IMAGE_RIGHT_COLOR ? right_ : left_;
+}
+
+bool Rectifier::Remap(const ImageType& eye, const std::uint8_t* src,
+    std::size_t src_step, std::uint8_t* dst, std::size_t dst_step,
+    int channels) const {
+  if (!valid_) return false;
+  if (eye != ImageType::IMAGE_LEFT_COLOR &&
+      eye != ImageType::IMAGE_RIGHT_COLOR) {
+    LOGE("Error: Rectifier:: ImageType must be left or right color");
+    return false;
+  }
+  const Map& map = GetMap(eye);
+  switch (channels) {
+    case 1:
+      remap<1>(map, width(), height(), src, src_step, dst, dst_step);
+      break;
+    case 2:
+      remap<2>(map, width(), height(), src, src_step, dst, dst_step);
+      break;
+    case 3:
+      remap<3>(map, width(), height(), src, src_step, dst, dst_step);
+      break;
+    case 4:
+      remap<4>(map, width(), height(), src, src_step, dst, dst_step);
+      break;
+    default:
+      LOGE("Error: Rectifier:: channels must be 1 to 4");
+      return false;
+  }
+  return true;
+}
+
+Image::pointer Rectifier::Rectify(const ImageType& eye,
+    const Image::pointer& image) const {
+  if (!valid_ || !image) return nullptr;
+  if (image->width() != width() || image->height() != height()) {
+    LOGE("Error: Rectifier:: image must be %dx%d", width(), height());
+    return nullptr;
+  }
+  auto src = image;
+  if (src->format() != ImageFormat::COLOR_BGR &&
+      src->format() != ImageFormat::COLOR_RGB) {
+    src = src->To(ImageFormat::COLOR_RGB);
+    if (!src) return nullptr;
+  }
+  auto dst = Image::Create(eye, src->format(), width(), height(), false);
+  dst->set_frame_id(image->frame_id());
+  if (!Remap(eye, src->cdata(), width() * 3, dst->data(), width() * 3, 3)) {
+    return nullptr;
+  }
+  return dst;
+}
+
+MYNTEYE_END_NAMESPACE
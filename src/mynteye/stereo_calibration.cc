@@ -0,0 +1,125 @@
+// Copyright 2018 Slightech Co., Ltd. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include "mynteye/stereo_calibration.h"
+
+#include <cmath>
+#include <cstring>
+#include <iomanip>
+#include <limits>
+
+#define FULL_PRECISION \
+  std::fixed << std::setprecision(std::numeric_limits<double>::max_digits10)
+
+MYNTEYE_BEGIN_NAMESPACE
+
+namespace {
+
+CameraIntrinsics to_intrinsics(const float* proj, int width, int height,
+    double sx, double sy) {
+  // proj: 3x4 projection matrix, fx' 0 cx' Tx 0 fy' cy' 0 0 0 1 0
+  return {width, height, proj[0] * sx, proj[5] * sy, proj[2] * sx,
+      proj[6] * sy};
+}
+
+}  // namespace
+
+StereoCalibration::StereoCalibration()
+  : valid_(false), left_{0, 0, 0, 0, 0, 0}, right_{0, 0, 0, 0, 0, 0},
+    baseline_(0) {
+  std::memset(&data_, 0, sizeof(data_));
+  std::memset(q_, 0, sizeof(q_));
+}
+
+StereoCalibration::StereoCalibration(const CameraCtrlRectLogData& data,
+    int width, int height)
+  : StereoCalibration() {
+  data_ = data;
+  // OutImgWidth is of the side by side image
+  int out_width = data.OutImgWidth / 2;
+  int out_height = data.OutImgHeight;
+  if (out_width <= 0 || out_height <= 0 || width <= 0 || height <= 0 ||
+      data.NewCamMat1[0] <= 0) {
+    return;
+  }
+  double sx = static_cast<double>(width) / out_width;
+  double sy = static_cast<double>(height) / out_height;
+
+  left_ = to_intrinsics(data.NewCamMat1, width, height, sx, sy);
+  right_ = to_intrinsics(data.NewCamMat2, width, height, sx, sy);
+
+  const float* t = data.TranMat;
+  baseline_ = std::sqrt(t[0] * t[0] + t[1] * t[1] + t[2] * t[2]);
+  if (baseline_ <= 0 && data.NewCamMat2[0] > 0) {
+    baseline_ = std::fabs(data.NewCamMat2[3] / data.NewCamMat2[0]);
+  }
+
+  bool has_q = false;
+  for (int i = 0; i < 16; i++) {
+    q_[i / 4][i % 4] = data.ReProjectMat[i];
+    if (data.ReProjectMat[i] != 0) has_q = true;
+  }
+  if (has_q) {
+    // Q of the image scaled is Q * diag(1 / sx, 1 / sy, 1 / sx, 1), u and
+    // disparity scale by sx, v by sy. Times sx, as a homogeneous matrix, it
+    // keeps the columns of u and disparity, v scales by sx / sy and the
+    // constant by sx. x/w, y/w and z/w stay in the calibration unit.
+    for (int i = 0; i < 4; i++) {
+      q_[i][1] *= sx / sy;
+      q_[i][3] *= sx;
+    }
+  } else if (baseline_ > 0) {
+    std::memset(q_, 0, sizeof(q_));
+    q_[0][0] = 1;
+    q_[0][3] = -left_.cx;
+    q_[1][1] = 1;
+    q_[1][3] = -left_.cy;
+    q_[2][3] = left_.fx;
+    q_[3][2] = 1 / baseline_;
+    q_[3][3] = (right_.cx - left_.cx) / baseline_;
+  } else {
+    return;
+  }
+  valid_ = true;
+}
+
+bool StereoCalibration::Reproject(double u, double v, double disparity,
+    double* x, double* y, double* z) const {
+  double p[4] = {u, v, disparity, 1};
+  double r[4] = {0, 0, 0, 0};
+  for (int i = 0; i < 4; i++) {
+    for (int j = 0; j < 4; j++) {
+      r[i] += q_[i][j] * p[j];
+    }
+  }
+  if (std::fabs(r[3]) < std::numeric_limits<double>::epsilon()) {
+    return false;
+  }
+  *x = r[0] / r[3];
+  *y = r[1] / r[3];
+  *z = r[2] / r[3];
+  return true;
+}
+
+std::ostream &operator<<(std::ostream &os, const StereoCalibration &calib) {
+  os << FULL_PRECISION << "valid: " << std::boolalpha << calib.IsValid()
+     << ", left: {" << calib.GetIntrinsics()
+     << "}, right: {" << calib.GetRightIntrinsics()
+     << "}, baseline: " << calib.baseline() << ", Q: [";
+  for (int i = 0; i < 16; i++) {
+    os << calib.Q(i / 4, i % 4) << (i < 15 ? ", " : "]");
+  }
+  return os;
+}
+
+MYNTEYE_END_NAMESPACE
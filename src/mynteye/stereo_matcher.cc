@@ -0,0 +1,331 @@
+// Copyright 2018 Slightech Co., Ltd. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include "mynteye/stereo_matcher.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "mynteye/util/log.h"
+#include "mynteye/util/parallel.h"
+
+MYNTEYE_BEGIN_NAMESPACE
+
+constexpr int StereoMatcher::kDisparityScale;
+constexpr std::uint16_t StereoMatcher::kInvalidDisparity;
+
+namespace {
+
+const int kMinBandRows = 8;
+const int kMinBandCols = 32;
+/** Census window, 9x7 less the center is 62 bits */
+const int kCensusRadiusX = 4;
+const int kCensusRadiusY = 3;
+/** Cost where the right pixel is out of the image */
+const std::uint8_t kMaxCost = 64;
+/** Path cost out of the disparity range, so + p1 does not overflow */
+const std::uint16_t kPad = 0x3FFF;
+
+/** Bit count in plain arithmetic, so a loop of it vectorizes without
+ * a popcnt instruction of the target. */
+inline int popcount(std::uint64_t v) {
+  v = v - ((v >> 1) & 0x5555555555555555ull);
+  v = (v & 0x3333333333333333ull) + ((v >> 2) & 0x3333333333333333ull);
+  v = (v + (v >> 4)) & 0x0F0F0F0F0F0F0F0Full;
+  v += v >> 8;
+  v += v >> 16;
+  v += v >> 32;
+  return static_cast<int>(v & 0x7F);
+}
+
+/**
+ * One step of a path at a pixel, over all disparities:
+ * L(d) = C(d) + min(L'(d), L'(d -+ 1) + p1, min L' + p2) - min L'.
+ * prev and cur hold n + 2 costs, the first and last are kPad.
+ * @return min of cur.
+ */
+template <bool kAdd>
+inline std::uint16_t path_step(const std::uint8_t* cost,
+    const std::uint16_t* prev, std::uint16_t prev_min, std::uint16_t p1,
+    std::uint16_t p2, int n, std::uint16_t* cur, std::uint16_t* sum) {
+  const std::uint16_t jump = prev_min + p2;
+  std::uint16_t m = 0xFFFF;
+  for (int d = 0; d < n; d++) {
+    std::uint16_t v = std::min(std::min(prev[d + 1], jump),
+        static_cast<std::uint16_t>(std::min(prev[d], prev[d + 2]) + p1));
+    std::uint16_t l = cost[d] + v - prev_min;
+    cur[d + 1] = l;
+    sum[d] = kAdd ? sum[d] + l : l;
+    m = std::min(m, l);
+  }
+  return m;
+}
+
+/** Min of s[begin, end), 0xFFFF if empty. */
+inline std::uint16_t min_of(const std::uint16_t* s, int begin, int end) {
+  std::uint16_t m = 0xFFFF;
+  for (int d = begin; d < end; d++) m = std::min(m, s[d]);
+  return m;
+}
+
+inline void init_path(std::uint16_t* path, int n) {
+  path[0] = path[n + 1] = kPad;
+  std::fill(path + 1, path + n + 1, 0);
+}
+
+}  // namespace
+
+StereoMatcher::StereoMatcher(int width, int height,
+    const StereoMatcherParams& params)
+  : width_(std::max(0, width)), height_(std::max(0, height)),
+    params_(params) {
+  disparities_ = (std::max(16, params_.max_disparity) + 15) / 16 * 16;
+  params_.max_disparity = disparities_;
+  params_.p1 = std::max(0, std::min(params_.p1, 1000));
+  params_.p2 = std::max(params_.p1, std::min(params_.p2, 4000));
+  census_left_.resize(static_cast<std::size_t>(width_) * height_);
+  census_right_.resize(census_left_.size());
+  sum_.resize(census_left_.size() * disparities_);
+}
+
+StereoMatcher::~StereoMatcher() {
+}
+
+void StereoMatcher::Census(const std::uint8_t* src, std::size_t step,
+    std::uint64_t* dst) const {
+  const int w = width_, h = height_;
+  parallel::for_each(h, [&](int begin, int end) {
+    int cols[2 * kCensusRadiusX + 1];
+    for (int y = begin; y < end; y++) {
+      const std::uint8_t* rows[2 * kCensusRadiusY + 1];
+      for (int j = -kCensusRadiusY; j <= kCensusRadiusY; j++) {
+        int yy = std::max(0, std::min(h - 1, y + j));
+        rows[j + kCensusRadiusY] = src + yy * step;
+      }
+      const std::uint8_t* center = src + y * step;
+      std::uint64_t* out = dst + y * w;
+      for (int x = 0; x < w; x++) {
+        // the image border is repeated
+        for (int i = -kCensusRadiusX; i <= kCensusRadiusX; i++) {
+          cols[i + kCensusRadiusX] = std::max(0, std::min(w - 1, x + i));
+        }
+        const std::uint8_t c = center[x];
+        std::uint64_t bits = 0;
+        for (int j = 0; j <= 2 * kCensusRadiusY; j++) {
+          for (int i = 0; i <= 2 * kCensusRadiusX; i++) {
+            if (j == kCensusRadiusY && i == kCensusRadiusX) continue;
+            bits = (bits << 1) | (rows[j][cols[i]] < c);
+          }
+        }
+        out[x] = bits;
+      }
+    }
+  }, kMinBandRows);
+}
+
+void StereoMatcher::CostRow(int y, int x0, int x1, std::uint8_t* cost) const {
+  const int n = disparities_;
+  const std::uint64_t* left = census_left_.data() + y * width_;
+  // right rows are reversed, so right pixel x - d is at w - 1 - x + d
+  const std::uint64_t* right = census_right_.data() + y * width_;
+  for (int x = x0; x < x1; x++, cost += n) {
+    const std::uint64_t c = left[x];
+    const std::uint64_t* r = right + width_ - 1 - x;
+    const int valid = std::min(n, x + 1);
+    for (int d = 0; d < valid; d++) {
+      cost[d] = static_cast<std::uint8_t>(popcount(c ^ r[d]));
+    }
+    std::fill(cost + valid, cost + n, kMaxCost);
+  }
+}
+
+void StereoMatcher::AggregateVertical() {
+  const int w = width_, h = height_, n = disparities_;
+  const std::uint16_t p1 = params_.p1, p2 = params_.p2;
+  parallel::for_each(w, [&](int x0, int x1) {
+    const int cols = x1 - x0;
+    buffer_t<std::uint8_t> cost(static_cast<std::size_t>(cols) * n);
+    buffer_t<std::uint16_t> prev(static_cast<std::size_t>(cols) * (n + 2));
+    buffer_t<std::uint16_t> cur(prev.size());
+    std::vector<std::uint16_t> prev_min(cols), cur_min(cols);
+    // top to bottom assigns the sum, bottom to top adds
+    for (int pass = 0; pass < 2; pass++) {
+      for (int i = 0; i < cols; i++) init_path(&prev[i * (n + 2)], n);
+      std::fill(prev_min.begin(), prev_min.end(), 0);
+      for (int i = 0; i < cols; i++) {
+        cur[i * (n + 2)] = cur[i * (n + 2) + n + 1] = kPad;
+      }
+      for (int k = 0; k < h; k++) {
+        const int y = pass == 0 ? k : h - 1 - k;
+        CostRow(y, x0, x1, cost.data());
+        std::uint16_t* sum = sum_.data() + (y * w + x0) * n;
+        for (int i = 0; i < cols; i++) {
+          const std::size_t p = i * (n + 2);
+          if (pass == 0) {
+            cur_min[i] = path_step<false>(&cost[i * n], &prev[p],
+                prev_min[i], p1, p2, n, &cur[p], sum + i * n);
+          } else {
+            cur_min[i] = path_step<true>(&cost[i * n], &prev[p],
+                prev_min[i], p1, p2, n, &cur[p], sum + i * n);
+          }
+        }
+        prev.swap(cur);
+        prev_min.swap(cur_min);
+      }
+    }
+  }, kMinBandCols);
+}
+
+void StereoMatcher::AggregateRows(std::uint16_t* disparity,
+    std::size_t disparity_step) {
+  const int w = width_, h = height_, n = disparities_;
+  const std::uint16_t p1 = params_.p1, p2 = params_.p2;
+  const int uniqueness = std::max(0, params_.uniqueness);
+  const bool lr_check = params_.lr_check, subpixel = params_.subpixel;
+  parallel::for_each(h, [&](int begin, int end) {
+    buffer_t<std::uint8_t> cost(static_cast<std::size_t>(w) * n);
+    buffer_t<std::uint16_t> prev(n + 2), cur(n + 2);
+    std::vector<std::uint16_t> right_cost(w);
+    std::vector<std::int32_t> right_disp(w);
+    for (int y = begin; y < end; y++) {
+      CostRow(y, 0, w, cost.data());
+      std::uint16_t* sum = sum_.data() + y * w * n;
+      // left to right, then right to left
+      for (int pass = 0; pass < 2; pass++) {
+        init_path(prev.data(), n);
+        cur[0] = cur[n + 1] = kPad;
+        std::uint16_t prev_min = 0;
+        for (int k = 0; k < w; k++) {
+          const int x = pass == 0 ? k : w - 1 - k;
+          prev_min = path_step<true>(&cost[x * n], prev.data(), prev_min,
+              p1, p2, n, cur.data(), sum + x * n);
+          prev.swap(cur);
+        }
+      }
+
+      // best disparity of each right pixel, for the check
+      if (lr_check) {
+        std::fill(right_cost.begin(), right_cost.end(), 0xFFFF);
+        std::fill(right_disp.begin(), right_disp.end(), -1);
+        for (int x = 0; x < w; x++) {
+          const std::uint16_t* s = sum + x * n;
+          const int valid = std::min(n, x + 1);
+          for (int d = 0; d < valid; d++) {
+            if (s[d] < right_cost[x - d]) {
+              right_cost[x - d] = s[d];
+              right_disp[x - d] = d;
+            }
+          }
+        }
+      }
+
+      std::uint16_t* out = reinterpret_cast<std::uint16_t*>(
+          reinterpret_cast<std::uint8_t*>(disparity) + y * disparity_step);
+      for (int x = 0; x < w; x++) {
+        const std::uint16_t* s = sum + x * n;
+        const int valid = std::min(n, x + 1);
+        // the min as a reduction first, which vectorizes, then its index
+        const std::uint16_t best_cost = min_of(s, 0, valid);
+        int best = 0;
+        while (s[best] != best_cost) best++;
+        bool ok = true;
+        if (uniqueness > 0) {
+          std::uint16_t second = std::min(min_of(s, 0, best - 1),
+              min_of(s, best + 2, valid));
+          ok = second * (100 - uniqueness) >= best_cost * 100;
+        }
+        if (ok && lr_check && std::abs(right_disp[x - best] - best) > 1) {
+          ok = false;
+        }
+        if (!ok) {
+          out[x] = kInvalidDisparity;
+          continue;
+        }
+        int value = best * kDisparityScale;
+        if (subpixel && best > 0 && best < valid - 1) {
+          int prev_cost = s[best - 1], next_cost = s[best + 1];
+          int denom = std::max(prev_cost + next_cost - 2 * s[best], 1);
+          value += ((prev_cost - next_cost) * kDisparityScale + denom) /
+              (denom * 2);
+        }
+        out[x] = static_cast<std::uint16_t>(std::max(0, value));
+      }
+    }
+  }, kMinBandRows);
+}
+
+void StereoMatcher::Compute(const std::uint8_t* left, std::size_t left_step,
+    const std::uint8_t* right, std::size_t right_step,
+    std::uint16_t* disparity, std::size_t disparity_step) {
+  if (width_ == 0 || height_ == 0) return;
+  Census(left, left_step, census_left_.data());
+  Census(right, right_step, census_right_.data());
+  parallel::for_each(height_, [this](int begin, int end) {
+    for (int y = begin; y < end; y++) {
+      std::uint64_t* row = census_right_.data() + y * width_;
+      std::reverse(row, row + width_);
+    }
+  }, kMinBandRows);
+  AggregateVertical();
+  AggregateRows(disparity, disparity_step);
+}
+
+namespace {
+
+bool to_gray(const Image::pointer& image, std::vector<std::uint8_t,
+    AlignedAllocator<std::uint8_t>>* gray) {
+  gray->resize(image->width() * image->height());
+  return image->ConvertTo(ImageFormat::IMAGE_GRAY_8, gray->data());
+}
+
+}  // namespace
+
+bool StereoMatcher::Compute(const Image::pointer& left,
+    const Image::pointer& right, buffer_t<std::uint16_t>* disparity) {
+  if (!left || !right || left->width() != width_ ||
+      left->height() != height_ || right->width() != width_ ||
+      right->height() != height_) {
+    LOGE("Error: StereoMatcher:: images must be of %dx%d", width_, height_);
+    return false;
+  }
+  if (!to_gray(left, &gray_left_) || !to_gray(right, &gray_right_)) {
+    LOGE("Error: StereoMatcher:: images can not be converted to gray");
+    return false;
+  }
+  disparity->resize(static_cast<std::size_t>(width_) * height_);
+  Compute(gray_left_.data(), width_, gray_right_.data(), width_,
+      disparity->data(), width_ * sizeof(std::uint16_t));
+  return true;
+}
+
+Image::pointer StereoMatcher::ToDepth(
+    const buffer_t<std::uint16_t>& disparity,
+    const StereoCalibration& calib) const {
+  if (disparity.size() != static_cast<std::size_t>(width_) * height_) {
+    LOGE("Error: StereoMatcher:: disparity must be of %dx%d",
+        width_, height_);
+    return nullptr;
+  }
+  auto depth = ImageDepth::Create(ImageFormat::DEPTH_RAW, width_, height_,
+      false);
+  std::uint16_t* out = reinterpret_cast<std::uint16_t*>(depth->data());
+  const std::size_t n = disparity.size();
+  for (std::size_t i = 0; i < n; i++) {
+    double z = disparity[i] == kInvalidDisparity ? 0 :
+        calib.DisparityToDepth(disparity[i] / double(kDisparityScale));
+    out[i] = static_cast<std::uint16_t>(std::min(65535., std::round(z)));
+  }
+  return depth;
+}
+
+MYNTEYE_END_NAMESPACE
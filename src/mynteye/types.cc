@@ -91,6 +91,12 @@ std::ostream &operator<<(std::ostream &os, const ImuIntrinsics &in) {
   return os;
 }
 
+std::ostream &operator<<(std::ostream &os, const CameraIntrinsics &in) {
+  return os << FULL_PRECISION << "width: " << in.width
+            << ", height: " << in.height << ", fx: " << in.fx
+            << ", fy: " << in.fy << ", cx: " << in.cx << ", cy: " << in.cy;
+}
+
 std::ostream &operator<<(std::ostream &os, const MotionIntrinsics &in) {
   return os << FULL_PRECISION << "accel: {" << in.accel << "}, gyro: {"
             << in.gyro << "}";
@@ -13,6 +13,8 @@
 // limitations under the License.
 #include "mynteye/util/convertor.h"
 
+#include <cstdlib>
+
 #include "mynteye/util/log.h"
 
 MYNTEYE_BEGIN_NAMESPACE
@@ -38,9 +40,14 @@ my_error_exit(j_common_ptr cinfo) {
 
 #endif
 
-int MJPEG_TO_RGB_LIBJPEG(unsigned char* jpg, int nJpgSize,
-    unsigned char* rgb) {
 #ifdef WITH_JPEG
+
+namespace {
+
+// decode to out_color_space, of width * output_components bytes per row,
+// swap_rb swaps r and b of each row while it is still in cache
+int mjpeg_decode(unsigned char* jpg, int nJpgSize, unsigned char* out,
+    J_COLOR_SPACE out_color_space, bool swap_rb = false) {
   struct jpeg_decompress_struct cinfo;
   struct my_error_mgr jerr;
 
@@ -64,6 +71,7 @@ int MJPEG_TO_RGB_LIBJPEG(unsigned char* jpg, int nJpgSize,
     LOGE("Error: File does not seem to be a normal JPEG !!");
   }
 
+  cinfo.out_color_space = out_color_space;
   jpeg_start_decompress(&cinfo);
 
   width = cinfo.output_width;
@@ -76,9 +84,17 @@ int MJPEG_TO_RGB_LIBJPEG(unsigned char* jpg, int nJpgSize,
     unsigned char *buffer_array[1];
     // buffer_array[0] = rgb + (width * height * 3) -
     //     (cinfo.output_scanline) * row_stride;
-    buffer_array[0] = rgb + (cinfo.output_scanline) * row_stride;
+    buffer_array[0] = out + (cinfo.output_scanline) * row_stride;
 
     jpeg_read_scanlines(&cinfo, buffer_array, 1);
+    if (swap_rb && pixel_size == 3) {
+      unsigned char* p = buffer_array[0];
+      for (int i = 0; i < width; i++, p += 3) {
+        unsigned char tmp = p[0];
+        p[0] = p[2];
+        p[2] = tmp;
+      }
+    }
   }
 
   jpeg_finish_decompress(&cinfo);
@@ -86,12 +102,45 @@ int MJPEG_TO_RGB_LIBJPEG(unsigned char* jpg, int nJpgSize,
 
   UNUSED(height);
   return 0;
+}
+
+}  // namespace
+
+#endif
+
+int MJPEG_TO_RGB_LIBJPEG(unsigned char* jpg, int nJpgSize,
+    unsigned char* rgb) {
+#ifdef WITH_JPEG
+  return mjpeg_decode(jpg, nJpgSize, rgb, JCS_RGB);
 #else
   throw new std::runtime_error(
       "Can't convert MJPG to RGB, as libjpeg not found.");
 #endif
 }
 
+int MJPEG_TO_BGR_LIBJPEG(unsigned char* jpg, int nJpgSize,
+    unsigned char* bgr) {
+#if defined(WITH_JPEG) && defined(JCS_EXTENSIONS)
+  // libjpeg-turbo writes bgr itself
+  return mjpeg_decode(jpg, nJpgSize, bgr, JCS_EXT_BGR);
+#elif defined(WITH_JPEG)
+  return mjpeg_decode(jpg, nJpgSize, bgr, JCS_RGB, true);
+#else
+  throw new std::runtime_error(
+      "Can't convert MJPG to BGR, as libjpeg not found.");
+#endif
+}
+
+int MJPEG_TO_GRAY_LIBJPEG(unsigned char* jpg, int nJpgSize,
+    unsigned char* gray) {
+#ifdef WITH_JPEG
+  return mjpeg_decode(jpg, nJpgSize, gray, JCS_GRAYSCALE);
+#else
+  throw new std::runtime_error(
+      "Can't convert MJPG to GRAY, as libjpeg not found.");
+#endif
+}
+
 namespace {
 
 int yuv_to_rgb_pixel(int y, int u, int v) {
@@ -120,6 +169,54 @@ int yuv_to_rgb_pixel(int y, int u, int v) {
 
 }  // namespace
 
+bool RGB_TO_MJPEG_LIBJPEG(const unsigned char* rgb,
+    unsigned int width, unsigned int height, int quality,
+    std::vector<unsigned char>* jpg) {
+#ifdef WITH_JPEG
+  struct jpeg_compress_struct cinfo;
+  struct my_error_mgr jerr;
+  unsigned char* out = nullptr;
+  unsigned long out_size = 0;  // NOLINT
+
+  cinfo.err = jpeg_std_error(&jerr.pub);
+  jerr.pub.error_exit = my_error_exit;
+
+  if (setjmp(jerr.setjmp_buffer)) {
+    jpeg_destroy_compress(&cinfo);
+    std::free(out);
+    return false;
+  }
+
+  jpeg_create_compress(&cinfo);
+  jpeg_mem_dest(&cinfo, &out, &out_size);
+
+  cinfo.image_width = width;
+  cinfo.image_height = height;
+  cinfo.input_components = 3;
+  cinfo.in_color_space = JCS_RGB;
+  jpeg_set_defaults(&cinfo);
+  jpeg_set_quality(&cinfo, quality, TRUE);
+  jpeg_start_compress(&cinfo, TRUE);
+
+  int row_stride = width * 3;
+  while (cinfo.next_scanline < cinfo.image_height) {
+    JSAMPROW row = const_cast<unsigned char*>(
+        rgb + cinfo.next_scanline * row_stride);
+    jpeg_write_scanlines(&cinfo, &row, 1);
+  }
+
+  jpeg_finish_compress(&cinfo);
+  jpg->assign(out, out + out_size);
+  jpeg_destroy_compress(&cinfo);
+  std::free(out);
+  return true;
+#else
+  UNUSED(rgb, width, height, quality, jpg);
+  throw new std::runtime_error(
+      "Can't convert RGB to MJPG, as libjpeg not found.");
+#endif
+}
+
 int YUYV_TO_RGB(unsigned char* yuv, unsigned char* rgb, unsigned int width,
     unsigned int height) {
   unsigned int in, out = 0;
@@ -226,6 +323,53 @@ void BGR_TO_RGB(unsigned char* bgr,
   reverse(bgr, width, height);
 }
 
+void RGB_TO_BGR(const unsigned char* rgb, unsigned char* bgr,
+    unsigned int width, unsigned int height) {
+  for (unsigned int i = 0, n = width * height * 3; i < n; i += 3) {
+    bgr[i] = rgb[i + 2];
+    bgr[i + 1] = rgb[i + 1];
+    bgr[i + 2] = rgb[i];
+  }
+}
+
+void BGR_TO_RGB(const unsigned char* bgr, unsigned char* rgb,
+    unsigned int width, unsigned int height) {
+  RGB_TO_BGR(bgr, rgb, width, height);
+}
+
+namespace {
+
+// luma of BT.601 in 8 bit fixed point, r at offset r and b at 2 - r
+void to_gray(const unsigned char* src, unsigned char* gray,
+    unsigned int width, unsigned int height, int r) {
+  const int b = 2 - r;
+  for (unsigned int i = 0, n = width * height; i < n; i++) {
+    const unsigned char* p = src + 3 * i;
+    gray[i] = static_cast<unsigned char>(
+        (p[r] * 77 + p[1] * 150 + p[b] * 29) >> 8);
+  }
+}
+
+}  // namespace
+
+void RGB_TO_GRAY(const unsigned char* rgb, unsigned char* gray,
+    unsigned int width, unsigned int height) {
+  to_gray(rgb, gray, width, height, 0);
+}
+
+void BGR_TO_GRAY(const unsigned char* bgr, unsigned char* gray,
+    unsigned int width, unsigned int height) {
+  to_gray(bgr, gray, width, height, 2);
+}
+
+void YUYV_TO_GRAY(const unsigned char* yuv, unsigned char* gray,
+    unsigned int width, unsigned int height) {
+  // y of each pixel is its first byte
+  for (unsigned int i = 0, n = width * height; i < n; i++) {
+    gray[i] = yuv[2 * i];
+  }
+}
+
 namespace {
 
 void swap(unsigned char* a, unsigned char* b, unsigned char* tmp) {
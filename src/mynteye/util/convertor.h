@@ -28,6 +28,8 @@ extern "C" {
 
 #endif
 
+#include <vector>
+
 #include "mynteye/stubs/global.h"
 
 MYNTEYE_BEGIN_NAMESPACE
@@ -46,6 +48,17 @@ typedef struct my_error_mgr* my_error_ptr;
 extern int MJPEG_TO_RGB_LIBJPEG(unsigned char* jpg, int nJpgSize,
     unsigned char* rgb);
 
+extern int MJPEG_TO_BGR_LIBJPEG(unsigned char* jpg, int nJpgSize,
+    unsigned char* bgr);
+
+extern int MJPEG_TO_GRAY_LIBJPEG(unsigned char* jpg, int nJpgSize,
+    unsigned char* gray);
+
+/** Encode rgb into jpg, of quality 0-100, false if it failed. */
+extern bool RGB_TO_MJPEG_LIBJPEG(const unsigned char* rgb,
+    unsigned int width, unsigned int height, int quality,
+    std::vector<unsigned char>* jpg);
+
 extern int YUYV_TO_RGB(unsigned char* yuv, unsigned char* rgb,
     unsigned int width, unsigned int height);
 
@@ -58,6 +71,21 @@ extern void RGB_TO_BGR(unsigned char* rgb,
 extern void BGR_TO_RGB(unsigned char* bgr,
     unsigned int width, unsigned int height);
 
+extern void RGB_TO_BGR(const unsigned char* rgb, unsigned char* bgr,
+    unsigned int width, unsigned int height);
+
+extern void BGR_TO_RGB(const unsigned char* bgr, unsigned char* rgb,
+    unsigned int width, unsigned int height);
+
+extern void RGB_TO_GRAY(const unsigned char* rgb, unsigned char* gray,
+    unsigned int width, unsigned int height);
+
+extern void BGR_TO_GRAY(const unsigned char* bgr, unsigned char* gray,
+    unsigned int width, unsigned int height);
+
+extern void YUYV_TO_GRAY(const unsigned char* yuv, unsigned char* gray,
+    unsigned int width, unsigned int height);
+
 extern void FLIP_UP_DOWN_C3(unsigned char* rgb, unsigned int width, unsigned int height);
 
 MYNTEYE_END_NAMESPACE
@@ -0,0 +1,40 @@
+// Copyright 2018 Slightech Co., Ltd. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#ifndef MYNTEYE_UTIL_DEPTH_H_
+#define MYNTEYE_UTIL_DEPTH_H_
+#pragma once
+
+#include <cstdint>
+
+#include "mynteye/stubs/global.h"
+
+MYNTEYE_BEGIN_NAMESPACE
+
+namespace depth {
+
+/** Raw depth value the device reports for no depth. */
+constexpr std::uint16_t kInvalid = 0;
+/** Raw depth value the device reports for out of range. */
+constexpr std::uint16_t kOutOfRange = 4096;
+
+/** Whether raw depth value d is a measurement, branch free. */
+inline bool is_valid(std::uint16_t d) {
+  return (d != kInvalid) & (d != kOutOfRange);
+}
+
+}  // namespace depth
+
+MYNTEYE_END_NAMESPACE
+
+#endif  // MYNTEYE_UTIL_DEPTH_H_
@@ -10,13 +10,14 @@
 #include <sys/stat.h>
 #endif
 
+#include <cerrno>
 #include <string>
 
 MYNTEYE_BEGIN_NAMESPACE
 
 namespace files {
 
-bool _mkdir(const std::string &path) {
+inline bool _mkdir(const std::string &path) {
 #if defined(MYNTEYE_OS_MINGW) || defined(MYNTEYE_OS_CYGWIN)
   const int status = ::mkdir(path.c_str());
 #elif defined(MYNTEYE_OS_WIN)
@@ -42,16 +43,19 @@ bool _mkdir(const std::string &path) {
   }
 }
 
-bool mkdir(const std::string &path) {
+inline bool mkdir(const std::string &path) {
   auto &&dirs = strings::split(path, MYNTEYE_OS_SEP);
   auto &&size = dirs.size();
   if (size <= 0)
     return false;
   std::string p{dirs[0]};
-  if (!_mkdir(p))
+  // empty if absolute
+  if (!p.empty() && !_mkdir(p))
     return false;
   for (std::size_t i = 1; i < size; i++) {
     p.append(MYNTEYE_OS_SEP).append(dirs[i]);
+    if (dirs[i].empty())
+      continue;
     if (!_mkdir(p))
       return false;
   }
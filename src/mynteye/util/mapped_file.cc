@@ -0,0 +1,123 @@
+// Copyright 2018 Slightech Co., Ltd. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include "mynteye/util/mapped_file.h"
+
+#include <algorithm>
+
+#ifdef MYNTEYE_OS_WIN
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+MYNTEYE_BEGIN_NAMESPACE
+
+#ifdef MYNTEYE_OS_WIN
+
+MappedFile::MappedFile()
+  : data_(nullptr), size_(0), file_(nullptr), mapping_(nullptr) {
+}
+
+bool MappedFile::Open(const std::string& path) {
+  Close();
+  HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ,
+      NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+  if (file == INVALID_HANDLE_VALUE) return false;
+  LARGE_INTEGER size;
+  if (!GetFileSizeEx(file, &size) || size.QuadPart == 0) {
+    CloseHandle(file);
+    return false;
+  }
+  HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+  if (mapping == NULL) {
+    CloseHandle(file);
+    return false;
+  }
+  void* data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+  if (data == NULL) {
+    CloseHandle(mapping);
+    CloseHandle(file);
+    return false;
+  }
+  file_ = file;
+  mapping_ = mapping;
+  data_ = static_cast<std::uint8_t*>(data);
+  size_ = static_cast<std::size_t>(size.QuadPart);
+  return true;
+}
+
+void MappedFile::Close() {
+  if (data_) UnmapViewOfFile(data_);
+  if (mapping_) CloseHandle(mapping_);
+  if (file_) CloseHandle(file_);
+  data_ = nullptr;
+  size_ = 0;
+  mapping_ = nullptr;
+  file_ = nullptr;
+}
+
+void MappedFile::Prefetch(std::size_t offset, std::size_t size) const {
+  // read ahead by the cache manager of windows
+  (void)offset;
+  (void)size;
+}
+
+#else
+
+MappedFile::MappedFile() : data_(nullptr), size_(0) {
+}
+
+bool MappedFile::Open(const std::string& path) {
+  Close();
+  int fd = ::open(path.c_str(), O_RDONLY);
+  if (fd < 0) return false;
+  struct stat st;
+  if (::fstat(fd, &st) != 0 || st.st_size <= 0) {
+    ::close(fd);
+    return false;
+  }
+  void* data = ::mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  // the mapping keeps the file alive
+  ::close(fd);
+  if (data == MAP_FAILED) return false;
+  data_ = static_cast<std::uint8_t*>(data);
+  size_ = static_cast<std::size_t>(st.st_size);
+  return true;
+}
+
+void MappedFile::Close() {
+  if (data_) ::munmap(data_, size_);
+  data_ = nullptr;
+  size_ = 0;
+}
+
+void MappedFile::Prefetch(std::size_t offset, std::size_t size) const {
+  if (!data_ || offset >= size_) return;
+  size = std::min(size, size_ - offset);
+  // madvise takes a page aligned start
+  static const std::size_t page = ::sysconf(_SC_PAGESIZE);
+  std::size_t begin = offset / page * page;
+  ::madvise(data_ + begin, offset + size - begin, MADV_WILLNEED);
+}
+
+#endif
+
+MappedFile::~MappedFile() {
+  Close();
+}
+
+MYNTEYE_END_NAMESPACE
@@ -0,0 +1,66 @@
+// Copyright 2018 Slightech Co., Ltd. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#ifndef MYNTEYE_UTIL_MAPPED_FILE_H_
+#define MYNTEYE_UTIL_MAPPED_FILE_H_
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+#include "mynteye/stubs/global.h"
+
+MYNTEYE_BEGIN_NAMESPACE
+
+/**
+ * A whole file mapped read-only into memory, unmapped on destruction.
+ */
+class MappedFile {
+ public:
+  MappedFile();
+  ~MappedFile();
+
+  /** Map the file, false if it does not exist, is empty or failed. */
+  bool Open(const std::string& path);
+  void Close();
+
+  bool IsOpened() const {
+    return data_ != nullptr;
+  }
+
+  const std::uint8_t* data() const {
+    return data_;
+  }
+
+  std::size_t size() const {
+    return size_;
+  }
+
+  /** Hint the bytes of the range are read soon, to read them ahead. */
+  void Prefetch(std::size_t offset, std::size_t size) const;
+
+ private:
+  std::uint8_t* data_;
+  std::size_t size_;
+#ifdef MYNTEYE_OS_WIN
+  void* file_;
+  void* mapping_;
+#endif
+
+  MYNTEYE_DISABLE_COPY(MappedFile)
+  MYNTEYE_DISABLE_MOVE(MappedFile)
+};
+
+MYNTEYE_END_NAMESPACE
+
+#endif  // MYNTEYE_UTIL_MAPPED_FILE_H_
@@ -0,0 +1,175 @@
+// Copyright 2018 Slightech Co., Ltd. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include "mynteye/util/parallel.h"
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+MYNTEYE_BEGIN_NAMESPACE
+
+namespace parallel {
+
+namespace {
+
+struct Job {
+  const band_func_t* func;
+  int n;
+  int chunk;
+  int chunks;
+  std::atomic<int> next;
+  std::atomic<int> done;
+
+  std::mutex mutex;
+  std::condition_variable finished;
+
+  /** Run chunks until none is left, return true if it finished the job. */
+  bool Work() {
+    int finished_here = 0;
+    for (;;) {
+      int i = next.fetch_add(1);
+      if (i >= chunks) break;
+      int begin = i * chunk;
+      int end = std::min(n, begin + chunk);
+      (*func)(begin, end);
+      ++finished_here;
+    }
+    if (finished_here == 0) return false;
+    return done.fetch_add(finished_here) + finished_here == chunks;
+  }
+};
+
+class WorkerPool {
+ public:
+  static WorkerPool& instance() {
+    static WorkerPool pool;
+    return pool;
+  }
+
+  int concurrency() const {
+    return static_cast<int>(threads_.size()) + 1;
+  }
+
+  void Run(int n, const band_func_t& func, int grain) {
+    if (n <= 0) return;
+    int max_chunks = concurrency() * 4;
+    int chunk = std::max(grain, (n + max_chunks - 1) / max_chunks);
+    int chunks = (n + chunk - 1) / chunk;
+    if (chunks <= 1 || threads_.empty()) {
+      func(0, n);
+      return;
+    }
+
+    auto job = std::make_shared<Job>();
+    job->func = &func;
+    job->n = n;
+    job->chunk = chunk;
+    job->chunks = chunks;
+    job->next = 0;
+    job->done = 0;
+    {
+      std::lock_guard<std::mutex> _(mutex_);
+      int helpers = std::min(chunks - 1, static_cast<int>(threads_.size()));
+      for (int i = 0; i < helpers; i++) {
+        jobs_.push_back(job);
+      }
+    }
+    cond_.notify_all();
+
+    if (!job->Work()) {
+      std::unique_lock<std::mutex> lock(job->mutex);
+      job->finished.wait(lock, [&job] {
+        return job->done.load() == job->chunks;
+      });
+    }
+  }
+
+ private:
+  WorkerPool() : stop_(false) {
+    unsigned int n = std::thread::hardware_concurrency();
+    for (unsigned int i = 1; i < n; i++) {
+      threads_.emplace_back(&WorkerPool::Loop, this);
+    }
+  }
+
+  ~WorkerPool() {
+    {
+      std::lock_guard<std::mutex> _(mutex_);
+      stop_ = true;
+    }
+    cond_.notify_all();
+    for (auto&& thread : threads_) {
+      if (thread.joinable()) thread.join();
+    }
+  }
+
+  void Loop() {
+    for (;;) {
+      std::shared_ptr<Job> job;
+      {
+        std::unique_lock<std::mutex> lock(mutex_);
+        cond_.wait(lock, [this] { return stop_ || !jobs_.empty(); });
+        if (stop_) return;
+        job = jobs_.front();
+        jobs_.pop_front();
+      }
+      if (job->Work()) {
+        std::lock_guard<std::mutex> _(job->mutex);
+        job->finished.notify_all();
+      }
+    }
+  }
+
+  std::vector<std::thread> threads_;
+  std::deque<std::shared_ptr<Job>> jobs_;
+  std::mutex mutex_;
+  std::condition_variable cond_;
+  bool stop_;
+
+  MYNTEYE_DISABLE_COPY(WorkerPool)
+  MYNTEYE_DISABLE_MOVE(WorkerPool)
+};
+
+}  // namespace
+
+int concurrency() {
+  return WorkerPool::instance().concurrency();
+}
+
+void for_each(int n, const band_func_t& func, int grain) {
+  WorkerPool::instance().Run(n, func, std::max(grain, 1));
+}
+
+Bands::Bands(int n, int max_bands) : n_(std::max(n, 0)) {
+  if (max_bands <= 0) max_bands = concurrency() * 2;
+  bands_ = std::max(1, std::min(n_, max_bands));
+}
+
+void Bands::Run(
+    const std::function<void(int band, int begin, int end)>& func) const {
+  for_each(bands_, [this, &func](int b0, int b1) {
+    for (int b = b0; b < b1; b++) {
+      func(b, begin(b), end(b));
+    }
+  });
+}
+
+}  // namespace parallel
+
+MYNTEYE_END_NAMESPACE
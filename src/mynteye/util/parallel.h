@@ -0,0 +1,64 @@
+// Copyright 2018 Slightech Co., Ltd. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#ifndef MYNTEYE_UTIL_PARALLEL_H_
+#define MYNTEYE_UTIL_PARALLEL_H_
+#pragma once
+
+#include <functional>
+
+#include "mynteye/stubs/global.h"
+
+MYNTEYE_BEGIN_NAMESPACE
+
+namespace parallel {
+
+using band_func_t = std::function<void(int begin, int end)>;
+
+/** Number of threads a parallel call may use, including the caller. */
+int concurrency();
+
+/**
+ * Split [0, n) into bands of at least grain items and run func on each band.
+ * The bands run on a process wide worker pool and the calling thread, and
+ * this returns when all of them are done. Nested calls are allowed.
+ */
+void for_each(int n, const band_func_t& func, int grain = 1);
+
+/**
+ * Split [0, n) into exactly bands() contiguous bands, the same split for the
+ * same n, so that results of one pass can be indexed by band in the next.
+ */
+class Bands {
+ public:
+  explicit Bands(int n, int max_bands = 0);
+
+  int bands() const { return bands_; }
+  int begin(int band) const { return static_cast<int>(
+      static_cast<long long>(n_) * band / bands_); }  // NOLINT
+  int end(int band) const { return begin(band + 1); }
+
+  /** Run func(band, begin, end) for every band in parallel. */
+  void Run(const std::function<void(int band, int begin, int end)>& func)
+      const;
+
+ private:
+  int n_;
+  int bands_;
+};
+
+}  // namespace parallel
+
+MYNTEYE_END_NAMESPACE
+
+#endif  // MYNTEYE_UTIL_PARALLEL_H_
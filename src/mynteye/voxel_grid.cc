@@ -0,0 +1,303 @@
+// Copyright 2018 Slightech Co., Ltd. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include "mynteye/voxel_grid.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#include "mynteye/util/log.h"
+#include "mynteye/util/parallel.h"
+
+MYNTEYE_BEGIN_NAMESPACE
+
+constexpr int VoxelGrid::kBlockSize;
+constexpr int VoxelGrid::kShards;
+constexpr int VoxelGrid::kBlockVoxels;
+
+namespace {
+
+const int kMinBandRows = 16;
+/** Updates a band gathers for a shard before taking its lock */
+const std::size_t kBatchSize = 4096;
+
+const int kKeyBits = 21;
+const std::uint64_t kKeyMask = (1ull << kKeyBits) - 1;
+
+inline std::uint64_t block_key(int bx, int by, int bz) {
+  return ((static_cast<std::uint64_t>(bx) & kKeyMask) << (2 * kKeyBits)) |
+      ((static_cast<std::uint64_t>(by) & kKeyMask) << kKeyBits) |
+      (static_cast<std::uint64_t>(bz) & kKeyMask);
+}
+
+inline int key_coord(std::uint64_t key, int shift) {
+  // sign extend the 21 bits
+  std::int64_t v = static_cast<std::int64_t>(
+      (key >> shift) & kKeyMask) << (64 - kKeyBits);
+  return static_cast<int>(v >> (64 - kKeyBits));
+}
+
+inline int shard_of(std::uint64_t key, int shards) {
+  key ^= key >> 29;
+  key *= 0xbf58476d1ce4e5b9ull;
+  key ^= key >> 32;
+  return static_cast<int>(key % shards);
+}
+
+inline int floor_int(float v) {
+  return static_cast<int>(std::floor(v));
+}
+
+}  // namespace
+
+VoxelGrid::VoxelGrid(const CameraIntrinsics& in,
+    const VoxelGridParams& params, float depth_unit)
+  : in_(in), params_(params), cloud_(in, depth_unit), frame_(0) {
+  if (params_.voxel_size <= 0) {
+    LOGE("Error: VoxelGrid:: voxel_size must be positive, use 0.05");
+    params_.voxel_size = 0.05f;
+  }
+  params_.pixel_step = std::max(1, params_.pixel_step);
+  params_.max_blocks = std::max<std::size_t>(1, params_.max_blocks);
+}
+
+VoxelGrid::~VoxelGrid() {
+}
+
+void VoxelGrid::Integrate(const std::uint16_t* depth, std::size_t step,
+    const Pose& pose) {
+  std::lock_guard<std::mutex> _(mtx_);
+  ++frame_;
+  points_.resize(static_cast<std::size_t>(in_.width) * in_.height);
+  cloud_.Generate(depth, step, points_.data());
+
+  const float inv = 1.f / params_.voxel_size;
+  const float max_range = params_.max_range;
+  const int pixel_step = params_.pixel_step;
+  const int width = in_.width;
+  const int rows = (in_.height + pixel_step - 1) / pixel_step;
+  // the camera center in voxel units
+  const float ox = pose.translation[0] * inv;
+  const float oy = pose.translation[1] * inv;
+  const float oz = pose.translation[2] * inv;
+  const auto& r = pose.rotation;
+
+  parallel::for_each(rows, [&](int begin, int end) {
+    std::vector<Update> batches[kShards];
+    auto emit = [&](int x, int y, int z, bool hit) {
+      std::uint64_t key = block_key(x >> 3, y >> 3, z >> 3);
+      std::uint16_t voxel = static_cast<std::uint16_t>(
+          ((z & 7) << 6) | ((y & 7) << 3) | (x & 7));
+      int shard = shard_of(key, kShards);
+      auto&& batch = batches[shard];
+      batch.push_back({key, voxel, hit});
+      if (batch.size() >= kBatchSize) {
+        Apply(shard, batch);
+        batch.clear();
+      }
+    };
+    for (int row = begin; row < end; row++) {
+      const PointXYZ* p = points_.data() + row * pixel_step * width;
+      for (int u = 0; u < width; u += pixel_step) {
+        const PointXYZ& c = p[u];
+        if (std::isnan(c.z)) continue;
+        // truncated rays are free space only
+        float range = std::sqrt(c.x * c.x + c.y * c.y + c.z * c.z);
+        bool hit = range <= max_range;
+        float s = hit ? 1.f : max_range / range;
+        float cx = c.x * s, cy = c.y * s, cz = c.z * s;
+        float ex = (r[0][0] * cx + r[0][1] * cy + r[0][2] * cz) * inv + ox;
+        float ey = (r[1][0] * cx + r[1][1] * cy + r[1][2] * cz) * inv + oy;
+        float ez = (r[2][0] * cx + r[2][1] * cy + r[2][2] * cz) * inv + oz;
+
+        // 3D DDA from the center to the end voxel
+        int ix = floor_int(ox), iy = floor_int(oy), iz = floor_int(oz);
+        const int jx = floor_int(ex), jy = floor_int(ey), jz = floor_int(ez);
+        const float dx = ex - ox, dy = ey - oy, dz = ez - oz;
+        const float inf = std::numeric_limits<float>::infinity();
+        const int sx = dx > 0 ? 1 : -1;
+        const int sy = dy > 0 ? 1 : -1;
+        const int sz = dz > 0 ? 1 : -1;
+        const float tdx = dx != 0 ? std::abs(1.f / dx) : inf;
+        const float tdy = dy != 0 ? std::abs(1.f / dy) : inf;
+        const float tdz = dz != 0 ? std::abs(1.f / dz) : inf;
+        float tx = dx != 0 ? (sx > 0 ? ix + 1 - ox : ox - ix) * tdx : inf;
+        float ty = dy != 0 ? (sy > 0 ? iy + 1 - oy : oy - iy) * tdy : inf;
+        float tz = dz != 0 ? (sz > 0 ? iz + 1 - oz : oz - iz) * tdz : inf;
+        int n = std::abs(jx - ix) + std::abs(jy - iy) + std::abs(jz - iz);
+        for (int i = 0; i < n; i++) {
+          emit(ix, iy, iz, false);
+          if (tx < ty && tx < tz) {
+            ix += sx;
+            tx += tdx;
+          } else if (ty < tz) {
+            iy += sy;
+            ty += tdy;
+          } else {
+            iz += sz;
+            tz += tdz;
+          }
+        }
+        emit(jx, jy, jz, hit);
+      }
+    }
+    for (int shard = 0; shard < kShards; shard++) {
+      if (!batches[shard].empty()) Apply(shard, batches[shard]);
+    }
+  }, std::max(1, kMinBandRows / pixel_step));
+
+  Evict();
+}
+
+bool VoxelGrid::Integrate(const Image::pointer& depth, const Pose& pose) {
+  if (!depth || depth->format() != ImageFormat::DEPTH_RAW ||
+      depth->width() != in_.width || depth->height() != in_.height) {
+    LOGE("Error: VoxelGrid:: depth must be DEPTH_RAW of %dx%d",
+        in_.width, in_.height);
+    return false;
+  }
+  Integrate(reinterpret_cast<const std::uint16_t*>(depth->cdata()),
+      depth->width() * sizeof(std::uint16_t), pose);
+  return true;
+}
+
+void VoxelGrid::Apply(int shard, const std::vector<Update>& updates) {
+  const float hit = params_.log_odds_hit, miss = params_.log_odds_miss;
+  const float lo = params_.log_odds_min, hi = params_.log_odds_max;
+  auto&& s = shards_[shard];
+  std::lock_guard<std::mutex> _(s.mtx);
+  std::uint64_t key = 0;
+  Block* block = nullptr;
+  for (auto&& update : updates) {
+    // rays walk a block for several voxels, so look up on change only
+    if (!block || update.key != key) {
+      key = update.key;
+      auto&& ptr = s.blocks[key];
+      if (!ptr) {
+        ptr.reset(new Block);
+        std::fill(ptr->log_odds, ptr->log_odds + kBlockVoxels, 0.f);
+      }
+      block = ptr.get();
+      block->last_used = frame_;
+    }
+    float& v = block->log_odds[update.voxel];
+    v = std::min(hi, std::max(lo, v + (update.hit ? hit : miss)));
+  }
+}
+
+void VoxelGrid::Evict() {
+  std::size_t n = 0;
+  for (auto&& s : shards_) n += s.blocks.size();
+  if (n <= params_.max_blocks) return;
+  // evict down to 90% of the cap, so not again at the next frame
+  std::size_t keep = params_.max_blocks - params_.max_blocks / 10;
+  std::vector<std::uint64_t> ages;
+  ages.reserve(n);
+  for (auto&& s : shards_) {
+    for (auto&& it : s.blocks) ages.push_back(it.second->last_used);
+  }
+  auto nth = ages.begin() + (n - keep);
+  std::nth_element(ages.begin(), nth, ages.end());
+  std::uint64_t oldest_kept = *nth;
+  // blocks older than the kept ones go, then of its age until enough
+  std::size_t evict = n - keep;
+  for (auto&& s : shards_) {
+    for (auto it = s.blocks.begin(); it != s.blocks.end() && evict > 0;) {
+      if (it->second->last_used < oldest_kept) {
+        it = s.blocks.erase(it);
+        --evict;
+      } else {
+        ++it;
+      }
+    }
+  }
+  for (auto&& s : shards_) {
+    for (auto it = s.blocks.begin(); it != s.blocks.end() && evict > 0;) {
+      if (it->second->last_used == oldest_kept) {
+        it = s.blocks.erase(it);
+        --evict;
+      } else {
+        ++it;
+      }
+    }
+  }
+}
+
+const VoxelGrid::Block* VoxelGrid::Find(const PointXYZ& point,
+    int* voxel) const {
+  const float inv = 1.f / params_.voxel_size;
+  int x = floor_int(point.x * inv);
+  int y = floor_int(point.y * inv);
+  int z = floor_int(point.z * inv);
+  std::uint64_t key = block_key(x >> 3, y >> 3, z >> 3);
+  auto&& s = shards_[shard_of(key, kShards)];
+  auto it = s.blocks.find(key);
+  if (it == s.blocks.end()) return nullptr;
+  *voxel = ((z & 7) << 6) | ((y & 7) << 3) | (x & 7);
+  return it->second.get();
+}
+
+float VoxelGrid::GetLogOdds(const PointXYZ& point) const {
+  std::lock_guard<std::mutex> _(mtx_);
+  int voxel;
+  const Block* block = Find(point, &voxel);
+  return block ? block->log_odds[voxel] : 0.f;
+}
+
+VoxelState VoxelGrid::GetState(const PointXYZ& point) const {
+  float log_odds = GetLogOdds(point);
+  if (log_odds > 0) return VoxelState::OCCUPIED;
+  if (log_odds < 0) return VoxelState::FREE;
+  return VoxelState::UNKNOWN;
+}
+
+std::size_t VoxelGrid::GetOccupied(std::vector<PointXYZ>* centers) const {
+  std::lock_guard<std::mutex> _(mtx_);
+  centers->clear();
+  const float size = params_.voxel_size;
+  for (auto&& s : shards_) {
+    for (auto&& it : s.blocks) {
+      const int bx = key_coord(it.first, 2 * kKeyBits) * kBlockSize;
+      const int by = key_coord(it.first, kKeyBits) * kBlockSize;
+      const int bz = key_coord(it.first, 0) * kBlockSize;
+      const float* log_odds = it.second->log_odds;
+      for (int v = 0; v < kBlockVoxels; v++) {
+        if (log_odds[v] <= 0) continue;
+        centers->push_back({(bx + (v & 7) + 0.5f) * size,
+            (by + ((v >> 3) & 7) + 0.5f) * size,
+            (bz + (v >> 6) + 0.5f) * size});
+      }
+    }
+  }
+  return centers->size();
+}
+
+std::size_t VoxelGrid::blocks() const {
+  std::lock_guard<std::mutex> _(mtx_);
+  std::size_t n = 0;
+  for (auto&& s : shards_) n += s.blocks.size();
+  return n;
+}
+
+std::uint64_t VoxelGrid::frames() const {
+  std::lock_guard<std::mutex> _(mtx_);
+  return frame_;
+}
+
+void VoxelGrid::Clear() {
+  std::lock_guard<std::mutex> _(mtx_);
+  for (auto&& s : shards_) s.blocks.clear();
+}
+
+MYNTEYE_END_NAMESPACE
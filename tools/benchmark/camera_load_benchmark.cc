@@ -0,0 +1,133 @@
+// Copyright 2018 Slightech Co., Ltd. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "mynteye/camera.h"
+
+MYNTEYE_USE_NAMESPACE
+
+namespace {
+
+struct Counts {
+  std::size_t colors = 0;
+  std::size_t depths = 0;
+  std::size_t motions = 0;
+};
+
+}  // namespace
+
+int main(int argc, char const* argv[]) {
+  // [cameras] [seconds] [--fps n] [--stream mode] [--mjpg] [--jitter ms]
+  // [--drop rate]
+  int cameras = 4;
+  int seconds = 10;
+  SyntheticParams params;
+  params.framerate = 60;
+  InitParams init(0);
+  init.stream_mode = StreamMode::STREAM_1280x720;
+  int positional = 0;
+  for (int i = 1; i < argc; i++) {
+    if (std::strcmp(argv[i], "--fps") == 0 && i + 1 < argc) {
+      params.framerate = std::atoi(argv[++i]);
+    } else if (std::strcmp(argv[i], "--stream") == 0 && i + 1 < argc) {
+      init.stream_mode = static_cast<StreamMode>(std::atoi(argv[++i]));
+    } else if (std::strcmp(argv[i], "--mjpg") == 0) {
+      init.color_stream_format = StreamFormat::STREAM_MJPG;
+    } else if (std::strcmp(argv[i], "--jitter") == 0 && i + 1 < argc) {
+      params.jitter_ms = std::atof(argv[++i]);
+    } else if (std::strcmp(argv[i], "--drop") == 0 && i + 1 < argc) {
+      params.drop_rate = std::atof(argv[++i]);
+    } else if (positional == 0) {
+      cameras = std::atoi(argv[i]);
+      positional++;
+    } else {
+      seconds = std::atoi(argv[i]);
+    }
+  }
+  if (cameras <= 0 || seconds <= 0 || params.framerate <= 0) {
+    std::cerr << "Usage: " << argv[0] << " [cameras] [seconds] [--fps n] "
+        "[--stream mode] [--mjpg] [--jitter ms] [--drop rate]" << std::endl;
+    return 1;
+  }
+
+  std::vector<std::unique_ptr<Camera>> cams;
+  for (int i = 0; i < cameras; i++) {
+    params.name = "synthetic" + std::to_string(i);
+    params.seed = i;
+    std::unique_ptr<Camera> cam(new Camera(params));
+    cam->EnableImageType(ImageType::IMAGE_LEFT_COLOR);
+    cam->EnableImageType(ImageType::IMAGE_DEPTH);
+    if (cam->Open(init) != ErrorCode::SUCCESS) {
+      std::cerr << "Error: Open " << params.name << " failed" << std::endl;
+      return 1;
+    }
+    cams.push_back(std::move(cam));
+  }
+
+  // those queued while opening the others are not counted
+  for (auto &&cam : cams) {
+    cam->RetrieveImages(ImageType::IMAGE_LEFT_COLOR);
+    cam->RetrieveImages(ImageType::IMAGE_DEPTH);
+    cam->RetrieveMotions();
+  }
+
+  // each camera retrieved by a thread, as by an app of its own
+  std::atomic<bool> is_stop(false);
+  std::vector<Counts> counts(cameras);
+  std::vector<std::thread> threads;
+  auto &&time_beg = std::chrono::steady_clock::now();
+  for (int i = 0; i < cameras; i++) {
+    threads.emplace_back([&cams, &counts, &is_stop, i]() {
+      auto &&cam = cams[i];
+      auto &&count = counts[i];
+      while (!is_stop) {
+        count.colors +=
+            cam->RetrieveImages(ImageType::IMAGE_LEFT_COLOR).size();
+        count.depths += cam->RetrieveImages(ImageType::IMAGE_DEPTH).size();
+        count.motions += cam->RetrieveMotions().size();
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+      }
+    });
+  }
+  std::this_thread::sleep_for(std::chrono::seconds(seconds));
+  is_stop = true;
+  for (auto &&thread : threads) {
+    thread.join();
+  }
+  double elapsed = std::chrono::duration<double>(
+      std::chrono::steady_clock::now() - time_beg).count();
+  for (auto &&cam : cams) {
+    cam->Close();
+  }
+
+  std::cout << cameras << " cameras at " << params.framerate << " fps, "
+      << seconds << " s" << std::endl;
+  for (int i = 0; i < cameras; i++) {
+    auto &&count = counts[i];
+    std::cout << "synthetic" << i << std::fixed << std::setprecision(1)
+        << ", color fps: " << count.colors / elapsed
+        << ", depth fps: " << count.depths / elapsed
+        << ", motion hz: " << count.motions / elapsed << std::endl;
+  }
+  return 0;
+}
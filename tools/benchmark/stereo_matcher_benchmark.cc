@@ -0,0 +1,132 @@
+// Copyright 2018 Slightech Co., Ltd. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <vector>
+
+#include "mynteye/stereo_matcher.h"
+
+MYNTEYE_USE_NAMESPACE
+
+namespace {
+
+/**
+ * A textured scene of two fronto-parallel planes, the left half at near
+ * and the right half at far disparity, and the pair seen of it.
+ */
+struct Scene {
+  int width;
+  int height;
+  int near;
+  int far;
+  std::vector<std::uint8_t> left;
+  std::vector<std::uint8_t> right;
+
+  int Disparity(int x) const {
+    return x < width / 2 ? near : far;
+  }
+};
+
+Scene make_scene(int width, int height, int near, int far) {
+  Scene scene{width, height, near, far, {}, {}};
+  const int tw = width + 2 * near + 8;
+  std::mt19937 rng(0);
+  std::vector<std::uint8_t> noise(tw * height);
+  for (auto&& v : noise) v = static_cast<std::uint8_t>(rng());
+  // blur a little, so the texture is not only pixel noise
+  std::vector<std::uint8_t> texture(noise.size());
+  for (int y = 0; y < height; y++) {
+    for (int x = 0; x < tw; x++) {
+      int sum = 0;
+      for (int i = -1; i <= 1; i++) {
+        sum += noise[y * tw + std::max(0, std::min(tw - 1, x + i))];
+      }
+      texture[y * tw + x] = static_cast<std::uint8_t>(sum / 3);
+    }
+  }
+  scene.left.resize(width * height);
+  scene.right.resize(width * height);
+  for (int y = 0; y < height; y++) {
+    for (int x = 0; x < width; x++) {
+      scene.left[y * width + x] = texture[y * tw + x + near];
+      // right pixel x sees the left pixel x + d of its plane
+      int d = scene.Disparity(std::min(width - 1, x + near));
+      scene.right[y * width + x] = texture[y * tw + x + d + near];
+    }
+  }
+  return scene;
+}
+
+void run(int width, int height, int max_disparity, int iterations) {
+  const Scene scene = make_scene(width, height, max_disparity / 2,
+      max_disparity / 4);
+  StereoMatcherParams params;
+  params.max_disparity = max_disparity;
+  StereoMatcher matcher(width, height, params);
+  std::vector<std::uint16_t> disparity(width * height);
+
+  // the first run allocates and warms up
+  matcher.Compute(scene.left.data(), width, scene.right.data(), width,
+      disparity.data(), width * sizeof(std::uint16_t));
+  auto begin = std::chrono::steady_clock::now();
+  for (int i = 0; i < iterations; i++) {
+    matcher.Compute(scene.left.data(), width, scene.right.data(), width,
+        disparity.data(), width * sizeof(std::uint16_t));
+  }
+  double ms = std::chrono::duration<double, std::milli>(
+      std::chrono::steady_clock::now() - begin).count() / iterations;
+
+  // accuracy, less the columns without a full disparity range
+  std::size_t total = 0, valid = 0, good = 0;
+  for (int y = 0; y < height; y++) {
+    for (int x = max_disparity; x < width; x++) {
+      std::uint16_t d = disparity[y * width + x];
+      total++;
+      if (d == StereoMatcher::kInvalidDisparity) continue;
+      valid++;
+      double err = d / double(StereoMatcher::kDisparityScale) -
+          scene.Disparity(x);
+      if (std::abs(err) <= 1) good++;
+    }
+  }
+  std::cout << std::setw(4) << width << "x" << std::setw(4) << height
+      << ", disparities: " << params.max_disparity
+      << ", time: " << std::fixed << std::setprecision(1) << ms << " ms"
+      << ", fps: " << std::setprecision(1) << 1000 / ms
+      << ", valid: " << std::setprecision(1) << 100. * valid / total << "%"
+      << ", error <= 1px: " << 100. * good / std::max<std::size_t>(1, valid)
+      << "%" << std::endl;
+}
+
+}  // namespace
+
+int main(int argc, char const* argv[]) {
+  int max_disparity = argc > 1 ? std::atoi(argv[1]) : 64;
+  int iterations = argc > 2 ? std::atoi(argv[2]) : 10;
+  if (max_disparity <= 0 || iterations <= 0) {
+    std::cerr << "Usage: " << argv[0] << " [max_disparity] [iterations]"
+        << std::endl;
+    return 1;
+  }
+  std::cout << "StereoMatcher, census 9x7, 4 paths, " << iterations
+      << " iterations" << std::endl;
+  run(640, 480, max_disparity, iterations);
+  run(1280, 720, max_disparity, iterations);
+  return 0;
+}
@@ -14,13 +14,8 @@
 #include "dataset/dataset.h"
 #include "mynteye/util/files.h"
 
-#ifdef WITH_OPENCV2
-#include <opencv2/highgui/highgui.hpp>
-#else
-#include <opencv2/imgcodecs/imgcodecs.hpp>
-#endif
-
 #include <iomanip>
+#include <iostream>
 #include <limits>
 #include <stdexcept>
 #include <utility>
@@ -0,0 +1,89 @@
+// Copyright 2018 Slightech Co., Ltd. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <thread>
+
+#include "mynteye/camera.h"
+#include "mynteye/record_reader.h"
+
+#include "dataset/dataset.h"
+
+MYNTEYE_USE_NAMESPACE
+
+int main(int argc, char const *argv[]) {
+  // export_text [infile] [outdir]
+  mynteye::ReplayParams params;
+  params.path = argc >= 2 ? argv[1] : "./dataset.rec";
+  params.speed = 0;
+  const char *outdir = argc >= 3 ? argv[2] : "./dataset";
+
+  // right is cut of the color only if recorded side by side
+  bool right = false;
+  {
+    mynteye::RecordReader reader;
+    mynteye::RecordDevice device;
+    if (!reader.Open(params.path) || !reader.GetDevice(&device)) {
+      std::cerr << "Error: Read " << params.path << " failed" << std::endl;
+      return 1;
+    }
+    right = device.stream_mode ==
+        static_cast<std::int32_t>(mynteye::StreamMode::STREAM_2560x720);
+  }
+
+  // replayed losslessly, through the same match and imu process of the device
+  mynteye::Camera cam(params);
+  cam.EnableImageType(mynteye::ImageType::IMAGE_LEFT_COLOR);
+  if (right) cam.EnableImageType(mynteye::ImageType::IMAGE_RIGHT_COLOR);
+  if (cam.Open() != mynteye::ErrorCode::SUCCESS) {
+    std::cerr << "Error: Replay " << params.path << " failed" << std::endl;
+    return 1;
+  }
+
+  tools::Dataset dataset(outdir);
+  std::size_t lefts = 0, rights = 0, motions = 0;
+  auto save_images = [&dataset, &cam](const mynteye::ImageType &type) {
+    std::size_t count = 0;
+    for (auto &&data : cam.RetrieveImages(type)) {
+      if (!data.img_info) continue;
+      dataset.SaveStreamData(type, data);
+      count++;
+    }
+    return count;
+  };
+  // the last images may come just after the end, until none more
+  bool ended = false;
+  while (true) {
+    std::size_t count = save_images(mynteye::ImageType::IMAGE_LEFT_COLOR);
+    lefts += count;
+    if (right) {
+      std::size_t n = save_images(mynteye::ImageType::IMAGE_RIGHT_COLOR);
+      rights += n;
+      count += n;
+    }
+    for (auto &&data : cam.RetrieveMotions()) {
+      dataset.SaveMotionData(data);
+      motions++;
+    }
+    if (ended && count == 0) break;
+    ended = cam.IsEnded();
+    std::this_thread::sleep_for(std::chrono::milliseconds(ended ? 100 : 1));
+  }
+  cam.Close();
+
+  std::cout << "Export " << outdir << ", left: " << lefts
+    << ", right: " << rights << ", motion: " << motions << std::endl;
+  return 0;
+}
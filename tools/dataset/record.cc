@@ -11,20 +11,44 @@
 // WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
 // See the License for the specific language governing permissions and
 // limitations under the License.
-#include <iomanip>
+#include <atomic>
+#include <chrono>
+#include <csignal>
+#include <cstring>
 #include <iostream>
-
-#include <opencv2/highgui/highgui.hpp>
+#include <memory>
+#include <string>
+#include <thread>
 
 #include "mynteye/camera.h"
+#include "mynteye/record.h"
 #include "mynteye/utils.h"
 #include "mynteye/util/times.h"
 
-#include "dataset/dataset.h"
-
 MYNTEYE_USE_NAMESPACE
 
+namespace {
+
+std::atomic<bool> is_stop(false);
+
+void on_signal(int) {
+  is_stop = true;
+}
+
+}  // namespace
+
 int main(int argc, char const *argv[]) {
+  // record [outfile] [--direct]
+  std::string outfile = "./dataset.rec";
+  mynteye::RecorderParams rec_params;
+  for (int i = 1; i < argc; i++) {
+    if (std::strcmp(argv[i], "--direct") == 0) {
+      rec_params.direct_io = true;
+    } else {
+      outfile = argv[i];
+    }
+  }
+
   mynteye::Camera cam;
   mynteye::DeviceInfo dev_info;
   if (!mynteye::util::select(cam, &dev_info)) {
@@ -35,21 +59,18 @@ int main(int argc, char const *argv[]) {
   std::cout << "Open device: " << dev_info.index << ", "
       << dev_info.name << std::endl << std::endl;
 
-  // Warning: Color stream format MJPG doesn't work.
+  // the raw color and depth of the device are recorded as captured
   mynteye::InitParams params(dev_info.index);
-  params.depth_mode = mynteye::DepthMode::DEPTH_COLORFUL;
+  params.depth_mode = mynteye::DepthMode::DEPTH_RAW;
   params.stream_mode = StreamMode::STREAM_2560x720;
   params.ir_intensity = 4;
   params.framerate = 30;
 
-  // output file path
-  const char *outdir = nullptr;
-  if (argc >= 2) {
-    outdir = argv[1];
-  } else {
-    outdir = "./dataset";
+  auto &&recorder = std::make_shared<mynteye::Recorder>(rec_params);
+  if (!recorder->Open(outfile)) {
+    std::cerr << "Error: Open " << outfile << " failed" << std::endl;
+    return 1;
   }
-  tools::Dataset dataset(outdir);
 
   cam.EnableImageType(mynteye::ImageType::ALL);
   cam.Open(params);
@@ -61,67 +82,26 @@ int main(int argc, char const *argv[]) {
   }
   std::cout << "Open device success" << std::endl << std::endl;
 
-  std::cout << "Press ESC/Q on Windows to terminate" << std::endl;
+  // nothing retrieved, the types are only captured to be recorded
+  cam.DisableImageType(mynteye::ImageType::ALL);
+  cam.SetRecorder(recorder);
 
-  cv::namedWindow("color", cv::WINDOW_AUTOSIZE);
+  std::signal(SIGINT, on_signal);
+  std::cout << "Press Ctrl-C to terminate" << std::endl;
 
-  double t, fps = 0;
-  std::size_t imu_count = 0;
-  std::size_t img_count = 0;
   auto &&time_beg = mynteye::times::now();
-  for (;;) {
-    auto &&left_color = cam.RetrieveImages(mynteye::ImageType::IMAGE_LEFT_COLOR);
-    auto &&right_color = cam.RetrieveImages(mynteye::ImageType::IMAGE_RIGHT_COLOR);
-    img_count += left_color.size();
-    if (!left_color.empty() && !right_color.empty()) {
-      auto &&left = left_color.back();
-      auto &&right = right_color.back();
-      cv::Mat image_left =
-        left.img->To(mynteye::ImageFormat::COLOR_BGR)->ToMat();
-      cv::Mat image_right =
-        right.img->To(mynteye::ImageFormat::COLOR_BGR)->ToMat();
-
-      cv::Mat color;
-      cv::hconcat(image_left, image_right, color);
-      cv::imshow("color", color);
-    }
-
-    t = static_cast<double>(cv::getTickCount());
-    auto &&motion_data = cam.RetrieveMotions();
-    imu_count += motion_data.size();
-
-    {
-      for (auto &&left : left_color) {
-        dataset.SaveStreamData(
-            mynteye::ImageType::IMAGE_LEFT_COLOR, left);
-      }
-
-      for (auto &&right : right_color) {
-        dataset.SaveStreamData(
-            mynteye::ImageType::IMAGE_RIGHT_COLOR, right);
-      }
-
-      for (auto &&motion : motion_data) {
-        dataset.SaveMotionData(motion);
-      }
-
-      std::cout << "\rSaved " << img_count << " imgs" <<
-        ", " << imu_count << " imus" << std::flush;
-    }
-
-    char key = static_cast<char>(cv::waitKey(10));
-    if (key == 27 || key == 'q' || key == 'Q') {  // ESC/Q
-      break;
-    }
-
-    t = static_cast<double>(cv::getTickCount()) - t;
-    fps = cv::getTickFrequency() / t;
+  while (!is_stop) {
+    std::this_thread::sleep_for(std::chrono::seconds(1));
+    std::cout << "\rRecorded " << recorder->records() << " records, "
+        << (recorder->bytes() >> 20) << " MiB, "
+        << recorder->dropped() << " dropped" << std::flush;
   }
-  std::cout << " to " << outdir << std::endl;
   auto &&time_end = mynteye::times::now();
-  (void)(fps);
 
+  cam.SetRecorder(nullptr);
   cam.Close();
+  recorder->Close();
+  std::cout << " to " << outfile << std::endl;
 
   float elapsed_ms =
       mynteye::times::count<mynteye::times::microseconds>(time_end - time_beg) *
@@ -129,11 +109,9 @@ int main(int argc, char const *argv[]) {
   std::cout << "Time beg: " << mynteye::times::to_local_string(time_beg)
     << ", end: " << mynteye::times::to_local_string(time_end)
     << ", cost: " << elapsed_ms << "ms" << std::endl;
-  std::cout << "Img count: " << img_count
-    << ", fps: " << (1000.f * img_count / elapsed_ms) << std::endl;
-  std::cout << "Imu count: " << imu_count
-    << ", hz: " << (1000.f * imu_count / elapsed_ms) << std::endl;
-
-  cv::destroyAllWindows();
+  std::cout << "Records: " << recorder->records()
+    << ", dropped: " << recorder->dropped()
+    << ", MiB/s: " << (1000.f * (recorder->bytes() >> 20) / elapsed_ms)
+    << std::endl;
   return 0;
 }
@@ -0,0 +1,118 @@
+// Copyright 2018 Slightech Co., Ltd. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include <atomic>
+#include <chrono>
+#include <csignal>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <thread>
+
+#include "mynteye/camera.h"
+#include "mynteye/record_reader.h"
+#include "mynteye/util/times.h"
+
+MYNTEYE_USE_NAMESPACE
+
+namespace {
+
+std::atomic<bool> is_stop(false);
+
+void on_signal(int) {
+  is_stop = true;
+}
+
+}  // namespace
+
+int main(int argc, char const *argv[]) {
+  // replay <infile> [--speed x] [--loop], speed 0 as fast as possible
+  mynteye::ReplayParams params;
+  params.path = "./dataset.rec";
+  for (int i = 1; i < argc; i++) {
+    if (std::strcmp(argv[i], "--speed") == 0 && i + 1 < argc) {
+      params.speed = std::atof(argv[++i]);
+    } else if (std::strcmp(argv[i], "--loop") == 0) {
+      params.loop = true;
+    } else {
+      params.path = argv[i];
+    }
+  }
+
+  mynteye::Camera cam(params);
+  cam.EnableImageType(mynteye::ImageType::IMAGE_LEFT_COLOR);
+  cam.EnableImageType(mynteye::ImageType::IMAGE_DEPTH);
+  if (cam.Open() != mynteye::ErrorCode::SUCCESS) {
+    std::cerr << "Error: Replay " << params.path << " failed" << std::endl;
+    return 1;
+  }
+
+  // speed 0 replays losslessly, each image recorded must come out
+  std::size_t recorded_colors = 0, recorded_depths = 0;
+  {
+    mynteye::RecordReader reader;
+    if (reader.Open(params.path)) {
+      for (std::size_t i = 0; i < reader.size(); i++) {
+        if (reader.type(i) == mynteye::RecordType::COLOR) recorded_colors++;
+        if (reader.type(i) == mynteye::RecordType::DEPTH) recorded_depths++;
+      }
+    }
+  }
+
+  std::signal(SIGINT, on_signal);
+  std::cout << "Press Ctrl-C to terminate" << std::endl;
+
+  std::size_t colors = 0, depths = 0, motions = 0;
+  auto &&time_beg = mynteye::times::now();
+  // the last images may come just after the end, until none more
+  bool ended = false;
+  while (!is_stop) {
+    auto &&color_count =
+        cam.RetrieveImages(mynteye::ImageType::IMAGE_LEFT_COLOR).size();
+    auto &&depth_count =
+        cam.RetrieveImages(mynteye::ImageType::IMAGE_DEPTH).size();
+    colors += color_count;
+    depths += depth_count;
+    motions += cam.RetrieveMotions().size();
+    if (ended && color_count + depth_count == 0) break;
+    ended = cam.IsEnded();
+    std::this_thread::sleep_for(std::chrono::milliseconds(ended ? 100 : 1));
+  }
+  auto &&time_end = mynteye::times::now();
+  cam.Close();
+
+  float elapsed_ms =
+      mynteye::times::count<mynteye::times::microseconds>(time_end - time_beg) *
+      0.001f;
+  std::cout << "Time beg: " << mynteye::times::to_local_string(time_beg)
+    << ", end: " << mynteye::times::to_local_string(time_end)
+    << ", cost: " << elapsed_ms << "ms" << std::endl;
+  std::cout << "Color count: " << colors
+    << ", fps: " << (1000.f * colors / elapsed_ms) << std::endl;
+  std::cout << "Depth count: " << depths
+    << ", fps: " << (1000.f * depths / elapsed_ms) << std::endl;
+  std::cout << "Motion count: " << motions
+    << ", hz: " << (1000.f * motions / elapsed_ms) << std::endl;
+
+  if (params.speed <= 0 && !params.loop && !is_stop) {
+    std::cout << "Recorded color count: " << recorded_colors
+      << ", depth count: " << recorded_depths << std::endl;
+    if (colors != recorded_colors || depths != recorded_depths) {
+      std::cerr << "Error: Replayed counts differ from the recorded"
+        << std::endl;
+      return 1;
+    }
+  }
+  return 0;
+}
@@ -14,17 +14,28 @@
 #include <ros/ros.h>
 #include <nodelet/nodelet.h>
 
-#include <cv_bridge/cv_bridge.h>
 #include <image_transport/image_transport.h>
 #include <sensor_msgs/image_encodings.h>
+#include <sensor_msgs/CompressedImage.h>
+#include <sensor_msgs/Image.h>
 #include <sensor_msgs/Imu.h>
+#include <sensor_msgs/LaserScan.h>
 #include <tf/tf.h>
 #include <tf2_ros/static_transform_broadcaster.h>
 
 #include <unistd.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <map>
+#include <memory>
+#include <mutex>
 #include <vector>
 #include <string>
 
+#include <boost/array.hpp>
 #include <boost/make_shared.hpp>
 #include <boost/thread/thread.hpp>
 
@@ -45,19 +56,36 @@ class MYNTEYEWrapperNodelet : public nodelet::Nodelet {
   ros::NodeHandle nh;
   ros::NodeHandle nh_ns;
   boost::shared_ptr<boost::thread> device_poll_thread;
+  boost::shared_ptr<boost::thread> imu_poll_thread;
 
   image_transport::CameraPublisher pub_left_mono;
   image_transport::CameraPublisher pub_left_color;
   image_transport::CameraPublisher pub_right_mono;
   image_transport::CameraPublisher pub_right_color;
   image_transport::CameraPublisher pub_depth;
+  ros::Publisher pub_left_compressed;
   ros::Publisher pub_points;
   ros::Publisher pub_imu;
   ros::Publisher pub_temp;
+  ros::Publisher pub_scan;
 
   // tf2_ros::StaticTransformBroadcaster static_tf_broadcaster;
 
-  sensor_msgs::CameraInfoPtr camera_info_ptr_;
+  // camera infos of the opened stream mode, built once and never changed
+  sensor_msgs::CameraInfoConstPtr left_info;
+  sensor_msgs::CameraInfoConstPtr right_info;
+
+  // the last messages of an image publisher
+  struct ImageMsgs {
+    sensor_msgs::ImagePtr image;
+    sensor_msgs::CameraInfoPtr info;
+  };
+  ImageMsgs left_mono_msgs;
+  ImageMsgs left_color_msgs;
+  ImageMsgs right_mono_msgs;
+  ImageMsgs right_color_msgs;
+  ImageMsgs depth_msgs;
+  sensor_msgs::CompressedImagePtr left_compressed_msg;
 
   // Launch params
   int dev_index;
@@ -69,7 +97,14 @@ class MYNTEYEWrapperNodelet : public nodelet::Nodelet {
   bool state_ae;
   bool state_awb;
   int ir_intensity;
-  int gravity;
+  double gravity;
+  int imu_batch;
+  bool depth_filter;
+  bool scan;
+  /** Right is streamed side by side with left, if a side by side mode */
+  bool right_enabled;
+  /** Left jpeg of the camera is published as is, as left compressed */
+  bool compressed_passthrough;
 
   std::string base_frame_id;
   std::string left_mono_frame_id;
@@ -80,6 +115,7 @@ class MYNTEYEWrapperNodelet : public nodelet::Nodelet {
   std::string points_frame_id;
   std::string imu_frame_id;
   std::string temp_frame_id;
+  std::string scan_frame_id;
 
   // MYNTEYE objects
   mynteye::InitParams params;
@@ -87,98 +123,179 @@ class MYNTEYEWrapperNodelet : public nodelet::Nodelet {
 
   std::unique_ptr<PointCloudGenerator> pointcloud_generator;
 
-  std::shared_ptr<ImuData> imu_accel;
-  std::shared_ptr<ImuData> imu_gyro;
+  boost::array<double, 9> accel_covariance;
+  boost::array<double, 9> gyro_covariance;
+
+  /** Frames passed by the stream callbacks, until published */
+  std::map<mynteye::ImageType, std::vector<mynteye::StreamData>> frames;
+  std::mutex mtx_frames;
+  std::condition_variable frames_cond;
+  /** Imu samples passed by the imu callback, until published */
+  std::vector<mynteye::ImuSample> motions;
+  std::mutex mtx_motions;
+  std::condition_variable motions_cond;
+  std::atomic<bool> imu_subscribed;
+
+  /** Streams follow the subscribers once the camera is opened */
+  std::mutex mtx_streams;
+  bool streams_ready;
+  std::mutex mtx_time;
 
   std::string dashes;
 
  public:
-  MYNTEYEWrapperNodelet() : dashes(std::string(30, '-')) {
+  MYNTEYEWrapperNodelet() : imu_subscribed(false), streams_ready(false),
+      dashes(std::string(30, '-')) {
+  }
+
+  /**
+   * A message of the size to convert a frame into. The last message of a
+   * publisher is reused once no subscriber holds it, so its buffer is
+   * allocated once and the frame is only written by the conversion.
+   */
+  sensor_msgs::ImagePtr createImage(ImageMsgs* msgs,
+      const std::string& frame_id, ros::Time stamp,
+      const std::string& encoding, int width, int height, int channel_size) {
+    if (!msgs->image || !msgs->image.unique()) {
+      msgs->image = boost::make_shared<sensor_msgs::Image>();
+    }
+    auto &&msg = msgs->image;
+    msg->header.stamp = stamp;
+    msg->header.frame_id = frame_id;
+    msg->encoding = encoding;
+    msg->width = width;
+    msg->height = height;
+    msg->is_bigendian = 0;
+    msg->step = width * channel_size;
+    msg->data.resize(msg->step * height);
+    return msg;
   }
 
   void publishColor(const std::string& frame_id, image_transport::CameraPublisher& pub,  // NOLINT
-    mynteye::Image::pointer img, ros::Time stamp,
-      cv::Mat* mat, std::uint32_t seq) {
+    ImageMsgs* msgs, const sensor_msgs::CameraInfoConstPtr& info,
+      mynteye::Image::pointer img, ros::Time stamp, std::uint32_t seq) {
     if (pub.getNumSubscribers() == 0)
       return;
-    std_msgs::Header header;
-    // header.seq = 0;
-    header.stamp = stamp;
-    header.frame_id = frame_id;
-    *mat = img->To(mynteye::ImageFormat::COLOR_RGB)->ToMat();
-
-    auto &&msg =
-        cv_bridge::CvImage(header, enc::RGB8, *mat).toImageMsg();
-    auto &&info = getCameraInfo();
-    info->header.stamp = msg->header.stamp;
-    pub.publish(msg, info);
+    auto &&msg = createImage(msgs, frame_id, stamp, enc::RGB8,
+        img->width(), img->height(), 3);
+    if (!img->ConvertTo(mynteye::ImageFormat::COLOR_RGB, msg->data.data())) {
+      NODELET_ERROR_STREAM("Color can not be converted to RGB");
+      return;
+    }
+    pub.publish(sensor_msgs::ImageConstPtr(msg),
+        stampCameraInfo(msgs, info, msg->header));
+  }
+
+  /**
+   * Publish the jpeg of the camera as it is, instead of the compressed
+   * plugin of image_transport encoding the decoded frame again.
+   */
+  void publishCompressed(mynteye::Image::pointer img, ros::Time stamp) {
+    if (pub_left_compressed.getNumSubscribers() == 0)
+      return;
+    if (img->format() != mynteye::ImageFormat::COLOR_MJPG) {
+      NODELET_ERROR_STREAM("Color is not jpeg, can not be passed through");
+      return;
+    }
+    if (!left_compressed_msg || !left_compressed_msg.unique()) {
+      left_compressed_msg = boost::make_shared<sensor_msgs::CompressedImage>();
+    }
+    auto &&msg = left_compressed_msg;
+    msg->header.stamp = stamp;
+    msg->header.frame_id = left_color_frame_id;
+    msg->format = "jpeg";
+    auto size = std::min(img->valid_size(), img->size());
+    msg->data.assign(img->cdata(), img->cdata() + size);
+    pub_left_compressed.publish(sensor_msgs::CompressedImageConstPtr(msg));
   }
 
   void publishMono(const std::string& frame_id, image_transport::CameraPublisher& pub, // NOLINT
-    mynteye::Image::pointer img, ros::Time stamp,
-      cv::Mat* mat, std::uint32_t seq) {
+    ImageMsgs* msgs, const sensor_msgs::CameraInfoConstPtr& info,
+      mynteye::Image::pointer img, ros::Time stamp, std::uint32_t seq) {
     if (pub.getNumSubscribers() == 0)
       return;
-    std_msgs::Header header;
-    // header.seq = 0;
-    header.stamp = stamp;
-    header.frame_id = frame_id;
-    *mat = img->To(mynteye::ImageFormat::COLOR_RGB)->ToMat();
-    cv::Mat dst;
-    cv::cvtColor(*mat, dst, CV_RGB2GRAY);
-    auto &&msg =
-        cv_bridge::CvImage(header, enc::MONO8, dst).toImageMsg();
-    auto &&info = getCameraInfo();
-    info->header.stamp = msg->header.stamp;
-
-    pub.publish(msg, info);
+    auto &&msg = createImage(msgs, frame_id, stamp, enc::MONO8,
+        img->width(), img->height(), 1);
+    if (!img->ConvertTo(mynteye::ImageFormat::IMAGE_GRAY_8,
+        msg->data.data())) {
+      NODELET_ERROR_STREAM("Color can not be converted to mono");
+      return;
+    }
+    pub.publish(sensor_msgs::ImageConstPtr(msg),
+        stampCameraInfo(msgs, info, msg->header));
   }
 
-  sensor_msgs::CameraInfoPtr getCameraInfo() {
-    // http://docs.ros.org/kinetic/api/sensor_msgs/html/msg/CameraInfo.html
-    sensor_msgs::CameraInfo *camera_info = new sensor_msgs::CameraInfo();
-    camera_info_ptr_ = sensor_msgs::CameraInfoPtr(camera_info);
-
-    struct MYNTEYE_NAMESPACE::CameraCtrlRectLogData camera_ctrl_data;
+  /**
+   * The camera info of a published image, a copy of the info of its camera
+   * with the header of the image. The last copy of a publisher is stamped
+   * again once no subscriber holds it.
+   */
+  sensor_msgs::CameraInfoConstPtr stampCameraInfo(ImageMsgs* msgs,
+      const sensor_msgs::CameraInfoConstPtr& info,
+      const std_msgs::Header& header) {
+    if (!msgs->info || !msgs->info.unique()) {
+      msgs->info = boost::make_shared<sensor_msgs::CameraInfo>(*info);
+    }
+    msgs->info->header = header;
+    return msgs->info;
+  }
 
+  void createCameraInfos() {
     // <arg name="stream_1280x720"   default="0" />
     // <arg name="stream_2560x720"   default="1" />
     // GetHDCameraCtrlData();
     // <arg name="stream_1280x480"   default="2" />
     // <arg name="stream_640x480"    default="3" />
     // GetVGACameraCtrlData();
-
+    struct MYNTEYE_NAMESPACE::CameraCtrlRectLogData camera_ctrl_data;
     if (stream_mode == 0 || stream_mode == 1) {
       camera_ctrl_data = mynteye->GetHDCameraCtrlData();
     } else if (stream_mode == 2 || stream_mode == 3) {
       camera_ctrl_data = mynteye->GetVGACameraCtrlData();
+    } else {
+      std::memset(&camera_ctrl_data, 0, sizeof(camera_ctrl_data));
     }
+    left_info = createCameraInfo(camera_ctrl_data, true);
+    right_info = createCameraInfo(camera_ctrl_data, false);
+  }
+
+  sensor_msgs::CameraInfoPtr createCameraInfo(
+      const MYNTEYE_NAMESPACE::CameraCtrlRectLogData& camera_ctrl_data,
+      bool left) {
+    // http://docs.ros.org/kinetic/api/sensor_msgs/html/msg/CameraInfo.html
+    auto &&camera_info = boost::make_shared<sensor_msgs::CameraInfo>();
+
+    const float* cam_mat =
+        left ? camera_ctrl_data.CamMat1 : camera_ctrl_data.CamMat2;
+    const float* cam_dist =
+        left ? camera_ctrl_data.CamDist1 : camera_ctrl_data.CamDist2;
+    const float* new_cam_mat =
+        left ? camera_ctrl_data.NewCamMat1 : camera_ctrl_data.NewCamMat2;
 
-    // camera_info->header.frame_id = color_frame_id;
     camera_info->width = camera_ctrl_data.OutImgWidth;
     camera_info->height = camera_ctrl_data.OutImgHeight;
 
     //     [fx  0 cx]
     // K = [ 0 fy cy]
     //     [ 0  0  1]
-    camera_info->K.at(0) = camera_ctrl_data.CamMat1[0];
-    camera_info->K.at(2) = camera_ctrl_data.CamMat1[2];
-    camera_info->K.at(4) = camera_ctrl_data.CamMat1[4];
-    camera_info->K.at(5) = camera_ctrl_data.CamMat1[5];
+    camera_info->K.at(0) = cam_mat[0];
+    camera_info->K.at(2) = cam_mat[2];
+    camera_info->K.at(4) = cam_mat[4];
+    camera_info->K.at(5) = cam_mat[5];
     camera_info->K.at(8) = 1;
 
     //     [fx'  0  cx' Tx]
     // P = [ 0  fy' cy' Ty]
     //     [ 0   0   1   0]
     for (int i = 0; i < 12; i++) {
-        camera_info->P.at(i) = camera_ctrl_data.NewCamMat1[i];
+        camera_info->P.at(i) = new_cam_mat[i];
     }
 
     camera_info->distortion_model = "plumb_bob";
 
     // D of plumb_bob: (k1, k2, t1, t2, k3)
     for (int i = 0; i < 5; i++) {
-      camera_info->D.push_back(camera_ctrl_data.CamDist1[i]);
+      camera_info->D.push_back(cam_dist[i]);
     }
 
     // R to identity matrix
@@ -192,89 +309,78 @@ class MYNTEYEWrapperNodelet : public nodelet::Nodelet {
     camera_info->R.at(7) = 0.0;
     camera_info->R.at(8) = 1.0;
 
-    return camera_info_ptr_;
+    return camera_info;
   }
 
-  void publishDepth(mynteye::Image::pointer img, ros::Time stamp,
-      cv::Mat* mat) {
-    std_msgs::Header header;
-    // header.seq = 0;
-    header.stamp = stamp;
-    header.frame_id = depth_frame_id;
-
-    auto &&info = getCameraInfo();
+  void publishDepth(mynteye::Image::pointer img, ros::Time stamp) {
+    mynteye::ImageFormat format;
+    std::string encoding;
+    int channel_size;
     if (depth_mode == 0) {  // DEPTH_RAW
-      *mat = img->To(mynteye::ImageFormat::DEPTH_RAW)->ToMat();
-      pub_depth.publish(
-          cv_bridge::CvImage(header, enc::MONO16, *mat).toImageMsg(), info);
+      format = mynteye::ImageFormat::DEPTH_RAW;
+      encoding = enc::MONO16;
+      channel_size = 2;
     } else if (depth_mode == 1) {  // DEPTH_GRAY
-      *mat = img->To(mynteye::ImageFormat::DEPTH_GRAY_24)->ToMat();
-      pub_depth.publish(
-          cv_bridge::CvImage(header, enc::RGB8, *mat).toImageMsg(), info);
+      format = mynteye::ImageFormat::DEPTH_GRAY_24;
+      encoding = enc::RGB8;
+      channel_size = 3;
     } else if (depth_mode == 2) {  // DEPTH_COLORFUL
-      *mat = img->To(mynteye::ImageFormat::DEPTH_RGB)->ToMat();
-      pub_depth.publish(
-          cv_bridge::CvImage(header, enc::RGB8, *mat).toImageMsg(), info);
+      format = mynteye::ImageFormat::DEPTH_RGB;
+      encoding = enc::RGB8;
+      channel_size = 3;
     } else {
       NODELET_ERROR_STREAM("Depth mode unsupported");
       return;
     }
+    auto &&msg = createImage(&depth_msgs, depth_frame_id, stamp, encoding,
+        img->width(), img->height(), channel_size);
+    if (!img->ConvertTo(format, msg->data.data())) {
+      NODELET_ERROR_STREAM("Depth can not be converted to " << encoding);
+      return;
+    }
+
+    // depth is of the left camera
+    pub_depth.publish(sensor_msgs::ImageConstPtr(msg),
+        stampCameraInfo(&depth_msgs, left_info, msg->header));
     // NODELET_INFO_STREAM("Publish depth");
   }
 
-  void publishImu(ros::Time stamp, bool pub_temp) {
-    if (imu_accel == nullptr || imu_gyro == nullptr) {
-      return;
+  /** Covariances of imu, diagonal of the noise and random walk variances */
+  void createImuCovariances() {
+    auto &&in = mynteye->GetMotionIntrinsics();
+    accel_covariance.assign(0);
+    gyro_covariance.assign(0);
+    for (int i = 0; i < 3; i++) {
+      // accelerometer in g, gyroscope in deg/s
+      accel_covariance[i * 4] = (in.accel.noise[i] + in.accel.bias[i]) *
+          gravity * gravity;
+      gyro_covariance[i * 4] = (in.gyro.noise[i] + in.gyro.bias[i]) *
+          (M_PI / 180) * (M_PI / 180);
     }
+  }
+
+  void publishImu(const mynteye::ImuSample& sample, ros::Time stamp) {
     sensor_msgs::Imu msg;
 
-    //msg.header.seq = seq;
     msg.header.stamp = stamp;
     msg.header.frame_id = imu_frame_id;
 
-    // acceleration should be in m/s^2 (not in g's)
-    msg.linear_acceleration.x = imu_accel->accel[0] * gravity;
-    msg.linear_acceleration.y = imu_accel->accel[1] * gravity;
-    msg.linear_acceleration.z = imu_accel->accel[2] * gravity;
-
-    msg.linear_acceleration_covariance[0] = 0;
-    msg.linear_acceleration_covariance[1] = 0;
-    msg.linear_acceleration_covariance[2] = 0;
-
-    msg.linear_acceleration_covariance[3] = 0;
-    msg.linear_acceleration_covariance[4] = 0;
-    msg.linear_acceleration_covariance[5] = 0;
+    // no orientation
+    msg.orientation_covariance[0] = -1;
 
-    msg.linear_acceleration_covariance[6] = 0;
-    msg.linear_acceleration_covariance[7] = 0;
-    msg.linear_acceleration_covariance[8] = 0;
+    // acceleration should be in m/s^2 (not in g's)
+    msg.linear_acceleration.x = sample.accel[0] * gravity;
+    msg.linear_acceleration.y = sample.accel[1] * gravity;
+    msg.linear_acceleration.z = sample.accel[2] * gravity;
+    msg.linear_acceleration_covariance = accel_covariance;
 
     // velocity should be in rad/sec
-    msg.angular_velocity.x = imu_gyro->gyro[0] * M_PI / 180;
-    msg.angular_velocity.y = imu_gyro->gyro[1] * M_PI / 180;
-    msg.angular_velocity.z = imu_gyro->gyro[2] * M_PI / 180;
-
-    msg.angular_velocity_covariance[0] = 0;
-    msg.angular_velocity_covariance[1] = 0;
-    msg.angular_velocity_covariance[2] = 0;
-
-    msg.angular_velocity_covariance[3] = 0;
-    msg.angular_velocity_covariance[4] = 0;
-    msg.angular_velocity_covariance[5] = 0;
-
-    msg.angular_velocity_covariance[6] = 0;
-    msg.angular_velocity_covariance[7] = 0;
-    msg.angular_velocity_covariance[8] = 0;
+    msg.angular_velocity.x = sample.gyro[0] * M_PI / 180;
+    msg.angular_velocity.y = sample.gyro[1] * M_PI / 180;
+    msg.angular_velocity.z = sample.gyro[2] * M_PI / 180;
+    msg.angular_velocity_covariance = gyro_covariance;
 
     pub_imu.publish(msg);
-
-    if (pub_temp) {
-      publishTemp(imu_accel->temperature, stamp);
-    }
-
-    imu_accel = nullptr;
-    imu_gyro = nullptr;
-    ros::Duration(0.001).sleep();
   }
 
   void publishTemp(float temperature, ros::Time stamp) {
@@ -286,6 +392,8 @@ class MYNTEYEWrapperNodelet : public nodelet::Nodelet {
   }
 
   ros::Time hardTimeToSoftTime(double _hard_time) {
+    // images and imu are stamped on their own threads
+    std::lock_guard<std::mutex> _(mtx_time);
     static bool isInited = false;
     static double soft_time_begin(0), hard_time_begin(0);
 
@@ -299,69 +407,257 @@ class MYNTEYEWrapperNodelet : public nodelet::Nodelet {
         soft_time_begin + (_hard_time - hard_time_begin) * 0.00001f);
   }
 
+  void createPointCloudGenerator() {
+    // depth is aligned to the rectified left eye, params > 0 override it
+    auto &&calib = mynteye->GetStereoCalibration();
+    mynteye::CameraIntrinsics in = calib.GetIntrinsics();
+    double cx = 0, cy = 0, fx = 0, fy = 0;
+    std::int32_t points_frequency = 0;
+    nh_ns.getParam("cx", cx);
+    nh_ns.getParam("cy", cy);
+    nh_ns.getParam("fx", fx);
+    nh_ns.getParam("fy", fy);
+    nh_ns.getParam("points_frequency", points_frequency);
+    if (cx > 0) in.cx = cx;
+    if (cy > 0) in.cy = cy;
+    if (fx > 0) in.fx = fx;
+    if (fy > 0) in.fy = fy;
+    if (!calib.IsValid() && (in.fx <= 0 || in.fy <= 0)) {
+      NODELET_WARN_STREAM("Stereo calibration is invalid, "
+          "set fx, fy, cx, cy to generate points");
+    }
+    NODELET_INFO_STREAM("Points intrinsics: " << in);
+
+    pointcloud_generator.reset(new PointCloudGenerator(in,
+      [this](const sensor_msgs::PointCloud2Ptr& msg) {
+        msg->header.frame_id = points_frame_id;
+        pub_points.publish(sensor_msgs::PointCloud2ConstPtr(msg));
+      }, points_frequency));
+  }
+
+  void createLaserScanProjector() {
+    // a band of rows around cy of the depth, projected in the SDK
+    auto &&calib = mynteye->GetStereoCalibration();
+    if (!calib.IsValid()) {
+      NODELET_WARN_STREAM("Stereo calibration is invalid, disable scan");
+      return;
+    }
+    mynteye::CameraIntrinsics in = calib.GetIntrinsics();
+    int scan_rows = 10;
+    double scan_range_min = 0.2, scan_range_max = 10;
+    nh_ns.getParam("scan_rows", scan_rows);
+    nh_ns.getParam("scan_range_min", scan_range_min);
+    nh_ns.getParam("scan_range_max", scan_range_max);
+    int row_begin = static_cast<int>(in.cy) - scan_rows / 2;
+    mynteye->SetLaserScan(std::make_shared<mynteye::LaserScanProjector>(
+        in, row_begin, row_begin + std::max(1, scan_rows), 0,
+        scan_range_min, scan_range_max));
+    NODELET_INFO_STREAM("Scan rows: [" << row_begin << ", "
+        << row_begin + std::max(1, scan_rows) << ")");
+  }
+
+  void publishScan(const mynteye::LaserScan& scan, ros::Time stamp) {
+    sensor_msgs::LaserScan msg;
+    msg.header.stamp = stamp;
+    msg.header.frame_id = scan_frame_id;
+    msg.angle_min = scan.angle_min;
+    msg.angle_max = scan.angle_max;
+    msg.angle_increment = scan.angle_increment;
+    msg.range_min = scan.range_min;
+    msg.range_max = scan.range_max;
+    msg.ranges = scan.ranges;
+    pub_scan.publish(msg);
+  }
+
+  /** Subscribed streams are enabled in the SDK, the others disabled. */
+  void updateStreams() {
+    std::lock_guard<std::mutex> _(mtx_streams);
+    if (!streams_ready) return;
+    bool points = pub_points.getNumSubscribers() > 0 && depth_mode == 0;
+    bool depth = pub_depth.getNumSubscribers() > 0 || points ||
+        pub_scan.getNumSubscribers() > 0;
+    // depth is stamped by left
+    bool left = pub_left_color.getNumSubscribers() > 0 ||
+        pub_left_mono.getNumSubscribers() > 0 ||
+        pub_left_compressed.getNumSubscribers() > 0 || depth;
+    bool right = pub_right_color.getNumSubscribers() > 0 ||
+        pub_right_mono.getNumSubscribers() > 0;
+    enableStream(mynteye::ImageType::IMAGE_LEFT_COLOR, left);
+    // right is streamed only if enabled at open
+    if (right_enabled) {
+      enableStream(mynteye::ImageType::IMAGE_RIGHT_COLOR, right);
+    }
+    enableStream(mynteye::ImageType::IMAGE_DEPTH, depth);
+    imu_subscribed = pub_imu.getNumSubscribers() > 0 ||
+        pub_temp.getNumSubscribers() > 0;
+  }
+
+  void enableStream(const mynteye::ImageType& type, bool enable) {
+    if (enable) {
+      mynteye->EnableImageType(type);
+    } else {
+      mynteye->DisableImageType(type);
+    }
+  }
+
+  void imageStatus(const image_transport::SingleSubscriberPublisher&) {
+    updateStreams();
+  }
+
+  void status(const ros::SingleSubscriberPublisher&) {
+    updateStreams();
+  }
+
+  void pushFrame(const mynteye::ImageType& type,
+      const mynteye::StreamData& data) {
+    {
+      std::lock_guard<std::mutex> _(mtx_frames);
+      auto &&datas = frames[type];
+      // drop the oldest if publishing falls behind
+      if (datas.size() >= 4) datas.erase(datas.begin());
+      datas.push_back(data);
+    }
+    frames_cond.notify_one();
+  }
+
+  void pushMotions(const std::vector<mynteye::ImuSample>& samples) {
+    if (!imu_subscribed) return;
+    {
+      std::lock_guard<std::mutex> _(mtx_motions);
+      // drop the oldest if publishing falls behind
+      if (motions.size() >= 200) motions.clear();
+      motions.insert(motions.end(), samples.begin(), samples.end());
+    }
+    motions_cond.notify_one();
+  }
+
+  void imu_poll() {
+    std::vector<mynteye::ImuSample> samples;
+    while (nh_ns.ok()) {
+      {
+        std::unique_lock<std::mutex> lock(mtx_motions);
+        motions_cond.wait_for(lock, std::chrono::milliseconds(100),
+            [this]() { return !motions.empty(); });
+        samples.clear();
+        samples.swap(motions);
+      }
+      if (samples.empty()) continue;
+      bool temp_subscribed = pub_temp.getNumSubscribers() > 0;
+      for (auto &&sample : samples) {
+        ros::Time stamp = hardTimeToSoftTime(sample.timestamp);
+        publishImu(sample, stamp);
+        if (temp_subscribed) {
+          publishTemp(sample.temperature, stamp);
+        }
+      }
+    }
+  }
+
   void device_poll() {
     // Main loop
     mynteye->SetImageMode(mynteye::ImageMode::IMAGE_RAW);
-    mynteye->EnableImageType(mynteye::ImageType::ALL);
+    mynteye->EnableImageType(mynteye::ImageType::IMAGE_LEFT_COLOR);
+    mynteye->EnableImageType(mynteye::ImageType::IMAGE_DEPTH);
+    if (right_enabled) {
+      mynteye->EnableImageType(mynteye::ImageType::IMAGE_RIGHT_COLOR);
+    }
+    if (depth_filter) {
+      mynteye->SetDepthFilter(mynteye::DepthFilterChain::CreateDefault());
+    }
     mynteye->Open(params);
     if (!mynteye->IsOpened()) {
       NODELET_ERROR_STREAM("Open camera failed");
       return;
     }
     NODELET_INFO_STREAM("Open camera success");
-    std::size_t imu_count = 0;
-    std::size_t img_count = 0;
-    cv::Mat color_left, mono_left, color_right, mono_right, depth_mat;
+    createCameraInfos();
+    createImuCovariances();
+    createPointCloudGenerator();
+    if (scan) {
+      createLaserScanProjector();
+    }
+
+    // frames and motions are passed by callbacks, of the streams subscribed
+    mynteye->DisableImageType(mynteye::ImageType::ALL);
+    for (auto &&type : {mynteye::ImageType::IMAGE_LEFT_COLOR,
+        mynteye::ImageType::IMAGE_RIGHT_COLOR,
+        mynteye::ImageType::IMAGE_DEPTH}) {
+      mynteye->SetStreamCallback(type,
+          [this, type](const mynteye::StreamData& data) {
+            pushFrame(type, data);
+          });
+    }
+    // accelerometer and gyroscope paired, imu_batch samples per callback
+    mynteye->SetImuCallback(
+        [this](const std::vector<mynteye::ImuSample>& samples) {
+          pushMotions(samples);
+        }, imu_batch);
+    {
+      std::lock_guard<std::mutex> _(mtx_streams);
+      streams_ready = true;
+    }
+    updateStreams();
+    imu_poll_thread = boost::shared_ptr<boost::thread>(new boost::thread(
+        boost::bind(&MYNTEYEWrapperNodelet::imu_poll, this)));
+
+    std::map<mynteye::ImageType, std::vector<mynteye::StreamData>> datas;
+    // points are of the depth and the last left, both held by pointer
+    mynteye::Image::pointer last_left;
+    // depth may come in a batch of its own, and is stamped by the last left
+    bool left_color_ok = false;
+    ros::Time leftTimeStamp;
     while (nh_ns.ok()) {
+      {
+        std::unique_lock<std::mutex> lock(mtx_frames);
+        frames_cond.wait_for(lock, std::chrono::milliseconds(100),
+            [this]() { return !frames.empty(); });
+        datas.clear();
+        datas.swap(frames);
+      }
+      if (datas.empty()) continue;
+
       // Check for subscribers
       int left_mono_SubNumber = pub_left_mono.getNumSubscribers();
       int left_color_SubNumber = pub_left_color.getNumSubscribers();
+      int left_compressed_SubNumber = pub_left_compressed.getNumSubscribers();
       int right_mono_SubNumber = pub_right_mono.getNumSubscribers();
       int right_color_SubNumber = pub_right_color.getNumSubscribers();
       int depth_SubNumber = pub_depth.getNumSubscribers();
       int points_SubNumber = pub_points.getNumSubscribers();
-      int imu_SubNumber = pub_imu.getNumSubscribers();
-      int temp_SubNumber = pub_temp.getNumSubscribers();
-
-      bool img_Sub = (left_mono_SubNumber + right_mono_SubNumber +
-        left_color_SubNumber + right_color_SubNumber +
-        depth_SubNumber + points_SubNumber) > 0;
-      bool imu_Sub = (imu_SubNumber + temp_SubNumber) > 0;
       // publish points, the depth mode must be DEPTH_RAW.
       bool points_subscribed = (points_SubNumber > 0) && (depth_mode == 0);
 
-      auto &&left_color = mynteye->RetrieveImages(
-        mynteye::ImageType::IMAGE_LEFT_COLOR);
-      auto &&right_color = mynteye->RetrieveImages(
-        mynteye::ImageType::IMAGE_RIGHT_COLOR);
-      auto &&image_depth = mynteye->RetrieveImages(
-        mynteye::ImageType::IMAGE_DEPTH);
-      img_count += left_color.size();
-
-      auto &&motion_datas = mynteye->RetrieveMotions();
-      imu_count += motion_datas.size();
+      auto &&left_color = datas[mynteye::ImageType::IMAGE_LEFT_COLOR];
+      auto &&right_color = datas[mynteye::ImageType::IMAGE_RIGHT_COLOR];
+      auto &&image_depth = datas[mynteye::ImageType::IMAGE_DEPTH];
 
       {
-        bool left_color_ok = false;
-        ros::Time leftTimeStamp;
         if (left_color_SubNumber > 0
+            || left_compressed_SubNumber > 0
             || points_subscribed
             || left_mono_SubNumber > 0
             || depth_SubNumber > 0) {
           for (auto &&left : left_color) {
             if (left.img) {
               left_color_ok = true;
+              last_left = left.img;
               leftTimeStamp = hardTimeToSoftTime(left.img_info -> timestamp);
 
               static std::size_t count = 0;
               ++count;
+              // the jpeg is decoded only for the raw subscribers
+              if (left_compressed_SubNumber > 0) {
+                publishCompressed(left.img, leftTimeStamp);
+              }
               if (left_color_SubNumber > 0) {
                 publishColor(left_color_frame_id, pub_left_color,
-                  left.img, leftTimeStamp, &color_left, count);
+                  &left_color_msgs, left_info, left.img, leftTimeStamp,
+                  count);
               }
               if (left_mono_SubNumber > 0) {
                 publishMono(left_mono_frame_id, pub_left_mono,
-                  left.img, leftTimeStamp, &mono_left, count);
+                  &left_mono_msgs, left_info, left.img, leftTimeStamp,
+                  count);
               }
             } else {
               static int k_l = 0;
@@ -371,17 +667,26 @@ class MYNTEYEWrapperNodelet : public nodelet::Nodelet {
           }
         }
 
-        bool depth_ok = false;
-        if (depth_SubNumber > 0 ||
-            points_subscribed && left_color_ok) {
-          for (auto &&depth : image_depth) {
-            depth_ok = true;
-            publishDepth(depth.img, leftTimeStamp, &depth_mat);
+        for (auto &&depth : image_depth) {
+          if (!depth.img) continue;
+          if (depth_SubNumber > 0) {
+            publishDepth(depth.img, leftTimeStamp);
+          }
+          // every depth frame, the generator drops if it falls behind
+          if (points_subscribed && last_left) {
+            pointcloud_generator->Push(last_left, depth.img, leftTimeStamp);
           }
         }
 
-        if (points_subscribed && left_color_ok && depth_ok) {
-          pointcloud_generator->Push(color_left, depth_mat, leftTimeStamp);
+        if (scan) {
+          // drain scans even if no subscriber
+          auto &&scans = mynteye->RetrieveLaserScans();
+          if (pub_scan.getNumSubscribers() > 0) {
+            ros::Time stamp = left_color_ok ? leftTimeStamp : ros::Time::now();
+            for (auto &&laser_scan : scans) {
+              publishScan(laser_scan, stamp);
+            }
+          }
         }
 
         for (auto &&right : right_color) {
@@ -396,11 +701,13 @@ class MYNTEYEWrapperNodelet : public nodelet::Nodelet {
               ++count;
               if (right_color_SubNumber > 0) {
                 publishColor(right_color_frame_id, pub_right_color,
-                  right.img, rightTimeStamp, &color_right, count);
+                  &right_color_msgs, right_info, right.img, rightTimeStamp,
+                  count);
               }
               if (right_mono_SubNumber > 0) {
                 publishMono(right_mono_frame_id, pub_right_mono,
-                  right.img, rightTimeStamp, &mono_right, count);
+                  &right_mono_msgs, right_info, right.img, rightTimeStamp,
+                  count);
               }
             } else {
               static int k_r = 0;
@@ -409,29 +716,20 @@ class MYNTEYEWrapperNodelet : public nodelet::Nodelet {
             }
           }
         }
-        if (imu_Sub) {
-          if (motion_datas.size() > 0) {
-            for (auto data : motion_datas) {
-              ros::Time stamp = hardTimeToSoftTime(data.imu->timestamp);
-              if (data.imu) {
-                if (data.imu->flag == 1) {  // accelerometer
-                  imu_accel = data.imu;
-                  publishImu(stamp, temp_SubNumber > 0);
-                } else if (data.imu->flag == 2) {  // gyroscope
-                  imu_gyro = data.imu;
-                  publishImu(stamp, temp_SubNumber > 0);
-                } else {
-                  NODELET_WARN_STREAM("Imu type is unknown");
-                }
-              } else {
-                NODELET_WARN_STREAM("Motion data is empty");
-              }
-            }
-          }
-        }
       }
     }
 
+    {
+      std::lock_guard<std::mutex> _(mtx_streams);
+      streams_ready = false;
+    }
+    for (auto &&type : {mynteye::ImageType::IMAGE_LEFT_COLOR,
+        mynteye::ImageType::IMAGE_RIGHT_COLOR,
+        mynteye::ImageType::IMAGE_DEPTH}) {
+      mynteye->SetStreamCallback(type, nullptr);
+    }
+    mynteye->SetImuCallback(nullptr);
+    imu_poll_thread->join();
     mynteye.reset();
   }
 
@@ -450,6 +748,9 @@ class MYNTEYEWrapperNodelet : public nodelet::Nodelet {
     state_awb = true;
     ir_intensity = 0;
     gravity = 9.8;
+    imu_batch = 1;
+    depth_filter = false;
+    scan = false;
     std::uint32_t timeBeginPointOnDevice = 0;
 
     nh_ns.getParam("dev_index", dev_index);
@@ -462,6 +763,9 @@ class MYNTEYEWrapperNodelet : public nodelet::Nodelet {
     nh_ns.getParam("state_awb", state_awb);
     nh_ns.getParam("ir_intensity", ir_intensity);
     nh_ns.getParam("gravity", gravity);
+    nh_ns.getParam("imu_batch", imu_batch);
+    nh_ns.getParam("depth_filter", depth_filter);
+    nh_ns.getParam("scan", scan);
 
     base_frame_id = "mynteye_link";
     left_mono_frame_id = "mynteye_left_mono_frame";
@@ -472,6 +776,7 @@ class MYNTEYEWrapperNodelet : public nodelet::Nodelet {
     points_frame_id = "mynteye_points_frame";
     imu_frame_id = "mynteye_imu_frame";
     temp_frame_id = "mynteye_temp_frame";
+    scan_frame_id = "mynteye_scan_frame";
     nh_ns.getParam("base_frame_id", base_frame_id);
     nh_ns.getParam("left_mono_frame", left_mono_frame_id);
     nh_ns.getParam("left_color_frame", left_color_frame_id);
@@ -481,6 +786,7 @@ class MYNTEYEWrapperNodelet : public nodelet::Nodelet {
     nh_ns.getParam("points_frame", points_frame_id);
     nh_ns.getParam("imu_frame", imu_frame_id);
     nh_ns.getParam("temp_frame", temp_frame_id);
+    nh_ns.getParam("scan_frame", scan_frame_id);
     NODELET_INFO_STREAM("base_frame: " << base_frame_id);
     NODELET_INFO_STREAM("left_mono_frame: " << left_mono_frame_id);
     NODELET_INFO_STREAM("left_color_frame: " << left_color_frame_id);
@@ -490,6 +796,7 @@ class MYNTEYEWrapperNodelet : public nodelet::Nodelet {
     NODELET_INFO_STREAM("points_frame: " << points_frame_id);
     NODELET_INFO_STREAM("imu_frame: " << imu_frame_id);
     NODELET_INFO_STREAM("temp_frame: " << temp_frame_id);
+    NODELET_INFO_STREAM("scan_frame: " << scan_frame_id);
 
     std::string left_mono_topic = "mynteye/left/image_mono";
     std::string left_color_topic = "mynteye/left/image_color";
@@ -499,6 +806,7 @@ class MYNTEYEWrapperNodelet : public nodelet::Nodelet {
     std::string points_topic = "mynteye/points";
     std::string imu_topic = "mynteye/imu";
     std::string temp_topic = "mynteye/temp";
+    std::string scan_topic = "mynteye/scan";
 
     nh_ns.getParam("left_mono_topic", left_mono_topic);
     nh_ns.getParam("left_color_topic", left_color_topic);
@@ -508,6 +816,7 @@ class MYNTEYEWrapperNodelet : public nodelet::Nodelet {
     nh_ns.getParam("points_topic", points_topic);
     nh_ns.getParam("imu_topic", imu_topic);
     nh_ns.getParam("temp_topic", temp_topic);
+    nh_ns.getParam("scan_topic", scan_topic);
 
     // MYNTEYE objects
     mynteye.reset(new mynteye::Camera);
@@ -558,56 +867,68 @@ class MYNTEYEWrapperNodelet : public nodelet::Nodelet {
     params.state_ae = state_ae;
     params.state_awb = state_awb;
     params.ir_intensity = ir_intensity;
+    // right enabled streams 2560x720, as side by side modes did before
+    right_enabled =
+        params.stream_mode == mynteye::StreamMode::STREAM_2560x720 ||
+        params.stream_mode == mynteye::StreamMode::STREAM_1280x480;
+    // a jpeg cut from a side by side frame is decoded, so not passed through
+    compressed_passthrough = !right_enabled &&
+        params.color_stream_format == mynteye::StreamFormat::STREAM_MJPG;
 
     // Image publishers
 
+    // streams are enabled and disabled as subscribers come and go
+    image_transport::SubscriberStatusCallback image_status = boost::bind(
+        &MYNTEYEWrapperNodelet::imageStatus, this, _1);
+    ros::SubscriberStatusCallback status = boost::bind(
+        &MYNTEYEWrapperNodelet::status, this, _1);
     image_transport::ImageTransport it_mynteye(nh);
+    if (compressed_passthrough) {
+      // left compressed is published of the camera jpeg, not by the plugin
+      nh.setParam(nh.resolveName(left_color_topic) + "/disable_pub_plugins",
+          std::vector<std::string>{"image_transport/compressed"});
+    }
     // left
-    pub_left_mono = it_mynteye.advertiseCamera(left_mono_topic, 1);
+    pub_left_mono = it_mynteye.advertiseCamera(left_mono_topic, 1,
+        image_status, image_status, status, status);
     NODELET_INFO_STREAM("Advertized on topic " << left_mono_topic);
-    pub_left_color = it_mynteye.advertiseCamera(left_color_topic, 1);
+    pub_left_color = it_mynteye.advertiseCamera(left_color_topic, 1,
+        image_status, image_status, status, status);
     NODELET_INFO_STREAM("Advertized on topic " << left_color_topic);
+    if (compressed_passthrough) {
+      std::string left_compressed_topic = left_color_topic + "/compressed";
+      pub_left_compressed = nh.advertise<sensor_msgs::CompressedImage>(
+          left_compressed_topic, 1, status, status);
+      NODELET_INFO_STREAM("Advertized on topic " << left_compressed_topic);
+    }
     // right
-    pub_right_mono = it_mynteye.advertiseCamera(right_mono_topic, 1);
+    pub_right_mono = it_mynteye.advertiseCamera(right_mono_topic, 1,
+        image_status, image_status, status, status);
     NODELET_INFO_STREAM("Advertized on topic " << right_mono_topic);
-    pub_right_color = it_mynteye.advertiseCamera(right_color_topic, 1);
+    pub_right_color = it_mynteye.advertiseCamera(right_color_topic, 1,
+        image_status, image_status, status, status);
     NODELET_INFO_STREAM("Advertized on topic " << right_color_topic);
     // depth
-    pub_depth = it_mynteye.advertiseCamera(depth_topic, 1);
+    pub_depth = it_mynteye.advertiseCamera(depth_topic, 1,
+        image_status, image_status, status, status);
     NODELET_INFO_STREAM("Advertized on topic " << depth_topic);
     // points
-    pub_points = nh.advertise<sensor_msgs::PointCloud2>(points_topic, 1);
+    pub_points = nh.advertise<sensor_msgs::PointCloud2>(points_topic, 1,
+        status, status);
     NODELET_INFO_STREAM("Advertized on topic " << points_topic);
     // imu
-    pub_imu = nh.advertise<sensor_msgs::Imu>(imu_topic, 1);
+    pub_imu = nh.advertise<sensor_msgs::Imu>(imu_topic, 1, status, status);
     NODELET_INFO_STREAM("Advertized on topic " << imu_topic);
     // temp
-    pub_temp = nh.advertise<mynteye_wrapper_d::Temp>(temp_topic, 1);
+    pub_temp = nh.advertise<mynteye_wrapper_d::Temp>(temp_topic, 1,
+        status, status);
     NODELET_INFO_STREAM("Advertized on topic " << temp_topic);
-
-    double cx, cy, fx, fy;
-    std::int32_t points_frequency;
-    nh_ns.getParam("cx", cx);
-    nh_ns.getParam("cy", cy);
-    nh_ns.getParam("fx", fx);
-    nh_ns.getParam("fy", fy);
-    nh_ns.getParam("points_frequency", points_frequency);
-
-    pointcloud_generator.reset(new PointCloudGenerator(
-      {
-        1000.0,  // factor, mm > m
-        cx > 0 ? cx : 682.3,  // cx
-        cy > 0 ? cy : 254.9,  // cy
-        fx > 0 ? fx : 979.8,  // fx
-        fy > 0 ? fy : 942.8,  // fy
-      },
-      [this](sensor_msgs::PointCloud2 msg) {
-        // msg.header.seq = 0;
-        // msg.header.stamp = ros::Time::now();
-        msg.header.frame_id = points_frame_id;
-        pub_points.publish(msg);
-        // NODELET_INFO_STREAM("Publish points");
-      }, points_frequency));
+    // scan
+    if (scan) {
+      pub_scan = nh.advertise<sensor_msgs::LaserScan>(scan_topic, 1,
+          status, status);
+      NODELET_INFO_STREAM("Advertized on topic " << scan_topic);
+    }
 
     device_poll_thread = boost::shared_ptr<boost::thread>(new boost::thread(
         boost::bind(&MYNTEYEWrapperNodelet::device_poll, this)));
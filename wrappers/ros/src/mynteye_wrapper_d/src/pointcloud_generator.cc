@@ -13,19 +13,30 @@
 // limitations under the License.
 #include "pointcloud_generator.h"
 
+#include <algorithm>
+#include <stdexcept>
 #include <utility>
 
+#include <boost/make_shared.hpp>
+
+#include <ros/console.h>
+
 MYNTEYE_USE_NAMESPACE
 
 PointCloudGenerator::PointCloudGenerator(CameraIntrinsics in, Callback callback,
-    std::int32_t frequency)
+    std::int32_t frequency, std::size_t slots)
   : in_(std::move(in)),
     callback_(std::move(callback)),
-    rate_(nullptr),
+    period_(std::chrono::steady_clock::duration::zero()),
     running_(false),
-    generating_(false) {
+    taken_(0),
+    next_(0) {
   if (frequency > 0) {
-    rate_.reset(new mynteye::Rate(frequency));
+    period_ = std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+        std::chrono::duration<double>(1. / frequency));
+  }
+  for (std::size_t i = 0, n = std::max<std::size_t>(1, slots); i < n; i++) {
+    slots_.emplace_back(new Slot());
   }
   Start();
 }
@@ -34,109 +45,156 @@ PointCloudGenerator::~PointCloudGenerator() {
   Stop();
 }
 
-bool PointCloudGenerator::Push(cv::Mat color, cv::Mat depth, ros::Time stamp) {
+bool PointCloudGenerator::Push(const Image::pointer& color,
+    const Image::pointer& depth, ros::Time stamp) {
   if (!running_) {
     throw new std::runtime_error("Start first!");
   }
-  if (generating_) return false;
+  if (!color || !depth) return false;
+  bool dropped = false;
   {
     std::lock_guard<std::mutex> _(mutex_);
-    if (generating_) return false;
-    generating_ = true;
-    color_ = color.clone();
-    depth_ = depth.clone();
-    stamp_ = stamp;
+    auto now = std::chrono::steady_clock::now();
+    if (period_ != std::chrono::steady_clock::duration::zero()) {
+      if (now - last_push_ < period_) return false;
+      last_push_ = now;
+    }
+    if (frames_.size() >= slots_.size()) {
+      frames_.pop_front();
+      dropped = true;
+    }
+    frames_.push_back({color, depth, stamp});
   }
   condition_.notify_one();
-  return true;
+  return !dropped;
 }
 
 void PointCloudGenerator::Start() {
-  if (running_) return;
   {
     std::lock_guard<std::mutex> _(mutex_);
     if (running_) return;
     running_ = true;
   }
-  thread_ = std::thread(&PointCloudGenerator::Run, this);
+  for (auto &&slot : slots_) {
+    slot->thread = std::thread(&PointCloudGenerator::Run, this, slot.get());
+  }
 }
 
 void PointCloudGenerator::Stop() {
-  if (!running_) return;
   {
     std::lock_guard<std::mutex> _(mutex_);
     if (!running_) return;
     running_ = false;
-    generating_ = true;
+    frames_.clear();
   }
-  condition_.notify_one();
-  if (thread_.joinable()) {
-    thread_.join();
+  condition_.notify_all();
+  delivered_.notify_all();
+  for (auto &&slot : slots_) {
+    if (slot->thread.joinable()) {
+      slot->thread.join();
+    }
   }
 }
 
-void PointCloudGenerator::Run() {
-  while (running_) {
+void PointCloudGenerator::Run(Slot* slot) {
+  while (true) {
+    Frame frame;
+    std::uint64_t order;
     {
       std::unique_lock<std::mutex> lock(mutex_);
-      condition_.wait(lock, [this] { return generating_; });
+      condition_.wait(lock, [this] { return !running_ || !frames_.empty(); });
       if (!running_) break;
+      frame = std::move(frames_.front());
+      frames_.pop_front();
+      order = taken_++;
     }
 
-    sensor_msgs::PointCloud2 msg;
-    msg.header.stamp = stamp_;
-    msg.width = depth_.cols;
-    msg.height = depth_.rows;
-    msg.is_dense = true;
+    auto &&msg = Generate(slot, frame);
 
-    sensor_msgs::PointCloud2Modifier modifier(msg);
+    {
+      // in the order taken, a slot waits for the ones before it
+      std::unique_lock<std::mutex> lock(mutex_);
+      delivered_.wait(lock, [this, order] {
+        return !running_ || next_ == order;
+      });
+      if (!running_) break;
+    }
+    if (msg && callback_) {
+      callback_(msg);
+    }
+    {
+      std::lock_guard<std::mutex> _(mutex_);
+      ++next_;
+    }
+    delivered_.notify_all();
+  }
+}
 
+sensor_msgs::PointCloud2Ptr PointCloudGenerator::Generate(Slot* slot,
+    const Frame& frame) {
+  auto &&depth = frame.depth;
+  auto &&color = frame.color;
+  if (depth->format() != ImageFormat::DEPTH_RAW) {
+    ROS_ERROR_STREAM("Points depth must be DEPTH_RAW");
+    return nullptr;
+  }
+  if (color->width() != depth->width() ||
+      color->height() != depth->height()) {
+    ROS_ERROR_STREAM("Points color must be of the depth size");
+    return nullptr;
+  }
+
+  // intrinsics size follows the depth, the rays are recomputed if changed
+  std::shared_ptr<mynteye::PointCloud> points;
+  {
+    std::lock_guard<std::mutex> _(mutex_);
+    if (!points_ || points_->GetIntrinsics().width != depth->width() ||
+        points_->GetIntrinsics().height != depth->height()) {
+      in_.width = depth->width();
+      in_.height = depth->height();
+      points_ = std::make_shared<mynteye::PointCloud>(in_);
+    }
+    points = points_;
+  }
+
+  const std::uint8_t* rgb = color->cdata();
+  auto format = color->format();
+  if (format != ImageFormat::COLOR_RGB && format != ImageFormat::COLOR_BGR) {
+    // converted into the buffer of the slot, the frame is not written
+    slot->rgb.resize(static_cast<std::size_t>(color->width()) *
+        color->height() * 3);
+    if (!color->ConvertTo(ImageFormat::COLOR_RGB, slot->rgb.data())) {
+      ROS_ERROR_STREAM("Points color can not be converted to RGB");
+      return nullptr;
+    }
+    rgb = slot->rgb.data();
+    format = ImageFormat::COLOR_RGB;
+  }
+
+  // the message of the slot, once nobody holds it any more
+  if (!slot->msg || !slot->msg.unique()) {
+    slot->msg = boost::make_shared<sensor_msgs::PointCloud2>();
+  }
+  auto &&msg = slot->msg;
+  msg->header.stamp = frame.stamp;
+  msg->is_dense = true;
+
+  // x y z rgb at offsets 0 4 8 12, the layout of mynteye::PointXYZRGB
+  sensor_msgs::PointCloud2Modifier modifier(*msg);
+  if (msg->fields.empty()) {
     modifier.setPointCloud2Fields(4,
         "x", 1, sensor_msgs::PointField::FLOAT32,
         "y", 1, sensor_msgs::PointField::FLOAT32,
         "z", 1, sensor_msgs::PointField::FLOAT32,
         "rgb", 1, sensor_msgs::PointField::FLOAT32);
-    modifier.setPointCloud2FieldsByString(2, "xyz", "rgb");
-
-    sensor_msgs::PointCloud2Iterator<float> iter_x(msg, "x");
-    sensor_msgs::PointCloud2Iterator<float> iter_y(msg, "y");
-    sensor_msgs::PointCloud2Iterator<float> iter_z(msg, "z");
-
-    sensor_msgs::PointCloud2Iterator<uchar> iter_r(msg, "r");
-    sensor_msgs::PointCloud2Iterator<uchar> iter_g(msg, "g");
-    sensor_msgs::PointCloud2Iterator<uchar> iter_b(msg, "b");
-
-    for (int m = 0; m < depth_.rows; m++) {
-      for (int n = 0; n < depth_.cols; n++) {
-        // get depth value at (m, n)
-        ushort d = depth_.ptr<ushort>(m)[n];
-        // when d is equal 0 or 4096 means no depth
-        if (d == 0 || d == 4096)
-          continue;
-
-        *iter_z = d / in_.factor;
-        *iter_x = (n - in_.cx) * *iter_z / in_.fx;
-        *iter_y = (m - in_.cy) * *iter_z / in_.fy;
-
-        *iter_r = color_.ptr<uchar>(m)[n * 3 + 2];
-        *iter_g = color_.ptr<uchar>(m)[n * 3 + 1];
-        *iter_b = color_.ptr<uchar>(m)[n * 3];
-
-        ++iter_x; ++iter_y; ++iter_z;  // NOLINT
-        ++iter_r; ++iter_g; ++iter_b;  // NOLINT
-      }
-    }
-
-    if (callback_) {
-      callback_(std::move(msg));
-    }
-
-    if (rate_) {
-      rate_->Sleep();
-    }
-    {
-      std::lock_guard<std::mutex> _(mutex_);
-      generating_ = false;
-    }
   }
+  modifier.resize(static_cast<std::size_t>(depth->width()) * depth->height());
+
+  std::size_t n = points->Generate(
+      reinterpret_cast<const std::uint16_t*>(depth->cdata()),
+      depth->width() * sizeof(std::uint16_t), rgb, color->width() * 3, format,
+      reinterpret_cast<mynteye::PointXYZRGB*>(msg->data.data()),
+      mynteye::PointCloudLayout::COMPACT);
+  modifier.resize(n);
+  return msg;
 }
@@ -15,61 +15,92 @@
 #define MYNTEYE_WRAPPER_POINTCLOUD_GENERATOR_H_
 #pragma once
 
+#include <chrono>
 #include <condition_variable>
+#include <cstdint>
+#include <deque>
 #include <functional>
 #include <memory>
 #include <mutex>
 #include <thread>
-
-#include <opencv2/core/core.hpp>
+#include <vector>
 
 #include <sensor_msgs/PointCloud2.h>
 #include <sensor_msgs/point_cloud2_iterator.h>
 
-#include "mynteye/util/rate.h"
+#include "mynteye/image.h"
+#include "mynteye/point_cloud.h"
 
 MYNTEYE_BEGIN_NAMESPACE
 
-struct CameraIntrinsics {
-  double factor;
-  double cx;
-  double cy;
-  double fx;
-  double fy;
-};
-
+/**
+ * Generate point clouds of color and depth frames on slots threads.
+ *
+ * Frames are held by pointer, the SDK does not write a frame once passed.
+ * Each slot generates a frame into a message of its own, which is reused
+ * once the callback and subscribers have released it. The points of a frame
+ * are generated in row bands on all cores by mynteye::PointCloud, so slots
+ * overlap the conversion and publishing of one cloud with the next.
+ *
+ * Clouds are passed to the callback in the order of their frames. If all
+ * slots are busy, up to slots frames wait, then the oldest one is dropped.
+ */
 class PointCloudGenerator {
  public:
-  using Callback = std::function<void(sensor_msgs::PointCloud2)>;
+  using Callback = std::function<void(const sensor_msgs::PointCloud2Ptr&)>;
 
+  /**
+   * @param frequency the most clouds per second, 0 for every frame.
+   */
   PointCloudGenerator(CameraIntrinsics in, Callback callback,
-      std::int32_t frequency = 0);
+      std::int32_t frequency = 0, std::size_t slots = 2);
   ~PointCloudGenerator();
 
-  bool Push(cv::Mat color, cv::Mat depth, ros::Time stamp);
+  /**
+   * Push a color frame and its DEPTH_RAW depth to generate points.
+   * @return false if dropped by frequency or for a newer frame.
+   */
+  bool Push(const Image::pointer& color, const Image::pointer& depth,
+      ros::Time stamp);
 
  private:
+  struct Frame {
+    Image::pointer color;
+    Image::pointer depth;
+    ros::Time stamp;
+  };
+
+  struct Slot {
+    sensor_msgs::PointCloud2Ptr msg;
+    /** Color converted to RGB, if not RGB */
+    std::vector<std::uint8_t> rgb;
+    std::thread thread;
+  };
+
   void Start();
   void Stop();
 
-  void Run();
+  void Run(Slot* slot);
+  sensor_msgs::PointCloud2Ptr Generate(Slot* slot, const Frame& frame);
 
   CameraIntrinsics in_;
   Callback callback_;
+  std::chrono::steady_clock::duration period_;
+  std::chrono::steady_clock::time_point last_push_;
 
-  std::unique_ptr<mynteye::Rate> rate_;
+  /** Rebuilt by a slot if the depth size changes, under mutex_ */
+  std::shared_ptr<mynteye::PointCloud> points_;
 
   std::mutex mutex_;
   std::condition_variable condition_;
+  std::condition_variable delivered_;
 
   bool running_;
-  std::thread thread_;
-
-  cv::Mat color_;
-  cv::Mat depth_;
-  ros::Time stamp_;
-
-  bool generating_;
+  std::deque<Frame> frames_;
+  std::vector<std::unique_ptr<Slot>> slots_;
+  /** Order of the frame a slot took, and of the next to pass */
+  std::uint64_t taken_;
+  std::uint64_t next_;
 };
 
 MYNTEYE_END_NAMESPACE